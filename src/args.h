@@ -2,10 +2,31 @@
 #define ARGS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "timing.h"
+
+enum Emit {
+    EMIT_AST,                       // the tree, printed back as source
+    EMIT_C,                         // C11, see emitc.h
+};
 
 struct Args {
-    int   verbose;
-    char* output;
+    int             verbose;
+    char*           output;         // NULL for stdout
+    enum Emit       emit;
+    int             fold;           // print the tree with constants folded
+    size_t          jobs;           // 0 is one per cpu
+    char*           cache_dir;      // NULL when not caching
+    enum TimeReport time_report;    // printed to stderr at exit
+    int             mem_report;     // printed to stderr at exit
+    int             print_ir;       // the optimized IR instead of printing
+    int             print_layout;   // the memory layout of every type
+    int             time_passes;    // printed to stderr per file
+    int             run;            // func main instead of printing
+    int             test;           // the tests instead of printing
+    int             native;         // run and test on machine code
+    int             object;         // -c, an ELF object of every file
 };
 
 extern struct Args args;
@@ -1,123 +1,673 @@
+#include <inttypes.h>
+// for: PRIu64
 #include <stdio.h>
+#include <string.h>
+// for: strpbrk, strncmp
+#include <sys/mman.h>
+// for: munmap
 
 #include "ast.h"
+#include "memory.h"
+#include "symbol.h"
 
-static void printPath(FILE *stream, struct Path* path) {
-    while (path != NULL) {
-        fprintf(
-            stream,
-            "%.*s",
-            (int) path -> name.length,
-            path -> name.string
+void initAST(struct AST* ast, struct Symbols* symbols) {
+    (*ast) = (struct AST) {
+        .symbols = symbols
+    };
+}
+
+// borrowed arrays have no capacity and belong to the mapping
+#define FREE_NODES(name)                        \
+    if (ast -> name.capacity != 0) {            \
+        memoryFree(ast -> name.items);          \
+    }
+
+void freeAST(struct AST* ast) {
+    AST_ARRAYS(FREE_NODES)
+    if (ast -> mapped != NULL) {
+        munmap(ast -> mapped, ast -> mapped_size);
+    }
+    (*ast) = (struct AST) {
+        .symbols = ast -> symbols
+    };
+}
+
+struct Path importedPath(struct AST* ast, struct Path path) {
+    if (path.is_relative || path.names.count != 1) {
+        return path;
+    }
+    uint32_t name = ast -> names.items[path.names.start];
+    for (uint32_t i = 0; i < ast -> imports.count; i++) {
+        struct Import import = ast -> imports.items[i];
+        struct Range names = import.path.names;
+        uint32_t as = import.is_rename
+            ? import.as
+            : ast -> names.items[names.start + names.count - 1];
+        if (as == name) {
+            return import.path;
+        }
+    }
+    return path;
+}
+
+bool pathIs(struct AST* ast, struct Path path, const char* str) {
+    if (path.is_relative) {
+        return false;
+    }
+    for (uint32_t i = 0; i < path.names.count; i++) {
+        if (i != 0 && *str++ != '.') {
+            return false;
+        }
+        struct String name = symbolString(
+            ast -> symbols,
+            ast -> names.items[path.names.start + i]
         );
-        path = path -> next;
+        if (strncmp(str, name.string, name.length) != 0) {
+            return false;
+        }
+        str += name.length;
+    }
+    return *str == 0;
+}
+
+static void printName(FILE *stream, struct AST* ast, uint32_t name) {
+    struct String string = symbolString(ast -> symbols, name);
+    fprintf(stream, "%.*s", (int) string.length, string.string);
+}
+
+static void printPath(FILE* stream, struct AST* ast, struct Path path) {
+    for (uint32_t i = 0; i < path.names.count; i++) {
+        if (i != 0 || path.is_relative) {
+            fprintf(stream, ".");
+        }
+        printName(stream, ast, ast -> names.items[path.names.start + i]);
     }
 }
 
-static void printImport(FILE *stream, struct Import import) {
+static void printImport(FILE* stream, struct AST* ast, struct Import import) {
     fprintf(stream, "import ");
-    printPath(stream, import.path);
+    printPath(stream, ast, import.path);
     if (import.is_rename) {
-        fprintf(
-            stream,
-            " as %.*s",
-            (int) import.as.length,
-            import.as.string
-        );
+        fprintf(stream, " as ");
+        printName(stream, ast, import.as);
     }
     fprintf(stream, ";\n");
 }
 
-static void printTypeParams(FILE *stream, struct TypeParams* params) {
-    if (params != NULL) {
+static void printTypeParams(
+    FILE*        stream,
+    struct AST*  ast,
+    struct Range params
+) {
+    if (params.count != 0) {
         fprintf(stream, "<");
-        while (params != NULL) {
-            fprintf(
-                stream,
-                "%.*s",
-                (int) params -> name.length,
-                params -> name.string
-            );
-
-            params = params -> next;
-            if (params -> next == NULL) {
-                break;
+        for (uint32_t i = 0; i < params.count; i++) {
+            if (i != 0) {
+                fprintf(stream, ", ");
             }
-            fprintf(stream, ", ");
+            printName(stream, ast, ast -> names.items[params.start + i]);
         }
         fprintf(stream, ">");
     }
 }
 
-static void printTypeHeader(FILE *stream, struct TypeHeader header) {
-    fprintf(
-        stream,
-        "%.*s ",
-        (int) header.name.length,
-        header.name.string
-    );
-    printTypeParams(stream, header.params);
+static void printTypeHeader(
+    FILE*             stream,
+    struct AST*       ast,
+    struct TypeHeader header
+) {
+    printName(stream, ast, header.name);
+    fprintf(stream, " ");
+    printTypeParams(stream, ast, header.params);
 }
 
-static void printType(FILE *stream, struct Type type);
-static void printTypeArgs(FILE *stream, struct TypeArgs* args) {
-    if (args != NULL) {
+static void printType(FILE* stream, struct AST* ast, struct Type type);
+static void printTypeArgs(FILE* stream, struct AST* ast, struct Range args) {
+    if (args.count != 0) {
         fprintf(stream, "(");
-        while (args != NULL) {
-            printType(
-                stream,
-                args -> type
-            );
-
-            args = args -> next;
-            if (args -> next == NULL) {
-                break;
+        for (uint32_t i = 0; i < args.count; i++) {
+            if (i != 0) {
+                fprintf(stream, ", ");
             }
-            fprintf(stream, ", ");
+            printType(stream, ast, ast -> types.items[args.start + i]);
         }
         fprintf(stream, ")");
     }
 }
 
-static void printType(FILE *stream, struct Type type) {
-    fprintf(
-        stream,
-        "%.*s",
-        (int) type.name.length,
-        type.name.string
-    );
-    printTypeArgs(stream, type.args);
+static void printType(FILE* stream, struct AST* ast, struct Type type) {
+    if (type.is_ref) {
+        fprintf(stream, "ref ");
+    }
+    printName(stream, ast, type.name);
+    printTypeArgs(stream, ast, type.args);
+}
+
+static void printTypeFild(FILE* stream, struct AST* ast, struct TypeFild fild) {
+    fprintf(stream, "    ");
+    printName(stream, ast, fild.name);
+    fprintf(stream, ": ");
+    printType(stream, ast, fild.type);
+    fprintf(stream, ";\n");
+}
+
+static void printTypeFildList(
+    FILE*        stream,
+    struct AST*  ast,
+    struct Range filds
+) {
+    fprintf(stream, "{\n");
+    for (uint32_t i = 0; i < filds.count; i++) {
+        printTypeFild(stream, ast, ast -> filds.items[filds.start + i]);
+    }
+    fprintf(stream, "}");
+}
+
+static void printEnumFildList(
+    FILE*        stream,
+    struct AST*  ast,
+    struct Range filds
+) {
+    fprintf(stream, "{\n");
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[filds.start + i];
+        if (fild.type == ENUM_FILD_TYPED) {
+            printTypeFild(stream, ast, fild.fild);
+        } else {
+            fprintf(stream, "    ");
+            printName(stream, ast, fild.fild.name);
+            fprintf(stream, ";\n");
+        }
+    }
+    fprintf(stream, "}");
 }
 
-static void printTypeDecl(FILE *stream, struct TypeDecl type) {
+static void printTypeDecl(FILE* stream, struct AST* ast, struct TypeDecl type) {
     fprintf(stream, "\n");
     if (type.is_exported) {
-        printf("export ");
+        fprintf(stream, "export ");
     }
     fprintf(stream, "type ");
-    printTypeHeader(stream, type.header);
+    printTypeHeader(stream, ast, type.header);
     switch (type.type) {
     case TYPE_TYPE:
         fprintf(stream, "= ");
-        printType(stream, type._type);
+        printType(stream, ast, type._type);
+        break;
+    case TYPE_STRUCT:
+        printTypeFildList(stream, ast, type._struct);
+        break;
+    case TYPE_UNION:
+        fprintf(stream, "union ");
+        printTypeFildList(stream, ast, type._union);
+        break;
+    case TYPE_ENUM:
+        fprintf(stream, "enum ");
+        printEnumFildList(stream, ast, type._enum);
         break;
     }
-    
 
     fprintf(stream, ";\n");
 }
 
+static void printString(FILE* stream, struct AST* ast, uint32_t string) {
+    struct String text = symbolString(ast -> symbols, string);
+    fprintf(stream, "\"");
+    for (size_t i = 0; i < text.length; i++) {
+        unsigned char ch = text.string[i];
+        switch (ch) {
+        case '"':
+        case '\\':
+            fprintf(stream, "\\%c", ch);
+            break;
+        case '\n':
+            fprintf(stream, "\\n");
+            break;
+        case '\t':
+            fprintf(stream, "\\t");
+            break;
+        default:
+            if (ch < 0x20 || ch >= 0x7f) {
+                fprintf(stream, "\\x%02x", ch);
+            } else {
+                fprintf(stream, "%c", ch);
+            }
+        }
+    }
+    fprintf(stream, "\"");
+}
+
+static void printLiteral(
+    FILE*          stream,
+    struct AST*    ast,
+    struct Literal literal
+) {
+    switch (literal.type) {
+    case LITERAL_STING:
+        printString(stream, ast, literal.string);
+        break;
+    case LITERAL_FLOAT: {
+        // keeps a float that happens to be whole from reading as an int
+        char text[64];
+        long double value = ast -> floats.items[literal._float];
+        snprintf(text, sizeof(text), "%Lg", value);
+        fprintf(stream, "%s%s", text, strpbrk(text, ".eni") ? "" : ".0");
+        break;
+    }
+    case LITERAL_INT:
+        fprintf(stream, "%" PRIu64, literal._int);
+        break;
+    case LITERAL_NAME:
+        printPath(stream, ast, literal.name);
+        break;
+    }
+}
+
+static const char* const operator_names[] = {
+    [EXPRETION_REF]                = "ref ",
+    [EXPRETION_NEG]                = "-",
+    [EXPRETION_ADD]                = "+",
+    [EXPRETION_SUBTRACT]           = "-",
+    [EXPRETION_MULTIPLY]           = "*",
+    [EXPRETION_DIVIDE]             = "/",
+    [EXPRETION_MODULO]             = "%",
+    [EXPRETION_EQUAL]              = "==",
+    [EXPRETION_LESS_THEN]          = "<",
+    [EXPRETION_GREAT_THEN]         = ">",
+    [EXPRETION_NOT_EQUAL]          = "!=",
+    [EXPRETION_LESS_THEN_OR_EQUAL] = "<=",
+    [EXPRETION_GREA_THEN_OR_EQUAL] = ">=",
+    [EXPRETION_BITWIZE_NOT]        = "~",
+    [EXPRETION_BITWIZE_OR]         = "|",
+    [EXPRETION_BITWIZE_AND]        = "&",
+    [EXPRETION_LEFT_SHIFT]         = "<<",
+    [EXPRETION_RIGHT_SHIFT]        = ">>",
+    [EXPRETION_LOGICAL_NOT]        = "!",
+    [EXPRETION_LOGICAL_AND]        = "&&",
+    [EXPRETION_LOGICAL_OR]         = "||",
+};
+
+enum PrintItemType {
+    PRINT_EXPRETION,
+    PRINT_TYPE,
+    PRINT_OPERATOR,
+    PRINT_TEXT,
+};
+
+// what is left to print of an expretion, see printExpretion
+struct PrintItem {
+    enum PrintItemType type;
+    uint32_t           index;       // AST.expretions, AST.types
+    const char*        text;
+};
+
+#define PRINT(item_type, ...)                                               \
+    pushNode(stack, MEMORY_OTHER, ((struct PrintItem) {                     \
+        .type = (item_type), __VA_ARGS__                                    \
+    }))
+
+/*
+ * Every operator gets parens, so the output shows how it was parsed. Works
+ * off an explicit stack like the parser does, what is printed last is
+ * pushed first, so any nesting the parser takes prints too.
+ */
+static void printExpretion(FILE* stream, struct AST* ast, uint32_t index) {
+    NODES(struct PrintItem) stack = { 0 };
+    PRINT(PRINT_EXPRETION, .index = index);
+    while (stack.count != 0) {
+        struct PrintItem item = stack.items[--stack.count];
+        if (item.type == PRINT_TEXT) {
+            fprintf(stream, "%s", item.text);
+            continue;
+        }
+        if (item.type == PRINT_OPERATOR) {
+            fprintf(stream, " %s ", item.text);
+            continue;
+        }
+        if (item.type == PRINT_TYPE) {
+            printType(stream, ast, ast -> types.items[item.index]);
+            continue;
+        }
+        struct Expretion expr = ast -> expretions.items[item.index];
+        switch (expr.type) {
+        case EXPRETION_NONE:
+            break;
+        case EXPRETION_CAST:
+            fprintf(stream, "(");
+            PRINT(PRINT_TEXT, .text = ")");
+            PRINT(PRINT_TYPE, .index = expr.cast);
+            PRINT(PRINT_OPERATOR, .text = "as");
+            PRINT(PRINT_EXPRETION, .index = expr.expr);
+            break;
+        case EXPRETION_REF:
+        case EXPRETION_NEG:
+        case EXPRETION_BITWIZE_NOT:
+        case EXPRETION_LOGICAL_NOT:
+            fprintf(stream, "(%s", operator_names[expr.type]);
+            PRINT(PRINT_TEXT, .text = ")");
+            PRINT(PRINT_EXPRETION, .index = expr.expr);
+            break;
+        case EXPRETION_DEREF:
+            PRINT(PRINT_TEXT, .text = "[]");
+            PRINT(PRINT_EXPRETION, .index = expr.expr);
+            break;
+        case EXPRETION_GET:
+            PRINT(PRINT_TEXT, .text = "]");
+            PRINT(PRINT_EXPRETION, .index = expr.right);
+            PRINT(PRINT_TEXT, .text = "[");
+            PRINT(PRINT_EXPRETION, .index = expr.left);
+            break;
+        case EXPRETION_FUNCTION: {
+            struct Range args = expr.func.args;
+            printPath(stream, ast, expr.func.name);
+            fprintf(stream, "(");
+            PRINT(PRINT_TEXT, .text = ")");
+            for (uint32_t i = args.count; i > 0; i--) {
+                uint32_t arg = ast -> expretion_lists.items[args.start + i - 1];
+                PRINT(PRINT_EXPRETION, .index = arg);
+                if (i != 1) {
+                    PRINT(PRINT_TEXT, .text = ", ");
+                }
+            }
+            break;
+        }
+        case EXPRETION_LITERAL:
+            printLiteral(stream, ast, expr.literal);
+            break;
+        default:
+            fprintf(stream, "(");
+            PRINT(PRINT_TEXT, .text = ")");
+            PRINT(PRINT_EXPRETION, .index = expr.right);
+            PRINT(PRINT_OPERATOR, .text = operator_names[expr.type]);
+            PRINT(PRINT_EXPRETION, .index = expr.left);
+            break;
+        }
+    }
+    memoryFree(stack.items);
+}
+
+#undef PRINT
+
+static void printStatement(
+    FILE*       stream,
+    struct AST* ast,
+    uint32_t    index,
+    int         indent
+);
+
+// { statements } with the closing brace at indent
+static void printBlock(
+    FILE*        stream,
+    struct AST*  ast,
+    struct Range block,
+    int          indent
+) {
+    fprintf(stream, "{\n");
+    for (uint32_t i = 0; i < block.count; i++) {
+        printStatement(
+            stream,
+            ast,
+            ast -> statement_lists.items[block.start + i],
+            indent + 4
+        );
+    }
+    fprintf(stream, "%*s}", indent, "");
+}
+
+static void printLabel(
+    FILE*       stream,
+    struct AST* ast,
+    bool        is_label,
+    uint32_t    label
+) {
+    if (is_label) {
+        fprintf(stream, "@");
+        printName(stream, ast, label);
+        fprintf(stream, " ");
+    }
+}
+
+static void printCondition(FILE* stream, struct AST* ast, uint32_t condition) {
+    fprintf(stream, "(");
+    printExpretion(stream, ast, condition);
+    fprintf(stream, ") ");
+}
+
+static void printVar(FILE* stream, struct AST* ast, struct StatementVar var) {
+    fprintf(stream, "var ");
+    printName(stream, ast, var.name);
+    if (var.type != NODE_NONE) {
+        fprintf(stream, ": ");
+        printType(stream, ast, ast -> types.items[var.type]);
+    }
+    fprintf(stream, " = ");
+    printExpretion(stream, ast, var.value);
+    fprintf(stream, ";");
+}
+
+static void printSwitch(
+    FILE*                  stream,
+    struct AST*            ast,
+    struct StatementSwitch statement,
+    int                    indent
+) {
+    fprintf(stream, "switch ");
+    printCondition(stream, ast, statement.value);
+    fprintf(stream, "{\n");
+    for (uint32_t i = 0; i < statement.cases.count; i++) {
+        struct StatementSwitchCase _case =
+            ast -> cases.items[statement.cases.start + i];
+        fprintf(stream, "%*s", indent, "");
+        if (_case._default) {
+            fprintf(stream, "default:\n");
+        } else {
+            fprintf(stream, "case ");
+            printLiteral(stream, ast, _case._case);
+            fprintf(stream, ":\n");
+        }
+        for (uint32_t j = 0; j < _case.then.count; j++) {
+            printStatement(
+                stream,
+                ast,
+                ast -> statement_lists.items[_case.then.start + j],
+                indent + 4
+            );
+        }
+    }
+    fprintf(stream, "%*s}", indent, "");
+}
+
+static void printStatement(
+    FILE*       stream,
+    struct AST* ast,
+    uint32_t    index,
+    int         indent
+) {
+    struct Statement statement = ast -> statements.items[index];
+    fprintf(stream, "%*s", indent, "");
+    switch (statement.type) {
+    case STATEMENT_NONE:
+        break;
+    case STATEMENT_VAR:
+        printVar(stream, ast, statement.statement_var);
+        break;
+    case STATEMENT_CONST:
+        fprintf(stream, "const ");
+        printName(stream, ast, statement.statement_const.name);
+        fprintf(stream, " = ");
+        printExpretion(stream, ast, statement.statement_const.value);
+        fprintf(stream, ";");
+        break;
+    case STATEMENT_IF: {
+        struct StatementIf _if = statement.statement_if;
+        fprintf(stream, "if ");
+        printCondition(stream, ast, _if.condition);
+        printBlock(stream, ast, _if.then, indent);
+        if (_if._else.count != 0) {
+            fprintf(stream, " else ");
+            printBlock(stream, ast, _if._else, indent);
+        }
+        break;
+    }
+    case STATEMENT_SWITCH:
+        printSwitch(stream, ast, statement.statement_switch, indent);
+        break;
+    case STATEMENT_DO: {
+        struct StatementDo _do = statement.statement_do;
+        printLabel(stream, ast, _do.is_label, _do.label);
+        fprintf(stream, "do ");
+        printBlock(stream, ast, _do.then, indent);
+        fprintf(stream, " while (");
+        printExpretion(stream, ast, _do.condition);
+        fprintf(stream, ");");
+        break;
+    }
+    case STATEMENT_WHILE: {
+        struct StatementWhile _while = statement.statement_while;
+        printLabel(stream, ast, _while.is_label, _while.label);
+        if (_while.condition == NODE_NONE) {
+            fprintf(stream, "loop ");
+        } else {
+            fprintf(stream, "while ");
+            printCondition(stream, ast, _while.condition);
+        }
+        printBlock(stream, ast, _while.then, indent);
+        break;
+    }
+    case STATEMENT_FOR: {
+        struct StatementFor _for = statement.statement_for;
+        printLabel(stream, ast, _for.is_label, _for.label);
+        fprintf(stream, "for (");
+        printVar(stream, ast, ast -> statements.items[_for.var].statement_var);
+        fprintf(stream, " ");
+        printExpretion(stream, ast, _for.condition);
+        fprintf(stream, ") ");
+        printBlock(stream, ast, _for.then, indent);
+        break;
+    }
+    case STATEMENT_REPEAD: {
+        struct StatementRepead repead = statement.statement_repead;
+        printLabel(stream, ast, repead.is_label, repead.label);
+        fprintf(stream, "repead ");
+        printCondition(stream, ast, repead.condition);
+        printBlock(stream, ast, repead.then, indent);
+        break;
+    }
+    case STATEMENT_RETURN:
+        fprintf(stream, "return");
+        if (statement.statement_return.value != NODE_NONE) {
+            fprintf(stream, " ");
+            printExpretion(stream, ast, statement.statement_return.value);
+        }
+        fprintf(stream, ";");
+        break;
+    case STATEMENT_ASIGN: {
+        struct StatementAsign asign = statement.statement_asign;
+        if (asign.get_expr != NODE_NONE) {
+            printExpretion(stream, ast, asign.get_expr);
+        } else {
+            printName(stream, ast, asign.var_name);
+        }
+        fprintf(stream, " = ");
+        printExpretion(stream, ast, asign.value);
+        fprintf(stream, ";");
+        break;
+    }
+    case STATEMENT_CALL:
+        printExpretion(stream, ast, statement.statement_expr);
+        fprintf(stream, ";");
+        break;
+    }
+    fprintf(stream, "\n");
+}
+
+static void printArgs(FILE* stream, struct AST* ast, struct Range args) {
+    fprintf(stream, "(");
+    for (uint32_t i = 0; i < args.count; i++) {
+        struct TypeFild arg = ast -> filds.items[args.start + i];
+        if (i != 0) {
+            fprintf(stream, ", ");
+        }
+        printName(stream, ast, arg.name);
+        fprintf(stream, ": ");
+        printType(stream, ast, arg.type);
+    }
+    fprintf(stream, ")");
+}
+
+static void printResult(FILE* stream, struct AST* ast, uint32_t result) {
+    if (result != NODE_NONE) {
+        fprintf(stream, " ");
+        printType(stream, ast, ast -> types.items[result]);
+    }
+}
+
+static void printFunc(FILE* stream, struct AST* ast, struct FuncDecl func) {
+    fprintf(stream, "\n");
+    if (func.is_exported) {
+        fprintf(stream, "export ");
+    }
+    fprintf(stream, "func ");
+    if (func.has_self) {
+        fprintf(stream, "(");
+        printName(stream, ast, func.self.name);
+        fprintf(stream, " ");
+        printName(stream, ast, func.self.type.name);
+        if (func.self.type.params.count != 0) {
+            fprintf(stream, " ");
+            printTypeParams(stream, ast, func.self.type.params);
+        }
+        fprintf(stream, ") ");
+    }
+    printName(stream, ast, func.name);
+    printArgs(stream, ast, func.args);
+    printResult(stream, ast, func.result);
+    if (func.is_external) {
+        fprintf(stream, ";\n");
+        return;
+    }
+    fprintf(stream, " ");
+    printBlock(stream, ast, func.body, 0);
+    fprintf(stream, "\n");
+}
+
+static void printCFunc(FILE* stream, struct AST* ast, struct CFuncDecl func) {
+    fprintf(stream, "\ncfunc ");
+    printName(stream, ast, func.name);
+    printArgs(stream, ast, func.args);
+    printResult(stream, ast, func.result);
+    fprintf(stream, " ");
+    printBlock(stream, ast, func.body, 0);
+    fprintf(stream, "\n");
+}
+
+static void printTest(FILE* stream, struct AST* ast, struct Test test) {
+    fprintf(stream, "\ntest ");
+    printBlock(stream, ast, test.body, 0);
+    fprintf(stream, "\n");
+}
+
 void printAST(FILE *stream, struct AST* ast) {
-    while (ast != NULL) {
-        switch (ast -> type) {
+    for (uint32_t i = 0; i < ast -> decls.count; i++) {
+        struct Decl decl = ast -> decls.items[i];
+        switch (decl.type) {
         case AST_IMPORT:
-            printImport(stream, ast -> ast_import);
+            printImport(stream, ast, ast -> imports.items[decl.index]);
             break;
         case AST_TYPE:
-            printTypeDecl(stream, ast -> ast_type);
+            printTypeDecl(stream, ast, ast -> type_decls.items[decl.index]);
+            break;
+        case AST_FUNC:
+            printFunc(stream, ast, ast -> funcs.items[decl.index]);
+            break;
+        case AST_CFUNC:
+            printCFunc(stream, ast, ast -> cfuncs.items[decl.index]);
+            break;
+        case AST_TEST:
+            printTest(stream, ast, ast -> tests.items[decl.index]);
+            break;
+        default:
             break;
         }
-        ast = ast -> next;
     }
 }
-
@@ -5,74 +5,120 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "string.h"
 #include "memory.h"
+#include "symbol.h"
+
+/*
+ * The tree is stored flat: every kind of node lives in its own contiguous
+ * array inside struct AST and nodes refer to each other by 32-bit index.
+ * Lists of children are a Range of consecutive entries in one array.
+ *
+ * All names in the tree are symbol ids from the Symbols table the file was
+ * parsed with, see symbol.h.
+ */
 
+#define NODE_NONE UINT32_MAX
+
+#define NODES(type)         \
+    struct {                \
+        type*    items;     \
+        uint32_t count;     \
+        uint32_t capacity;  \
+    }
+
+// evaluates to the index of the pushed node, kind is a MemoryKind
+#define pushNode(nodes, kind, node)                                         \
+    ((nodes).items = reserveNodes(                                          \
+         (nodes).items, &(nodes).capacity, (nodes).count,                   \
+         sizeof(*(nodes).items), (kind)),                                   \
+     (nodes).items[(nodes).count] = (node),                                 \
+     (nodes).count++)
+
+/*
+ * An array with items but no capacity is borrowed, e.g. mapped from the
+ * AST cache, and gets copied to the heap before it grows. New room is
+ * zeroed, so the padding of nodes written into it is the same every time
+ * the AST cache stores them.
+ */
+static inline void* reserveNodes(
+    void*           items,
+    uint32_t*       capacity,
+    uint32_t        count,
+    size_t          size,
+    enum MemoryKind kind
+) {
+    if (count < (*capacity)) {
+        return items;
+    }
+    char* res;
+    if ((*capacity) == 0 && count != 0) {
+        (*capacity) = count * 2;
+        res = memoryAllocKind(kind, (*capacity) * size);
+        memcpy(res, items, count * size);
+    } else {
+        (*capacity) = (*capacity) == 0 ? 16 : (*capacity) * 2;
+        res = memoryReallocKind(kind, items, (*capacity) * size);
+    }
+    memset(res + count * size, 0, ((*capacity) - count) * size);
+    return res;
+}
+
+struct Range {
+    uint32_t start;
+    uint32_t count;
+};
+
+/*
+ * A.b.c is a range of names, .b.c (relative to the current module) too,
+ * with is_relative set.
+ */
 struct Path {
-    struct String name;
-    struct Path*  next;
+    bool         is_relative;
+    struct Range names;             // AST.names
 };
 
 struct Import {
     bool          is_rename;
-    struct String as;
-    struct Path*  path;
+    uint32_t      as;
+    struct Path   path;
 };
 
-/*      
+/*
  * Type <Type, Type> | TypeHeader
- *      ^- TypeParams
+ *      ^- params
  * Type <Type<Type>> | Type
- *      ^- TypeArgs
+ *      ^- args
  */
 
 struct TypeHeader {
-    struct String      name;
-    struct TypeParams* params;
-};
-
-struct TypeParams {
-    struct String      name;
-    struct TypeParams* next;
+    uint32_t     name;
+    struct Range params;            // AST.names
 };
 
 struct Type {
-    bool             is_ref;
-    struct String    name;
-    struct TypeArgs* args;
-};
-
-struct TypeArgs {
-    struct Type      type;
-    struct TypeArgs* next;
+    bool         is_ref;
+    uint32_t     name;
+    struct Range args;              // AST.types
 };
 
 struct TypeFild {
-    struct String name;
+    uint32_t      name;
     struct Type   type;
 };
 
-struct TypeFildList {
-    struct TypeFild      type;
-    struct TypeFildList* next;
-};
-
-enum EnumFildListType {
+enum EnumFildType {
     ENUM_FILD_UNTYPED,
     ENUM_FILD_TYPED,
 };
 
-struct EnumFildList {
-    enum EnumFildListType type;
-    union {
-        struct String   untyped;
-        struct TypeFild typed;
-    };
-    struct EnumFildList* next;
+struct EnumFild {
+    enum EnumFildType type;
+    struct TypeFild   fild;         // fild.type unused when untyped
 };
 
-
 enum TypeDeclType {
     TYPE_TYPE,
     TYPE_ENUM,
@@ -85,10 +131,10 @@ struct TypeDecl {
     struct TypeHeader header;
     enum TypeDeclType type;
     union {
-        struct Type          _type;
-        struct TypeFildList* _struct;
-        struct TypeFildList* _union;
-        struct EnumFildList* _enum;
+        struct Type  _type;
+        struct Range _struct;       // AST.filds
+        struct Range _union;        // AST.filds
+        struct Range _enum;         // AST.enum_filds
     };
 };
 
@@ -102,13 +148,17 @@ enum LiteralType {
 struct Literal {
     enum LiteralType type;
     union {
-        struct String string;
-        struct Path*  name;
-        long double   _float;
-        uint64_t      _int;
+        uint32_t    string;         // symbol of the unescaped text
+        struct Path name;
+        uint32_t    _float;         // AST.floats
+        uint64_t    _int;
     };
 };
 
+/*
+ * Unary kinds use expr, binary ones left and right. ref x is EXPRETION_REF,
+ * x[] is EXPRETION_DEREF and x[i] is EXPRETION_GET with left x, right i.
+ */
 enum ExpretionTypy {
     EXPRETION_NONE,
     EXPRETION_CAST,
@@ -146,95 +196,91 @@ enum ExpretionTypy {
 };
 
 struct FunctionCall {
-    struct String        name;
-    struct FunctionArgs* args;
+    struct Path  name;
+    struct Range args;              // AST.expretion_lists
 };
 
 struct Expretion {
     enum ExpretionTypy type;
     union {
         struct {
-            struct Expretion* left;
-            struct Expretion* right;
+            uint32_t left;
+            uint32_t right;
         };
         struct {
-            struct Expretion* expr;
-            struct Type       cast;
+            uint32_t expr;
+            uint32_t cast;          // AST.types
         };
         struct FunctionCall func;
         struct Literal      literal;
     };
 };
 
-struct FunctionArgs {
-    struct Expretion     arg;
-    struct FunctionArgs* next;
-};
-
 struct StatementVar {
-    struct String     name;
-    struct Expretion* value;
+    uint32_t name;
+    uint32_t type;                  // AST.types, NODE_NONE if not given
+    uint32_t value;
 };
 
 struct StatementConst {
-    struct String     name;
-    struct Expretion* value;
+    uint32_t name;
+    uint32_t value;
 };
 
 struct StatementIf {
-    struct Expretion*     condition;
-    struct StatementBloc* then;
-    struct StatementBloc* _else;
+    uint32_t     condition;
+    struct Range then;              // AST.statement_lists
+    struct Range _else;             // AST.statement_lists
 };
 
 struct StatementSwitchCase {
-    bool                       _default;
-    struct Literal             _case;
-    struct StatementBloc*      then;
-    struct StatementSwitchCase* next;
+    bool           _default;
+    struct Literal _case;
+    struct Range   then;            // AST.statement_lists
 };
 
 struct StatementSwitch {
-    struct StatementSwitchCase* cases;
+    uint32_t     value;
+    struct Range cases;             // AST.cases
 };
 
 struct StatementDo {
-    bool                  is_label;
-    struct String         label;
-    struct Expretion*     condition;
-    struct StatementBloc* then;
+    bool         is_label;
+    uint32_t     label;
+    uint32_t     condition;
+    struct Range then;
 };
 
 struct StatementWhile {
-    bool                  is_label;
-    struct String         label;
-    struct Expretion*     condition;
-    struct StatementBloc* then;
+    bool         is_label;
+    uint32_t     label;
+    uint32_t     condition;
+    struct Range then;
 };
 
 struct StatementFor {
-    bool                  is_label;
-    struct String         label;
-    struct String         var;
-    struct Expretion*     condition;
-    struct StatementBloc* then;
+    bool         is_label;
+    uint32_t     label;
+    uint32_t     var;
+    uint32_t     condition;
+    struct Range then;
 };
 
 struct StatementRepead {
-    bool                  is_label;
-    struct String         label;
-    struct Expretion*     condition;
-    struct StatementBloc* then;
+    bool         is_label;
+    uint32_t     label;
+    uint32_t     condition;
+    struct Range then;
 };
 
 struct StatementReturn {
-    struct Expretion* value;
+    uint32_t value;                 // NODE_NONE for a bare return
 };
 
 struct StatementAsign {
-    struct Expretion* get_expr;
-    struct String     var_name;
-    struct Expretion* value;
+    uint32_t get_expr;
+    uint32_t var_name;
+    uint32_t value;
 };
 
 enum StatementType {
@@ -255,47 +301,45 @@ enum StatementType {
 struct Statement {
     enum StatementType type;
     union {
-        struct StatementVar*     statement_var;
-        struct StatementConst*   statement_const;
-        struct StatementIf*      statement_if;
-        struct StatementSwitch*  statement_switch;
-        struct StatementDo*      statement_do;
-        struct StatementWhile*   statement_while;
-        struct StatementFor*     statement_for;
-        struct StatementRepead*  statement_repead;
-        struct StatementReturn*  statement_return;
-        struct StatementAsign*   statement_asign;
-        struct FunctionCall*     statement_expr;
+        struct StatementVar     statement_var;
+        struct StatementConst   statement_const;
+        struct StatementIf      statement_if;
+        struct StatementSwitch  statement_switch;
+        struct StatementDo      statement_do;
+        struct StatementWhile   statement_while;
+        struct StatementFor     statement_for;
+        struct StatementRepead  statement_repead;
+        struct StatementReturn  statement_return;
+        struct StatementAsign   statement_asign;
+        uint32_t                statement_expr;
     };
 };
 
-struct StatementBloc {
-    struct Statement      expr;
-    struct StatementBloc* next;
-};
-
 struct Self {
-    struct String     name;
+    uint32_t          name;
     struct TypeHeader type;
 };
 
 struct FuncDecl {
-    bool                  is_exported;
-    bool                  is_external;
-    struct Self*          self;
-    struct String         name;
-    struct TypeFildList*  args;
-    struct Statement*     body;
+    bool          is_exported;
+    bool          is_external;
+    bool          has_self;
+    struct Self   self;
+    uint32_t      name;
+    struct Range  args;             // AST.filds
+    uint32_t      result;           // AST.types, NODE_NONE if nothing
+    struct Range  body;             // AST.statement_lists
 };
 
 struct CFuncDecl {
-    struct String         name;
-    struct TypeFildList*  args;
-    struct Statement*     body;
+    uint32_t      name;
+    struct Range  args;             // AST.filds
+    uint32_t      result;           // AST.types, NODE_NONE if nothing
+    struct Range  body;             // AST.statement_lists
 };
 
 struct Test {
-    struct Statement* body;
+    struct Range body;              // AST.statement_lists
 };
 
 enum ASTType {
@@ -307,775 +351,842 @@ enum ASTType {
     AST_CFUNC,
 };
 
-struct AST {
+// top level declaration, index is into the array for its type
+struct Decl {
     enum ASTType type;
-    union {
-        struct Import     ast_import;
-        struct Test       ast_test;
-        struct TypeDecl   ast_type;
-        struct FuncDecl   ast_func;
-        struct CFuncDecl  ast_cfunc;
-    };
-    struct AST* next;
+    uint32_t     index;
+};
+
+struct AST {
+    struct Symbols*                    symbols;
+    void*                              mapped;      // cache file, see cache.h
+    size_t                             mapped_size;
+
+    NODES(struct Decl)                 decls;
+    NODES(struct Import)               imports;
+    NODES(struct TypeDecl)             type_decls;
+    NODES(struct FuncDecl)             funcs;
+    NODES(struct CFuncDecl)            cfuncs;
+    NODES(struct Test)                 tests;
+
+    NODES(uint32_t)                    names;
+    NODES(struct Type)                 types;
+    NODES(struct TypeFild)             filds;
+    NODES(struct EnumFild)             enum_filds;
+    NODES(struct Expretion)            expretions;
+    NODES(uint32_t)                    expretion_lists;
+    NODES(long double)                 floats;
+    NODES(struct Statement)            statements;
+    NODES(uint32_t)                    statement_lists;
+    NODES(struct StatementSwitchCase)  cases;
 };
 
-static inline struct Expretion* expretionCast(
-    struct Expretion* expr,
-    struct Type       cast
+// every node array of struct AST, for code that handles them all alike
+#define AST_ARRAYS(X)                                                       \
+    X(decls) X(imports) X(type_decls) X(funcs) X(cfuncs) X(tests)           \
+    X(names) X(types) X(filds) X(enum_filds) X(expretions)                  \
+    X(expretion_lists) X(floats) X(statements) X(statement_lists) X(cases)
+
+
+static inline uint32_t appendName(struct AST* ast, uint32_t name);
+static inline uint32_t appendType(struct AST* ast, struct Type type);
+static inline struct Range appendTypes(
+    struct AST*        ast,
+    const struct Type* types,
+    uint32_t           count
+);
+static inline uint32_t appendTypeFild(struct AST* ast, struct TypeFild fild);
+static inline uint32_t appendEnumFildTyped(
+    struct AST*     ast,
+    struct TypeFild fild
+);
+static inline uint32_t appendEnumFildUntyped(struct AST* ast, uint32_t fild);
+static inline struct Range appendExpretionList(
+    struct AST*     ast,
+    const uint32_t* expretions,
+    uint32_t        count
 );
-static inline struct Expretion* expretionRef(struct Expretion* expr); 
-static inline struct Expretion* expretionDeref(struct Expretion* expr);
-static inline struct Expretion* expretionGet(struct Expretion* expr);
-static inline struct Expretion* expretionNeg(struct Expretion* expr);
-static inline struct Expretion* expretionAdd(
-    struct Expretion* left,
-    struct Expretion* right
+static inline struct Range appendStatementList(
+    struct AST*     ast,
+    const uint32_t* statements,
+    uint32_t        count
 );
-static inline struct Expretion* expretionSubtract(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t appendSwitchCase(
+    struct AST*                ast,
+    struct StatementSwitchCase _case
 );
-static inline struct Expretion* expretionMultiply(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionUnary(
+    struct AST*        ast,
+    enum ExpretionTypy type,
+    uint32_t           expr
 );
-static inline struct Expretion* expretionDivide(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionBinary(
+    struct AST*        ast,
+    enum ExpretionTypy type,
+    uint32_t           left,
+    uint32_t           right
 );
-static inline struct Expretion* expretionModulo(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionCast(
+    struct AST* ast,
+    uint32_t    expr,
+    uint32_t    cast
 );
-static inline struct Expretion* expretionEqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionRef(struct AST* ast, uint32_t expr);
+static inline uint32_t expretionDeref(struct AST* ast, uint32_t expr);
+static inline uint32_t expretionGet(
+    struct AST* ast,
+    uint32_t    expr,
+    uint32_t    index
 );
-static inline struct Expretion* expretionLessThen(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionNeg(struct AST* ast, uint32_t expr);
+static inline uint32_t expretionAdd(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionGreatThen(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionSubtract(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionNotEqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionMultiply(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionLessThenOrAqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionDivide(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionGreaThenOrEqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionModulo(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionBitwizeNot(struct Expretion* expr);
-static inline struct Expretion* expretionBitwizeOr(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionEqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionBitwizeAnd(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionLessThen(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionLeftShift(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionGreatThen(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionRightShift(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionNotEqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionLogicalNot(struct Expretion* expr);
-static inline struct Expretion* expretionLogicalAnd(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionLessThenOrAqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionLogicalOr(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionGreaThenOrEqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* expretionFunction(
-    struct String        name,
-    struct FunctionArgs* args
+static inline uint32_t expretionBitwizeNot(struct AST* ast, uint32_t expr);
+static inline uint32_t expretionBitwizeOr(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline struct Expretion* literalSting(struct String string);
-static inline struct Expretion* literalFloat(long double _float);
-static inline struct Expretion* literalInt(uint64_t _int);
-static inline struct Expretion* literalName(struct Path* name);
-static inline struct Self* self(
-    struct String     name,
-    struct TypeHeader type
+static inline uint32_t expretionBitwizeAnd(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline void addStatementConst(
-    struct StatementBloc** stm,
-    struct String          name,
-    struct Expretion*      value
+static inline uint32_t expretionLeftShift(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline void addStatementVar(
-    struct StatementBloc** stm,
-    struct String          name,
-    struct Expretion*      value
+static inline uint32_t expretionRightShift(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline void addStatementSwitch(
-    struct StatementBloc**      stm,
-    struct StatementSwitchCase* cases
+static inline uint32_t expretionLogicalNot(struct AST* ast, uint32_t expr);
+static inline uint32_t expretionLogicalAnd(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline void addStatementIf(
-    struct StatementBloc** stm,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
+static inline uint32_t expretionLogicalOr(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 );
-static inline void addStatementDo(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
+static inline uint32_t expretionFunction(
+    struct AST*  ast,
+    struct Path  name,
+    struct Range args
 );
-static inline void addStatementWhile(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
-); 
-static inline void addStatementFor(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct String          var,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
+static inline uint32_t expretionLiteral(
+    struct AST*    ast,
+    struct Literal literal
 );
-static inline void addStatementRepead(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct Expretion*      conition,
-    struct StatementBloc*  then
-); 
-static inline void addStatementReturn(
-    struct StatementBloc** stm,
-    struct Expretion*      value
+static inline uint32_t appendFloat(struct AST* ast, long double _float);
+static inline uint32_t literalSting(struct AST* ast, uint32_t string);
+static inline uint32_t literalFloat(struct AST* ast, long double _float);
+static inline uint32_t literalInt(struct AST* ast, uint64_t _int);
+static inline uint32_t literalName(struct AST* ast, struct Path name);
+static inline struct Self self(uint32_t name, struct TypeHeader type);
+static inline uint32_t addStatementVar(
+    struct AST* ast,
+    uint32_t    name,
+    uint32_t    type,
+    uint32_t    value
 );
-static inline void addStatementAsign(
-    struct StatementBloc** stm,
-    struct Expretion*      get_expr,
-    struct String          var_name,
-    struct Expretion*      value
+static inline uint32_t addStatementConst(
+    struct AST* ast,
+    uint32_t    name,
+    uint32_t    value
 );
-static inline void FunctionArgs(
-    struct FunctionArgs** args,
-    struct Expretion      arg
+static inline uint32_t addStatementSwitch(
+    struct AST*  ast,
+    uint32_t     value,
+    struct Range cases
 );
-static inline void appendEnumFildUntyped(
-    struct EnumFildList** _enum,
-    struct String         fild
+static inline uint32_t addStatementIf(
+    struct AST*  ast,
+    uint32_t     condition,
+    struct Range then,
+    struct Range _else
 );
-static inline void appendEnumFildTyped(
-    struct EnumFildList** _enum,
-    struct TypeFild       fild
+static inline uint32_t addStatementDo(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     condition,
+    struct Range then
 );
-static inline void appendTypeFildList(
-    struct TypeFildList** filds,
-    struct TypeFild       type
+static inline uint32_t addStatementWhile(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     condition,
+    struct Range then
 );
-static inline void  appendTypeArgs(
-    struct TypeArgs** args,
-    struct Type       type
+static inline uint32_t addStatementFor(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     var,
+    uint32_t     condition,
+    struct Range then
 );
-static inline void appendTypeParams(
-    struct TypeParams** params,
-    struct String       name
+static inline uint32_t addStatementRepead(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     condition,
+    struct Range then
 );
-static inline void appendPath(struct Path** path, struct String name);
-static inline void addImport(struct AST** ast, struct Import import);
-static inline void addTest(struct AST** ast, struct Test test);
-static inline void addType(struct AST** ast, struct TypeDecl type);
-static inline void addFunc(struct AST** ast, struct FuncDecl func);
-static inline void addCFunc(struct AST** ast, struct CFuncDecl func);
-
-void printAST(FILE *stream, struct AST*);
-void freeAST(struct AST*);
-
-static inline struct Expretion* expretionCast(
-    struct Expretion* expr,
-    struct Type       cast
+static inline uint32_t addStatementReturn(struct AST* ast, uint32_t value);
+static inline uint32_t addStatementAsign(
+    struct AST* ast,
+    uint32_t    get_expr,
+    uint32_t    var_name,
+    uint32_t    value
+);
+static inline uint32_t addStatementCall(struct AST* ast, uint32_t expr);
+static inline void addDecl(struct AST* ast, enum ASTType type, uint32_t index);
+static inline void addImport(struct AST* ast, struct Import import);
+static inline void addTest(struct AST* ast, struct Test test);
+static inline void addTypeDecl(struct AST* ast, struct TypeDecl type);
+static inline void addFunc(struct AST* ast, struct FuncDecl func);
+static inline void addCFunc(struct AST* ast, struct CFuncDecl func);
+
+void initAST(struct AST* ast, struct Symbols* symbols);
+void freeAST(struct AST* ast);
+void printAST(FILE *stream, struct AST* ast);
+
+// the path an import makes name stand for, path itself if none does
+struct Path importedPath(struct AST* ast, struct Path path);
+// whether path is spelled like str, e.g. "File.write"
+bool pathIs(struct AST* ast, struct Path path, const char* str);
+
+static inline uint32_t appendName(struct AST* ast, uint32_t name) {
+    return pushNode(ast -> names, MEMORY_PATH, name);
+}
+
+static inline uint32_t appendType(struct AST* ast, struct Type type) {
+    return pushNode(ast -> types, MEMORY_TYPE, type);
+}
+
+static inline struct Range appendTypes(
+    struct AST*        ast,
+    const struct Type* types,
+    uint32_t           count
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_CAST;
-    res -> expr = expr;
-    res -> cast = cast;
+    struct Range res = {
+        .start = ast -> types.count,
+        .count = count
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        pushNode(ast -> types, MEMORY_TYPE, types[i]);
+    }
     return res;
 }
 
-static inline struct Expretion* expretionRef(struct Expretion* expr) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_REF;
-    res -> expr = expr;
-    return res;
+static inline uint32_t appendTypeFild(struct AST* ast, struct TypeFild fild) {
+    return pushNode(ast -> filds, MEMORY_TYPE, fild);
 }
 
-static inline struct Expretion* expretionDeref(struct Expretion* expr) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_DEREF;
-    res -> expr = expr;
-    return res;
+static inline uint32_t appendEnumFildTyped(
+    struct AST*     ast,
+    struct TypeFild fild
+) {
+    struct EnumFild res = {
+        .type = ENUM_FILD_TYPED,
+        .fild = fild
+    };
+    return pushNode(ast -> enum_filds, MEMORY_TYPE, res);
 }
 
-static inline struct Expretion* expretionGet(struct Expretion* expr) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_GET;
-    res -> expr = expr;
-    return res;
+static inline uint32_t appendEnumFildUntyped(struct AST* ast, uint32_t fild) {
+    struct EnumFild res = {
+        .type = ENUM_FILD_UNTYPED,
+        .fild = { .name = fild }
+    };
+    return pushNode(ast -> enum_filds, MEMORY_TYPE, res);
 }
 
-static inline struct Expretion* expretionNeg(struct Expretion* expr) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_NEG;
-    res -> expr = expr;
+static inline struct Range appendExpretionList(
+    struct AST*     ast,
+    const uint32_t* expretions,
+    uint32_t        count
+) {
+    struct Range res = {
+        .start = ast -> expretion_lists.count,
+        .count = count
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        pushNode(ast -> expretion_lists, MEMORY_EXPRETION, expretions[i]);
+    }
     return res;
 }
 
-static inline struct Expretion* expretionAdd(
-    struct Expretion* left,
-    struct Expretion* right
+static inline struct Range appendStatementList(
+    struct AST*     ast,
+    const uint32_t* statements,
+    uint32_t        count
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_ADD;
-    res -> left = left;
-    res -> right = right;
+    struct Range res = {
+        .start = ast -> statement_lists.count,
+        .count = count
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        pushNode(ast -> statement_lists, MEMORY_STATEMENT, statements[i]);
+    }
     return res;
 }
 
-static inline struct Expretion* expretionSubtract(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t appendSwitchCase(
+    struct AST*                ast,
+    struct StatementSwitchCase _case
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_SUBTRACT;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return pushNode(ast -> cases, MEMORY_STATEMENT, _case);
 }
 
-static inline struct Expretion* expretionMultiply(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionUnary(
+    struct AST*        ast,
+    enum ExpretionTypy type,
+    uint32_t           expr
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_MULTIPLY;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    struct Expretion res = {
+        .type = type,
+        .expr = expr,
+        .cast = NODE_NONE
+    };
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline struct Expretion* expretionDivide(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionBinary(
+    struct AST*        ast,
+    enum ExpretionTypy type,
+    uint32_t           left,
+    uint32_t           right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_DIVIDE;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    struct Expretion res = {
+        .type  = type,
+        .left  = left,
+        .right = right
+    };
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline struct Expretion* expretionModulo(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionCast(
+    struct AST* ast,
+    uint32_t    expr,
+    uint32_t    cast
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_MODULO;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    struct Expretion res = {
+        .type = EXPRETION_CAST,
+        .expr = expr,
+        .cast = cast
+    };
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
+}
+
+static inline uint32_t expretionRef(struct AST* ast, uint32_t expr) {
+    return expretionUnary(ast, EXPRETION_REF, expr);
+}
+
+static inline uint32_t expretionDeref(struct AST* ast, uint32_t expr) {
+    return expretionUnary(ast, EXPRETION_DEREF, expr);
 }
 
-static inline struct Expretion* expretionEqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionGet(
+    struct AST* ast,
+    uint32_t    expr,
+    uint32_t    index
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_EQUAL;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_GET, expr, index);
+}
+
+static inline uint32_t expretionNeg(struct AST* ast, uint32_t expr) {
+    return expretionUnary(ast, EXPRETION_NEG, expr);
 }
 
-static inline struct Expretion* expretionLessThen(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionAdd(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LESS_THEN;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_ADD, left, right);
 }
 
-static inline struct Expretion* expretionGreatThen(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionSubtract(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_GREAT_THEN;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_SUBTRACT, left, right);
 }
 
-static inline struct Expretion* expretionNotEqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionMultiply(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_NOT_EQUAL;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_MULTIPLY, left, right);
 }
 
-static inline struct Expretion* expretionLessThenOrAqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionDivide(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LESS_THEN_OR_EQUAL;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_DIVIDE, left, right);
 }
 
-static inline struct Expretion* expretionGreaThenOrEqual(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionModulo(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_GREA_THEN_OR_EQUAL;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_MODULO, left, right);
 }
 
-static inline struct Expretion* expretionBitwizeNot(struct Expretion* expr) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_BITWIZE_NOT;
-    res -> expr = expr;
-    return res;
+static inline uint32_t expretionEqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
+) {
+    return expretionBinary(ast, EXPRETION_EQUAL, left, right);
 }
 
-static inline struct Expretion* expretionBitwizeOr(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionLessThen(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_BITWIZE_OR;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_LESS_THEN, left, right);
 }
 
-static inline struct Expretion* expretionBitwizeAnd(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionGreatThen(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_BITWIZE_AND;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_GREAT_THEN, left, right);
 }
 
-static inline struct Expretion* expretionLeftShift(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionNotEqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LEFT_SHIFT;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_NOT_EQUAL, left, right);
 }
 
-static inline struct Expretion* expretionRightShift(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionLessThenOrAqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_RIGHT_SHIFT;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_LESS_THEN_OR_EQUAL, left, right);
 }
 
-static inline struct Expretion* expretionLogicalNot(struct Expretion* expr) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_NOT;
-    res -> expr = expr;
-    return res;
+static inline uint32_t expretionGreaThenOrEqual(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
+) {
+    return expretionBinary(ast, EXPRETION_GREA_THEN_OR_EQUAL, left, right);
 }
 
-static inline struct Expretion* expretionLogicalAnd(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionBitwizeNot(struct AST* ast, uint32_t expr) {
+    return expretionUnary(ast, EXPRETION_BITWIZE_NOT, expr);
+}
+
+static inline uint32_t expretionBitwizeOr(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_AND;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_BITWIZE_OR, left, right);
 }
 
-static inline struct Expretion* expretionLogicalOr(
-    struct Expretion* left,
-    struct Expretion* right
+static inline uint32_t expretionBitwizeAnd(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_OR;
-    res -> left = left;
-    res -> right = right;
-    return res;
+    return expretionBinary(ast, EXPRETION_BITWIZE_AND, left, right);
 }
 
-static inline struct Expretion* expretionFunction(
-    struct String        name,
-    struct FunctionArgs* args
+static inline uint32_t expretionLeftShift(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_OR;
-    res -> func = (struct FunctionCall) {
-        .name = name,
-        .args = args
-    };
-    return res;
+    return expretionBinary(ast, EXPRETION_LEFT_SHIFT, left, right);
 }
 
-static inline struct Self* self(
-    struct String     name,
-    struct TypeHeader type
+static inline uint32_t expretionRightShift(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct Self* res = memoryAlloc(sizeof(struct Self));
-    res -> name = name;
-    res -> type = type;
-    return res;
+    return expretionBinary(ast, EXPRETION_RIGHT_SHIFT, left, right);
 }
 
-static inline void addStatementVar(
-    struct StatementBloc** stm,
-    struct String          name,
-    struct Expretion*      value
+static inline uint32_t expretionLogicalNot(struct AST* ast, uint32_t expr) {
+    return expretionUnary(ast, EXPRETION_LOGICAL_NOT, expr);
+}
+
+static inline uint32_t expretionLogicalAnd(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct StatementVar* res = memoryAlloc(sizeof(struct StatementVar));
-    res -> name = name;
-    res -> value = value;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_VAR,
-        .statement_var = res
-    };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return expretionBinary(ast, EXPRETION_LOGICAL_AND, left, right);
 }
 
-static inline void addStatementConst(
-    struct StatementBloc** stm,
-    struct String          name,
-    struct Expretion*      value
+static inline uint32_t expretionLogicalOr(
+    struct AST* ast,
+    uint32_t    left,
+    uint32_t    right
 ) {
-    struct StatementConst* res = memoryAlloc(sizeof(struct StatementConst));
-    res -> name = name;
-    res -> value = value;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_CONST,
-        .statement_const = res
-    };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return expretionBinary(ast, EXPRETION_LOGICAL_OR, left, right);
 }
 
-static inline void addStatementSwitch(
-    struct StatementBloc**      stm,
-    struct StatementSwitchCase* cases
+static inline uint32_t expretionFunction(
+    struct AST*  ast,
+    struct Path  name,
+    struct Range args
 ) {
-    struct StatementSwitch* res =
-        memoryAlloc(sizeof(struct StatementSwitchCase));
-    res -> cases = cases;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_SWITCH,
-        .statement_switch = res
+    struct Expretion res = {
+        .type = EXPRETION_FUNCTION,
+        .func = {
+            .name = name,
+            .args = args
+        }
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline void addStatementIf(
-    struct StatementBloc** stm,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
+static inline uint32_t expretionLiteral(
+    struct AST*    ast,
+    struct Literal literal
 ) {
-    struct StatementIf* res = memoryAlloc(sizeof(struct StatementIf));
-    res -> condition = condition;
-    res -> then = then;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_DO,
-        .statement_if = res
+    struct Expretion res = {
+        .type    = EXPRETION_LITERAL,
+        .literal = literal
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline void addStatementDo(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
-) {
-    struct StatementDo* res = memoryAlloc(sizeof(struct StatementDo));
-    res -> is_label = is_label;
-    res -> label = label;
-    res -> condition = condition;
-    res -> then = then;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_DO,
-        .statement_do = res
+static inline uint32_t appendFloat(struct AST* ast, long double _float) {
+    return pushNode(ast -> floats, MEMORY_EXPRETION, _float);
+}
+
+static inline uint32_t literalSting(struct AST* ast, uint32_t string) {
+    struct Expretion res = {
+        .type    = EXPRETION_LITERAL,
+        .literal = {
+            .type   = LITERAL_STING,
+            .string = string
+        }
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline void addStatementWhile(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
-) {
-    struct StatementWhile* res = memoryAlloc(sizeof(struct StatementWhile));
-    res -> is_label = is_label;
-    res -> label = label;
-    res -> condition = condition;
-    res -> then = then;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_WHILE,
-        .statement_while = res
+static inline uint32_t literalFloat(struct AST* ast, long double _float) {
+    struct Expretion res = {
+        .type    = EXPRETION_LITERAL,
+        .literal = {
+            .type   = LITERAL_FLOAT,
+            ._float = appendFloat(ast, _float)
+        }
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline void addStatementFor(
-    struct StatementBloc** stm,
-    bool                  is_label,
-    struct String         label,
-    struct String         var,
-    struct Expretion*     condition,
-    struct StatementBloc* then
-) {
-    struct StatementFor* res = memoryAlloc(sizeof(struct StatementFor));
-    res -> is_label = is_label;
-    res -> label = label;
-    res -> var = var;
-    res -> condition = condition;
-    res -> then = then;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_FOR,
-        .statement_for = res
+static inline uint32_t literalInt(struct AST* ast, uint64_t _int) {
+    struct Expretion res = {
+        .type    = EXPRETION_LITERAL,
+        .literal = {
+            .type = LITERAL_INT,
+            ._int = _int
+        }
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline void addStatementRepead(
-    struct StatementBloc** stm,
-    bool                   is_label,
-    struct String          label,
-    struct Expretion*      condition,
-    struct StatementBloc*  then
-) {
-    struct StatementRepead* res = memoryAlloc(sizeof(struct StatementRepead));
-    res -> is_label = is_label;
-    res -> label = label;
-    res -> condition = condition;
-    res -> then = then;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_REPEAD,
-        .statement_repead = res
+static inline uint32_t literalName(struct AST* ast, struct Path name) {
+    struct Expretion res = {
+        .type    = EXPRETION_LITERAL,
+        .literal = {
+            .type = LITERAL_NAME,
+            .name = name
+        }
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> expretions, MEMORY_EXPRETION, res);
 }
 
-static inline void addStatementReturn(
-    struct StatementBloc** stm,
-    struct Expretion*      value
-) {
-    struct StatementReturn* res = memoryAlloc(sizeof(struct StatementReturn));
-    res -> value = value;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_RETURN,
-        .statement_return = res
+static inline struct Self self(uint32_t name, struct TypeHeader type) {
+    return (struct Self) {
+        .name = name,
+        .type = type
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
 }
 
-static inline void addStatementAsign(
-    struct StatementBloc** stm,
-    struct Expretion*      get_expr,
-    struct String          var_name,
-    struct Expretion*      value
+static inline uint32_t addStatementVar(
+    struct AST* ast,
+    uint32_t    name,
+    uint32_t    type,
+    uint32_t    value
 ) {
-    struct StatementAsign* res = memoryAlloc(sizeof(struct StatementAsign));
-    res -> get_expr = get_expr;
-    res -> var_name = var_name;
-    res -> value = value;
-    (*stm) -> expr = (struct Statement) {
-        .type = STATEMENT_ASIGN,
-        .statement_asign = res
+    struct Statement res = {
+        .type = STATEMENT_VAR,
+        .statement_var = {
+            .name  = name,
+            .type  = type,
+            .value = value
+        }
     };
-    (*stm) -> next = memoryAlloc(sizeof(struct StatementBloc));
-    (*stm) = (*stm) -> next;
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline struct Expretion* literalSting(struct String string) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_OR;
-    res -> literal = (struct Literal) {
-        .type = LITERAL_STING,
-        .string = string
+static inline uint32_t addStatementConst(
+    struct AST* ast,
+    uint32_t    name,
+    uint32_t    value
+) {
+    struct Statement res = {
+        .type = STATEMENT_CONST,
+        .statement_const = {
+            .name  = name,
+            .value = value
+        }
     };
-    return res;
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline struct Expretion* literalFloat(long double _float) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_OR;
-    res -> literal = (struct Literal) {
-        .type = LITERAL_FLOAT,
-        ._float = _float
+static inline uint32_t addStatementSwitch(
+    struct AST*  ast,
+    uint32_t     value,
+    struct Range cases
+) {
+    struct Statement res = {
+        .type = STATEMENT_SWITCH,
+        .statement_switch = {
+            .value = value,
+            .cases = cases
+        }
     };
-    return res;
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline struct Expretion* literalInt(uint64_t _int) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_OR;
-    res -> literal = (struct Literal) {
-        .type = LITERAL_INT,
-        ._int = _int
+static inline uint32_t addStatementIf(
+    struct AST*  ast,
+    uint32_t     condition,
+    struct Range then,
+    struct Range _else
+) {
+    struct Statement res = {
+        .type = STATEMENT_IF,
+        .statement_if = {
+            .condition = condition,
+            .then      = then,
+            ._else     = _else
+        }
     };
-    return res;
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline struct Expretion* literalName(struct Path* name) {
-    struct Expretion* res = memoryAlloc(sizeof(struct Expretion));
-    res -> type = EXPRETION_LOGICAL_OR;
-    res -> literal = (struct Literal) {
-        .type = LITERAL_NAME,
-        .name = name
+static inline uint32_t addStatementDo(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     condition,
+    struct Range then
+) {
+    struct Statement res = {
+        .type = STATEMENT_DO,
+        .statement_do = {
+            .is_label  = is_label,
+            .label     = label,
+            .condition = condition,
+            .then      = then
+        }
     };
-    return res;
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void FunctionArgs(
-    struct FunctionArgs** args,
-    struct Expretion      arg
+static inline uint32_t addStatementWhile(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     condition,
+    struct Range then
 ) {
-    (*args) -> arg = arg;
-    (*args) -> next = memoryAlloc(sizeof(struct FunctionArgs));
-    (*args) = (*args) -> next;
+    struct Statement res = {
+        .type = STATEMENT_WHILE,
+        .statement_while = {
+            .is_label  = is_label,
+            .label     = label,
+            .condition = condition,
+            .then      = then
+        }
+    };
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void appendEnumFildTyped(
-    struct EnumFildList** _enum,
-    struct TypeFild       fild
+static inline uint32_t addStatementFor(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     var,
+    uint32_t     condition,
+    struct Range then
 ) {
-    (*_enum) -> type = ENUM_FILD_TYPED;
-    (*_enum) -> typed = fild;
-    (*_enum) -> next = memoryAlloc(sizeof(struct EnumFildList));
-    (*_enum) = (*_enum) -> next;
+    struct Statement res = {
+        .type = STATEMENT_FOR,
+        .statement_for = {
+            .is_label  = is_label,
+            .label     = label,
+            .var       = var,
+            .condition = condition,
+            .then      = then
+        }
+    };
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void appendEnumFildUntyped(
-    struct EnumFildList** _enum,
-    struct String         fild
+static inline uint32_t addStatementRepead(
+    struct AST*  ast,
+    bool         is_label,
+    uint32_t     label,
+    uint32_t     condition,
+    struct Range then
 ) {
-    (*_enum) -> type = ENUM_FILD_UNTYPED;
-    (*_enum) -> untyped = fild;
-    (*_enum) -> next = memoryAlloc(sizeof(struct EnumFildList));
-    (*_enum) = (*_enum) -> next;
+    struct Statement res = {
+        .type = STATEMENT_REPEAD,
+        .statement_repead = {
+            .is_label  = is_label,
+            .label     = label,
+            .condition = condition,
+            .then      = then
+        }
+    };
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void appendTypeFildList(
-    struct TypeFildList** filds,
-    struct TypeFild       type
-) {
-    (*filds) -> type = type;
-    (*filds) -> next = memoryAlloc(sizeof(struct TypeFildList));
-    (*filds) = (*filds) -> next;
+static inline uint32_t addStatementReturn(struct AST* ast, uint32_t value) {
+    struct Statement res = {
+        .type = STATEMENT_RETURN,
+        .statement_return = {
+            .value = value
+        }
+    };
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void  appendTypeArgs(
-    struct TypeArgs** args,
-    struct Type       type
+static inline uint32_t addStatementAsign(
+    struct AST* ast,
+    uint32_t    get_expr,
+    uint32_t    var_name,
+    uint32_t    value
 ) {
-    (*args) -> type = type;
-    (*args) -> next = memoryAlloc(sizeof(struct TypeArgs));
-    (*args) = (*args) -> next;
+    struct Statement res = {
+        .type = STATEMENT_ASIGN,
+        .statement_asign = {
+            .get_expr = get_expr,
+            .var_name = var_name,
+            .value    = value
+        }
+    };
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void appendTypeParams(
-    struct TypeParams** params,
-    struct String       name
-) {
-    (*params) -> name = name;
-    (*params) -> next = memoryAlloc(sizeof(struct TypeParams));
-    (*params) = (*params) -> next;
+static inline uint32_t addStatementCall(struct AST* ast, uint32_t expr) {
+    struct Statement res = {
+        .type           = STATEMENT_CALL,
+        .statement_expr = expr
+    };
+    return pushNode(ast -> statements, MEMORY_STATEMENT, res);
 }
 
-static inline void appendPath(struct Path** path, struct String name) {
-    (*path) -> name = name;
-    (*path) -> next = memoryAlloc(sizeof(struct Path));
-    (*path) = (*path) -> next;
+static inline void addDecl(struct AST* ast, enum ASTType type, uint32_t index) {
+    struct Decl res = {
+        .type  = type,
+        .index = index
+    };
+    pushNode(ast -> decls, MEMORY_DECL, res);
 }
 
-static inline void addImport(struct AST** ast, struct Import import) {
-    (*ast) -> type = AST_IMPORT;
-    (*ast) -> ast_import = import;
-    (*ast) -> next = memoryAlloc(sizeof(struct AST));
-    (*ast) = (*ast) -> next;
+static inline void addImport(struct AST* ast, struct Import import) {
+    addDecl(ast, AST_IMPORT, pushNode(ast -> imports, MEMORY_DECL, import));
 }
 
-static inline void addTest(struct AST** ast, struct Test test) {
-    (*ast) -> type = AST_TYPE;
-    (*ast) -> ast_test = test;
-    (*ast) -> next = memoryAlloc(sizeof(struct AST));
-    (*ast) = (*ast) -> next;
+static inline void addTest(struct AST* ast, struct Test test) {
+    addDecl(ast, AST_TEST, pushNode(ast -> tests, MEMORY_DECL, test));
 }
 
-static inline void addType(struct AST** ast, struct TypeDecl type) {
-    (*ast) -> type = AST_TYPE;
-    (*ast) -> ast_type = type;
-    (*ast) -> next = memoryAlloc(sizeof(struct AST));
-    (*ast) = (*ast) -> next;
+static inline void addTypeDecl(struct AST* ast, struct TypeDecl type) {
+    addDecl(ast, AST_TYPE, pushNode(ast -> type_decls, MEMORY_DECL, type));
 }
 
-static inline void addFunc(struct AST** ast, struct FuncDecl func) {
-    (*ast) -> type = AST_FUNC;
-    (*ast) -> ast_func = func;
-    (*ast) -> next = memoryAlloc(sizeof(struct AST));
-    (*ast) = (*ast) -> next;
+static inline void addFunc(struct AST* ast, struct FuncDecl func) {
+    addDecl(ast, AST_FUNC, pushNode(ast -> funcs, MEMORY_DECL, func));
 }
 
-static inline void addCFunc(struct AST** ast, struct CFuncDecl func) {
-    (*ast) -> type = AST_CFUNC;
-    (*ast) -> ast_cfunc = func;
-    (*ast) -> next = memoryAlloc(sizeof(struct AST));
-    (*ast) = (*ast) -> next;
+static inline void addCFunc(struct AST* ast, struct CFuncDecl func) {
+    addDecl(ast, AST_CFUNC, pushNode(ast -> cfuncs, MEMORY_DECL, func));
 }
 
 #endif
@@ -0,0 +1,748 @@
+#include <ctype.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "args.h"
+#include "ast.h"
+#include "error.h"
+#include "file.h"
+#include "lexer.h"
+#include "memory.h"
+#include "parser.h"
+#include "scan.h"
+#include "symbol.h"
+
+struct Args args;
+
+/*
+ * Output is one tab separated row per measurement under a fixed header,
+ * lines starting with '#' are comments. Times are the best of all rounds,
+ * allocations are counted over one round. Save a run and diff the next
+ * one against it.
+ */
+
+#define BENCH_SIZE   16
+#define BENCH_ROUNDS 8
+#define BENCH_SEED   1
+
+struct Corpus {
+    char*  text;
+    size_t length;
+    size_t capacity;
+};
+
+struct Result {
+    double seconds;
+    size_t tokens;
+    size_t allocs;
+};
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/*
+ * Corpus generator. Deterministic for a seed, so numbers from two runs
+ * describe the same input.
+ */
+
+static uint64_t random_state;
+
+static uint32_t randomNext(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint32_t)(random_state >> 32);
+}
+
+static uint32_t randomBelow(uint32_t n) {
+    return randomNext() % n;
+}
+
+static void emit(struct Corpus* corpus, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void emit(struct Corpus* corpus, const char* format, ...) {
+    va_list list;
+    while (true) {
+        size_t free = corpus -> capacity - corpus -> length;
+        va_start(list, format);
+        int length = vsnprintf(
+            corpus -> text + corpus -> length,
+            free,
+            format,
+            list
+        );
+        va_end(list);
+        if ((size_t) length < free) {
+            corpus -> length += length;
+            return;
+        }
+        corpus -> capacity *= 2;
+        corpus -> text = memoryRealloc(corpus -> text, corpus -> capacity);
+    }
+}
+
+static const char* const upper_names[] = {
+    "Int", "Uint8", "Float64", "Str", "Bool", "Vec", "Map", "Maybe",
+    "Either", "List", "Node", "Token", "Buffer", "Handle", "Pair",
+};
+static const char* const lower_names[] = {
+    "count", "index", "buffer", "next", "value", "left", "right", "size",
+    "offset", "name", "data", "line", "state", "result", "cursor",
+};
+
+#define PICK(names) (names[randomBelow(sizeof(names) / sizeof(names[0]))])
+
+static void emitType(struct Corpus* corpus, int depth) {
+    if (randomBelow(4) == 0) {
+        emit(corpus, "ref ");
+    }
+    emit(corpus, "%s", PICK(upper_names));
+    if (depth > 0 && randomBelow(3) == 0) {
+        uint32_t args = 1 + randomBelow(2);
+        emit(corpus, "<");
+        for (uint32_t i = 0; i < args; i++) {
+            emit(corpus, i == 0 ? "" : ", ");
+            emitType(corpus, depth - 1);
+        }
+        emit(corpus, ">");
+    }
+}
+
+static void emitComment(struct Corpus* corpus) {
+    if (randomBelow(2) == 0) {
+        emit(corpus, "/*");
+        for (int i = 0; i < 40; i++) {
+            emit(corpus, "*");
+        }
+        emit(corpus, "\n * generated, do not edit\n *\n");
+        for (uint32_t i = randomBelow(6); i > 0; i--) {
+            emit(corpus, " * the %s of the %s is kept in %s\n",
+                PICK(lower_names), PICK(lower_names), PICK(lower_names));
+        }
+        emit(corpus, " */\n");
+    } else {
+        emit(corpus, "// ----------------------------------------"
+                     "----------------------------------\n");
+    }
+}
+
+static void emitImport(struct Corpus* corpus) {
+    if (randomBelow(3) == 0) {
+        emit(corpus, "import .%s.%s as %s;\n",
+            PICK(lower_names), PICK(lower_names), PICK(lower_names));
+    } else {
+        emit(corpus, "import %s.%s;\n", PICK(upper_names), PICK(lower_names));
+    }
+}
+
+static void emitTypeDecl(struct Corpus* corpus, uint32_t id) {
+    const char* kind[] = { "", "union ", "enum " };
+    uint32_t choice = randomBelow(4);
+    if (randomBelow(4) == 0) {
+        emit(corpus, "export ");
+    }
+    emit(corpus, "type T%u <A, B> ", id);
+    if (choice == 3) {
+        emit(corpus, "= ");
+        emitType(corpus, 3);
+        emit(corpus, ";\n\n");
+        return;
+    }
+    emit(corpus, "%s{\n", kind[choice]);
+    for (uint32_t i = 4 + randomBelow(8); i > 0; i--) {
+        emit(corpus, "    %s%u", PICK(lower_names), i);
+        if (choice != 2 || randomBelow(2) == 0) {
+            emit(corpus, ": ");
+            emitType(corpus, 2);
+        }
+        emit(corpus, ";\n");
+    }
+    emit(corpus, "}\n\n");
+}
+
+static void emitExpretion(struct Corpus* corpus, int depth) {
+    static const char* const operators[] = {
+        "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "&&", "||",
+        "==", "!=", "<", "<=", ">", ">=",
+    };
+    if (depth == 0) {
+        switch (randomBelow(4)) {
+        case 0:
+            emit(corpus, "%u", randomBelow(100000));
+            break;
+        case 1:
+            emit(corpus, "%u.%ue%u", randomBelow(100), randomBelow(1000),
+                randomBelow(10));
+            break;
+        default:
+            emit(corpus, "%s", PICK(lower_names));
+        }
+        return;
+    }
+    switch (randomBelow(5)) {
+    case 0:
+        emit(corpus, "(");
+        emitExpretion(corpus, depth - 1);
+        emit(corpus, ")");
+        break;
+    case 1:
+        emit(corpus, "%s(", PICK(lower_names));
+        emitExpretion(corpus, depth - 1);
+        emit(corpus, ", ");
+        emitExpretion(corpus, depth - 1);
+        emit(corpus, ")");
+        break;
+    default:
+        emitExpretion(corpus, depth - 1);
+        emit(corpus, " %s ", PICK(operators));
+        emitExpretion(corpus, depth - 1);
+    }
+}
+
+static void emitFunc(struct Corpus* corpus, uint32_t id) {
+    emit(corpus, "func (self T%u <A, B>) %s%u(%s: Int, %s: ",
+        id, PICK(lower_names), id, PICK(lower_names), PICK(lower_names));
+    emitType(corpus, 2);
+    emit(corpus, ") Int {\n");
+    for (uint32_t i = 2 + randomBelow(4); i > 0; i--) {
+        emit(corpus, "    var %s%u: Int = ", PICK(lower_names), i);
+        emitExpretion(corpus, 6);
+        emit(corpus, ";\n");
+    }
+    emit(corpus, "    write(stdout, \"a rather long string with some"
+                 " \\\"escapes\\\" and a \\x41 inside of it\\n\");\n");
+    emit(corpus, "    return ");
+    emitExpretion(corpus, 4);
+    emit(corpus, ";\n}\n\n");
+}
+
+/*
+ * decls has only comments, imports and type declarations, which keeps the
+ * expretion parser out of its numbers. full adds functions with deep
+ * expretions and string literals on top.
+ */
+static struct Corpus generateCorpus(size_t size, uint64_t seed, bool full) {
+    struct Corpus res = {
+        .capacity = size + 4096,
+        .text     = memoryAlloc(size + 4096)
+    };
+    random_state = seed * 0x9e3779b97f4a7c15ull + 1;
+    for (uint32_t id = 0; res.length < size; id++) {
+        if (id % 16 == 0) {
+            emitComment(&res);
+            for (uint32_t i = 1 + randomBelow(4); i > 0; i--) {
+                emitImport(&res);
+            }
+            emit(&res, "\n");
+        }
+        emitTypeDecl(&res, id);
+        if (full && randomBelow(2) == 0) {
+            emitFunc(&res, id);
+        }
+    }
+    return res;
+}
+
+/*
+ * Measurements
+ */
+
+static void printHeader(const char* corpus, size_t size, int rounds) {
+    printf("# mic-bench corpus=%s bytes=%zu rounds=%d\n", corpus, size, rounds);
+    printf("bench\tkernel\tbytes\ttokens\tseconds\tmb_per_s\ttokens_per_s"
+           "\tallocs_per_kb\n");
+}
+
+static void printResult(
+    const char*   name,
+    const char*   kernel,
+    size_t        bytes,
+    struct Result result
+) {
+    double mb = bytes / (1024.0 * 1024.0);
+    printf(
+        "%s\t%s\t%zu\t%zu\t%.6f\t%.1f\t%.0f\t%.3f\n",
+        name,
+        kernel,
+        bytes,
+        result.tokens,
+        result.seconds,
+        mb / result.seconds,
+        result.tokens / result.seconds,
+        result.allocs / (bytes / 1024.0)
+    );
+}
+
+static void keepBest(struct Result* best, struct Result now, int round) {
+    if (round == 0 || now.seconds < best -> seconds) {
+        best -> seconds = now.seconds;
+    }
+    best -> tokens = now.tokens;
+    best -> allocs = now.allocs;
+}
+
+static struct Result benchReadFile(const char* path, int rounds) {
+    struct Result res = { 0 };
+    for (int round = 0; round < rounds; round++) {
+        size_t allocs = memoryStats().allocs;
+        double start = now();
+        struct File file;
+        struct Error error = { 0 };
+        if (!readFile(&file, path, &error)) {
+            printError(stderr, &error);
+            exit(EXIT_FAILURE);
+        }
+        // touch every page, mapping alone reads nothing
+        volatile unsigned char sum = 0;
+        for (size_t i = 0; i < file.length; i += 4096) {
+            sum += file.text[i];
+        }
+        closeFile(&file);
+        keepBest(&res, (struct Result) {
+            .seconds = now() - start,
+            .allocs  = memoryStats().allocs - allocs
+        }, round);
+    }
+    return res;
+}
+
+static struct Result benchSkipWhiteSpaces(const char* src, int rounds) {
+    struct Result res = { 0 };
+    for (int round = 0; round < rounds; round++) {
+        struct Lexer lexer = {
+            .file = "<bench>",
+            .line = 1
+        };
+        size_t allocs = memoryStats().allocs;
+        double start = now();
+        const char* now_src = src;
+        while (*now_src != 0) {
+            skipWhiteSpaces(&lexer, &now_src);
+            while (*now_src != 0 && !isspace((unsigned char)*now_src)
+                && *now_src != '/') {
+                now_src++;
+            }
+            if (*now_src == '/' && now_src[1] != '/' && now_src[1] != '*') {
+                now_src++;
+            }
+        }
+        keepBest(&res, (struct Result) {
+            .seconds = now() - start,
+            .allocs  = memoryStats().allocs - allocs
+        }, round);
+    }
+    return res;
+}
+
+static struct Result benchTokenize(const char* src, int rounds) {
+    struct Result res = { 0 };
+    for (int round = 0; round < rounds; round++) {
+        struct Arena arena;
+        struct Symbols symbols;
+        struct Tokens tokens;
+        size_t allocs = memoryStats().allocs;
+        double start = now();
+        arenaInit(&arena, ARENA_CHUNK_SIZE);
+        initSymbols(&symbols, &arena);
+        struct Lexer lexer = {
+            .file    = "<bench>",
+            .line    = 1,
+            .symbols = &symbols
+        };
+        tokenize(&lexer, &tokens, src);
+        size_t count = tokens.count;
+        freeTokens(&tokens);
+        freeSymbols(&symbols);
+        arenaFree(&arena);
+        keepBest(&res, (struct Result) {
+            .seconds = now() - start,
+            .tokens  = count,
+            .allocs  = memoryStats().allocs - allocs
+        }, round);
+    }
+    return res;
+}
+
+/*
+ * Each matcher runs on exactly the tokens it is meant for, found by a
+ * tokenize pass beforehand, so bytes and rates are of those tokens only.
+ */
+
+static bool benchUpperName(struct Lexer* l, const char* s, const char** e) {
+    struct String res;
+    return matchUpperName(l, s, e, &res);
+}
+
+static bool benchLowerName(struct Lexer* l, const char* s, const char** e) {
+    struct String res;
+    return matchLowerName(l, s, e, &res);
+}
+
+static bool benchDotName(struct Lexer* l, const char* s, const char** e) {
+    struct String res;
+    return matchDotName(l, s, e, &res);
+}
+
+static bool benchAtName(struct Lexer* l, const char* s, const char** e) {
+    struct String res;
+    return matchAtName(l, s, e, &res);
+}
+
+static bool benchString(struct Lexer* l, const char* s, const char** e) {
+    struct String res;
+    if (matchString(l, s, e, &res)) {
+        memoryFree(res.string);
+        return true;
+    }
+    return false;
+}
+
+static bool benchUint(struct Lexer* l, const char* s, const char** e) {
+    uint64_t res;
+    return matchUint(l, s, e, &res);
+}
+
+static bool benchFloat(struct Lexer* l, const char* s, const char** e) {
+    long double res;
+    return matchFloat(l, s, e, &res);
+}
+
+static bool benchKeyword(struct Lexer* l, const char* s, const char** e) {
+    // the corpus only has these, and their first letters differ
+    static const char* const by_letter[26] = {
+        ['e' - 'a'] = "export",
+        ['f' - 'a'] = "func",
+        ['i' - 'a'] = "import",
+        ['r' - 'a'] = "return",
+        ['t' - 'a'] = "type",
+        ['u' - 'a'] = "union",
+        ['v' - 'a'] = "var",
+    };
+    const char* keyword = by_letter[(*s) - 'a'];
+    if (*s == 'e' && s[1] == 'n') {
+        keyword = "enum";
+    } else if (*s == 'a') {
+        keyword = "as";
+    } else if (*s == 'r' && s[2] == 'f') {
+        keyword = "ref";
+    }
+    return keyword != NULL && matchKeyword(l, s, e, keyword);
+}
+
+static bool benchChar(struct Lexer* l, const char* s, const char** e) {
+    return matchChar(l, s, e, *s);
+}
+
+#define BENCH_OPERATOR(name)                                                \
+    static bool bench##name(struct Lexer* l, const char* s, const char** e) \
+    {                                                                       \
+        return match##name(l, s, e);                                        \
+    }
+BENCH_OPERATOR(Asign)
+BENCH_OPERATOR(Equal)
+BENCH_OPERATOR(NotEqual)
+BENCH_OPERATOR(LessThen)
+BENCH_OPERATOR(LessThenOrEqual)
+BENCH_OPERATOR(LeftShift)
+BENCH_OPERATOR(GreatThen)
+BENCH_OPERATOR(GreatThenOrEqual)
+BENCH_OPERATOR(RightShift)
+BENCH_OPERATOR(BitwizeOr)
+BENCH_OPERATOR(LogicalOr)
+BENCH_OPERATOR(BitwizeAnd)
+BENCH_OPERATOR(LogicalAnd)
+
+// first and last are a range of token types, see enum TokenType
+static const struct {
+    const char*    name;
+    bool           (*match)(struct Lexer*, const char*, const char**);
+    enum TokenType first;
+    enum TokenType last;
+} matchers[] = {
+    #define MATCHER(name, first, last) \
+        { "match" #name, bench##name, first, last }
+    MATCHER(UpperName,        TOKEN_UPPER_NAME,  TOKEN_UPPER_NAME),
+    MATCHER(LowerName,        TOKEN_LOWER_NAME,  TOKEN_LOWER_NAME),
+    MATCHER(DotName,          TOKEN_DOT_NAME,    TOKEN_DOT_NAME),
+    MATCHER(AtName,           TOKEN_AT_NAME,     TOKEN_AT_NAME),
+    MATCHER(String,           TOKEN_STRING,      TOKEN_STRING),
+    MATCHER(Uint,             TOKEN_INT,         TOKEN_INT),
+    MATCHER(Float,            TOKEN_FLOAT,       TOKEN_FLOAT),
+    MATCHER(Keyword,          TOKEN_IMPORT,      TOKEN_RETURN),
+    MATCHER(Char,             TOKEN_LEFT_BRACE,  TOKEN_COLON),
+    MATCHER(Asign,            TOKEN_ASIGN,       TOKEN_ASIGN),
+    MATCHER(Equal,            TOKEN_EQUAL,       TOKEN_EQUAL),
+    MATCHER(NotEqual,         TOKEN_NOT_EQUAL,   TOKEN_NOT_EQUAL),
+    MATCHER(LessThen,         TOKEN_LESS_THEN,   TOKEN_LESS_THEN),
+    MATCHER(LessThenOrEqual,
+        TOKEN_LESS_THEN_OR_EQUAL, TOKEN_LESS_THEN_OR_EQUAL),
+    MATCHER(LeftShift,        TOKEN_LEFT_SHIFT,  TOKEN_LEFT_SHIFT),
+    MATCHER(GreatThen,        TOKEN_GREAT_THEN,  TOKEN_GREAT_THEN),
+    MATCHER(GreatThenOrEqual,
+        TOKEN_GREAT_THEN_OR_EQUAL, TOKEN_GREAT_THEN_OR_EQUAL),
+    MATCHER(RightShift,       TOKEN_RIGHT_SHIFT, TOKEN_RIGHT_SHIFT),
+    MATCHER(BitwizeOr,        TOKEN_BITWIZE_OR,  TOKEN_BITWIZE_OR),
+    MATCHER(LogicalOr,        TOKEN_LOGICAL_OR,  TOKEN_LOGICAL_OR),
+    MATCHER(BitwizeAnd,       TOKEN_BITWIZE_AND, TOKEN_BITWIZE_AND),
+    MATCHER(LogicalAnd,       TOKEN_LOGICAL_AND, TOKEN_LOGICAL_AND),
+    #undef MATCHER
+};
+
+static void benchMatchers(const char* src, const char* kernel, int rounds) {
+    struct Arena arena;
+    struct Symbols symbols;
+    struct Tokens tokens;
+    arenaInit(&arena, ARENA_CHUNK_SIZE);
+    initSymbols(&symbols, &arena);
+    struct Lexer lexer = {
+        .file    = "<bench>",
+        .line    = 1,
+        .symbols = &symbols
+    };
+    tokenize(&lexer, &tokens, src);
+
+    uint32_t* offsets = memoryAlloc(tokens.count * sizeof(uint32_t));
+    for (size_t m = 0; m < sizeof(matchers) / sizeof(matchers[0]); m++) {
+        size_t count = 0;
+        size_t bytes = 0;
+        for (size_t i = 0; i < tokens.count; i++) {
+            struct Token* token = &tokens.tokens[i];
+            if (token -> type >= matchers[m].first
+             && token -> type <= matchers[m].last) {
+                offsets[count++] = token -> offset;
+                bytes += token -> length;
+            }
+        }
+        if (count == 0) {
+            printf("# %s: no tokens in the corpus\n", matchers[m].name);
+            continue;
+        }
+
+        struct Result res = { 0 };
+        size_t missed = 0;
+        for (int round = 0; round < rounds; round++) {
+            missed = 0;
+            size_t allocs = memoryStats().allocs;
+            double start = now();
+            for (size_t i = 0; i < count; i++) {
+                const char* end = NULL;
+                if (!matchers[m].match(&lexer, src + offsets[i], &end)) {
+                    missed++;
+                }
+            }
+            keepBest(&res, (struct Result) {
+                .seconds = now() - start,
+                .tokens  = count,
+                .allocs  = memoryStats().allocs - allocs
+            }, round);
+        }
+        if (missed != 0) {
+            printf("# %s: missed %zu of %zu tokens\n",
+                matchers[m].name, missed, count);
+        }
+        printResult(matchers[m].name, kernel, bytes, res);
+    }
+    memoryFree(offsets);
+
+    freeTokens(&tokens);
+    freeSymbols(&symbols);
+    arenaFree(&arena);
+}
+
+// tokens is the number of lexed tokens, so the rate compares to tokenize
+static struct Result benchParse(const char* src, int rounds, bool* parsed) {
+    struct Result res = { 0 };
+    for (int round = 0; round < rounds; round++) {
+        struct Arena arena;
+        struct Symbols symbols;
+        struct AST ast;
+        struct Error error = { 0 };
+        size_t allocs = memoryStats().allocs;
+        double start = now();
+        arenaInit(&arena, ARENA_CHUNK_SIZE);
+        initSymbols(&symbols, &arena);
+        initAST(&ast, &symbols);
+        (*parsed) = parse(&ast, src, "<bench>", &error);
+        freeAST(&ast);
+        freeSymbols(&symbols);
+        arenaFree(&arena);
+        keepBest(&res, (struct Result) {
+            .seconds = now() - start,
+            .allocs  = memoryStats().allocs - allocs
+        }, round);
+        if (!(*parsed)) {
+            printf("# parse skipped: ");
+            printError(stdout, &error);
+            return res;
+        }
+    }
+
+    struct Arena arena;
+    struct Symbols symbols;
+    struct Tokens tokens;
+    arenaInit(&arena, ARENA_CHUNK_SIZE);
+    initSymbols(&symbols, &arena);
+    struct Lexer lexer = {
+        .file    = "<bench>",
+        .line    = 1,
+        .symbols = &symbols
+    };
+    tokenize(&lexer, &tokens, src);
+    res.tokens = tokens.count;
+    freeTokens(&tokens);
+    freeSymbols(&symbols);
+    arenaFree(&arena);
+    return res;
+}
+
+static void benchCorpus(const char* name, struct Corpus* corpus, int rounds) {
+    printHeader(name, corpus -> length, rounds);
+
+    char path[] = "/tmp/mic-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        bool written = write(fd, corpus -> text, corpus -> length)
+                    == (ssize_t) corpus -> length;
+        close(fd);
+        if (written) {
+            printResult(
+                "readFile",
+                "-",
+                corpus -> length,
+                benchReadFile(path, rounds)
+            );
+        }
+        unlink(path);
+    }
+
+    enum ScanKernel all[] = { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+    enum ScanKernel best = SCAN_SCALAR;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (!scanSupported(all[i])) {
+            continue;
+        }
+        best = all[i];
+        scanSelect(all[i]);
+        printResult(
+            "skipWhiteSpaces",
+            scanKernelName(all[i]),
+            corpus -> length,
+            benchSkipWhiteSpaces(corpus -> text, rounds)
+        );
+        printResult(
+            "tokenize",
+            scanKernelName(all[i]),
+            corpus -> length,
+            benchTokenize(corpus -> text, rounds)
+        );
+    }
+
+    // the rest only runs with the kernel the compiler picks itself
+    scanSelect(best);
+    benchMatchers(corpus -> text, scanKernelName(best), rounds);
+
+    bool parsed;
+    struct Result res = benchParse(corpus -> text, rounds, &parsed);
+    if (parsed) {
+        printResult("parse", scanKernelName(best), corpus -> length, res);
+    }
+}
+
+static void usage(const char* prog_name) {
+    fprintf(
+        stderr,
+        "usage:\t%s [options] [file...]\n"
+        "options:\n"
+        "\t-s <mb>      size of the generated corpora, default %d\n"
+        "\t-r <n>       rounds, the best one is reported, default %d\n"
+        "\t-S <seed>    seed of the generator, default %d\n"
+        "\t-g <corpus>  write the decls or full corpus to stdout and exit\n"
+        "without files both generated corpora are measured\n",
+        prog_name,
+        BENCH_SIZE,
+        BENCH_ROUNDS,
+        BENCH_SEED
+    );
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    size_t size = BENCH_SIZE;
+    int rounds = BENCH_ROUNDS;
+    uint64_t seed = BENCH_SEED;
+    memoryTrack(true);
+    const char* generate = NULL;
+    int ch;
+    while ((ch = getopt(argc, argv, "s:r:S:g:")) != -1) {
+        switch (ch) {
+        case 's':
+            size = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'g':
+            generate = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (size == 0 || rounds <= 0) {
+        usage(argv[0]);
+    }
+    size *= 1024 * 1024;
+
+    if (generate != NULL) {
+        bool full = strcmp(generate, "full") == 0;
+        if (!full && strcmp(generate, "decls") != 0) {
+            usage(argv[0]);
+        }
+        struct Corpus corpus = generateCorpus(size, seed, full);
+        fwrite(corpus.text, 1, corpus.length, stdout);
+        memoryFree(corpus.text);
+        return EXIT_SUCCESS;
+    }
+
+    if (optind == argc) {
+        struct Corpus decls = generateCorpus(size, seed, false);
+        benchCorpus("decls", &decls, rounds);
+        memoryFree(decls.text);
+        struct Corpus full = generateCorpus(size, seed, true);
+        benchCorpus("full", &full, rounds);
+        memoryFree(full.text);
+        return EXIT_SUCCESS;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        struct File file;
+        struct Error error = { 0 };
+        if (!readFile(&file, argv[i], &error)) {
+            printError(stderr, &error);
+            return EXIT_FAILURE;
+        }
+        struct Corpus corpus = {
+            .text     = memoryStringnLengthDup(file.text, file.length),
+            .length   = file.length,
+            .capacity = file.length + 1
+        };
+        closeFile(&file);
+        benchCorpus(argv[i], &corpus, rounds);
+        memoryFree(corpus.text);
+    }
+    return EXIT_SUCCESS;
+}
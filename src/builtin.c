@@ -0,0 +1,40 @@
+#include <string.h>
+// for: memcmp, strlen
+
+#include "builtin.h"
+
+static const struct {
+    const char*    name;
+    struct Builtin builtin;
+} builtins[] = {
+    { "Int",      { BUILTIN_INT,   64  } },
+    { "Int8",     { BUILTIN_INT,   8   } },
+    { "Int16",    { BUILTIN_INT,   16  } },
+    { "Int32",    { BUILTIN_INT,   32  } },
+    { "Int64",    { BUILTIN_INT,   64  } },
+    { "Uint",     { BUILTIN_UINT,  64  } },
+    { "Uint8",    { BUILTIN_UINT,  8   } },
+    { "Uint16",   { BUILTIN_UINT,  16  } },
+    { "Uint32",   { BUILTIN_UINT,  32  } },
+    { "Uint64",   { BUILTIN_UINT,  64  } },
+    { "Float",    { BUILTIN_FLOAT, 64  } },
+    { "Float32",  { BUILTIN_FLOAT, 32  } },
+    { "Float64",  { BUILTIN_FLOAT, 64  } },
+    { "Float128", { BUILTIN_FLOAT, 128 } },
+    { "Bool",     { BUILTIN_BOOL,  8   } },
+    { "Str",      { BUILTIN_STR,   0   } },
+    { "Etc",      { BUILTIN_ETC,   0   } },
+    { "None",     { BUILTIN_NONE,  0   } },
+    { "Func",     { BUILTIN_FUNC,  0   } },
+};
+
+struct Builtin builtinType(struct Symbols* symbols, uint32_t name) {
+    struct String string = symbolString(symbols, name);
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strlen(builtins[i].name) == string.length
+         && memcmp(builtins[i].name, string.string, string.length) == 0) {
+            return builtins[i].builtin;
+        }
+    }
+    return (struct Builtin) { .type = BUILTIN_USER };
+}
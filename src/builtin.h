@@ -0,0 +1,50 @@
+#ifndef BUILTIN_H
+#define BUILTIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "symbol.h"
+
+/*
+ * The types every program has, see "build in types" in syntax.md. Int and
+ * Uint are 64 bits wide, Float is Float64. Float128 is the widest float of
+ * the host, long double.
+ */
+
+enum BuiltinType {
+    BUILTIN_USER,                   // not built in
+    BUILTIN_INT,
+    BUILTIN_UINT,
+    BUILTIN_FLOAT,
+    BUILTIN_BOOL,
+    BUILTIN_STR,
+    BUILTIN_ETC,
+    BUILTIN_NONE,
+    BUILTIN_FUNC,
+};
+
+struct Builtin {
+    enum BuiltinType type;
+    uint32_t         bits;          // numbers only
+};
+
+struct Builtin builtinType(struct Symbols* symbols, uint32_t name);
+
+/*
+ * value wrapped around to an integer of the given width, sign extended to
+ * 64 bits when signed. 0 is as wide as 64.
+ */
+static inline uint64_t wrapInt(uint64_t value, bool is_signed, uint32_t bits) {
+    if (bits == 0 || bits >= 64) {
+        return value;
+    }
+    uint64_t mask = (UINT64_C(1) << bits) - 1;
+    value &= mask;
+    if (is_signed && ((value >> (bits - 1)) & 1)) {
+        value |= ~mask;
+    }
+    return value;
+}
+
+#endif
@@ -0,0 +1,978 @@
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <stdio.h>
+// for: vsnprintf
+#include <string.h>
+// for: memcmp, memset, strlen
+
+#include "ast.h"
+#include "builtin.h"
+#include "bytecode.h"
+#include "memory.h"
+#include "timing.h"
+
+#define LOWER_ERROR "Compile error"
+
+// what an import of path gives, see enum Native
+static const struct {
+    const char* path;
+    bool        is_value;
+    uint32_t    native;             // enum Native, or the stream of a value
+    uint32_t    args;
+} natives[] = {
+    { "Cosole.stdout", true,  VM_STDOUT,     0 },
+    { "Cosole.stderr", true,  VM_STDERR,     0 },
+    { "File.write",    false, NATIVE_WRITE,  2 },
+    { "Test.assert",   false, NATIVE_ASSERT, 1 },
+};
+
+#define NATIVE_COUNT (sizeof(natives) / sizeof(natives[0]))
+
+struct Local {
+    uint32_t name;
+    uint32_t reg;
+    uint16_t cast;                  // castCode of its type, 0 if none
+};
+
+/*
+ * An expretion being lowered into target. state counts the children
+ * already lowered, left and temp are registers it still needs.
+ */
+struct Work {
+    uint32_t expr;
+    uint32_t target;
+    uint32_t state;
+    uint32_t left;
+    uint32_t temp;
+};
+
+struct Lower {
+    struct AST*         ast;
+    struct Program*     program;
+    struct Error*       error;
+    jmp_buf             bail;
+
+    uint32_t*           by_symbol;  // name -> Program.functions + 1, 0 if none
+    NODES(uint32_t)     queue;      // Program.functions still to lower
+    uint32_t            function;   // being lowered
+
+    NODES(struct Local) locals;
+    uint32_t            top;        // first free register
+    uint32_t            registers;  // most registers used at once
+
+    NODES(struct Work)  work;       // see lowerExpretion
+    NODES(uint32_t)     jumps;      // to patch, see lowerSwitch
+};
+
+static _Noreturn __attribute__((format(printf, 2, 3))) void errorLower(
+    struct Lower* lower,
+    const char*   format,
+    ...
+) {
+    char message[192];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+
+    struct Function function = lower -> program -> functions.items[
+        lower -> function
+    ];
+    if (function.name == SYMBOL_NONE) {
+        setError(lower -> error, LOWER_ERROR, lower -> program -> path, 0,
+            "%s, in a test", message);
+    } else {
+        struct String name = symbolString(lower -> ast -> symbols,
+            function.name);
+        setError(lower -> error, LOWER_ERROR, lower -> program -> path, 0,
+            "%s, in func %.*s", message, (int) name.length, name.string);
+    }
+    longjmp(lower -> bail, 1);
+}
+
+static inline struct String nameOf(struct Lower* lower, uint32_t symbol) {
+    return symbolString(lower -> ast -> symbols, symbol);
+}
+
+static inline uint32_t emit(
+    struct Lower*      lower,
+    enum Opcode        op,
+    uint32_t           a,
+    uint32_t           b,
+    uint32_t           c
+) {
+    struct Instruction instruction = {
+        .op = op,
+        .a  = a,
+        .b  = b,
+        .c  = c
+    };
+    return pushNode(lower -> program -> code, MEMORY_BYTECODE, instruction);
+}
+
+static inline uint32_t emitJump(
+    struct Lower* lower,
+    enum Opcode   op,
+    uint32_t      a
+) {
+    return emit(lower, op, a, 0, 0);
+}
+
+// makes the jump at pc land on the next instruction emitted
+static inline void patchJump(struct Lower* lower, uint32_t pc) {
+    lower -> program -> code.items[pc].offset =
+        (int32_t) (lower -> program -> code.count - (pc + 1));
+}
+
+static inline void emitJumpTo(
+    struct Lower* lower,
+    enum Opcode   op,
+    uint32_t      a,
+    uint32_t      target
+) {
+    uint32_t pc = emitJump(lower, op, a);
+    lower -> program -> code.items[pc].offset = (int32_t) target
+                                              - (int32_t) (pc + 1);
+}
+
+static uint32_t emitConstant(
+    struct Lower* lower,
+    uint32_t      target,
+    struct Value  value
+) {
+    uint32_t index = pushNode(
+        lower -> program -> constants,
+        MEMORY_BYTECODE,
+        value
+    );
+    struct Instruction instruction = {
+        .op    = OP_LOAD_CONST,
+        .a     = target,
+        .index = index
+    };
+    return pushNode(lower -> program -> code, MEMORY_BYTECODE, instruction);
+}
+
+static uint32_t allocRegisters(struct Lower* lower, uint32_t count) {
+    uint32_t res = lower -> top;
+    lower -> top += count;
+    if (lower -> top > UINT16_MAX) {
+        errorLower(lower, "too many registers needed");
+    }
+    if (lower -> top > lower -> registers) {
+        lower -> registers = lower -> top;
+    }
+    return res;
+}
+
+// the innermost local called name, or NULL
+static struct Local* findLocal(struct Lower* lower, uint32_t name) {
+    for (uint32_t i = lower -> locals.count; i > 0; i--) {
+        if (lower -> locals.items[i - 1].name == name) {
+            return &lower -> locals.items[i - 1];
+        }
+    }
+    return NULL;
+}
+
+static void pushLocal(
+    struct Lower* lower,
+    uint32_t      name,
+    uint32_t      reg,
+    uint16_t      cast
+) {
+    struct Local local = {
+        .name = name,
+        .reg  = reg,
+        .cast = cast
+    };
+    pushNode(lower -> locals, MEMORY_BYTECODE, local);
+}
+
+/*
+ * The native path names, a single name is looked up among the imports
+ * first, so import File.write; makes write the native File.write.
+ * Returns NATIVE_COUNT if there is none.
+ */
+static uint32_t findNative(struct Lower* lower, struct Path path) {
+    path = importedPath(lower -> ast, path);
+    for (uint32_t i = 0; i < NATIVE_COUNT; i++) {
+        if (pathIs(lower -> ast, path, natives[i].path)) {
+            return i;
+        }
+    }
+    return NATIVE_COUNT;
+}
+
+static _Noreturn void errorUnknownName(struct Lower* lower, struct Path path) {
+    struct AST* ast = lower -> ast;
+    struct String name = nameOf(lower, ast -> names.items[
+        path.names.start + path.names.count - 1
+    ]);
+    errorLower(lower, "unknown name '%.*s'", (int) name.length, name.string);
+}
+
+// the register of the local expr reads, or NODE_NONE
+static uint32_t localOf(struct Lower* lower, uint32_t expr) {
+    struct Expretion expretion = lower -> ast -> expretions.items[expr];
+    if (expretion.type != EXPRETION_LITERAL
+     || expretion.literal.type != LITERAL_NAME) {
+        return NODE_NONE;
+    }
+    struct Path path = expretion.literal.name;
+    if (path.is_relative || path.names.count != 1) {
+        return NODE_NONE;
+    }
+    struct Local* local = findLocal(
+        lower,
+        lower -> ast -> names.items[path.names.start]
+    );
+    return local == NULL ? NODE_NONE : local -> reg;
+}
+
+// the value of expr if it is an integer literal that fits an Int16
+static uint32_t immediateOf(struct Lower* lower, uint32_t expr) {
+    struct Expretion expretion = lower -> ast -> expretions.items[expr];
+    if (expretion.type != EXPRETION_LITERAL
+     || expretion.literal.type != LITERAL_INT
+     || expretion.literal._int > INT16_MAX) {
+        return NODE_NONE;
+    }
+    return (uint32_t) expretion.literal._int;
+}
+
+// castCode of the type, 0 if values of it are not converted
+static uint16_t castOf(struct Lower* lower, struct Type type) {
+    struct Builtin builtin = builtinType(lower -> ast -> symbols, type.name);
+    if (type.is_ref || type.args.count != 0) {
+        return 0;
+    }
+    switch (builtin.type) {
+    case BUILTIN_INT:
+    case BUILTIN_UINT:
+    case BUILTIN_FLOAT:
+    case BUILTIN_BOOL:
+        return castCode(builtin.type, builtin.bits);
+    default:
+        return 0;
+    }
+}
+
+static void lowerLiteral(
+    struct Lower*  lower,
+    struct Literal literal,
+    uint32_t       target
+) {
+    switch (literal.type) {
+    case LITERAL_INT:
+        if (literal._int <= INT32_MAX) {
+            struct Instruction instruction = {
+                .op     = OP_LOAD_INT,
+                .a      = target,
+                .offset = (int32_t) literal._int
+            };
+            pushNode(lower -> program -> code, MEMORY_BYTECODE, instruction);
+        } else {
+            emitConstant(lower, target, (struct Value) {
+                .type = VALUE_INT,
+                .bits = 64,
+                ._int = (int64_t) literal._int
+            });
+        }
+        return;
+    case LITERAL_FLOAT:
+        emitConstant(lower, target, (struct Value) {
+            .type   = VALUE_FLOAT,
+            .bits   = 64,
+            ._float = lower -> ast -> floats.items[literal._float]
+        });
+        return;
+    case LITERAL_STING: {
+        struct String string = nameOf(lower, literal.string);
+        emitConstant(lower, target, (struct Value) {
+            .type   = VALUE_STR,
+            .length = string.length,
+            .str    = string.string
+        });
+        return;
+    }
+    case LITERAL_NAME: {
+        struct Path path = literal.name;
+        struct Local* local = !path.is_relative && path.names.count == 1
+            ? findLocal(lower, lower -> ast -> names.items[path.names.start])
+            : NULL;
+        if (local != NULL) {
+            if (local -> reg != target) {
+                emit(lower, OP_MOVE, target, local -> reg, 0);
+            }
+            return;
+        }
+        uint32_t native = findNative(lower, path);
+        if (native == NATIVE_COUNT || !natives[native].is_value) {
+            errorUnknownName(lower, path);
+        }
+        emitConstant(lower, target, (struct Value) {
+            .type = VALUE_FILE,
+            ._int = natives[native].native
+        });
+        return;
+    }
+    }
+}
+
+static void queueFunction(struct Lower* lower, uint32_t index) {
+    struct Function* function = &lower -> program -> functions.items[index];
+    if (function -> start == NODE_NONE) {
+        // 0 while queued, the real start is set once it is lowered
+        function -> start = 0;
+        pushNode(lower -> queue, MEMORY_BYTECODE, index);
+    }
+}
+
+// the function called name, lowered later if it was not yet
+static uint32_t callFunction(struct Lower* lower, struct Path path) {
+    if (path.is_relative || path.names.count != 1) {
+        return NODE_NONE;
+    }
+    uint32_t name = lower -> ast -> names.items[path.names.start];
+    if (lower -> by_symbol[name] == 0) {
+        return NODE_NONE;
+    }
+    queueFunction(lower, lower -> by_symbol[name] - 1);
+    return lower -> by_symbol[name] - 1;
+}
+
+static enum Opcode opcodeOf(enum ExpretionTypy type) {
+    switch (type) {
+    case EXPRETION_ADD:                 return OP_ADD;
+    case EXPRETION_SUBTRACT:            return OP_SUBTRACT;
+    case EXPRETION_MULTIPLY:            return OP_MULTIPLY;
+    case EXPRETION_DIVIDE:              return OP_DIVIDE;
+    case EXPRETION_MODULO:              return OP_MODULO;
+    case EXPRETION_BITWIZE_OR:          return OP_BITWIZE_OR;
+    case EXPRETION_BITWIZE_AND:         return OP_BITWIZE_AND;
+    case EXPRETION_LEFT_SHIFT:          return OP_LEFT_SHIFT;
+    case EXPRETION_RIGHT_SHIFT:         return OP_RIGHT_SHIFT;
+    case EXPRETION_EQUAL:               return OP_EQUAL;
+    case EXPRETION_NOT_EQUAL:           return OP_NOT_EQUAL;
+    case EXPRETION_LESS_THEN:           return OP_LESS_THEN;
+    case EXPRETION_GREAT_THEN:          return OP_GREAT_THEN;
+    case EXPRETION_LESS_THEN_OR_EQUAL:  return OP_LESS_THEN_OR_EQUAL;
+    case EXPRETION_GREA_THEN_OR_EQUAL:  return OP_GREA_THEN_OR_EQUAL;
+    case EXPRETION_NEG:                 return OP_NEG;
+    case EXPRETION_BITWIZE_NOT:         return OP_BITWIZE_NOT;
+    case EXPRETION_LOGICAL_NOT:         return OP_LOGICAL_NOT;
+    case EXPRETION_CAST:                return OP_CAST;
+    default:                            return OPCODE_COUNT;
+    }
+}
+
+static inline void pushWork(
+    struct Lower* lower,
+    struct Work   work
+) {
+    pushNode(lower -> work, MEMORY_BYTECODE, work);
+}
+
+// a call in work.state 0 resolves the callee, in state n lowers argument n
+static void lowerCall(struct Lower* lower, struct Work work) {
+    struct Expretion expr = lower -> ast -> expretions.items[work.expr];
+    struct FunctionCall call = expr.func;
+    if (work.state == 0) {
+        // the target can be the first argument when nothing is above it
+        if (work.target + 1 == lower -> top) {
+            lower -> top = work.target;
+        }
+        work.left = allocRegisters(
+            lower,
+            call.args.count == 0 ? 1 : call.args.count
+        );
+    }
+    if (work.state < call.args.count) {
+        uint32_t arg = lower -> ast -> expretion_lists.items[
+            call.args.start + work.state
+        ];
+        uint32_t reg = work.left + work.state;
+        work.state++;
+        pushWork(lower, work);
+        pushWork(lower, (struct Work) { .expr = arg, .target = reg });
+        return;
+    }
+
+    uint32_t function = callFunction(lower, call.name);
+    uint32_t args;
+    if (function != NODE_NONE) {
+        args = lower -> program -> functions.items[function].args;
+        emit(lower, OP_CALL, work.left, function, call.args.count);
+    } else {
+        uint32_t native = findNative(lower, call.name);
+        if (native == NATIVE_COUNT || natives[native].is_value) {
+            errorUnknownName(lower, call.name);
+        }
+        args = natives[native].args;
+        emit(lower, OP_NATIVE, work.left, natives[native].native,
+            call.args.count);
+    }
+    if (args != call.args.count) {
+        struct String name = nameOf(lower, lower -> ast -> names.items[
+            call.name.names.start + call.name.names.count - 1
+        ]);
+        errorLower(lower, "'%.*s' takes %u arguments, got %u",
+            (int) name.length, name.string, args, call.args.count);
+    }
+    if (work.left != work.target) {
+        emit(lower, OP_MOVE, work.target, work.left, 0);
+    }
+    lower -> top = work.left == work.target ? work.target + 1 : work.left;
+}
+
+/*
+ * Lowers expr so its value ends up in target, which no local lives in.
+ * Nested expretions can be as deep as the parser allows, so instead of
+ * recursing the expretions still open are kept on lower -> work.
+ * Operands that are locals are read from their register in place.
+ */
+static void lowerExpretion(
+    struct Lower* lower,
+    uint32_t      root,
+    uint32_t      target
+) {
+    uint32_t mark = lower -> work.count;
+    pushWork(lower, (struct Work) { .expr = root, .target = target });
+    while (lower -> work.count > mark) {
+        struct Work work = lower -> work.items[--lower -> work.count];
+        struct Expretion expr = lower -> ast -> expretions.items[work.expr];
+        switch (expr.type) {
+        case EXPRETION_NONE:
+            break;
+        case EXPRETION_LITERAL:
+            lowerLiteral(lower, expr.literal, work.target);
+            break;
+        case EXPRETION_FUNCTION:
+            lowerCall(lower, work);
+            break;
+        case EXPRETION_REF:
+        case EXPRETION_DEREF:
+        case EXPRETION_GET:
+            errorLower(lower, "references and arrays can not run yet");
+        case EXPRETION_CAST:
+        case EXPRETION_NEG:
+        case EXPRETION_BITWIZE_NOT:
+        case EXPRETION_LOGICAL_NOT: {
+            uint32_t cast = 0;
+            if (expr.type == EXPRETION_CAST) {
+                cast = castOf(lower, lower -> ast -> types.items[expr.cast]);
+                if (cast == 0) {
+                    errorLower(lower, "only numbers and Bool can be cast");
+                }
+            }
+            uint32_t reg = localOf(lower, expr.expr);
+            if (reg == NODE_NONE && work.state == 0) {
+                work.state = 1;
+                pushWork(lower, work);
+                pushWork(lower, (struct Work) {
+                    .expr   = expr.expr,
+                    .target = work.target
+                });
+                break;
+            }
+            reg = reg == NODE_NONE ? work.target : reg;
+            emit(lower, opcodeOf(expr.type), work.target, reg, cast);
+            break;
+        }
+        case EXPRETION_LOGICAL_AND:
+        case EXPRETION_LOGICAL_OR:
+            // the left value is the result if it decides it
+            if (work.state == 0) {
+                work.state = 1;
+                pushWork(lower, work);
+                pushWork(lower, (struct Work) {
+                    .expr   = expr.left,
+                    .target = work.target
+                });
+            } else if (work.state == 1) {
+                work.state = 2;
+                work.temp = emitJump(
+                    lower,
+                    expr.type == EXPRETION_LOGICAL_AND
+                        ? OP_JUMP_FALSE
+                        : OP_JUMP_TRUE,
+                    work.target
+                );
+                pushWork(lower, work);
+                pushWork(lower, (struct Work) {
+                    .expr   = expr.right,
+                    .target = work.target
+                });
+            } else {
+                patchJump(lower, work.temp);
+            }
+            break;
+        default:
+            if (work.state == 0) {
+                work.left = localOf(lower, expr.left);
+                work.state = 1;
+                if (work.left == NODE_NONE) {
+                    work.left = work.target;
+                    pushWork(lower, work);
+                    pushWork(lower, (struct Work) {
+                        .expr   = expr.left,
+                        .target = work.target
+                    });
+                    break;
+                }
+            }
+            if (work.state == 1) {
+                uint32_t reg = localOf(lower, expr.right);
+                if (reg != NODE_NONE) {
+                    emit(lower, opcodeOf(expr.type), work.target, work.left,
+                        reg);
+                    break;
+                }
+                uint32_t immediate = immediateOf(lower, expr.right);
+                if (immediate != NODE_NONE) {
+                    emit(lower, OP_IMMEDIATE(opcodeOf(expr.type)),
+                        work.target, work.left, immediate);
+                    break;
+                }
+                work.temp = allocRegisters(lower, 1);
+                work.state = 2;
+                pushWork(lower, work);
+                pushWork(lower, (struct Work) {
+                    .expr   = expr.right,
+                    .target = work.temp
+                });
+                break;
+            }
+            emit(lower, opcodeOf(expr.type), work.target, work.left,
+                work.temp);
+            lower -> top = work.temp;
+            break;
+        }
+    }
+}
+
+// the register holding the value of expr, free registers from top after
+static uint32_t lowerOperand(struct Lower* lower, uint32_t expr) {
+    uint32_t reg = localOf(lower, expr);
+    if (reg != NODE_NONE) {
+        return reg;
+    }
+    reg = allocRegisters(lower, 1);
+    lowerExpretion(lower, expr, reg);
+    return reg;
+}
+
+/*
+ * Moves the value of expr into the register of local. The last
+ * instruction writes the value, so it can write to the local directly,
+ * unless jumps of && or || land after it or it is a call, whose result
+ * stays in the first register of its arguments.
+ */
+static void lowerAsign(struct Lower* lower, struct Local local, uint32_t expr) {
+    uint32_t top = lower -> top;
+    uint32_t start = lower -> program -> code.count;
+    uint32_t reg = lowerOperand(lower, expr);
+    lower -> top = top;
+    if (local.cast != 0) {
+        emit(lower, OP_CAST, local.reg, reg, local.cast);
+        return;
+    }
+    enum ExpretionTypy type = lower -> ast -> expretions.items[expr].type;
+    struct Instruction* last = &lower -> program -> code.items[
+        lower -> program -> code.count - 1
+    ];
+    if (lower -> program -> code.count > start
+     && last -> a == reg
+     && last -> op != OP_CALL
+     && last -> op != OP_NATIVE
+     && type != EXPRETION_LOGICAL_AND
+     && type != EXPRETION_LOGICAL_OR) {
+        last -> a = local.reg;
+    } else if (reg != local.reg) {
+        emit(lower, OP_MOVE, local.reg, reg, 0);
+    }
+}
+
+static void lowerStatement(struct Lower* lower, uint32_t index);
+
+static void lowerBlock(struct Lower* lower, struct Range block) {
+    uint32_t locals = lower -> locals.count;
+    uint32_t top = lower -> top;
+    for (uint32_t i = 0; i < block.count; i++) {
+        lowerStatement(
+            lower,
+            lower -> ast -> statement_lists.items[block.start + i]
+        );
+    }
+    lower -> locals.count = locals;
+    lower -> top = top;
+}
+
+static void lowerVar(
+    struct Lower* lower,
+    uint32_t      name,
+    uint32_t      type,
+    uint32_t      value
+) {
+    uint32_t reg = allocRegisters(lower, 1);
+    uint16_t cast = type == NODE_NONE
+        ? 0
+        : castOf(lower, lower -> ast -> types.items[type]);
+    lowerExpretion(lower, value, reg);
+    if (cast != 0) {
+        emit(lower, OP_CAST, reg, reg, cast);
+    }
+    pushLocal(lower, name, reg, cast);
+}
+
+/*
+ * Compares the value against every case in order and jumps to the first
+ * one equal, or to default. Cases do not fall through.
+ */
+static void lowerSwitch(struct Lower* lower, struct StatementSwitch _switch) {
+    struct AST* ast = lower -> ast;
+    uint32_t top = lower -> top;
+    uint32_t mark = lower -> jumps.count;
+    uint32_t value = lowerOperand(lower, _switch.value);
+    for (uint32_t i = 0; i < _switch.cases.count; i++) {
+        struct StatementSwitchCase _case = ast -> cases.items[
+            _switch.cases.start + i
+        ];
+        uint32_t jump = NODE_NONE;
+        if (!_case._default) {
+            uint32_t reg = allocRegisters(lower, 1);
+            lowerLiteral(lower, _case._case, reg);
+            emit(lower, OP_EQUAL, reg, value, reg);
+            jump = emitJump(lower, OP_JUMP_TRUE, reg);
+            lower -> top = reg;
+        }
+        pushNode(lower -> jumps, MEMORY_BYTECODE, jump);
+    }
+    lower -> top = top;
+    uint32_t other = emitJump(lower, OP_JUMP, 0);
+
+    bool has_default = false;
+    for (uint32_t i = 0; i < _switch.cases.count; i++) {
+        struct StatementSwitchCase _case = ast -> cases.items[
+            _switch.cases.start + i
+        ];
+        uint32_t* jump = &lower -> jumps.items[mark + i];
+        if (_case._default) {
+            has_default = true;
+            patchJump(lower, other);
+        } else {
+            patchJump(lower, *jump);
+        }
+        lowerBlock(lower, _case.then);
+        (*jump) = emitJump(lower, OP_JUMP, 0);
+    }
+    if (!has_default) {
+        patchJump(lower, other);
+    }
+    for (uint32_t i = 0; i < _switch.cases.count; i++) {
+        patchJump(lower, lower -> jumps.items[mark + i]);
+    }
+    lower -> jumps.count = mark;
+}
+
+// a missing condition loops forever
+static void lowerWhile(
+    struct Lower* lower,
+    uint32_t      condition,
+    struct Range  then
+) {
+    uint32_t start = lower -> program -> code.count;
+    uint32_t exit = NODE_NONE;
+    if (condition != NODE_NONE) {
+        uint32_t top = lower -> top;
+        exit = emitJump(lower, OP_JUMP_FALSE, lowerOperand(lower, condition));
+        lower -> top = top;
+    }
+    lowerBlock(lower, then);
+    emitJumpTo(lower, OP_JUMP, 0, start);
+    if (exit != NODE_NONE) {
+        patchJump(lower, exit);
+    }
+}
+
+static void lowerStatement(struct Lower* lower, uint32_t index) {
+    struct Statement statement = lower -> ast -> statements.items[index];
+    uint32_t top = lower -> top;
+    switch (statement.type) {
+    case STATEMENT_NONE:
+        break;
+    case STATEMENT_VAR:
+        lowerVar(
+            lower,
+            statement.statement_var.name,
+            statement.statement_var.type,
+            statement.statement_var.value
+        );
+        return;
+    case STATEMENT_CONST:
+        lowerVar(
+            lower,
+            statement.statement_const.name,
+            NODE_NONE,
+            statement.statement_const.value
+        );
+        return;
+    case STATEMENT_IF: {
+        struct StatementIf _if = statement.statement_if;
+        uint32_t skip = emitJump(
+            lower,
+            OP_JUMP_FALSE,
+            lowerOperand(lower, _if.condition)
+        );
+        lower -> top = top;
+        lowerBlock(lower, _if.then);
+        if (_if._else.count != 0) {
+            uint32_t end = emitJump(lower, OP_JUMP, 0);
+            patchJump(lower, skip);
+            lowerBlock(lower, _if._else);
+            patchJump(lower, end);
+        } else {
+            patchJump(lower, skip);
+        }
+        break;
+    }
+    case STATEMENT_SWITCH:
+        lowerSwitch(lower, statement.statement_switch);
+        break;
+    case STATEMENT_DO: {
+        uint32_t start = lower -> program -> code.count;
+        lowerBlock(lower, statement.statement_do.then);
+        uint32_t reg = lowerOperand(
+            lower,
+            statement.statement_do.condition
+        );
+        emitJumpTo(lower, OP_JUMP_TRUE, reg, start);
+        break;
+    }
+    case STATEMENT_WHILE:
+        lowerWhile(
+            lower,
+            statement.statement_while.condition,
+            statement.statement_while.then
+        );
+        break;
+    case STATEMENT_FOR: {
+        // the var lives as long as the loop
+        uint32_t locals = lower -> locals.count;
+        lowerStatement(lower, statement.statement_for.var);
+        lowerWhile(
+            lower,
+            statement.statement_for.condition,
+            statement.statement_for.then
+        );
+        lower -> locals.count = locals;
+        break;
+    }
+    case STATEMENT_REPEAD: {
+        uint32_t counter = allocRegisters(lower, 1);
+        lowerExpretion(lower, statement.statement_repead.condition, counter);
+        uint32_t start = lower -> program -> code.count;
+        uint32_t exit = emitJump(lower, OP_REPEAD, counter);
+        lowerBlock(lower, statement.statement_repead.then);
+        emitJumpTo(lower, OP_JUMP, 0, start);
+        patchJump(lower, exit);
+        break;
+    }
+    case STATEMENT_RETURN:
+        if (statement.statement_return.value == NODE_NONE) {
+            emit(lower, OP_RETURN_NONE, 0, 0, 0);
+        } else {
+            uint32_t reg = lowerOperand(
+                lower,
+                statement.statement_return.value
+            );
+            emit(lower, OP_RETURN, reg, 0, 0);
+        }
+        break;
+    case STATEMENT_ASIGN: {
+        struct StatementAsign asign = statement.statement_asign;
+        if (asign.get_expr != NODE_NONE) {
+            errorLower(lower, "references and arrays can not run yet");
+        }
+        struct Local* local = findLocal(lower, asign.var_name);
+        if (local == NULL) {
+            struct String name = nameOf(lower, asign.var_name);
+            errorLower(lower, "unknown variable '%.*s'", (int) name.length,
+                name.string);
+        }
+        lowerAsign(lower, (*local), asign.value);
+        break;
+    }
+    case STATEMENT_CALL:
+        lowerExpretion(
+            lower,
+            statement.statement_expr,
+            allocRegisters(lower, 1)
+        );
+        break;
+    }
+    lower -> top = top;
+}
+
+static void lowerFunction(struct Lower* lower, uint32_t index) {
+    struct AST* ast = lower -> ast;
+    struct Program* program = lower -> program;
+    uint32_t funcs = ast -> funcs.count;
+    uint32_t cfuncs = ast -> cfuncs.count;
+
+    bool has_self = false;
+    uint32_t self = SYMBOL_NONE;
+    struct Range args = { 0 };
+    struct Range body;
+    if (index < funcs) {
+        struct FuncDecl func = ast -> funcs.items[index];
+        has_self = func.has_self;
+        self = func.self.name;
+        args = func.args;
+        body = func.body;
+    } else if (index < funcs + cfuncs) {
+        struct CFuncDecl cfunc = ast -> cfuncs.items[index - funcs];
+        args = cfunc.args;
+        body = cfunc.body;
+    } else {
+        body = ast -> tests.items[index - funcs - cfuncs].body;
+    }
+
+    lower -> function = index;
+    lower -> locals.count = 0;
+    lower -> top = 0;
+    lower -> registers = 0;
+    program -> functions.items[index].start = program -> code.count;
+    if (index < funcs && ast -> funcs.items[index].is_external) {
+        errorLower(lower, "external functions can not run");
+    }
+
+    if (has_self) {
+        pushLocal(lower, self, allocRegisters(lower, 1), 0);
+    }
+    for (uint32_t i = 0; i < args.count; i++) {
+        struct TypeFild fild = ast -> filds.items[args.start + i];
+        uint32_t reg = allocRegisters(lower, 1);
+        uint16_t cast = castOf(lower, fild.type);
+        if (cast != 0) {
+            emit(lower, OP_CAST, reg, reg, cast);
+        }
+        pushLocal(lower, fild.name, reg, cast);
+    }
+    lowerBlock(lower, body);
+    emit(lower, OP_RETURN_NONE, 0, 0, 0);
+    program -> functions.items[index].registers = lower -> registers + 1;
+}
+
+static void pushFunction(
+    struct Program* program,
+    uint32_t        name,
+    uint32_t        args
+) {
+    struct Function function = {
+        .name  = name,
+        .args  = args,
+        .start = NODE_NONE
+    };
+    pushNode(program -> functions, MEMORY_BYTECODE, function);
+}
+
+uint32_t findFunction(struct Program* program, const char* name) {
+    size_t length = strlen(name);
+    for (uint32_t i = 0; i < program -> functions.count; i++) {
+        uint32_t symbol = program -> functions.items[i].name;
+        if (symbol == SYMBOL_NONE) {
+            continue;
+        }
+        struct String string = symbolString(program -> symbols, symbol);
+        if (string.length == length
+         && memcmp(string.string, name, length) == 0) {
+            return i;
+        }
+    }
+    return NODE_NONE;
+}
+
+/*
+ * Program.functions are the funcs, then the cfuncs, then the tests of
+ * ast. Only main, the tests and what they call get lowered, a function
+ * nothing runs may use what the VM can not do yet.
+ */
+bool lowerAST(
+    struct Program* program,
+    struct AST*     ast,
+    const char*     path,
+    struct Error*   error
+) {
+    timeBegin("lower");
+    (*program) = (struct Program) {
+        .path    = path,
+        .symbols = ast -> symbols,
+        .main    = NODE_NONE
+    };
+    struct Lower lower = {
+        .ast       = ast,
+        .program   = program,
+        .error     = error,
+        .by_symbol = memoryAllocKind(
+            MEMORY_BYTECODE,
+            (ast -> symbols -> count + 1) * sizeof(uint32_t)
+        )
+    };
+    memset(
+        lower.by_symbol,
+        0,
+        (ast -> symbols -> count + 1) * sizeof(uint32_t)
+    );
+
+    for (uint32_t i = 0; i < ast -> funcs.count; i++) {
+        struct FuncDecl func = ast -> funcs.items[i];
+        pushFunction(program, func.name, func.args.count + func.has_self);
+        if (!func.has_self) {
+            lower.by_symbol[func.name] = i + 1;
+        }
+    }
+    for (uint32_t i = 0; i < ast -> cfuncs.count; i++) {
+        struct CFuncDecl cfunc = ast -> cfuncs.items[i];
+        pushFunction(program, cfunc.name, cfunc.args.count);
+        lower.by_symbol[cfunc.name] = program -> functions.count;
+    }
+    for (uint32_t i = 0; i < ast -> tests.count; i++) {
+        uint32_t index = program -> functions.count;
+        pushFunction(program, SYMBOL_NONE, 0);
+        pushNode(program -> tests, MEMORY_BYTECODE, index);
+        pushNode(lower.queue, MEMORY_BYTECODE, index);
+    }
+
+    bool res = true;
+    if (setjmp(lower.bail) == 0) {
+        program -> main = findFunction(program, "main");
+        if (program -> main != NODE_NONE) {
+            queueFunction(&lower, program -> main);
+        }
+        for (uint32_t i = 0; i < lower.queue.count; i++) {
+            lowerFunction(&lower, lower.queue.items[i]);
+        }
+    } else {
+        res = false;
+    }
+
+    memoryFree(lower.by_symbol);
+    memoryFree(lower.queue.items);
+    memoryFree(lower.locals.items);
+    memoryFree(lower.work.items);
+    memoryFree(lower.jumps.items);
+    timeEnd();
+    return res;
+}
+
+void freeProgram(struct Program* program) {
+    memoryFree(program -> code.items);
+    memoryFree(program -> constants.items);
+    memoryFree(program -> functions.items);
+    memoryFree(program -> tests.items);
+    (*program) = (struct Program) { 0 };
+}
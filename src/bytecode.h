@@ -0,0 +1,175 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "symbol.h"
+
+/*
+ * Register bytecode run by vm.c. Every function has a window of registers
+ * on the VM stack: its arguments first, then its locals, then temporaries.
+ * A call puts the arguments in consecutive registers of the caller, which
+ * become the first registers of the callee, and the result comes back in
+ * the first of them.
+ *
+ * Jump offsets are relative to the instruction after the jump.
+ */
+
+#define BINARY_OPCODES(X)                                                   \
+    X(ADD)              /* a = b + c, and so on                     */      \
+    X(SUBTRACT)                                                             \
+    X(MULTIPLY)                                                             \
+    X(DIVIDE)                                                               \
+    X(MODULO)                                                               \
+    X(BITWIZE_OR)                                                           \
+    X(BITWIZE_AND)                                                          \
+    X(LEFT_SHIFT)                                                           \
+    X(RIGHT_SHIFT)                                                          \
+    X(EQUAL)                                                                \
+    X(NOT_EQUAL)                                                            \
+    X(LESS_THEN)                                                            \
+    X(GREAT_THEN)                                                           \
+    X(LESS_THEN_OR_EQUAL)                                                   \
+    X(GREA_THEN_OR_EQUAL)
+
+// the binary ops again with c an Int16, in the same order
+#define IMMEDIATE_OPCODES(X)                                                \
+    X(ADD_INT)          /* a = b + c as Int, and so on              */      \
+    X(SUBTRACT_INT)                                                         \
+    X(MULTIPLY_INT)                                                         \
+    X(DIVIDE_INT)                                                           \
+    X(MODULO_INT)                                                           \
+    X(BITWIZE_OR_INT)                                                       \
+    X(BITWIZE_AND_INT)                                                      \
+    X(LEFT_SHIFT_INT)                                                       \
+    X(RIGHT_SHIFT_INT)                                                      \
+    X(EQUAL_INT)                                                            \
+    X(NOT_EQUAL_INT)                                                        \
+    X(LESS_THEN_INT)                                                        \
+    X(GREAT_THEN_INT)                                                       \
+    X(LESS_THEN_OR_EQUAL_INT)                                               \
+    X(GREA_THEN_OR_EQUAL_INT)
+
+#define OPCODES(X)                                                          \
+    X(MOVE)             /* a = b                                    */      \
+    X(LOAD_INT)         /* a = offset as an Int                     */      \
+    X(LOAD_CONST)       /* a = Program.constants[index]             */      \
+    BINARY_OPCODES(X)                                                       \
+    IMMEDIATE_OPCODES(X)                                                    \
+    X(NEG)              /* a = -b                                   */      \
+    X(BITWIZE_NOT)      /* a = ~b                                   */      \
+    X(LOGICAL_NOT)      /* a = !b                                   */      \
+    X(CAST)             /* a = b as c, c is castCode                */      \
+    X(JUMP)             /* pc += offset                             */      \
+    X(JUMP_FALSE)       /* pc += offset if a is false               */      \
+    X(JUMP_TRUE)        /* pc += offset if a is true                */      \
+    X(REPEAD)           /* pc += offset if a <= 0, else a -= 1      */      \
+    X(CALL)             /* a = Program.functions[b](a, .., a+c-1)   */      \
+    X(NATIVE)           /* a = natives[b](a, .., a+c-1)             */      \
+    X(RETURN)           /* return a                                 */      \
+    X(RETURN_NONE)
+
+enum Opcode {
+#define OPCODE_ENUM(name) OP_##name,
+    OPCODES(OPCODE_ENUM)
+#undef OPCODE_ENUM
+    OPCODE_COUNT,
+};
+
+#define OP_IMMEDIATE(op) ((op) - OP_ADD + OP_ADD_INT)
+
+_Static_assert(
+    OP_IMMEDIATE(OP_GREA_THEN_OR_EQUAL) == OP_GREA_THEN_OR_EQUAL_INT,
+    "IMMEDIATE_OPCODES has to match BINARY_OPCODES"
+);
+
+struct Instruction {
+    uint16_t op;
+    uint16_t a;
+    union {
+        struct {
+            uint16_t b;
+            uint16_t c;
+        };
+        int32_t  offset;
+        uint32_t index;
+    };
+};
+
+enum ValueType {
+    VALUE_NONE,
+    VALUE_BOOL,                     // 0 or 1 in _uint
+    VALUE_INT,
+    VALUE_UINT,
+    VALUE_FLOAT,
+    VALUE_STR,
+    VALUE_FILE,                     // index into the streams of the VM
+};
+
+/*
+ * Integers are kept wrapped to bits and sign extended, like wrapInt. Floats
+ * are doubles, Float32 is rounded to float after every operation.
+ */
+struct Value {
+    uint8_t  type;                  // enum ValueType
+    uint8_t  bits;
+    uint32_t length;                // of str
+    union {
+        int64_t     _int;
+        uint64_t    _uint;
+        double      _float;
+        const char* str;
+    };
+};
+
+// the builtin functions and values, reached through an import
+enum Native {
+    NATIVE_WRITE,                   // File.write(file, value)
+    NATIVE_ASSERT,                  // Test.assert(condition)
+};
+
+#define VM_STDOUT 1
+#define VM_STDERR 2
+
+struct Function {
+    uint32_t name;                  // SYMBOL_NONE for tests
+    uint32_t args;
+    uint32_t registers;
+    uint32_t start;                 // Program.code
+};
+
+struct Program {
+    const char*               path;
+    struct Symbols*           symbols;
+    NODES(struct Instruction) code;
+    NODES(struct Value)       constants;
+    NODES(struct Function)    functions;
+    NODES(uint32_t)           tests;        // Program.functions, in order
+    uint32_t                  main;         // NODE_NONE without func main
+};
+
+// CAST operand c: the BuiltinType in the high byte and the bits in the low
+static inline uint16_t castCode(uint32_t type, uint32_t bits) {
+    return (uint16_t) (type << 8 | bits);
+}
+
+/*
+ * Lowers func main, the tests and what they call. Returns false and sets
+ * error for what the VM can not run yet, like references and arrays.
+ * The strings of the program point into the symbols of ast.
+ */
+bool lowerAST(
+    struct Program* program,
+    struct AST*     ast,
+    const char*     path,
+    struct Error*   error
+);
+void freeProgram(struct Program* program);
+
+// the function called name, or NODE_NONE
+uint32_t findFunction(struct Program* program, const char* name);
+
+#endif
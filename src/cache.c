@@ -0,0 +1,329 @@
+#include <fcntl.h>
+// for: open, O_RDONLY
+#include <inttypes.h>
+// for: PRIx64
+#include <pthread.h>
+// for: pthread_once, pthread_once_t, PTHREAD_ONCE_INIT
+#include <stdbool.h>
+// for: bool
+#include <stdio.h>
+// for: fopen, fwrite, snprintf, rename, remove
+#include <string.h>
+// for: memcmp, memcpy, memset, strlen
+#include <sys/mman.h>
+// for: mmap, munmap
+#include <sys/stat.h>
+// for: fstat
+#include <unistd.h>
+// for: close, getpid
+
+#include "ast.h"
+#include "cache.h"
+#include "hash.h"
+#include "memory.h"
+#include "symbol.h"
+#include "version.h"
+
+#define CACHE_MAGIC   "micast\0\1"
+#define CACHE_ALIGN   16
+#define CACHE_AST       ".ast"
+#define CACHE_INTERFACE ".mi"
+
+#define COUNT_NODES(name) + 1
+enum { CACHE_ARRAYS = 0 AST_ARRAYS(COUNT_NODES) };
+
+struct CacheArray {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct CacheHeader {
+    char              magic[8];
+    uint64_t          key;
+    uint64_t          size;             // of the whole entry
+    uint64_t          check;            // hash of everything after the header
+    uint64_t          strings;          // offset of the symbol names
+    uint64_t          symbols;          // number of symbol names
+    struct CacheArray arrays[CACHE_ARRAYS];
+};
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + CACHE_ALIGN - 1) & ~(uint64_t)(CACHE_ALIGN - 1);
+}
+
+static pthread_once_t seed_once = PTHREAD_ONCE_INIT;
+static uint64_t seed;
+
+// anything that changes what an entry means has to go in here
+static void initSeed(void) {
+    #define SIZE_NODES(name) sizeof(*((struct AST*) NULL) -> name.items),
+    const size_t layout[] = {
+        AST_ARRAYS(SIZE_NODES)
+        sizeof(struct CacheHeader)
+    };
+    #undef SIZE_NODES
+    seed = hashBytes(
+        layout,
+        sizeof(layout),
+        hashBytes(MIC_VERSION, sizeof(MIC_VERSION), 0)
+    );
+}
+
+// the workers of the pool ask for keys at the same time
+static uint64_t cacheSeed(void) {
+    pthread_once(&seed_once, initSeed);
+    return seed;
+}
+
+uint64_t cacheKey(const char* src, size_t length) {
+    return hashBytes(src, length, cacheSeed());
+}
+
+// like cacheKey, but an interface is not the AST of the same bytes
+uint64_t interfaceKey(const char* src, size_t length) {
+    uint64_t seed = hashBytes(CACHE_INTERFACE, sizeof(CACHE_INTERFACE),
+        cacheSeed());
+    return hashBytes(src, length, seed);
+}
+
+static void cachePath(
+    char*       path,
+    size_t      size,
+    const char* dir,
+    uint64_t    key,
+    const char* extension
+) {
+    snprintf(path, size, "%s/%016" PRIx64 "%s", dir, key, extension);
+}
+
+/*
+ * The names are a table of count + 1 offsets into the bytes that follow
+ * it, name i runs from offset i to offset i + 1.
+ */
+static uint64_t stringsSize(struct Symbols* symbols) {
+    uint64_t res = (symbols -> count + 1) * sizeof(uint32_t);
+    for (uint32_t i = 0; i < symbols -> count; i++) {
+        res += symbolString(symbols, i).length;
+    }
+    return res;
+}
+
+// the whole entry is built in memory first, the check covers all of it
+static unsigned char* buildEntry(uint64_t key, struct AST* ast, size_t* size) {
+    struct CacheHeader header = {
+        .magic = CACHE_MAGIC,
+        .key   = key
+    };
+    uint64_t offset = sizeof(header);
+    size_t index = 0;
+    #define LAYOUT_NODES(name)                                              \
+        offset = alignOffset(offset);                                       \
+        header.arrays[index].offset = offset;                               \
+        header.arrays[index].count  = ast -> name.count;                    \
+        offset += ast -> name.count * sizeof(*ast -> name.items);           \
+        index++;
+    AST_ARRAYS(LAYOUT_NODES)
+    #undef LAYOUT_NODES
+    header.strings = alignOffset(offset);
+    header.symbols = ast -> symbols -> count;
+    header.size    = header.strings + stringsSize(ast -> symbols);
+
+    // zeroed, the gaps that align the arrays are written too
+    unsigned char* res = memoryAllocKind(MEMORY_CACHE, header.size);
+    memset(res, 0, header.size);
+    index = 0;
+    #define COPY_NODES(name)                                                \
+        if (ast -> name.count != 0) {                                       \
+            memcpy(                                                         \
+                res + header.arrays[index].offset,                          \
+                ast -> name.items,                                          \
+                ast -> name.count * sizeof(*ast -> name.items)              \
+            );                                                              \
+        }                                                                   \
+        index++;
+    AST_ARRAYS(COPY_NODES)
+    #undef COPY_NODES
+
+    unsigned char* table = res + header.strings;
+    char* bytes = (char*) table + (header.symbols + 1) * sizeof(uint32_t);
+    uint32_t string_offset = 0;
+    for (uint32_t i = 0; i < header.symbols; i++) {
+        struct String name = symbolString(ast -> symbols, i);
+        memcpy(table + i * sizeof(uint32_t), &string_offset, sizeof(uint32_t));
+        memcpy(bytes + string_offset, name.string, name.length);
+        string_offset += name.length;
+    }
+    memcpy(
+        table + header.symbols * sizeof(uint32_t),
+        &string_offset,
+        sizeof(uint32_t)
+    );
+
+    header.check = hashBytes(
+        res + sizeof(header),
+        header.size - sizeof(header),
+        key
+    );
+    memcpy(res, &header, sizeof(header));
+    (*size) = header.size;
+    return res;
+}
+
+static void storeEntry(
+    const char* dir,
+    uint64_t    key,
+    const char* extension,
+    struct AST* ast
+) {
+    char path[4096];
+    char temp[4096 + 64];
+    cachePath(path, sizeof(path), dir, key, extension);
+    // written aside and renamed, readers never see half an entry
+    snprintf(
+        temp,
+        sizeof(temp),
+        "%s.%ld.%p.tmp",
+        path,
+        (long) getpid(),
+        (void*) ast
+    );
+    FILE* file = fopen(temp, "wb");
+    if (file == NULL) {
+        return;
+    }
+    size_t size;
+    unsigned char* entry = buildEntry(key, ast, &size);
+    bool res = fwrite(entry, 1, size, file) == size;
+    res = fclose(file) == 0 && res;
+    memoryFree(entry);
+    if (!res || rename(temp, path) != 0) {
+        remove(temp);
+    }
+}
+
+static bool checkArray(
+    const struct CacheHeader* header,
+    size_t                    index,
+    size_t                    size
+) {
+    const struct CacheArray* array = &header -> arrays[index];
+    return array -> offset % CACHE_ALIGN == 0
+        && array -> offset <= header -> strings
+        && array -> count <= UINT32_MAX
+        && array -> count <= (header -> strings - array -> offset) / size;
+}
+
+static bool loadStrings(
+    const unsigned char*      base,
+    const struct CacheHeader* header,
+    struct Symbols*           symbols
+) {
+    if (header -> symbols >= UINT32_MAX
+     || (header -> size - header -> strings) / sizeof(uint32_t)
+        < header -> symbols + 1) {
+        return false;
+    }
+    const unsigned char* table = base + header -> strings;
+    const char* bytes = (const char*) table
+                      + (header -> symbols + 1) * sizeof(uint32_t);
+    uint64_t bytes_size = header -> size - (header -> strings
+                        + (header -> symbols + 1) * sizeof(uint32_t));
+    uint32_t start;
+    memcpy(&start, table, sizeof(start));
+    for (uint32_t i = 0; i < header -> symbols; i++) {
+        uint32_t end;
+        memcpy(&end, table + (i + 1) * sizeof(uint32_t), sizeof(end));
+        if (end < start || end > bytes_size
+         || internSymbol(symbols, bytes + start, end - start) != i) {
+            return false;
+        }
+        start = end;
+    }
+    return true;
+}
+
+void storeCachedAST(const char* dir, uint64_t key, struct AST* ast) {
+    storeEntry(dir, key, CACHE_AST, ast);
+}
+
+void storeCachedInterface(const char* dir, uint64_t key, struct AST* iface) {
+    storeEntry(dir, key, CACHE_INTERFACE, iface);
+}
+
+static bool loadEntry(
+    const char* dir,
+    uint64_t    key,
+    const char* extension,
+    struct AST* ast
+) {
+    char path[4096];
+    cachePath(path, sizeof(path), dir, key, extension);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat stat;
+    if (fstat(fd, &stat) != 0
+     || (size_t) stat.st_size < sizeof(struct CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    // private and writable, later passes may rewrite nodes in place
+    void* mapped = mmap(
+        NULL,
+        stat.st_size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE,
+        fd,
+        0
+    );
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    const unsigned char* base = mapped;
+    const struct CacheHeader* header = mapped;
+    bool res = memcmp(header -> magic, CACHE_MAGIC, 8) == 0
+            && header -> key == key
+            && header -> size == (uint64_t) stat.st_size
+            && header -> strings <= header -> size
+            && header -> check == hashBytes(
+                base + sizeof(*header),
+                header -> size - sizeof(*header),
+                key
+            );
+    size_t index = 0;
+    #define CHECK_NODES(name)                                               \
+        res = res && checkArray(header, index, sizeof(*ast -> name.items)); \
+        index++;
+    AST_ARRAYS(CHECK_NODES)
+    #undef CHECK_NODES
+    res = res && loadStrings(base, header, ast -> symbols);
+    if (!res) {
+        munmap(mapped, stat.st_size);
+        return false;
+    }
+
+    index = 0;
+    #define MAP_NODES(name)                                                 \
+        ast -> name.items = header -> arrays[index].count == 0              \
+            ? NULL                                                          \
+            : (void*) (base + header -> arrays[index].offset);              \
+        ast -> name.count = header -> arrays[index].count;                  \
+        ast -> name.capacity = 0;                                           \
+        index++;
+    AST_ARRAYS(MAP_NODES)
+    #undef MAP_NODES
+    ast -> mapped = mapped;
+    ast -> mapped_size = stat.st_size;
+    return true;
+}
+
+bool loadCachedAST(const char* dir, uint64_t key, struct AST* ast) {
+    return loadEntry(dir, key, CACHE_AST, ast);
+}
+
+bool loadCachedInterface(const char* dir, uint64_t key, struct AST* iface) {
+    return loadEntry(dir, key, CACHE_INTERFACE, iface);
+}
@@ -0,0 +1,37 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+/*
+ * Parsed files kept on disk, one file per source under the cache
+ * directory, named after the key of the source. An entry is the node
+ * arrays of the AST written as they are in memory plus the symbol names
+ * in id order, so loading maps the file and points the arrays into it;
+ * only the names are interned again. The key covers the compiler version
+ * and the layout of the nodes, a new build never reads an old entry.
+ *
+ * The cache is best effort: a missing, stale or broken entry just means
+ * the file gets parsed, a failed store is ignored.
+ */
+
+uint64_t cacheKey(const char* src, size_t length);
+
+// true if the entry was there, ast must be freshly initialized
+bool loadCachedAST(const char* dir, uint64_t key, struct AST* ast);
+void storeCachedAST(const char* dir, uint64_t key, struct AST* ast);
+
+/*
+ * The interfaces of modules, see interface.h, are entries like ASTs.
+ * Their key is of the source too, so an importer that read a file finds
+ * the interface of exactly those bytes.
+ */
+uint64_t interfaceKey(const char* src, size_t length);
+bool loadCachedInterface(const char* dir, uint64_t key, struct AST* iface);
+void storeCachedInterface(const char* dir, uint64_t key, struct AST* iface);
+
+#endif
@@ -1,13 +1,397 @@
+#include <stdbool.h>
+// for: bool
+#include <stdio.h>
+// for: open_memstream, fopen, fwrite, fclose, perror
+#include <stdlib.h>
+// for: exit, EXIT_FAILURE
+#include <string.h>
+// for: strrchr, strlen, memcpy
+#include <sys/stat.h>
+// for: mkdir
+
+#include "args.h"
 #include "ast.h"
+#include "bytecode.h"
 #include "compile.h"
-#include "file.h"
+#include "emitc.h"
+#include "error.h"
+#include "fold.h"
+#include "ir.h"
+#include "jit.h"
+#include "layout.h"
 #include "lexer.h"
 #include "memory.h"
-#include "parser.h"
+#include "module.h"
+#include "mono.h"
+#include "native.h"
+#include "object.h"
+#include "passes.h"
+#include "pool.h"
+#include "symbol.h"
+#include "timing.h"
+#include "vm.h"
+
+struct Unit {
+    const char*  path;
+    char*        output;
+    size_t       output_length;
+    bool         failed;
+    struct Error error;
+    struct Module* module;          // the root of path
+    struct Timings timings;
+    size_t       folded;            // expretion nodes removed by foldAST
+    bool         has_passes;
+    struct PassStat passes[PASS_COUNT];
+};
+
+/*
+ * Runs func main and/or the tests of the unit, what they write to
+ * Cosole.stdout goes to output like the printed tree would.
+ */
+static bool runUnit(struct Unit* unit, struct AST* ast, FILE* output) {
+    struct Program program;
+    bool res = lowerAST(&program, ast, unit -> path, &unit -> error);
+    timeBegin("run");
+    if (res && args.run) {
+        if (program.main == NODE_NONE
+         || program.functions.items[program.main].args != 0) {
+            setError(&unit -> error, "Compile error", unit -> path, 0,
+                "no func main() to run");
+            res = false;
+        } else {
+            res = runFunction(&program, program.main, output, &unit -> error);
+        }
+    }
+    if (res && args.test) {
+        for (uint32_t i = 0; i < program.tests.count; i++) {
+            bool passed = runFunction(
+                &program,
+                program.tests.items[i],
+                output,
+                &unit -> error
+            );
+            fprintf(output, "%s: test %u %s\n", unit -> path, i + 1,
+                passed ? "ok" : "failed");
+            res = res && passed;
+        }
+    }
+    timeEnd();
+    freeProgram(&program);
+    return res;
+}
+
+// builds the IR of the unit and runs the passes on it
+static bool optimizeIR(
+    struct Unit*     unit,
+    struct AST*      ast,
+    struct IrModule* module
+) {
+    bool res = buildIR(module, ast, unit -> path, &unit -> error);
+    if (res) {
+        timeBegin("passes");
+        runPasses(module, unit -> passes);
+        unit -> has_passes = true;
+        timeEnd();
+    }
+    return res;
+}
+
+// builds and optimizes the IR, printing it to output for --print-ir
+static bool optimizeUnit(struct Unit* unit, struct AST* ast, FILE* output) {
+    struct IrModule module;
+    bool res = optimizeIR(unit, ast, &module);
+    if (res && args.print_ir) {
+        timeBegin("print");
+        printIR(output, &module);
+        timeEnd();
+    }
+    freeIR(&module);
+    return res;
+}
+
+// runUnit on machine code compiled from the optimized IR
+static bool runNativeUnit(struct Unit* unit, struct AST* ast, FILE* output) {
+    struct IrModule module;
+    if (!optimizeIR(unit, ast, &module)) {
+        freeIR(&module);
+        return false;
+    }
+    struct NativeModule native;
+    struct Jit jit = { 0 };
+    bool res = compileNative(&native, &module, NATIVE_TARGET_JIT,
+            &unit -> error)
+            && loadJit(&jit, &native, &unit -> error);
+    timeBegin("run");
+    if (res && args.run) {
+        if (module.main == NODE_NONE
+         || module.functions.items[module.main].params != 0) {
+            setError(&unit -> error, "Compile error", unit -> path, 0,
+                "no func main() to run");
+            res = false;
+        } else {
+            res = runJit(&jit, &module, module.main, output, &unit -> error);
+        }
+    }
+    if (res && args.test) {
+        for (uint32_t i = 0; i < module.tests.count; i++) {
+            bool passed = runJit(
+                &jit,
+                &module,
+                module.tests.items[i],
+                output,
+                &unit -> error
+            );
+            fprintf(output, "%s: test %u %s\n", unit -> path, i + 1,
+                passed ? "ok" : "failed");
+            res = res && passed;
+        }
+    }
+    timeEnd();
+    freeJit(&jit);
+    freeNative(&native);
+    freeIR(&module);
+    return res;
+}
+
+// the ELF object of the unit to output, written to its file by compile
+static bool objectUnit(struct Unit* unit, struct AST* ast, FILE* output) {
+    struct IrModule module;
+    if (!optimizeIR(unit, ast, &module)) {
+        freeIR(&module);
+        return false;
+    }
+    struct NativeModule native;
+    bool res = compileNative(&native, &module, NATIVE_TARGET_OBJECT,
+        &unit -> error);
+    if (res) {
+        writeObject(output, &native);
+    }
+    freeNative(&native);
+    freeIR(&module);
+    return res;
+}
+
+/*
+ * Instances of generic types first, then the layout, which reorders the
+ * filds of structs and picks the tags of enums. With print set the layout
+ * is printed instead of C.
+ */
+static bool emitCUnit(
+    struct Unit* unit,
+    struct AST*  ast,
+    FILE*        output,
+    bool         print
+) {
+    struct Layout layout;
+    if (!monomorphize(ast, unit -> path, &unit -> error)
+     || !layoutTypes(&layout, ast, unit -> path, &unit -> error)) {
+        return false;
+    }
+    bool res = true;
+    if (print) {
+        timeBegin("print");
+        printLayout(output, &layout);
+        timeEnd();
+    } else {
+        res = emitC(output, ast, &layout, unit -> path, &unit -> error);
+    }
+    freeLayout(&layout);
+    return res;
+}
+
+// the tree is printed as parsed unless --fold, everything else is folded
+static bool printsTree(void) {
+    return !args.print_ir && !args.time_passes && !args.object
+        && !args.run && !args.test && !args.print_layout
+        && args.emit == EMIT_AST;
+}
+
+// every unit has its own module, arena, symbols and tree, nothing is shared
+static void compileUnit(void* data, size_t index) {
+    struct Unit* unit = (struct Unit*) data + index;
+    struct Timings* driver = timingsAttach(
+        args.time_report == TIME_REPORT_NONE ? NULL : &unit -> timings
+    );
+    FILE* output = open_memstream(&unit -> output, &unit -> output_length);
+    if (output == NULL) {
+        perror("Memory Error");
+        exit(EXIT_FAILURE);
+    }
+
+    // read and parsed by loadModules, with its imports
+    struct Module* module = unit -> module;
+    struct AST* ast = &module -> ast;
+    if (module -> failed) {
+        unit -> error = module -> error;
+    }
+
+    if (!module -> failed) {
+        if (args.fold || !printsTree()) {
+            timeBegin("fold");
+            unit -> folded = foldAST(ast);
+            timeEnd();
+        }
+        if (args.print_ir) {
+            unit -> failed = !optimizeUnit(unit, ast, output);
+        } else if (args.time_passes && !optimizeUnit(unit, ast, output)) {
+            unit -> failed = true;
+        } else if (args.object) {
+            unit -> failed = !objectUnit(unit, ast, output);
+        } else if (args.native && (args.run || args.test)) {
+            unit -> failed = !runNativeUnit(unit, ast, output);
+        } else if (args.run || args.test) {
+            unit -> failed = !runUnit(unit, ast, output);
+        } else if (args.print_layout || args.emit == EMIT_C) {
+            unit -> failed = !emitCUnit(unit, ast, output,
+                args.print_layout);
+        } else {
+            timeBegin("print");
+            printAST(output, ast);
+            timeEnd();
+        }
+    } else {
+        unit -> failed = true;
+    }
+    timeBegin("free");
+    freeModule(module);
+    timeEnd();
+
+    fclose(output);
+    timingsAttach(driver);
+}
+
+// like cc: -o, or the name of the file with .o in the current directory
+static bool writeObjectFile(struct Unit* unit) {
+    char* path = args.output;
+    if (path == NULL) {
+        const char* name = strrchr(unit -> path, '/');
+        name = name == NULL ? unit -> path : name + 1;
+        const char* dot = strrchr(name, '.');
+        size_t length = dot == NULL || dot == name
+            ? strlen(name)
+            : (size_t) (dot - name);
+        path = memoryAlloc(length + 3);
+        memcpy(path, name, length);
+        memcpy(path + length, ".o", 3);
+    }
+    bool res = true;
+    FILE* stream = fopen(path, "wb");
+    if (stream == NULL
+     || fwrite(unit -> output, 1, unit -> output_length, stream)
+            != unit -> output_length) {
+        perror(path);
+        res = false;
+    }
+    if (stream != NULL && fclose(stream) != 0) {
+        perror(path);
+        res = false;
+    }
+    if (path != args.output) {
+        memoryFree(path);
+    }
+    return res;
+}
+
+bool compile(const char** paths, size_t count) {
+    double wall = timeWall();
+    struct Timings driver = { 0 };
+    if (args.time_report != TIME_REPORT_NONE) {
+        timingsAttach(&driver);
+    }
+
+    if (args.cache_dir != NULL) {
+        // a missing directory only means nothing gets cached
+        mkdir(args.cache_dir, 0777);
+    }
+
+    struct Unit* units = memoryAlloc(count * sizeof(struct Unit));
+    for (size_t i = 0; i < count; i++) {
+        units[i] = (struct Unit) {
+            .path = paths[i]
+        };
+    }
+
+    size_t workers = args.jobs == 0 ? poolDefaultWorkers() : args.jobs;
+    timeBegin("modules");
+    struct Timings** timings = memoryAlloc(count * sizeof(struct Timings*));
+    for (size_t i = 0; i < count; i++) {
+        timings[i] = args.time_report == TIME_REPORT_NONE
+            ? NULL
+            : &units[i].timings;
+    }
+    struct Modules modules;
+    bool res = loadModules(&modules, paths, timings, count, workers);
+    for (size_t i = 0; i < count; i++) {
+        units[i].module = modules.items.items[i];
+    }
+    memoryFree(timings);
+    timeEnd();
+
+    timeBegin("files");
+    poolRun(workers, count, compileUnit, units);
+    timeEnd();
+
+    timeBegin("write");
+    bool failed = false;
+    for (size_t i = 0; i < count; i++) {
+        failed = failed || units[i].failed;
+    }
+    // a failed compile leaves the file of -o as it was
+    FILE* stream = stdout;
+    if (args.output != NULL && !args.object) {
+        stream = failed ? NULL : fopen(args.output, "w");
+        if (!failed && stream == NULL) {
+            perror(args.output);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        // nothing of a failed unit is written
+        bool writes = !units[i].failed && stream != NULL;
+        if (writes && !args.object) {
+            fwrite(units[i].output, 1, units[i].output_length, stream);
+        } else if (writes && !writeObjectFile(&units[i])) {
+            res = false;
+        }
+        if (units[i].failed) {
+            printError(stderr, &units[i].error);
+            res = false;
+        } else if (args.verbose) {
+            fprintf(stderr, "%s: folded away %zu expretion nodes\n",
+                units[i].path, units[i].folded);
+        }
+        if (args.time_passes && units[i].has_passes) {
+            printPassStats(stderr, units[i].path, units[i].passes);
+        }
+        memoryFree(units[i].output);
+    }
+    // the errors of imported files, the ones of roots are in their units
+    for (size_t i = count; i < modules.items.count; i++) {
+        if (modules.items.items[i] -> error.kind != NULL) {
+            printError(stderr, &modules.items.items[i] -> error);
+        }
+    }
+    if (stream != NULL && stream != stdout && fclose(stream) != 0) {
+        perror(args.output);
+        res = false;
+    }
+    timeEnd();
 
-void compile(const char* path) {
-    char* src = readFile(path);
-    struct AST* ast = parse(src, path);
-    printAST(stdout, ast);
-    memoryFree(src);
+    if (args.time_report != TIME_REPORT_NONE) {
+        timingsAttach(NULL);
+        struct Timings* files = memoryAlloc(count * sizeof(struct Timings));
+        for (size_t i = 0; i < count; i++) {
+            files[i] = units[i].timings;
+        }
+        printTimeReport(stderr, args.time_report, &driver, paths, files,
+            count, timeWall() - wall, timeProcessCpu());
+        for (size_t i = 0; i < count; i++) {
+            freeTimings(&files[i]);
+        }
+        memoryFree(files);
+        freeTimings(&driver);
+    }
+    freeModules(&modules);
+    memoryFree(units);
+    return res;
 }
@@ -1,6 +1,18 @@
 #ifndef COMPILE_H
 #define COMPILE_H
 
-void compile(const char* path);
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Compiles every file on up to args.jobs threads, 0 means one per cpu,
+ * through the AST cache in args.cache_dir if there is one. Output
+ * of each file is buffered and written in the order of paths, whatever
+ * order the files finished in, errors too. With args.time_report the
+ * phases of every file are timed and reported at the end. False if any
+ * file failed, nothing of a failed file is written and the file of
+ * args.output is not touched then.
+ */
+bool compile(const char** paths, size_t count);
 
 #endif
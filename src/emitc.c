@@ -0,0 +1,1806 @@
+#include <inttypes.h>
+// for: PRIu64
+#include <math.h>
+// for: isinf, isnan, signbit
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <stdio.h>
+// for: fprintf, fwrite, open_memstream, perror, snprintf, vsnprintf
+#include <stdlib.h>
+// for: exit, EXIT_FAILURE
+#include <string.h>
+// for: memset, strpbrk
+
+#include "ast.h"
+#include "builtin.h"
+#include "emitc.h"
+#include "memory.h"
+#include "timing.h"
+
+#define EMIT_ERROR "Compile error"
+
+// everything the emitted code needs besides itself, once per C file
+static const char* const prelude =
+    "#include <inttypes.h>\n"
+    "#include <math.h>\n"
+    "#include <stdbool.h>\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "#ifndef MICRO_PRELUDE\n"
+    "#define MICRO_PRELUDE\n"
+    "\n"
+    "typedef struct {\n"
+    "    const char* ptr;\n"
+    "    size_t      length;\n"
+    "} m_Str;\n"
+    "\n"
+    "static inline bool m_Str_equal(m_Str a, m_Str b) {\n"
+    "    return a.length == b.length"
+    " && memcmp(a.ptr, b.ptr, a.length) == 0;\n"
+    "}\n"
+    "\n"
+    "static inline void m_writeStr(FILE* f, m_Str x) {\n"
+    "    fwrite(x.ptr, 1, x.length, f);\n"
+    "}\n"
+    "static inline void m_writeBool(FILE* f, bool x) {\n"
+    "    fputs(x ? \"true\" : \"false\", f);\n"
+    "}\n"
+    "static inline void m_writeInt(FILE* f, int64_t x) {\n"
+    "    fprintf(f, \"%\" PRId64, x);\n"
+    "}\n"
+    "static inline void m_writeUint(FILE* f, uint64_t x) {\n"
+    "    fprintf(f, \"%\" PRIu64, x);\n"
+    "}\n"
+    "static inline void m_writeFloat(FILE* f, double x) {\n"
+    "    fprintf(f, \"%g\", x);\n"
+    "}\n"
+    "\n"
+    "#define m_write(f, x) _Generic((x),"
+    "                                         \\\n"
+    "    m_Str: m_writeStr, bool: m_writeBool,"
+    "                                   \\\n"
+    "    int8_t: m_writeInt, int16_t: m_writeInt, int32_t: m_writeInt,"
+    "           \\\n"
+    "    int64_t: m_writeInt, uint8_t: m_writeUint, uint16_t: m_writeUint,"
+    "       \\\n"
+    "    uint32_t: m_writeUint, uint64_t: m_writeUint, float: m_writeFloat,"
+    "      \\\n"
+    "    double: m_writeFloat, long double: m_writeFloat)(f, x)\n"
+    "\n"
+    "static inline void m_assert(bool x) {\n"
+    "    if (!x) {\n"
+    "        fputs(\"assertion failed\\n\", stderr);\n"
+    "        exit(EXIT_FAILURE);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "_Noreturn static void m_fault(const char* message) {\n"
+    "    fprintf(stderr, \"Runtime error: %s\\n\", message);\n"
+    "    exit(EXIT_FAILURE);\n"
+    "}\n"
+    "\n"
+    "// like the VM: INT64_MIN / -1 wraps, shifts past the width give 0\n"
+    "static inline int64_t m_divideInt(int64_t a, int64_t b) {\n"
+    "    if (b == 0) {\n"
+    "        m_fault(\"division by zero\");\n"
+    "    }\n"
+    "    return b == -1 ? (int64_t) (0 - (uint64_t) a) : a / b;\n"
+    "}\n"
+    "static inline int64_t m_moduloInt(int64_t a, int64_t b) {\n"
+    "    if (b == 0) {\n"
+    "        m_fault(\"division by zero\");\n"
+    "    }\n"
+    "    return b == -1 ? 0 : a % b;\n"
+    "}\n"
+    "static inline uint64_t m_divideUint(uint64_t a, uint64_t b) {\n"
+    "    if (b == 0) {\n"
+    "        m_fault(\"division by zero\");\n"
+    "    }\n"
+    "    return a / b;\n"
+    "}\n"
+    "static inline uint64_t m_moduloUint(uint64_t a, uint64_t b) {\n"
+    "    if (b == 0) {\n"
+    "        m_fault(\"division by zero\");\n"
+    "    }\n"
+    "    return a % b;\n"
+    "}\n"
+    "static inline uint64_t m_shiftCount(int64_t count) {\n"
+    "    if (count < 0) {\n"
+    "        m_fault(\"negative shift count\");\n"
+    "    }\n"
+    "    return (uint64_t) count;\n"
+    "}\n"
+    "static inline uint64_t m_shiftLeft(unsigned bits, uint64_t a,"
+    " uint64_t count) {\n"
+    "    return count >= bits ? 0 : a << count;\n"
+    "}\n"
+    "static inline int64_t m_shiftRightInt(unsigned bits, int64_t a,"
+    " uint64_t count) {\n"
+    "    return count >= bits ? (a < 0 ? -1 : 0) : a >> count;\n"
+    "}\n"
+    "static inline uint64_t m_shiftRightUint(unsigned bits, uint64_t a,"
+    " uint64_t count) {\n"
+    "    return count >= bits ? 0 : a >> count;\n"
+    "}\n"
+    "\n"
+    "#endif\n"
+    "\n";
+
+// what an import of path gives in C, like the natives of bytecode.c
+static const struct {
+    const char* path;
+    const char* c;
+    bool        is_value;
+} natives[] = {
+    { "Cosole.stdout", "stdout",   true  },
+    { "Cosole.stderr", "stderr",   true  },
+    { "File.write",    "m_write",  false },
+    { "Test.assert",   "m_assert", false },
+};
+
+#define NATIVE_COUNT (sizeof(natives) / sizeof(natives[0]))
+
+static const char* const operators[] = {
+    [EXPRETION_ADD]                = " + ",
+    [EXPRETION_SUBTRACT]           = " - ",
+    [EXPRETION_MULTIPLY]           = " * ",
+    [EXPRETION_DIVIDE]             = " / ",
+    [EXPRETION_MODULO]             = " % ",
+    [EXPRETION_EQUAL]              = " == ",
+    [EXPRETION_LESS_THEN]          = " < ",
+    [EXPRETION_GREAT_THEN]         = " > ",
+    [EXPRETION_NOT_EQUAL]          = " != ",
+    [EXPRETION_LESS_THEN_OR_EQUAL] = " <= ",
+    [EXPRETION_GREA_THEN_OR_EQUAL] = " >= ",
+    [EXPRETION_BITWIZE_OR]         = " | ",
+    [EXPRETION_BITWIZE_AND]        = " & ",
+    [EXPRETION_LEFT_SHIFT]         = " << ",
+    [EXPRETION_RIGHT_SHIFT]        = " >> ",
+    [EXPRETION_LOGICAL_AND]        = " && ",
+    [EXPRETION_LOGICAL_OR]         = " || ",
+};
+
+struct Local {
+    uint32_t    name;
+    uint32_t    id;                 // locals called name it shadows
+    struct Type type;
+};
+
+enum Inferred {
+    INFERRED_NOT_YET,
+    INFERRED_TYPED,
+    INFERRED_LITERAL,               // a plain number, takes the other type
+};
+
+enum ItemType {
+    ITEM_EXPRETION,
+    ITEM_TEXT,
+};
+
+struct Item {
+    enum ItemType type;
+    uint32_t      index;            // AST.expretions
+    const char*   text;
+};
+
+enum TargetType {
+    TARGET_NONE,
+    TARGET_LOCAL,                   // names after the local are fields
+    TARGET_NATIVE,
+    TARGET_ENUM,                    // Enum.fild
+    TARGET_FUNC,
+    TARGET_CFUNC,
+    TARGET_METHOD,                  // local.filds.method
+};
+
+// what a path names, see resolvePath
+struct Target {
+    enum TargetType type;
+    uint32_t        index;          // natives, AST.type_decls, funcs, cfuncs
+    uint32_t        fild;           // AST.enum_filds of an enum
+    struct Type     result;         // of the value, or what a call returns
+};
+
+struct Emitter {
+    FILE*               stream;
+    struct AST*         ast;
+    struct Layout*      layout;
+    const char*         path;
+    struct Error*       error;
+    jmp_buf             bail;
+    char                where[96];  // what is emitted, for errors
+
+    // name -> index + 1 into AST.type_decls, funcs without self and cfuncs
+    uint32_t*           type_decls;
+    uint32_t*           funcs;
+    uint32_t*           cfuncs;
+    uint8_t*            marks;      // AST.type_decls, see emitTypeDecl
+
+    uint32_t            int_name;
+    uint32_t            float_name;
+    uint32_t            str_name;
+    uint32_t            bool_name;
+
+    NODES(struct Local) locals;
+    uint32_t            repeads;    // repead loops open
+
+    struct Type*        types;      // AST.expretions, see inferType
+    uint8_t*            inferred;   // AST.expretions, enum Inferred
+    NODES(uint32_t)     infer;      // see inferType
+    NODES(struct Item)  stack;      // see emitExpretion
+};
+
+static _Noreturn __attribute__((format(printf, 2, 3))) void errorEmit(
+    struct Emitter* emitter,
+    const char*     format,
+    ...
+) {
+    char message[160];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+    setError(emitter -> error, EMIT_ERROR, emitter -> path, 0, "%s, in %s",
+        message, emitter -> where);
+    longjmp(emitter -> bail, 1);
+}
+
+static inline struct String nameOf(struct Emitter* emitter, uint32_t name) {
+    return symbolString(emitter -> ast -> symbols, name);
+}
+
+static void setWhere(
+    struct Emitter* emitter,
+    const char*     what,
+    uint32_t        name
+) {
+    struct String string = nameOf(emitter, name);
+    snprintf(emitter -> where, sizeof(emitter -> where), "%s %.*s", what,
+        (int) string.length, string.string);
+}
+
+static void emitName(struct Emitter* emitter, uint32_t name) {
+    struct String string = nameOf(emitter, name);
+    fprintf(emitter -> stream, "m_%.*s", (int) string.length, string.string);
+}
+
+// the tag of an enum fild
+static void emitTag(struct Emitter* emitter, uint32_t type, uint32_t fild) {
+    struct String type_name = nameOf(emitter, type);
+    struct String fild_name = nameOf(emitter, fild);
+    fprintf(emitter -> stream, "M_%.*s_%.*s", (int) type_name.length,
+        type_name.string, (int) fild_name.length, fild_name.string);
+}
+
+// the layout of the enum named type, its tag may be kept in a niche
+static struct TypeLayout* enumLayout(struct Emitter* emitter, uint32_t type) {
+    return &emitter -> layout -> types[emitter -> type_decls[type] - 1];
+}
+
+static struct TypeDecl* findTypeDecl(struct Emitter* emitter, uint32_t name) {
+    if (name == SYMBOL_NONE || emitter -> type_decls[name] == 0) {
+        return NULL;
+    }
+    return &emitter -> ast -> type_decls.items[emitter -> type_decls[name] - 1];
+}
+
+// the type behind aliases, type = Other is the same type as Other
+static struct Type resolveAlias(struct Emitter* emitter, struct Type type) {
+    for (int i = 0; i < 64; i++) {
+        struct TypeDecl* decl = findTypeDecl(emitter, type.name);
+        if (decl == NULL || decl -> type != TYPE_TYPE) {
+            break;
+        }
+        bool is_ref = type.is_ref;
+        type = decl -> _type;
+        type.is_ref = type.is_ref || is_ref;
+    }
+    return type;
+}
+
+static bool findFild(
+    struct Emitter* emitter,
+    struct Type     type,
+    uint32_t        name,
+    struct Type*    res
+) {
+    struct TypeDecl* decl = findTypeDecl(
+        emitter,
+        resolveAlias(emitter, type).name
+    );
+    if (decl == NULL
+     || (decl -> type != TYPE_STRUCT && decl -> type != TYPE_UNION)) {
+        return false;
+    }
+    struct Range filds = decl -> type == TYPE_STRUCT
+        ? decl -> _struct
+        : decl -> _union;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct TypeFild fild = emitter -> ast -> filds.items[filds.start + i];
+        if (fild.name == name) {
+            (*res) = fild.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+// AST.enum_filds of the fild called name of an enum, or NODE_NONE
+static uint32_t findEnumFild(
+    struct TypeDecl* decl,
+    struct AST*      ast,
+    uint32_t         name
+) {
+    for (uint32_t i = 0; i < decl -> _enum.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[decl -> _enum.start + i];
+        if (fild.fild.name == name) {
+            return decl -> _enum.start + i;
+        }
+    }
+    return NODE_NONE;
+}
+
+// AST.funcs of the method name of the type called type, or NODE_NONE
+static uint32_t findMethod(
+    struct Emitter* emitter,
+    uint32_t        type,
+    uint32_t        name
+) {
+    struct AST* ast = emitter -> ast;
+    for (uint32_t i = 0; i < ast -> funcs.count; i++) {
+        struct FuncDecl func = ast -> funcs.items[i];
+        if (func.has_self && func.self.type.name == type && func.name == name) {
+            return i;
+        }
+    }
+    return NODE_NONE;
+}
+
+static struct Local* findLocal(struct Emitter* emitter, uint32_t name) {
+    for (uint32_t i = emitter -> locals.count; i > 0; i--) {
+        if (emitter -> locals.items[i - 1].name == name) {
+            return &emitter -> locals.items[i - 1];
+        }
+    }
+    return NULL;
+}
+
+// locals that shadow others get a number, C has no var x = x
+static struct Local* pushLocal(
+    struct Emitter* emitter,
+    uint32_t        name,
+    struct Type     type
+) {
+    struct Local* shadowed = findLocal(emitter, name);
+    struct Local local = {
+        .name = name,
+        .id   = shadowed == NULL ? 0 : shadowed -> id + 1,
+        .type = type
+    };
+    uint32_t index = pushNode(emitter -> locals, MEMORY_OTHER, local);
+    return &emitter -> locals.items[index];
+}
+
+static void emitLocal(struct Emitter* emitter, struct Local* local) {
+    emitName(emitter, local -> name);
+    if (local -> id != 0) {
+        fprintf(emitter -> stream, "_%u", local -> id);
+    }
+}
+
+static struct Type resultOf(struct Emitter* emitter, uint32_t result) {
+    if (result == NODE_NONE) {
+        return (struct Type) { .name = SYMBOL_NONE };
+    }
+    return emitter -> ast -> types.items[result];
+}
+
+/*
+ * What path names in the current scope: a local and its filds, a func, a
+ * cfunc, a method of the type of a local, an enum fild or a native. For
+ * a call the last name is a function, else a value.
+ */
+static struct Target resolvePath(
+    struct Emitter* emitter,
+    struct Path     path,
+    bool            is_call
+) {
+    struct AST* ast = emitter -> ast;
+    uint32_t* names = &ast -> names.items[path.names.start];
+    uint32_t count = path.names.count;
+    struct Target res = { .result = { .name = SYMBOL_NONE } };
+    if (path.is_relative) {
+        return res;
+    }
+
+    struct Local* local = findLocal(emitter, names[0]);
+    if (local != NULL) {
+        struct Type type = local -> type;
+        for (uint32_t i = 1; i < count; i++) {
+            if (is_call && i == count - 1) {
+                uint32_t method = findMethod(
+                    emitter,
+                    resolveAlias(emitter, type).name,
+                    names[i]
+                );
+                if (method == NODE_NONE) {
+                    return res;
+                }
+                res.type = TARGET_METHOD;
+                res.index = method;
+                res.result = resultOf(
+                    emitter,
+                    ast -> funcs.items[method].result
+                );
+                return res;
+            }
+            if (!findFild(emitter, type, names[i], &type)) {
+                return res;
+            }
+        }
+        if (!is_call) {
+            res.type = TARGET_LOCAL;
+            res.result = type;
+        }
+        return res;
+    }
+
+    if (count == 1 && is_call && emitter -> funcs[names[0]] != 0) {
+        res.type = TARGET_FUNC;
+        res.index = emitter -> funcs[names[0]] - 1;
+        res.result = resultOf(emitter, ast -> funcs.items[res.index].result);
+        return res;
+    }
+    if (count == 1 && is_call && emitter -> cfuncs[names[0]] != 0) {
+        res.type = TARGET_CFUNC;
+        res.index = emitter -> cfuncs[names[0]] - 1;
+        res.result = resultOf(emitter, ast -> cfuncs.items[res.index].result);
+        return res;
+    }
+    struct TypeDecl* decl = findTypeDecl(emitter, names[0]);
+    if (count == 2 && decl != NULL && decl -> type == TYPE_ENUM) {
+        res.fild = findEnumFild(decl, ast, names[1]);
+        if (res.fild != NODE_NONE) {
+            res.type = TARGET_ENUM;
+            res.index = emitter -> type_decls[names[0]] - 1;
+            res.result = (struct Type) { .name = names[0] };
+        }
+        return res;
+    }
+    struct Path imported = importedPath(ast, path);
+    for (uint32_t i = 0; i < NATIVE_COUNT; i++) {
+        if (natives[i].is_value != is_call
+         && pathIs(ast, imported, natives[i].path)) {
+            res.type = TARGET_NATIVE;
+            res.index = i;
+            return res;
+        }
+    }
+    return res;
+}
+
+static struct Type typeOfExpretion(struct Emitter* emitter, uint32_t index) {
+    struct AST* ast = emitter -> ast;
+    struct Expretion expr = ast -> expretions.items[index];
+    struct Type none = { .name = SYMBOL_NONE };
+    switch (expr.type) {
+    case EXPRETION_NONE:
+        return none;
+    case EXPRETION_LITERAL:
+        switch (expr.literal.type) {
+        case LITERAL_INT:
+            emitter -> inferred[index] = INFERRED_LITERAL;
+            return (struct Type) { .name = emitter -> int_name };
+        case LITERAL_FLOAT:
+            emitter -> inferred[index] = INFERRED_LITERAL;
+            return (struct Type) { .name = emitter -> float_name };
+        case LITERAL_STING:
+            return (struct Type) { .name = emitter -> str_name };
+        case LITERAL_NAME:
+            return resolvePath(emitter, expr.literal.name, false).result;
+        }
+        return none;
+    case EXPRETION_FUNCTION:
+        return resolvePath(emitter, expr.func.name, true).result;
+    case EXPRETION_CAST:
+        return ast -> types.items[expr.cast];
+    case EXPRETION_REF: {
+        struct Type type = emitter -> types[expr.expr];
+        if (type.is_ref) {
+            return none;
+        }
+        type.is_ref = true;
+        return type;
+    }
+    case EXPRETION_DEREF:
+    case EXPRETION_GET: {
+        struct Type type = resolveAlias(
+            emitter,
+            emitter -> types[expr.type == EXPRETION_GET ? expr.left : expr.expr]
+        );
+        if (!type.is_ref) {
+            return none;
+        }
+        type.is_ref = false;
+        return type;
+    }
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+        emitter -> inferred[index] = emitter -> inferred[expr.expr];
+        return emitter -> types[expr.expr];
+    case EXPRETION_LOGICAL_NOT:
+    case EXPRETION_EQUAL:
+    case EXPRETION_NOT_EQUAL:
+    case EXPRETION_LESS_THEN:
+    case EXPRETION_GREAT_THEN:
+    case EXPRETION_LESS_THEN_OR_EQUAL:
+    case EXPRETION_GREA_THEN_OR_EQUAL:
+    case EXPRETION_LOGICAL_AND:
+    case EXPRETION_LOGICAL_OR:
+        return (struct Type) { .name = emitter -> bool_name };
+    case EXPRETION_LEFT_SHIFT:
+    case EXPRETION_RIGHT_SHIFT:
+        emitter -> inferred[index] = emitter -> inferred[expr.left];
+        return emitter -> types[expr.left];
+    default: {
+        // a plain number takes the type of the other side
+        uint32_t from = emitter -> inferred[expr.left] == INFERRED_LITERAL
+            ? expr.right
+            : expr.left;
+        emitter -> inferred[index] = emitter -> inferred[from];
+        return emitter -> types[from];
+    }
+    }
+}
+
+// the children whose type the type of expr depends on
+static uint32_t typeChildren(struct Expretion expr, uint32_t* res) {
+    switch (expr.type) {
+    case EXPRETION_NONE:
+    case EXPRETION_LITERAL:
+    case EXPRETION_FUNCTION:
+    case EXPRETION_CAST:
+    case EXPRETION_LOGICAL_NOT:
+        return 0;
+    case EXPRETION_REF:
+    case EXPRETION_DEREF:
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+        res[0] = expr.expr;
+        return 1;
+    default:
+        res[0] = expr.left;
+        res[1] = expr.right;
+        return 2;
+    }
+}
+
+/*
+ * The type of root in the current scope, SYMBOL_NONE as its name if it
+ * can not be told. Children are typed before their parent with an
+ * explicit stack, an index is pushed a second time with the top bit set
+ * once its children are.
+ */
+static struct Type inferType(struct Emitter* emitter, uint32_t root) {
+    uint32_t mark = emitter -> infer.count;
+    pushNode(emitter -> infer, MEMORY_OTHER, root);
+    while (emitter -> infer.count > mark) {
+        uint32_t item = emitter -> infer.items[--emitter -> infer.count];
+        uint32_t index = item & ~(UINT32_C(1) << 31);
+        if (emitter -> inferred[index] != INFERRED_NOT_YET) {
+            continue;
+        }
+        if (item != index) {
+            emitter -> inferred[index] = INFERRED_TYPED;
+            emitter -> types[index] = typeOfExpretion(emitter, index);
+            continue;
+        }
+        pushNode(emitter -> infer, MEMORY_OTHER, item | UINT32_C(1) << 31);
+        uint32_t children[2];
+        uint32_t count = typeChildren(
+            emitter -> ast -> expretions.items[index],
+            children
+        );
+        for (uint32_t i = 0; i < count; i++) {
+            pushNode(emitter -> infer, MEMORY_OTHER, children[i]);
+        }
+    }
+    return emitter -> types[root];
+}
+
+static void emitType(struct Emitter* emitter, struct Type type) {
+    FILE* stream = emitter -> stream;
+    if (type.name == SYMBOL_NONE) {
+        errorEmit(emitter, "can not tell a type, give it one");
+    }
+    struct String name = nameOf(emitter, type.name);
+    if (type.args.count != 0) {
+        errorEmit(emitter, "generic type %.*s can not be emitted as C yet",
+            (int) name.length, name.string);
+    }
+    struct Builtin builtin = builtinType(emitter -> ast -> symbols, type.name);
+    switch (builtin.type) {
+    case BUILTIN_USER: {
+        struct TypeDecl* decl = findTypeDecl(emitter, type.name);
+        if (decl == NULL) {
+            errorEmit(emitter, "unknown type %.*s", (int) name.length,
+                name.string);
+        }
+        if (decl -> header.params.count != 0) {
+            errorEmit(emitter, "generic type %.*s can not be emitted as C yet",
+                (int) name.length, name.string);
+        }
+        emitName(emitter, type.name);
+        break;
+    }
+    case BUILTIN_INT:
+        fprintf(stream, "int%u_t", builtin.bits);
+        break;
+    case BUILTIN_UINT:
+        fprintf(stream, "uint%u_t", builtin.bits);
+        break;
+    case BUILTIN_FLOAT:
+        fputs(builtin.bits == 32 ? "float"
+            : builtin.bits == 64 ? "double"
+            : "long double", stream);
+        break;
+    case BUILTIN_BOOL:
+        fputs("bool", stream);
+        break;
+    case BUILTIN_STR:
+        fputs("m_Str", stream);
+        break;
+    case BUILTIN_NONE:
+        fputs("void", stream);
+        break;
+    case BUILTIN_ETC:
+    case BUILTIN_FUNC:
+        errorEmit(emitter, "%.*s can not be emitted as C yet",
+            (int) name.length, name.string);
+    }
+    if (type.is_ref) {
+        fputs("*", stream);
+    }
+}
+
+// C escapes, octal ones since hex ones do not end before a hex digit
+static void emitString(struct Emitter* emitter, uint32_t string) {
+    FILE* stream = emitter -> stream;
+    struct String text = nameOf(emitter, string);
+    fputs("((m_Str) { \"", stream);
+    for (size_t i = 0; i < text.length; i++) {
+        unsigned char ch = text.string[i];
+        if (ch == '"' || ch == '\\') {
+            fprintf(stream, "\\%c", ch);
+        } else if (ch == '\n') {
+            fputs("\\n", stream);
+        } else if (ch < 0x20 || ch >= 0x7f || ch == '?') {
+            // ? too, for trigraphs
+            fprintf(stream, "\\%03o", ch);
+        } else {
+            fputc(ch, stream);
+        }
+    }
+    fprintf(stream, "\", %zu })", text.length);
+}
+
+static void emitFloat(struct Emitter* emitter, long double value) {
+    // printf spells them inf and nan, which C does not know
+    if (isnan(value)) {
+        fputs("NAN", emitter -> stream);
+        return;
+    }
+    if (isinf(value)) {
+        fputs(signbit(value) ? "(-INFINITY)" : "INFINITY", emitter -> stream);
+        return;
+    }
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.17g", (double) value);
+    fputs(buffer, emitter -> stream);
+    if (strpbrk(buffer, ".en") == NULL) {
+        fputs(".0", emitter -> stream);
+    }
+}
+
+// names [0, count) of path: a local and its filds, -> behind a ref
+static void emitLocalPath(
+    struct Emitter* emitter,
+    struct Path     path,
+    uint32_t        count
+) {
+    uint32_t* names = &emitter -> ast -> names.items[path.names.start];
+    struct Local* local = findLocal(emitter, names[0]);
+    struct Type type = local -> type;
+    emitLocal(emitter, local);
+    for (uint32_t i = 1; i < count; i++) {
+        fputs(resolveAlias(emitter, type).is_ref ? "->" : ".",
+            emitter -> stream);
+        emitName(emitter, names[i]);
+        findFild(emitter, type, names[i], &type);
+    }
+}
+
+static _Noreturn void errorUnknown(struct Emitter* emitter, struct Path path) {
+    struct String name = nameOf(emitter, emitter -> ast -> names.items[
+        path.names.start + path.names.count - 1
+    ]);
+    errorEmit(emitter, "unknown name '%.*s'", (int) name.length, name.string);
+}
+
+static void emitLiteral(struct Emitter* emitter, struct Literal literal) {
+    FILE* stream = emitter -> stream;
+    switch (literal.type) {
+    case LITERAL_INT:
+        // a plain Int is 64 bits and signed, bigger literals wrap
+        if (literal._int == (uint64_t) INT64_MAX + 1) {
+            fputs("INT64_MIN", stream);
+        } else if (literal._int > INT64_MAX) {
+            fprintf(stream, "((int64_t) %" PRIu64 "u)", literal._int);
+        } else {
+            fprintf(stream, "%" PRIu64, literal._int);
+        }
+        return;
+    case LITERAL_FLOAT:
+        emitFloat(emitter, emitter -> ast -> floats.items[literal._float]);
+        return;
+    case LITERAL_STING:
+        emitString(emitter, literal.string);
+        return;
+    case LITERAL_NAME:
+        break;
+    }
+    struct Path path = literal.name;
+    struct Target target = resolvePath(emitter, path, false);
+    switch (target.type) {
+    case TARGET_LOCAL:
+        emitLocalPath(emitter, path, path.names.count);
+        return;
+    case TARGET_NATIVE:
+        fputs(natives[target.index].c, stream);
+        return;
+    case TARGET_ENUM: {
+        struct EnumFild fild = emitter -> ast -> enum_filds.items[target.fild];
+        if (fild.type == ENUM_FILD_TYPED) {
+            errorEmit(emitter, "an enum fild with a value is called");
+        }
+        if (enumLayout(emitter, target.result.name) -> tag_size == 0) {
+            emitName(emitter, target.result.name);
+            fputs("_make(", stream);
+            emitTag(emitter, target.result.name, fild.fild.name);
+            fputs(")", stream);
+            return;
+        }
+        fputs("((", stream);
+        emitName(emitter, target.result.name);
+        fputs(") { .tag = ", stream);
+        emitTag(emitter, target.result.name, fild.fild.name);
+        fputs(" })", stream);
+        return;
+    }
+    default:
+        errorUnknown(emitter, path);
+    }
+}
+
+#define EMIT(item_type, ...)                                                \
+    pushNode(emitter -> stack, MEMORY_OTHER, ((struct Item) {               \
+        .type = (item_type), __VA_ARGS__                                    \
+    }))
+
+// pushes the arguments, the opening paren is written already
+static void emitArgs(struct Emitter* emitter, struct Range args, bool first) {
+    EMIT(ITEM_TEXT, .text = ")");
+    for (uint32_t i = args.count; i > 0; i--) {
+        uint32_t arg = emitter -> ast -> expretion_lists.items[
+            args.start + i - 1
+        ];
+        EMIT(ITEM_EXPRETION, .index = arg);
+        if (i != 1 || !first) {
+            EMIT(ITEM_TEXT, .text = ", ");
+        }
+    }
+}
+
+static void emitCall(struct Emitter* emitter, struct FunctionCall call) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    struct Target target = resolvePath(emitter, call.name, true);
+    switch (target.type) {
+    case TARGET_FUNC:
+        emitName(emitter, ast -> funcs.items[target.index].name);
+        fputs("(", stream);
+        emitArgs(emitter, call.args, true);
+        return;
+    case TARGET_CFUNC: {
+        struct String name = nameOf(emitter,
+            ast -> cfuncs.items[target.index].name);
+        fprintf(stream, "%.*s(", (int) name.length, name.string);
+        emitArgs(emitter, call.args, true);
+        return;
+    }
+    case TARGET_NATIVE:
+        fprintf(stream, "%s(", natives[target.index].c);
+        emitArgs(emitter, call.args, true);
+        return;
+    case TARGET_METHOD: {
+        struct FuncDecl func = ast -> funcs.items[target.index];
+        uint32_t count = call.name.names.count - 1;
+        struct Type receiver = findLocal(
+            emitter,
+            ast -> names.items[call.name.names.start]
+        ) -> type;
+        for (uint32_t i = 1; i < count; i++) {
+            findFild(emitter, receiver,
+                ast -> names.items[call.name.names.start + i], &receiver);
+        }
+        emitName(emitter, func.self.type.name);
+        struct String name = nameOf(emitter, func.name);
+        fprintf(stream, "_%.*s(%s", (int) name.length, name.string,
+            resolveAlias(emitter, receiver).is_ref ? "*" : "");
+        emitLocalPath(emitter, call.name, count);
+        emitArgs(emitter, call.args, false);
+        return;
+    }
+    case TARGET_ENUM: {
+        struct EnumFild fild = ast -> enum_filds.items[target.fild];
+        if (fild.type != ENUM_FILD_TYPED || call.args.count != 1) {
+            errorEmit(emitter, "an enum fild takes its value, if it has one");
+        }
+        fputs("((", stream);
+        emitName(emitter, target.result.name);
+        if (enumLayout(emitter, target.result.name) -> tag_size == 0) {
+            fputs(") { .as.", stream);
+        } else {
+            fputs(") { .tag = ", stream);
+            emitTag(emitter, target.result.name, fild.fild.name);
+            fputs(", .as.", stream);
+        }
+        emitName(emitter, fild.fild.name);
+        fputs(" = ", stream);
+        EMIT(ITEM_TEXT, .text = " })");
+        EMIT(ITEM_EXPRETION, .index = ast -> expretion_lists.items[
+            call.args.start
+        ]);
+        return;
+    }
+    default:
+        errorUnknown(emitter, call.name);
+    }
+}
+
+// -9223372036854775808 is INT64_MIN, negated it would overflow
+static bool isInt64Min(struct Emitter* emitter, uint32_t expr) {
+    struct Expretion literal = emitter -> ast -> expretions.items[expr];
+    return literal.type == EXPRETION_LITERAL
+        && literal.literal.type == LITERAL_INT
+        && literal.literal._int == (uint64_t) INT64_MAX + 1;
+}
+
+// the C type of a builtin integer
+static const char* integerName(struct Builtin builtin) {
+    bool is_signed = builtin.type == BUILTIN_INT;
+    switch (builtin.bits) {
+    case 8:  return is_signed ? "int8_t" : "uint8_t";
+    case 16: return is_signed ? "int16_t" : "uint16_t";
+    case 32: return is_signed ? "int32_t" : "uint32_t";
+    default: return is_signed ? "int64_t" : "uint64_t";
+    }
+}
+
+// the builtin integer type of the value of expr, BUILTIN_USER if it is not
+static struct Builtin integerOf(struct Emitter* emitter, uint32_t expr) {
+    struct Type type = resolveAlias(emitter, inferType(emitter, expr));
+    struct Builtin res = { .type = BUILTIN_USER };
+    if (type.name == SYMBOL_NONE || type.is_ref || type.args.count != 0) {
+        return res;
+    }
+    struct Builtin builtin = builtinType(emitter -> ast -> symbols, type.name);
+    if (builtin.type == BUILTIN_INT || builtin.type == BUILTIN_UINT) {
+        res = builtin;
+    }
+    return res;
+}
+
+/*
+ * Integer operators the way the VM and fold run them. C does narrow
+ * arithmetic in int, so the result is cast back to its type to wrap.
+ * Division and shifts go through the prelude, which checks for zero and
+ * negative counts and keeps shifts past the width defined. An operand of
+ * a division is converted to the type of the result first, like a plain
+ * Int is. False if the result is no integer, expr is then emitted as is.
+ */
+static bool emitInteger(
+    struct Emitter*  emitter,
+    uint32_t         index,
+    struct Expretion expr
+) {
+    FILE* stream = emitter -> stream;
+    struct Builtin builtin = integerOf(emitter, index);
+    if (builtin.type == BUILTIN_USER) {
+        return false;
+    }
+    const char* name = integerName(builtin);
+    const char* sign = builtin.type == BUILTIN_INT ? "Int" : "Uint";
+    switch (expr.type) {
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+        if (builtin.bits == 64) {
+            return false;
+        }
+        fprintf(stream, "((%s) (%s", name,
+            expr.type == EXPRETION_NEG ? "-" : "~");
+        EMIT(ITEM_TEXT, .text = "))");
+        EMIT(ITEM_EXPRETION, .index = expr.expr);
+        return true;
+    case EXPRETION_DIVIDE:
+    case EXPRETION_MODULO:
+        fprintf(stream, "((%s) m_%s%s((%s) (", name,
+            expr.type == EXPRETION_DIVIDE ? "divide" : "modulo", sign, name);
+        EMIT(ITEM_TEXT, .text = ")))");
+        EMIT(ITEM_EXPRETION, .index = expr.right);
+        EMIT(ITEM_TEXT, .text = ") (");
+        EMIT(ITEM_TEXT, .text = name);
+        EMIT(ITEM_TEXT, .text = "), (");
+        EMIT(ITEM_EXPRETION, .index = expr.left);
+        return true;
+    case EXPRETION_LEFT_SHIFT:
+    case EXPRETION_RIGHT_SHIFT: {
+        // the count keeps its own type
+        bool is_signed = integerOf(emitter, expr.right).type != BUILTIN_UINT;
+        fprintf(stream, "((%s) m_shift%s(%u, ", name,
+            expr.type == EXPRETION_LEFT_SHIFT ? "Left"
+                : builtin.type == BUILTIN_INT ? "RightInt"
+                : "RightUint",
+            builtin.bits);
+        EMIT(ITEM_TEXT, .text = is_signed ? ")))" : "))");
+        EMIT(ITEM_EXPRETION, .index = expr.right);
+        EMIT(ITEM_TEXT, .text = is_signed ? ", m_shiftCount(" : ", ");
+        EMIT(ITEM_EXPRETION, .index = expr.left);
+        return true;
+    }
+    case EXPRETION_ADD:
+    case EXPRETION_SUBTRACT:
+    case EXPRETION_MULTIPLY:
+    case EXPRETION_BITWIZE_OR:
+    case EXPRETION_BITWIZE_AND:
+        if (builtin.bits == 64) {
+            return false;
+        }
+        fprintf(stream, "((%s) (", name);
+        EMIT(ITEM_TEXT, .text = "))");
+        EMIT(ITEM_EXPRETION, .index = expr.right);
+        EMIT(ITEM_TEXT, .text = operators[expr.type]);
+        EMIT(ITEM_EXPRETION, .index = expr.left);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Fully parenthesized, so C precedence never matters. Walks the tree with
+ * an explicit stack like printExpretion.
+ */
+static void emitExpretion(struct Emitter* emitter, uint32_t root) {
+    FILE* stream = emitter -> stream;
+    uint32_t mark = emitter -> stack.count;
+    EMIT(ITEM_EXPRETION, .index = root);
+    while (emitter -> stack.count > mark) {
+        struct Item item = emitter -> stack.items[--emitter -> stack.count];
+        if (item.type == ITEM_TEXT) {
+            fputs(item.text, stream);
+            continue;
+        }
+        struct Expretion expr = emitter -> ast -> expretions.items[item.index];
+        switch (expr.type) {
+        case EXPRETION_NONE:
+            break;
+        case EXPRETION_LITERAL:
+            emitLiteral(emitter, expr.literal);
+            break;
+        case EXPRETION_FUNCTION:
+            emitCall(emitter, expr.func);
+            break;
+        case EXPRETION_CAST:
+            fputs("((", stream);
+            emitType(emitter, emitter -> ast -> types.items[expr.cast]);
+            fputs(") ", stream);
+            EMIT(ITEM_TEXT, .text = ")");
+            EMIT(ITEM_EXPRETION, .index = expr.expr);
+            break;
+        case EXPRETION_NEG:
+            if (isInt64Min(emitter, expr.expr)) {
+                fputs("INT64_MIN", stream);
+                break;
+            }
+            // fall through
+        case EXPRETION_BITWIZE_NOT:
+            if (emitInteger(emitter, item.index, expr)) {
+                break;
+            }
+            // fall through
+        case EXPRETION_REF:
+        case EXPRETION_DEREF:
+        case EXPRETION_LOGICAL_NOT:
+            fputs(expr.type == EXPRETION_REF ? "(&"
+                : expr.type == EXPRETION_DEREF ? "(*"
+                : expr.type == EXPRETION_NEG ? "(-"
+                : expr.type == EXPRETION_BITWIZE_NOT ? "(~"
+                : "(!", stream);
+            EMIT(ITEM_TEXT, .text = ")");
+            EMIT(ITEM_EXPRETION, .index = expr.expr);
+            break;
+        case EXPRETION_GET:
+            EMIT(ITEM_TEXT, .text = "]");
+            EMIT(ITEM_EXPRETION, .index = expr.right);
+            EMIT(ITEM_TEXT, .text = "[");
+            EMIT(ITEM_EXPRETION, .index = expr.left);
+            break;
+        case EXPRETION_EQUAL:
+        case EXPRETION_NOT_EQUAL:
+            if (inferType(emitter, expr.left).name == emitter -> str_name) {
+                fputs(expr.type == EXPRETION_EQUAL
+                    ? "m_Str_equal("
+                    : "(!m_Str_equal(", stream);
+                EMIT(ITEM_TEXT, .text = expr.type == EXPRETION_EQUAL
+                    ? ")"
+                    : "))");
+                EMIT(ITEM_EXPRETION, .index = expr.right);
+                EMIT(ITEM_TEXT, .text = ", ");
+                EMIT(ITEM_EXPRETION, .index = expr.left);
+                break;
+            }
+            // fall through
+        default:
+            if (emitInteger(emitter, item.index, expr)) {
+                break;
+            }
+            fputs("(", stream);
+            EMIT(ITEM_TEXT, .text = ")");
+            EMIT(ITEM_EXPRETION, .index = expr.right);
+            EMIT(ITEM_TEXT, .text = operators[expr.type]);
+            EMIT(ITEM_EXPRETION, .index = expr.left);
+            break;
+        }
+    }
+}
+
+#undef EMIT
+
+static void emitStatement(
+    struct Emitter* emitter,
+    uint32_t        index,
+    int             indent
+);
+
+static void emitStatements(
+    struct Emitter* emitter,
+    struct Range    block,
+    int             indent
+) {
+    uint32_t locals = emitter -> locals.count;
+    for (uint32_t i = 0; i < block.count; i++) {
+        emitStatement(
+            emitter,
+            emitter -> ast -> statement_lists.items[block.start + i],
+            indent
+        );
+    }
+    emitter -> locals.count = locals;
+}
+
+// { statements } with the closing brace at indent
+static void emitBlock(struct Emitter* emitter, struct Range block, int indent) {
+    fputs("{\n", emitter -> stream);
+    emitStatements(emitter, block, indent + 4);
+    fprintf(emitter -> stream, "%*s}", indent, "");
+}
+
+static void emitCondition(struct Emitter* emitter, uint32_t condition) {
+    fputs("(", emitter -> stream);
+    emitExpretion(emitter, condition);
+    fputs(")", emitter -> stream);
+}
+
+// type name = value, the type is inferred if there is none
+static void emitVar(
+    struct Emitter* emitter,
+    uint32_t        name,
+    uint32_t        type,
+    uint32_t        value
+) {
+    struct Type var_type = type == NODE_NONE
+        ? inferType(emitter, value)
+        : emitter -> ast -> types.items[type];
+    if (var_type.name == SYMBOL_NONE) {
+        struct String string = nameOf(emitter, name);
+        errorEmit(emitter, "can not tell the type of %.*s, give it one",
+            (int) string.length, string.string);
+    }
+    emitType(emitter, var_type);
+    fputs(" ", emitter -> stream);
+    struct Local* local = pushLocal(emitter, name, var_type);
+    // the value is in the scope before the var
+    emitter -> locals.count--;
+    uint32_t id = local -> id;
+    emitName(emitter, name);
+    if (id != 0) {
+        fprintf(emitter -> stream, "_%u", id);
+    }
+    fputs(" = ", emitter -> stream);
+    emitExpretion(emitter, value);
+    emitter -> locals.count++;
+}
+
+static void emitIf(
+    struct Emitter*    emitter,
+    struct StatementIf _if,
+    int                indent
+) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    fputs("if ", stream);
+    emitCondition(emitter, _if.condition);
+    fputs(" ", stream);
+    emitBlock(emitter, _if.then, indent);
+    if (_if._else.count == 0) {
+        return;
+    }
+    fputs(" else ", stream);
+    struct Statement first = ast -> statements.items[
+        ast -> statement_lists.items[_if._else.start]
+    ];
+    if (_if._else.count == 1 && first.type == STATEMENT_IF) {
+        emitIf(emitter, first.statement_if, indent);
+    } else {
+        emitBlock(emitter, _if._else, indent);
+    }
+}
+
+// an enum is switched on by its tag, anything else needs integer cases
+static void emitSwitch(
+    struct Emitter*        emitter,
+    struct StatementSwitch _switch,
+    int                    indent
+) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    struct Type type = resolveAlias(
+        emitter,
+        inferType(emitter, _switch.value)
+    );
+    struct TypeDecl* decl = type.is_ref
+        ? NULL
+        : findTypeDecl(emitter, type.name);
+    bool is_enum = decl != NULL && decl -> type == TYPE_ENUM;
+    bool is_niche = is_enum && enumLayout(emitter, type.name) -> tag_size == 0;
+
+    fputs("switch (", stream);
+    if (is_niche) {
+        emitName(emitter, type.name);
+        fputs("_tag(", stream);
+    }
+    emitExpretion(emitter, _switch.value);
+    fputs(is_niche ? ")) {\n" : is_enum ? ".tag) {\n" : ") {\n", stream);
+    for (uint32_t i = 0; i < _switch.cases.count; i++) {
+        struct StatementSwitchCase _case = ast -> cases.items[
+            _switch.cases.start + i
+        ];
+        fprintf(stream, "%*s", indent, "");
+        if (_case._default) {
+            fputs("default: {\n", stream);
+        } else if (_case._case.type == LITERAL_INT && !is_enum) {
+            fprintf(stream, "case %" PRIu64 ": {\n", _case._case._int);
+        } else if (_case._case.type == LITERAL_NAME && is_enum) {
+            struct Path path = _case._case.name;
+            uint32_t name = ast -> names.items[
+                path.names.start + path.names.count - 1
+            ];
+            if (findEnumFild(decl, ast, name) == NODE_NONE) {
+                errorUnknown(emitter, path);
+            }
+            fputs("case ", stream);
+            emitTag(emitter, type.name, name);
+            fputs(": {\n", stream);
+        } else {
+            errorEmit(emitter, "a case is an integer or an enum fild");
+        }
+        emitStatements(emitter, _case.then, indent + 4);
+        fprintf(stream, "%*sbreak;\n%*s}\n", indent + 4, "", indent, "");
+    }
+    fprintf(stream, "%*s}", indent, "");
+}
+
+static void emitStatement(
+    struct Emitter* emitter,
+    uint32_t        index,
+    int             indent
+) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    struct Statement statement = ast -> statements.items[index];
+    fprintf(stream, "%*s", indent, "");
+    switch (statement.type) {
+    case STATEMENT_NONE:
+        fputs(";", stream);
+        break;
+    case STATEMENT_VAR:
+        emitVar(
+            emitter,
+            statement.statement_var.name,
+            statement.statement_var.type,
+            statement.statement_var.value
+        );
+        fputs(";", stream);
+        break;
+    case STATEMENT_CONST:
+        fputs("const ", stream);
+        emitVar(
+            emitter,
+            statement.statement_const.name,
+            NODE_NONE,
+            statement.statement_const.value
+        );
+        fputs(";", stream);
+        break;
+    case STATEMENT_IF:
+        emitIf(emitter, statement.statement_if, indent);
+        break;
+    case STATEMENT_SWITCH:
+        emitSwitch(emitter, statement.statement_switch, indent);
+        break;
+    case STATEMENT_DO:
+        fputs("do ", stream);
+        emitBlock(emitter, statement.statement_do.then, indent);
+        fputs(" while ", stream);
+        emitCondition(emitter, statement.statement_do.condition);
+        fputs(";", stream);
+        break;
+    case STATEMENT_WHILE:
+        if (statement.statement_while.condition == NODE_NONE) {
+            fputs("for (;;) ", stream);
+        } else {
+            fputs("while ", stream);
+            emitCondition(emitter, statement.statement_while.condition);
+            fputs(" ", stream);
+        }
+        emitBlock(emitter, statement.statement_while.then, indent);
+        break;
+    case STATEMENT_FOR: {
+        struct StatementVar var = ast -> statements.items[
+            statement.statement_for.var
+        ].statement_var;
+        uint32_t locals = emitter -> locals.count;
+        fputs("for (", stream);
+        emitVar(emitter, var.name, var.type, var.value);
+        fputs("; ", stream);
+        emitExpretion(emitter, statement.statement_for.condition);
+        fputs(";) ", stream);
+        emitBlock(emitter, statement.statement_for.then, indent);
+        emitter -> locals.count = locals;
+        break;
+    }
+    case STATEMENT_REPEAD: {
+        uint32_t counter = ++emitter -> repeads;
+        fprintf(stream, "for (int64_t m_repead_%u = ", counter);
+        emitExpretion(emitter, statement.statement_repead.condition);
+        fprintf(stream, "; m_repead_%u > 0; m_repead_%u--) ", counter,
+            counter);
+        emitBlock(emitter, statement.statement_repead.then, indent);
+        emitter -> repeads--;
+        break;
+    }
+    case STATEMENT_RETURN:
+        fputs("return", stream);
+        if (statement.statement_return.value != NODE_NONE) {
+            fputs(" ", stream);
+            emitExpretion(emitter, statement.statement_return.value);
+        }
+        fputs(";", stream);
+        break;
+    case STATEMENT_ASIGN: {
+        struct StatementAsign asign = statement.statement_asign;
+        if (asign.get_expr != NODE_NONE) {
+            emitExpretion(emitter, asign.get_expr);
+        } else {
+            struct Local* local = findLocal(emitter, asign.var_name);
+            if (local == NULL) {
+                struct String name = nameOf(emitter, asign.var_name);
+                errorEmit(emitter, "unknown variable '%.*s'",
+                    (int) name.length, name.string);
+            }
+            emitLocal(emitter, local);
+        }
+        fputs(" = ", stream);
+        emitExpretion(emitter, asign.value);
+        fputs(";", stream);
+        break;
+    }
+    case STATEMENT_CALL:
+        emitExpretion(emitter, statement.statement_expr);
+        fputs(";", stream);
+        break;
+    }
+    fputs("\n", stream);
+}
+
+// marks of AST.type_decls
+#define TYPE_EMITTING 1
+#define TYPE_EMITTED  2
+
+static void emitTypeDecl(struct Emitter* emitter, uint32_t index);
+
+// a type has to be complete before it is used by value
+static void emitTypeDependency(struct Emitter* emitter, struct Type type) {
+    struct TypeDecl* decl = findTypeDecl(emitter, type.name);
+    if (decl != NULL && (!type.is_ref || decl -> type == TYPE_TYPE)) {
+        emitTypeDecl(emitter, emitter -> type_decls[type.name] - 1);
+    }
+}
+
+static void emitFilds(struct Emitter* emitter, struct Range filds, int indent) {
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct TypeFild fild = emitter -> ast -> filds.items[filds.start + i];
+        fprintf(emitter -> stream, "%*s", indent, "");
+        emitType(emitter, fild.type);
+        fputs(" ", emitter -> stream);
+        emitName(emitter, fild.name);
+        fputs(";\n", emitter -> stream);
+    }
+}
+
+/*
+ * An enum with a niche has no tag, the filds without a value are spare
+ * values in the bytes of the one with a value. m_E_tag reads them and
+ * m_E_make writes them, see nicheValue of layout.h.
+ */
+static void emitNiche(struct Emitter* emitter, struct TypeDecl decl) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    uint32_t name = decl.header.name;
+    struct TypeLayout* layout = enumLayout(emitter, name);
+    uint32_t index = emitter -> type_decls[name] - 1;
+    uint32_t bits = layout -> niche.size * 8;
+    uint32_t typed = NODE_NONE;
+
+    fputs("static inline enum ", stream);
+    emitName(emitter, name);
+    fputs("_Tag ", stream);
+    emitName(emitter, name);
+    fputs("_tag(", stream);
+    emitName(emitter, name);
+    fprintf(stream, " x) {\n    uint%u_t niche;\n    memcpy(&niche, x.as.bytes"
+        " + %" PRIu64 ", sizeof(niche));\n    switch (niche) {\n", bits,
+        layout -> niche.offset);
+    for (uint32_t i = 0; i < decl._enum.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[decl._enum.start + i];
+        if (fild.type == ENUM_FILD_TYPED) {
+            typed = fild.fild.name;
+            continue;
+        }
+        fprintf(stream, "    case %" PRIu64 ": return ",
+            nicheValue(emitter -> layout, index, decl._enum.start + i));
+        emitTag(emitter, name, fild.fild.name);
+        fputs(";\n", stream);
+    }
+    fputs("    default: return ", stream);
+    emitTag(emitter, name, typed);
+    fputs(";\n    }\n}\n\n", stream);
+
+    fputs("static inline ", stream);
+    emitName(emitter, name);
+    fputs(" ", stream);
+    emitName(emitter, name);
+    fputs("_make(enum ", stream);
+    emitName(emitter, name);
+    fputs("_Tag tag) {\n    ", stream);
+    emitName(emitter, name);
+    fprintf(stream, " x;\n    memset(&x, 0, sizeof(x));\n    uint%u_t niche"
+        " = 0;\n    switch (tag) {\n", bits);
+    for (uint32_t i = 0; i < decl._enum.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[decl._enum.start + i];
+        if (fild.type == ENUM_FILD_TYPED) {
+            continue;
+        }
+        fputs("    case ", stream);
+        emitTag(emitter, name, fild.fild.name);
+        fprintf(stream, ": niche = %" PRIu64 "; break;\n",
+            nicheValue(emitter -> layout, index, decl._enum.start + i));
+    }
+    fprintf(stream, "    default: break;\n    }\n    memcpy(x.as.bytes + %"
+        PRIu64 ", &niche, sizeof(niche));\n    return x;\n}\n\n",
+        layout -> niche.offset);
+}
+
+/*
+ * Enums are a tag as wide as the layout says and a union of the filds
+ * that have a value, or that union alone when the tag is in a niche.
+ */
+static void emitEnum(struct Emitter* emitter, struct TypeDecl decl) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    uint32_t name = decl.header.name;
+    struct TypeLayout* layout = enumLayout(emitter, name);
+    bool has_values = false;
+    fputs("enum ", stream);
+    emitName(emitter, name);
+    fputs("_Tag {\n", stream);
+    for (uint32_t i = 0; i < decl._enum.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[decl._enum.start + i];
+        fputs("    ", stream);
+        emitTag(emitter, name, fild.fild.name);
+        fputs(",\n", stream);
+        has_values = has_values || fild.type == ENUM_FILD_TYPED;
+    }
+    fputs("};\n\nstruct ", stream);
+    emitName(emitter, name);
+    fputs(" {\n", stream);
+    if (layout -> tag_size != 0) {
+        fprintf(stream, "    uint%u_t tag;\n", layout -> tag_size * 8);
+    }
+    if (has_values) {
+        fputs("    union {\n", stream);
+        for (uint32_t i = 0; i < decl._enum.count; i++) {
+            struct EnumFild fild = ast -> enum_filds.items[
+                decl._enum.start + i
+            ];
+            if (fild.type == ENUM_FILD_TYPED) {
+                fputs("        ", stream);
+                emitType(emitter, fild.fild.type);
+                fputs(" ", stream);
+                emitName(emitter, fild.fild.name);
+                fputs(";\n", stream);
+            }
+        }
+        if (layout -> tag_size == 0) {
+            fprintf(stream, "        unsigned char bytes[%" PRIu64 "];\n",
+                layout -> size);
+        }
+        fputs("    } as;\n", stream);
+    }
+    fputs("};\n\n", stream);
+    if (layout -> tag_size == 0) {
+        emitNiche(emitter, decl);
+    }
+}
+
+// after the types it holds by value, which are emitted first
+static void emitTypeDecl(struct Emitter* emitter, uint32_t index) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    struct TypeDecl decl = ast -> type_decls.items[index];
+    if (emitter -> marks[index] == TYPE_EMITTED) {
+        return;
+    }
+    setWhere(emitter, "type", decl.header.name);
+    if (emitter -> marks[index] == TYPE_EMITTING) {
+        errorEmit(emitter, "the type holds itself");
+    }
+    emitter -> marks[index] = TYPE_EMITTING;
+    if (decl.header.params.count != 0) {
+        struct String name = nameOf(emitter, decl.header.name);
+        fprintf(stream, "// %.*s is generic, it is left out until it is"
+            " instantiated\n\n", (int) name.length, name.string);
+        emitter -> marks[index] = TYPE_EMITTED;
+        return;
+    }
+
+    switch (decl.type) {
+    case TYPE_TYPE:
+        emitTypeDependency(emitter, decl._type);
+        setWhere(emitter, "type", decl.header.name);
+        fputs("typedef ", stream);
+        emitType(emitter, decl._type);
+        fputs(" ", stream);
+        emitName(emitter, decl.header.name);
+        fputs(";\n\n", stream);
+        break;
+    case TYPE_STRUCT:
+    case TYPE_UNION: {
+        struct Range filds = decl.type == TYPE_STRUCT
+            ? decl._struct
+            : decl._union;
+        for (uint32_t i = 0; i < filds.count; i++) {
+            emitTypeDependency(
+                emitter,
+                ast -> filds.items[filds.start + i].type
+            );
+        }
+        setWhere(emitter, "type", decl.header.name);
+        fputs(decl.type == TYPE_STRUCT ? "struct " : "union ", stream);
+        emitName(emitter, decl.header.name);
+        fputs(" {\n", stream);
+        emitFilds(emitter, filds, 4);
+        if (filds.count == 0) {
+            fputs("    char empty;\n", stream);
+        }
+        fputs("};\n\n", stream);
+        break;
+    }
+    case TYPE_ENUM:
+        for (uint32_t i = 0; i < decl._enum.count; i++) {
+            struct EnumFild fild = ast -> enum_filds.items[
+                decl._enum.start + i
+            ];
+            if (fild.type == ENUM_FILD_TYPED) {
+                emitTypeDependency(emitter, fild.fild.type);
+            }
+        }
+        setWhere(emitter, "type", decl.header.name);
+        emitEnum(emitter, decl);
+        break;
+    }
+    emitter -> marks[index] = TYPE_EMITTED;
+}
+
+// self first for methods, it is SYMBOL_NONE for the rest
+static void emitParams(
+    struct Emitter* emitter,
+    struct Range    args,
+    uint32_t        self,
+    struct Type     self_type
+) {
+    FILE* stream = emitter -> stream;
+    fputs("(", stream);
+    if (self != SYMBOL_NONE) {
+        emitType(emitter, self_type);
+        fputs(" ", stream);
+        emitName(emitter, self);
+        pushLocal(emitter, self, self_type);
+    } else if (args.count == 0) {
+        fputs("void", stream);
+    }
+    for (uint32_t i = 0; i < args.count; i++) {
+        struct TypeFild fild = emitter -> ast -> filds.items[args.start + i];
+        if (i != 0 || self != SYMBOL_NONE) {
+            fputs(", ", stream);
+        }
+        emitType(emitter, fild.type);
+        fputs(" ", stream);
+        emitName(emitter, fild.name);
+        pushLocal(emitter, fild.name, fild.type);
+    }
+    fputs(")", stream);
+}
+
+static void emitResult(struct Emitter* emitter, uint32_t result) {
+    if (result == NODE_NONE) {
+        fputs("void ", emitter -> stream);
+        return;
+    }
+    emitType(emitter, emitter -> ast -> types.items[result]);
+    fputs(" ", emitter -> stream);
+}
+
+static void emitEnd(struct Emitter* emitter, struct Range body, bool is_body) {
+    if (is_body) {
+        fputs(" ", emitter -> stream);
+        emitBlock(emitter, body, 0);
+        fputs("\n\n", emitter -> stream);
+    } else {
+        fputs(";\n", emitter -> stream);
+    }
+    emitter -> locals.count = 0;
+}
+
+/*
+ * Funcs are static unless exported, methods are named Type_name and get
+ * self first. Generic methods are left out like generic types.
+ */
+static void emitFunc(struct Emitter* emitter, uint32_t index, bool is_body) {
+    FILE* stream = emitter -> stream;
+    struct FuncDecl func = emitter -> ast -> funcs.items[index];
+    if (func.has_self && func.self.type.params.count != 0) {
+        return;
+    }
+    if (is_body && func.is_external) {
+        return;
+    }
+    setWhere(emitter, "func", func.name);
+    if (func.is_external) {
+        fputs("extern ", stream);
+    } else if (!func.is_exported) {
+        fputs("static ", stream);
+    }
+    emitResult(emitter, func.result);
+    uint32_t self = SYMBOL_NONE;
+    struct Type self_type = { .name = SYMBOL_NONE };
+    if (func.has_self) {
+        self = func.self.name;
+        self_type.name = func.self.type.name;
+        emitName(emitter, func.self.type.name);
+        struct String name = nameOf(emitter, func.name);
+        fprintf(stream, "_%.*s", (int) name.length, name.string);
+    } else {
+        emitName(emitter, func.name);
+    }
+    emitParams(emitter, func.args, self, self_type);
+    emitEnd(emitter, func.body, is_body);
+}
+
+// cfuncs keep their name and linkage, C code calls them
+static void emitCFunc(struct Emitter* emitter, uint32_t index, bool is_body) {
+    struct CFuncDecl cfunc = emitter -> ast -> cfuncs.items[index];
+    struct String name = nameOf(emitter, cfunc.name);
+    setWhere(emitter, "cfunc", cfunc.name);
+    emitResult(emitter, cfunc.result);
+    fprintf(emitter -> stream, "%.*s", (int) name.length, name.string);
+    emitParams(emitter, cfunc.args, SYMBOL_NONE, (struct Type) { 0 });
+    emitEnd(emitter, cfunc.body, is_body);
+}
+
+static void emitTest(struct Emitter* emitter, uint32_t index, bool is_body) {
+    snprintf(emitter -> where, sizeof(emitter -> where), "test %u",
+        index + 1);
+    fprintf(emitter -> stream, "static void m_test_%u(void)", index + 1);
+    emitEnd(emitter, emitter -> ast -> tests.items[index].body, is_body);
+}
+
+// runs func main, or the tests with -DMICRO_TESTS
+static void emitMain(struct Emitter* emitter) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    uint32_t main_name = internSymbol(ast -> symbols, "main", 4);
+    if (emitter -> cfuncs[main_name] != 0) {
+        // a cfunc is the main of the program already
+        return;
+    }
+    if (ast -> tests.count != 0) {
+        fputs("#ifdef MICRO_TESTS\nint main(void) {\n", stream);
+        for (uint32_t i = 0; i < ast -> tests.count; i++) {
+            fprintf(stream, "    m_test_%u();\n", i + 1);
+            fprintf(stream, "    puts(\"test %u ok\");\n", i + 1);
+        }
+        fputs("    return 0;\n}\n#else\n", stream);
+    }
+    struct FuncDecl* func = NULL;
+    if (emitter -> funcs[main_name] != 0) {
+        func = &ast -> funcs.items[emitter -> funcs[main_name] - 1];
+    }
+    if (func != NULL && func -> args.count == 0) {
+        fputs("int main(void) {\n", stream);
+        fputs(func -> result == NODE_NONE
+            ? "    m_main();\n    return 0;\n"
+            : "    return (int) m_main();\n", stream);
+        fputs("}\n", stream);
+    } else if (ast -> tests.count != 0) {
+        fputs("int main(void) {\n    return 0;\n}\n", stream);
+    }
+    if (ast -> tests.count != 0) {
+        fputs("#endif\n", stream);
+    }
+}
+
+static void emitFile(struct Emitter* emitter) {
+    FILE* stream = emitter -> stream;
+    struct AST* ast = emitter -> ast;
+    fputs(prelude, stream);
+
+    bool has_types = false;
+    for (uint32_t i = 0; i < ast -> type_decls.count; i++) {
+        struct TypeDecl decl = ast -> type_decls.items[i];
+        if (decl.type == TYPE_TYPE || decl.header.params.count != 0) {
+            continue;
+        }
+        fputs(decl.type == TYPE_UNION ? "typedef union " : "typedef struct ",
+            stream);
+        emitName(emitter, decl.header.name);
+        fputs(" ", stream);
+        emitName(emitter, decl.header.name);
+        fputs(";\n", stream);
+        has_types = true;
+    }
+    if (has_types) {
+        fputs("\n", stream);
+    }
+    for (uint32_t i = 0; i < ast -> type_decls.count; i++) {
+        emitTypeDecl(emitter, i);
+    }
+
+    for (int is_body = 0; is_body < 2; is_body++) {
+        for (uint32_t i = 0; i < ast -> funcs.count; i++) {
+            emitFunc(emitter, i, is_body);
+        }
+        for (uint32_t i = 0; i < ast -> cfuncs.count; i++) {
+            emitCFunc(emitter, i, is_body);
+        }
+        for (uint32_t i = 0; i < ast -> tests.count; i++) {
+            emitTest(emitter, i, is_body);
+        }
+        if (!is_body && ast -> funcs.count + ast -> cfuncs.count
+            + ast -> tests.count != 0) {
+            fputs("\n", stream);
+        }
+    }
+    emitMain(emitter);
+}
+
+static void* zeroed(size_t count, size_t size) {
+    void* res = memoryAlloc(count * size);
+    memset(res, 0, count * size);
+    return res;
+}
+
+// index + 1 of the declaration called name in by_name, later ones win
+#define MAP_DECLS(emitter, by_name, array, name_of, skip)                  \
+    do {                                                                    \
+        for (uint32_t i = 0; i < (emitter).ast -> array.count; i++) {      \
+            if (!(skip)) {                                                  \
+                (emitter).by_name[(emitter).ast -> array.items[i].name_of] \
+                    = i + 1;                                                \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+bool emitC(
+    FILE*          stream,
+    struct AST*    ast,
+    struct Layout* layout,
+    const char*    path,
+    struct Error*  error
+) {
+    timeBegin("emit c");
+    char* text = NULL;
+    size_t length = 0;
+    FILE* buffer = open_memstream(&text, &length);
+    if (buffer == NULL) {
+        perror("Memory Error");
+        exit(EXIT_FAILURE);
+    }
+
+    struct Emitter emitter = {
+        .stream     = buffer,
+        .ast        = ast,
+        .layout     = layout,
+        .path       = path,
+        .error      = error,
+        .int_name   = internSymbol(ast -> symbols, "Int", 3),
+        .float_name = internSymbol(ast -> symbols, "Float", 5),
+        .str_name   = internSymbol(ast -> symbols, "Str", 3),
+        .bool_name  = internSymbol(ast -> symbols, "Bool", 4),
+    };
+    // interned before the maps are sized, see emitMain
+    internSymbol(ast -> symbols, "main", 4);
+    uint32_t symbols = ast -> symbols -> count;
+    emitter.type_decls = zeroed(symbols, sizeof(uint32_t));
+    emitter.funcs = zeroed(symbols, sizeof(uint32_t));
+    emitter.cfuncs = zeroed(symbols, sizeof(uint32_t));
+    emitter.marks = zeroed(ast -> type_decls.count + 1, 1);
+    emitter.types = zeroed(
+        ast -> expretions.count + 1,
+        sizeof(struct Type)
+    );
+    emitter.inferred = zeroed(ast -> expretions.count + 1, 1);
+    MAP_DECLS(emitter, type_decls, type_decls, header.name, false);
+    MAP_DECLS(emitter, funcs, funcs, name,
+        ast -> funcs.items[i].has_self);
+    MAP_DECLS(emitter, cfuncs, cfuncs, name, false);
+
+    bool res = setjmp(emitter.bail) == 0;
+    if (res) {
+        emitFile(&emitter);
+    }
+    fclose(buffer);
+    if (res) {
+        fwrite(text, 1, length, stream);
+    }
+    memoryFree(text);
+
+    memoryFree(emitter.type_decls);
+    memoryFree(emitter.funcs);
+    memoryFree(emitter.cfuncs);
+    memoryFree(emitter.marks);
+    memoryFree(emitter.types);
+    memoryFree(emitter.inferred);
+    memoryFree(emitter.locals.items);
+    memoryFree(emitter.infer.items);
+    memoryFree(emitter.stack.items);
+    timeEnd();
+    return res;
+}
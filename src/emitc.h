@@ -0,0 +1,31 @@
+#ifndef EMITC_H
+#define EMITC_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "layout.h"
+
+/*
+ * Translates ast to one C11 file for the system compiler: types, funcs,
+ * methods, cfuncs and tests, with an int main() that runs func main, or
+ * the tests when compiled with -DMICRO_TESTS. Every micro name gets an m_
+ * prefix, except cfuncs, which keep theirs so C can call them.
+ *
+ * Integers follow C, compile with -fwrapv to get the wrapping of micro.
+ * Enums get the tag width and niches of layout, from layoutTypes of the
+ * same ast. Returns false and sets error for what has no C translation
+ * yet, like generic types, which monomorphize of mono.h instantiates
+ * first.
+ */
+bool emitC(
+    FILE*          stream,
+    struct AST*    ast,
+    struct Layout* layout,
+    const char*    path,
+    struct Error*  error
+);
+
+#endif
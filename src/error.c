@@ -0,0 +1,48 @@
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <stdio.h>
+// for: vsnprintf, fprintf
+
+#include "error.h"
+
+void setError(
+    struct Error* error,
+    const char*   kind,
+    const char*   file,
+    size_t        line,
+    const char*   format,
+    ...
+) {
+    if (error == NULL || error -> kind != NULL) {
+        return;
+    }
+    error -> kind = kind;
+    error -> file = file;
+    error -> line = line;
+    va_list list;
+    va_start(list, format);
+    vsnprintf(error -> message, sizeof(error -> message), format, list);
+    va_end(list);
+}
+
+// line 0 is an error about the whole file
+void printError(FILE* stream, const struct Error* error) {
+    if (error -> line == 0) {
+        fprintf(
+            stream,
+            "%s %s: %s\n",
+            error -> kind,
+            error -> file,
+            error -> message
+        );
+        return;
+    }
+    fprintf(
+        stream,
+        "%s %s:%zu: %s\n",
+        error -> kind,
+        error -> file,
+        error -> line,
+        error -> message
+    );
+}
@@ -0,0 +1,31 @@
+#ifndef ERROR_H
+#define ERROR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * A diagnostic handed back to the caller instead of printed on the spot,
+ * so files compiled at the same time can report in a stable order. Only
+ * the first error is kept, later ones tend to be noise caused by it.
+ */
+struct Error {
+    const char* kind;           // NULL while nothing went wrong
+    const char* file;
+    size_t      line;
+    char        message[256];
+};
+
+void setError(
+    struct Error* error,
+    const char*   kind,
+    const char*   file,
+    size_t        line,
+    const char*   format,
+    ...
+) __attribute__((format(printf, 5, 6)));
+
+void printError(FILE* stream, const struct Error* error);
+
+#endif
@@ -1,27 +1,138 @@
-#include <stdio.h>
-// for: fopen, fseek, fclose, SEEK_END, SEEK_SET, perror
-#include <stdlib.h>
-// for: exit, EXIT_FAILURE
+#include <fcntl.h>
+// for: open, O_RDONLY
+#include <errno.h>
+// for: errno
+#include <stdbool.h>
+// for: bool
+#include <string.h>
+// for: strcmp, strerror
+#include <sys/mman.h>
+// for: mmap, munmap, madvise
+#include <sys/stat.h>
+// for: fstat, S_ISREG
+#include <unistd.h>
+// for: read, close, sysconf
 
+#include "error.h"
+#include "file.h"
 #include "memory.h"
 
-const char* readFile(const char* path) {
-    FILE *file = fopen(path, "rb");
-    if (file == NULL) {
-        perror("File error!");
-        exit(EXIT_FAILURE);
+#define READ_CHUNK (64 * 1024)
+#define FILE_ERROR "File error"
+
+// errno as the error of path, file is left empty
+static bool errorFile(
+    struct File*  file,
+    const char*   path,
+    struct Error* error
+) {
+    setError(error, FILE_ERROR, path, 0, "%s", strerror(errno));
+    (*file) = (struct File) { 0 };
+    return false;
+}
+
+// pipes and terminals have no size up front, so grow the buffer as we go
+static bool readStream(
+    struct File*  file,
+    int           fd,
+    const char*   path,
+    struct Error* error
+) {
+    size_t capacity = READ_CHUNK;
+    size_t length = 0;
+    char* text = memoryAllocKind(MEMORY_FILE, capacity + 1);
+    while (true) {
+        if (length == capacity) {
+            capacity *= 2;
+            text = memoryReallocKind(MEMORY_FILE, text, capacity + 1);
+        }
+        ssize_t size = read(fd, text + length, capacity - length);
+        if (size < 0) {
+            memoryFree(text);
+            return errorFile(file, path, error);
+        }
+        if (size == 0) {
+            break;
+        }
+        length += size;
+    }
+    text[length] = 0;
+    (*file) = (struct File) {
+        .text   = text,
+        .length = length,
+        .mapped = 0
+    };
+    return true;
+}
+
+/*
+ * The whole range is reserved as zeroed anonymous memory first and the file
+ * is mapped over its start. The tail of the last file page is zero filled by
+ * the kernel, and when the file ends exactly on a page the reserved page
+ * after it holds the terminator, so reading one byte past the end is safe.
+ */
+static bool mapFile(
+    struct File*  file,
+    int           fd,
+    size_t        length,
+    const char*   path,
+    struct Error* error
+) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t mapped = (length + 1 + page - 1) & ~(page - 1);
+    char* text = mmap(
+        NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (text == MAP_FAILED) {
+        return errorFile(file, path, error);
     }
+    if (length != 0) {
+        void* res = mmap(
+            text, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0
+        );
+        if (res == MAP_FAILED) {
+            int mmap_errno = errno;
+            munmap(text, mapped);
+            errno = mmap_errno;
+            return errorFile(file, path, error);
+        }
+        madvise(text, length, MADV_SEQUENTIAL);
+    }
+    (*file) = (struct File) {
+        .text   = text,
+        .length = length,
+        .mapped = mapped
+    };
+    return true;
+}
 
-    fseek(file, 0, SEEK_END);
-    size_t lengh = ftell(file);
-    fseek(file, 0, SEEK_SET);
+bool readFile(struct File* file, const char* path, struct Error* error) {
+    if (strcmp(path, "-") == 0) {
+        return readStream(file, STDIN_FILENO, path, error);
+    }
 
-    char *string = memoryAlloc(lengh + 1);
-    if (fread(string, sizeof(char), lengh, file) != lengh) {
-        perror("File error!");
-        exit(EXIT_FAILURE);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errorFile(file, path, error);
     }
+    struct stat info;
+    bool res;
+    if (fstat(fd, &info) != 0) {
+        res = errorFile(file, path, error);
+    } else if (S_ISREG(info.st_mode)) {
+        res = mapFile(file, fd, info.st_size, path, error);
+    } else {
+        res = readStream(file, fd, path, error);
+    }
+    close(fd);
+    return res;
+}
 
-    fclose(file);
-    return string;
+void closeFile(struct File* file) {
+    if (file -> mapped != 0) {
+        munmap((void*)file -> text, file -> mapped);
+    } else {
+        memoryFree((void*)file -> text);
+    }
+    (*file) = (struct File) { 0 };
 }
@@ -1,6 +1,26 @@
 #ifndef FILE_H
 #define FILE_H
 
-const char* readFile(const char* path);
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "error.h"
+
+/*
+ * Source text, always followed by at least one zero byte. Regular files are
+ * mapped straight from the page cache, anything else is read into memory.
+ */
+struct File {
+    const char* text;
+    size_t      length;
+    size_t      mapped;     // size of the mapping, 0 if text is on the heap
+};
+
+/*
+ * "-" reads stdin. On failure error gets the reason with path, file is
+ * left empty and false is returned, nothing exits, so workers can read.
+ */
+bool readFile(struct File* file, const char* path, struct Error* error);
+void closeFile(struct File* file);
 
 #endif
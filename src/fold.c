@@ -0,0 +1,656 @@
+#include <math.h>
+// for: isfinite, signbit, fabsl
+#include <stdbool.h>
+// for: bool
+#include <stdint.h>
+// for: uint64_t, int64_t, INT64_MIN
+
+#include "ast.h"
+#include "builtin.h"
+#include "fold.h"
+#include "memory.h"
+
+/*
+ * Children always come before their parent in AST.expretions, the parser
+ * pushes operands first. So one pass in index order sees every child
+ * before its parent without recursing, and the rewrites below keep it so.
+ */
+
+enum ConstantType {
+    CONSTANT_NONE,                  // not known before runtime
+    CONSTANT_INT,
+    CONSTANT_FLOAT,
+};
+
+// what is known about one expretion at compile time
+struct Constant {
+    enum ConstantType type;
+    bool              is_pure;      // no call anywhere below
+    bool              is_signed;
+    uint32_t          bits;         // 0 while untyped
+    uint32_t          cast;         // AST.types of the type, NODE_NONE if none
+    uint64_t          _int;         // sign extended when signed
+    long double       _float;
+};
+
+static inline uint32_t intBits(struct Constant value) {
+    return value.bits == 0 ? 64 : value.bits;
+}
+
+// untyped floats are doubles at runtime, like Float64
+static long double roundFloat(long double value, uint32_t bits) {
+    switch (bits) {
+    case 32:
+        return (float) value;
+    default:
+        return (double) value;
+    }
+}
+
+// the children of an expretion that has at most two, calls have more
+static uint32_t children(struct Expretion expr, uint32_t* res) {
+    switch (expr.type) {
+    case EXPRETION_NONE:
+    case EXPRETION_LITERAL:
+    case EXPRETION_FUNCTION:
+        return 0;
+    case EXPRETION_CAST:
+    case EXPRETION_REF:
+    case EXPRETION_DEREF:
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+    case EXPRETION_LOGICAL_NOT:
+        res[0] = expr.expr;
+        return 1;
+    default:
+        res[0] = expr.left;
+        res[1] = expr.right;
+        return 2;
+    }
+}
+
+static void markRoot(uint8_t* marked, uint32_t expr) {
+    if (expr != NODE_NONE) {
+        marked[expr] = 1;
+    }
+}
+
+// expretions reachable from a statement, parents are marked before children
+static size_t countReachable(struct AST* ast) {
+    uint32_t count = ast -> expretions.count;
+    uint8_t* marked = memoryAllocKind(MEMORY_EXPRETION, count + 1);
+    for (uint32_t i = 0; i < ast -> statements.count; i++) {
+        struct Statement statement = ast -> statements.items[i];
+        switch (statement.type) {
+        case STATEMENT_NONE:
+            break;
+        case STATEMENT_VAR:
+            markRoot(marked, statement.statement_var.value);
+            break;
+        case STATEMENT_CONST:
+            markRoot(marked, statement.statement_const.value);
+            break;
+        case STATEMENT_IF:
+            markRoot(marked, statement.statement_if.condition);
+            break;
+        case STATEMENT_SWITCH:
+            markRoot(marked, statement.statement_switch.value);
+            break;
+        case STATEMENT_DO:
+            markRoot(marked, statement.statement_do.condition);
+            break;
+        case STATEMENT_WHILE:
+            markRoot(marked, statement.statement_while.condition);
+            break;
+        case STATEMENT_FOR:
+            markRoot(marked, statement.statement_for.condition);
+            break;
+        case STATEMENT_REPEAD:
+            markRoot(marked, statement.statement_repead.condition);
+            break;
+        case STATEMENT_RETURN:
+            markRoot(marked, statement.statement_return.value);
+            break;
+        case STATEMENT_ASIGN:
+            markRoot(marked, statement.statement_asign.get_expr);
+            markRoot(marked, statement.statement_asign.value);
+            break;
+        case STATEMENT_CALL:
+            markRoot(marked, statement.statement_expr);
+            break;
+        }
+    }
+
+    size_t res = 0;
+    for (uint32_t i = count; i > 0; i--) {
+        if (!marked[i - 1]) {
+            continue;
+        }
+        res++;
+        struct Expretion expr = ast -> expretions.items[i - 1];
+        if (expr.type == EXPRETION_FUNCTION) {
+            for (uint32_t j = 0; j < expr.func.args.count; j++) {
+                markRoot(
+                    marked,
+                    ast -> expretion_lists.items[expr.func.args.start + j]
+                );
+            }
+            continue;
+        }
+        uint32_t child[2];
+        for (uint32_t j = children(expr, child); j > 0; j--) {
+            markRoot(marked, child[j - 1]);
+        }
+    }
+    memoryFree(marked);
+    return res;
+}
+
+static struct Constant castValue(
+    struct Constant   value,
+    struct Builtin builtin,
+    uint32_t       cast
+) {
+    struct Constant res = {
+        .is_pure   = value.is_pure,
+        .is_signed = builtin.type == BUILTIN_INT,
+        .bits      = builtin.bits,
+        .cast      = cast
+    };
+    if (builtin.type == BUILTIN_INT || builtin.type == BUILTIN_UINT) {
+        res.type = CONSTANT_INT;
+        if (value.type == CONSTANT_INT) {
+            res._int = wrapInt(value._int, res.is_signed, res.bits);
+            return res;
+        }
+        // out of range is undefined, leave it to runtime
+        long double limit = (long double) (UINT64_C(1) << (res.bits - 1));
+        long double low = res.is_signed ? -limit - 1 : -1;
+        long double high = res.is_signed ? limit : limit * 2;
+        if (!(value._float > low && value._float < high)) {
+            return (struct Constant) {
+                .is_pure = value.is_pure,
+                .cast    = NODE_NONE
+            };
+        }
+        res._int = res.is_signed
+            ? (uint64_t) (int64_t) value._float
+            : (uint64_t) value._float;
+        return res;
+    }
+    res.type = CONSTANT_FLOAT;
+    if (value.type == CONSTANT_INT) {
+        res._float = value.is_signed
+            ? (long double) (int64_t) value._int
+            : (long double) value._int;
+    } else {
+        res._float = value._float;
+    }
+    res._float = roundFloat(res._float, res.bits);
+    if (!isfinite(res._float)) {
+        // overflows to inf at runtime, leave it there
+        return (struct Constant) {
+            .is_pure = value.is_pure,
+            .cast    = NODE_NONE
+        };
+    }
+    return res;
+}
+
+/*
+ * Both sides have to have the same type. An untyped side takes the type of
+ * the other one, converted like a cast would.
+ */
+static bool commonType(struct Constant* left, struct Constant* right) {
+    if (left -> type != right -> type) {
+        return false;
+    }
+    if (left -> cast == NODE_NONE && right -> cast == NODE_NONE) {
+        return true;
+    }
+    struct Constant* typed = left -> cast != NODE_NONE ? left : right;
+    struct Constant* other = typed == left ? right : left;
+    if (other -> cast == NODE_NONE) {
+        other -> is_signed = typed -> is_signed;
+        other -> bits      = typed -> bits;
+        other -> cast      = typed -> cast;
+        if (other -> type == CONSTANT_INT) {
+            other -> _int = wrapInt(
+                other -> _int,
+                other -> is_signed,
+                other -> bits
+            );
+        } else {
+            other -> _float = roundFloat(other -> _float, other -> bits);
+        }
+        return true;
+    }
+    return left -> is_signed == right -> is_signed
+        && left -> bits == right -> bits;
+}
+
+// shifts by the width or more give 0, or -1 for a negative signed value
+static bool foldShift(
+    enum ExpretionTypy type,
+    struct Constant       left,
+    struct Constant       right,
+    struct Constant*      res
+) {
+    if (left.type != CONSTANT_INT || right.type != CONSTANT_INT
+     || (right.is_signed && (int64_t) right._int < 0)) {
+        return false;
+    }
+    (*res) = left;
+    uint32_t bits = intBits(left);
+    uint64_t count = right._int;
+    bool negative = left.is_signed && (int64_t) left._int < 0;
+    if (count >= bits) {
+        res -> _int = type == EXPRETION_RIGHT_SHIFT && negative
+            ? wrapInt(UINT64_MAX, left.is_signed, left.bits)
+            : 0;
+        return true;
+    }
+    if (type == EXPRETION_LEFT_SHIFT) {
+        res -> _int = left._int << count;
+    } else if (left.is_signed) {
+        res -> _int = (uint64_t) ((int64_t) left._int >> count);
+    } else {
+        res -> _int = wrapInt(left._int, false, left.bits) >> count;
+    }
+    res -> _int = wrapInt(res -> _int, left.is_signed, left.bits);
+    return true;
+}
+
+static bool foldInt(
+    enum ExpretionTypy type,
+    struct Constant       left,
+    struct Constant       right,
+    struct Constant*      res
+) {
+    (*res) = left;
+    uint64_t a = left._int;
+    uint64_t b = right._int;
+    switch (type) {
+    case EXPRETION_ADD:
+        res -> _int = a + b;
+        break;
+    case EXPRETION_SUBTRACT:
+        res -> _int = a - b;
+        break;
+    case EXPRETION_MULTIPLY:
+        res -> _int = a * b;
+        break;
+    case EXPRETION_DIVIDE:
+    case EXPRETION_MODULO:
+        if (b == 0) {
+            return false;
+        }
+        if (!left.is_signed) {
+            res -> _int = type == EXPRETION_DIVIDE ? a / b : a % b;
+        } else if ((int64_t) a == INT64_MIN && (int64_t) b == -1) {
+            // wraps like the multiplication it undoes
+            res -> _int = type == EXPRETION_DIVIDE ? a : 0;
+        } else {
+            res -> _int = type == EXPRETION_DIVIDE
+                ? (uint64_t) ((int64_t) a / (int64_t) b)
+                : (uint64_t) ((int64_t) a % (int64_t) b);
+        }
+        break;
+    case EXPRETION_BITWIZE_AND:
+        res -> _int = a & b;
+        break;
+    case EXPRETION_BITWIZE_OR:
+        res -> _int = a | b;
+        break;
+    default:
+        return false;
+    }
+    res -> _int = wrapInt(res -> _int, left.is_signed, left.bits);
+    return true;
+}
+
+static bool foldFloat(
+    enum ExpretionTypy type,
+    struct Constant       left,
+    struct Constant       right,
+    struct Constant*      res
+) {
+    (*res) = left;
+    switch (type) {
+    case EXPRETION_ADD:
+        res -> _float = left._float + right._float;
+        break;
+    case EXPRETION_SUBTRACT:
+        res -> _float = left._float - right._float;
+        break;
+    case EXPRETION_MULTIPLY:
+        res -> _float = left._float * right._float;
+        break;
+    case EXPRETION_DIVIDE:
+        res -> _float = left._float / right._float;
+        break;
+    default:
+        return false;
+    }
+    res -> _float = roundFloat(res -> _float, left.bits);
+    return isfinite(res -> _float);
+}
+
+static bool foldBinary(
+    enum ExpretionTypy type,
+    struct Constant       left,
+    struct Constant       right,
+    struct Constant*      res
+) {
+    if (type == EXPRETION_LEFT_SHIFT || type == EXPRETION_RIGHT_SHIFT) {
+        return foldShift(type, left, right, res);
+    }
+    if (left.type == CONSTANT_NONE || !commonType(&left, &right)) {
+        return false;
+    }
+    return left.type == CONSTANT_INT
+        ? foldInt(type, left, right, res)
+        : foldFloat(type, left, right, res);
+}
+
+static bool foldUnary(
+    enum ExpretionTypy type,
+    struct Constant       value,
+    struct Constant*      res
+) {
+    (*res) = value;
+    if (value.type == CONSTANT_INT && type == EXPRETION_NEG) {
+        res -> _int = wrapInt(0 - value._int, value.is_signed, value.bits);
+        return true;
+    }
+    if (value.type == CONSTANT_INT && type == EXPRETION_BITWIZE_NOT) {
+        res -> _int = wrapInt(~value._int, value.is_signed, value.bits);
+        return true;
+    }
+    if (value.type == CONSTANT_FLOAT && type == EXPRETION_NEG) {
+        res -> _float = -value._float;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Rewrites the constant expretion at index to its shortest form: a
+ * literal, -literal, literal as T or -literal as T. The nodes are reused
+ * from the subtree at index, which is dead once it is constant, parents
+ * taking the higher indices. A form that needs more nodes than there are
+ * is not written, the subtree stays as it is.
+ */
+static void writeValue(struct AST* ast, uint32_t index, struct Constant value) {
+    uint32_t slots[3] = { index };
+    uint32_t count = 1;
+    for (uint32_t i = 0; i < count && count < 3; i++) {
+        uint32_t child[2];
+        uint32_t children_count = children(
+            ast -> expretions.items[slots[i]],
+            child
+        );
+        for (uint32_t j = 0; j < children_count && count < 3; j++) {
+            slots[count++] = child[j];
+        }
+    }
+    if (count == 3 && slots[1] < slots[2]) {
+        uint32_t slot = slots[1];
+        slots[1] = slots[2];
+        slots[2] = slot;
+    }
+
+    bool negative;
+    struct Literal literal;
+    if (value.type == CONSTANT_INT) {
+        negative = value.is_signed && (int64_t) value._int < 0;
+        literal = (struct Literal) {
+            .type = LITERAL_INT,
+            ._int = negative ? 0 - value._int : value._int
+        };
+        if (negative && value.cast != NODE_NONE && count < 3) {
+            // the bits as an untyped literal, the cast truncates them
+            negative = false;
+            literal._int = wrapInt(value._int, false, value.bits);
+        }
+    } else {
+        negative = signbit(value._float);
+        if (negative && value.cast != NODE_NONE && count < 3) {
+            return;
+        }
+        literal = (struct Literal) {
+            .type   = LITERAL_FLOAT,
+            ._float = appendFloat(ast, fabsl(value._float))
+        };
+    }
+
+    uint32_t used = 1 + negative + (value.cast != NODE_NONE);
+    if (used > count) {
+        return;
+    }
+    struct Expretion* items = ast -> expretions.items;
+    uint32_t slot = 0;
+    if (value.cast != NODE_NONE) {
+        items[slots[slot]] = (struct Expretion) {
+            .type = EXPRETION_CAST,
+            .expr = slots[slot + 1],
+            .cast = value.cast
+        };
+        slot++;
+    }
+    if (negative) {
+        items[slots[slot]] = (struct Expretion) {
+            .type = EXPRETION_NEG,
+            .expr = slots[slot + 1],
+            .cast = NODE_NONE
+        };
+        slot++;
+    }
+    items[slots[slot]] = (struct Expretion) {
+        .type    = EXPRETION_LITERAL,
+        .literal = literal
+    };
+}
+
+static inline bool isInt(struct Constant value, uint64_t _int) {
+    return value.type == CONSTANT_INT && value._int == _int;
+}
+
+/*
+ * Whether value has the type of constant, so that x op constant has the
+ * type of x. An untyped constant takes the type of the other side. The
+ * type of an expretion that is not constant is only known from its cast.
+ */
+static bool hasTypeOf(struct Constant value, struct Constant constant) {
+    if (constant.cast == NODE_NONE) {
+        return true;
+    }
+    return value.type != CONSTANT_FLOAT
+        && value.cast != NODE_NONE
+        && value.is_signed == constant.is_signed
+        && value.bits == constant.bits;
+}
+
+// x * 0 and x & 0 are 0 of the type of x, so the 0 needs that type
+static inline bool isZeroOf(struct Constant zero, struct Constant value) {
+    return isInt(zero, 0) && zero.cast != NODE_NONE && value.is_pure
+        && hasTypeOf(value, zero);
+}
+
+/*
+ * x + 0, x - 0, x * 1, x / 1, x << 0, x >> 0 and x | 0 are x, x * 0 and
+ * x & 0 are 0 unless x calls something. Only integer constants count,
+ * x + 0.0 is not x for x = -0.0, and only when the result keeps the type
+ * x has: (1 as Int8) * y wraps y to 8 bits. Returns the index of what the
+ * expretion simplifies to, or NODE_NONE.
+ */
+static uint32_t simplify(
+    struct Expretion expr,
+    struct Constant     left,
+    struct Constant     right
+) {
+    switch (expr.type) {
+    case EXPRETION_ADD:
+    case EXPRETION_BITWIZE_OR:
+        if (isInt(left, 0) && hasTypeOf(right, left)) {
+            return expr.right;
+        }
+        return isInt(right, 0) && hasTypeOf(left, right)
+            ? expr.left
+            : NODE_NONE;
+    case EXPRETION_SUBTRACT:
+        return isInt(right, 0) && hasTypeOf(left, right)
+            ? expr.left
+            : NODE_NONE;
+    case EXPRETION_LEFT_SHIFT:
+    case EXPRETION_RIGHT_SHIFT:
+        // the count does not change the type
+        return isInt(right, 0) ? expr.left : NODE_NONE;
+    case EXPRETION_MULTIPLY:
+        if (isInt(left, 1) && hasTypeOf(right, left)) {
+            return expr.right;
+        }
+        if (isInt(right, 1) && hasTypeOf(left, right)) {
+            return expr.left;
+        }
+        if (isZeroOf(left, right)) {
+            return expr.left;
+        }
+        return isZeroOf(right, left) ? expr.right : NODE_NONE;
+    case EXPRETION_DIVIDE:
+        return isInt(right, 1) && hasTypeOf(left, right)
+            ? expr.left
+            : NODE_NONE;
+    case EXPRETION_MODULO:
+        return NODE_NONE;
+    case EXPRETION_BITWIZE_AND:
+        if (isZeroOf(left, right)) {
+            return expr.left;
+        }
+        return isZeroOf(right, left) ? expr.right : NODE_NONE;
+    default:
+        return NODE_NONE;
+    }
+}
+
+static bool isBinary(enum ExpretionTypy type) {
+    switch (type) {
+    case EXPRETION_ADD:
+    case EXPRETION_SUBTRACT:
+    case EXPRETION_MULTIPLY:
+    case EXPRETION_DIVIDE:
+    case EXPRETION_MODULO:
+    case EXPRETION_BITWIZE_OR:
+    case EXPRETION_BITWIZE_AND:
+    case EXPRETION_LEFT_SHIFT:
+    case EXPRETION_RIGHT_SHIFT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static struct Constant foldExpretion(
+    struct AST*   ast,
+    struct Constant* values,
+    uint32_t      index
+) {
+    struct Expretion expr = ast -> expretions.items[index];
+    struct Constant res = {
+        .is_pure = true,
+        .cast    = NODE_NONE
+    };
+    switch (expr.type) {
+    case EXPRETION_LITERAL:
+        if (expr.literal.type == LITERAL_INT) {
+            res.type = CONSTANT_INT;
+            res.is_signed = true;
+            res._int = expr.literal._int;
+        } else if (expr.literal.type == LITERAL_FLOAT) {
+            res._float = roundFloat(
+                ast -> floats.items[expr.literal._float],
+                0
+            );
+            res.type = isfinite(res._float) ? CONSTANT_FLOAT : CONSTANT_NONE;
+        }
+        return res;
+    case EXPRETION_FUNCTION:
+        res.is_pure = false;
+        return res;
+    case EXPRETION_CAST: {
+        struct Constant value = values[expr.expr];
+        struct Type type = ast -> types.items[expr.cast];
+        struct Builtin builtin = builtinType(ast -> symbols, type.name);
+        bool is_number = builtin.type == BUILTIN_INT
+                      || builtin.type == BUILTIN_UINT
+                      || builtin.type == BUILTIN_FLOAT;
+        if (!is_number || type.is_ref || type.args.count != 0) {
+            res.is_pure = value.is_pure;
+            return res;
+        }
+        if (value.type == CONSTANT_NONE) {
+            // not known, but the integer type of it is
+            res.is_pure = value.is_pure;
+            if (builtin.type != BUILTIN_FLOAT) {
+                res.is_signed = builtin.type == BUILTIN_INT;
+                res.bits      = builtin.bits;
+                res.cast      = expr.cast;
+            }
+            return res;
+        }
+        res = castValue(value, builtin, expr.cast);
+        break;
+    }
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+        if (!foldUnary(expr.type, values[expr.expr], &res)) {
+            return (struct Constant) {
+                .is_pure = values[expr.expr].is_pure,
+                .cast    = NODE_NONE
+            };
+        }
+        break;
+    default: {
+        uint32_t child[2] = { 0 };
+        uint32_t count = children(expr, child);
+        for (uint32_t i = 0; i < count; i++) {
+            res.is_pure = res.is_pure && values[child[i]].is_pure;
+        }
+        if (!isBinary(expr.type)) {
+            return res;
+        }
+        struct Constant left = values[expr.left];
+        struct Constant right = values[expr.right];
+        if (foldBinary(expr.type, left, right, &res)) {
+            break;
+        }
+        uint32_t same = simplify(expr, left, right);
+        if (same != NODE_NONE) {
+            ast -> expretions.items[index] = ast -> expretions.items[same];
+            return values[same];
+        }
+        return (struct Constant) {
+            .is_pure = left.is_pure && right.is_pure,
+            .cast    = NODE_NONE
+        };
+    }
+    }
+    if (res.type != CONSTANT_NONE) {
+        writeValue(ast, index, res);
+    }
+    return res;
+}
+
+size_t foldAST(struct AST* ast) {
+    size_t before = countReachable(ast);
+    uint32_t count = ast -> expretions.count;
+    struct Constant* values = memoryAllocKind(
+        MEMORY_EXPRETION,
+        (count + 1) * sizeof(struct Constant)
+    );
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] = foldExpretion(ast, values, i);
+    }
+    memoryFree(values);
+    return before - countReachable(ast);
+}
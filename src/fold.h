@@ -0,0 +1,22 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stddef.h>
+
+#include "ast.h"
+
+/*
+ * Evaluates constant expretions in place and drops identities like x * 1,
+ * x << 0 or x & 0, returns how many expretion nodes are no longer part of
+ * the tree. The dropped nodes stay in AST.expretions, nothing refers to
+ * them anymore.
+ *
+ * Integers wrap around at the width of their type, the type of a constant
+ * is the builtin it was cast to with as, Int for plain literals. Floats are
+ * rounded to the width of their type after every operation. Whatever would
+ * trap or is not a number at runtime, like a division by zero, is left for
+ * runtime.
+ */
+size_t foldAST(struct AST* ast);
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <string.h>
+// for: memcpy
+
+#include "hash.h"
+
+#define PRIME1 11400714785074694791ull
+#define PRIME2 14029467366897019727ull
+#define PRIME3  1609587929392839161ull
+#define PRIME4  9650029242287828579ull
+#define PRIME5  2870177450012600261ull
+
+static inline uint64_t rotate(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* data) {
+    uint64_t res;
+    memcpy(&res, data, sizeof(res));
+    return res;
+}
+
+static inline uint32_t read32(const unsigned char* data) {
+    uint32_t res;
+    memcpy(&res, data, sizeof(res));
+    return res;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotate(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t value) {
+    acc ^= round64(0, value);
+    return acc * PRIME1 + PRIME4;
+}
+
+uint64_t hashBytes(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* now = data;
+    const unsigned char* end = now + length;
+    uint64_t res;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        do {
+            v1 = round64(v1, read64(now));
+            v2 = round64(v2, read64(now + 8));
+            v3 = round64(v3, read64(now + 16));
+            v4 = round64(v4, read64(now + 24));
+            now += 32;
+        } while (now + 32 <= end);
+        res = rotate(v1, 1) + rotate(v2, 7) + rotate(v3, 12) + rotate(v4, 18);
+        res = merge64(res, v1);
+        res = merge64(res, v2);
+        res = merge64(res, v3);
+        res = merge64(res, v4);
+    } else {
+        res = seed + PRIME5;
+    }
+    res += length;
+
+    while (now + 8 <= end) {
+        res ^= round64(0, read64(now));
+        res = rotate(res, 27) * PRIME1 + PRIME4;
+        now += 8;
+    }
+    if (now + 4 <= end) {
+        res ^= (uint64_t) read32(now) * PRIME1;
+        res = rotate(res, 23) * PRIME2 + PRIME3;
+        now += 4;
+    }
+    while (now < end) {
+        res ^= (*now) * PRIME5;
+        res = rotate(res, 11) * PRIME1;
+        now++;
+    }
+
+    res ^= res >> 33;
+    res *= PRIME2;
+    res ^= res >> 29;
+    res *= PRIME3;
+    res ^= res >> 32;
+    return res;
+}
@@ -0,0 +1,13 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * XXH64 of data. Fast on whole source files, which is what it is for;
+ * short names use the FNV hash in symbol.c instead.
+ */
+uint64_t hashBytes(const void* data, size_t length, uint64_t seed);
+
+#endif
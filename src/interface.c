@@ -0,0 +1,413 @@
+#include <stdbool.h>
+// for: bool
+#include <string.h>
+// for: memset
+
+#include "interface.h"
+#include "timing.h"
+
+struct Interface {
+    struct AST*      iface;
+    struct AST*      ast;
+    uint32_t*        symbols;       // ast symbol -> iface symbol
+    uint32_t*        exprs;         // ast expretion -> iface, shared stay so
+
+    NODES(uint32_t)        ids;     // scratch stacks, see their users
+    NODES(struct Type)     types;
+    NODES(struct TypeFild) filds;
+};
+
+static uint32_t copySymbol(struct Interface* interface, uint32_t symbol) {
+    if (symbol == SYMBOL_NONE) {
+        return SYMBOL_NONE;
+    }
+    if (interface -> symbols[symbol] == SYMBOL_NONE) {
+        struct String name = symbolString(interface -> ast -> symbols, symbol);
+        interface -> symbols[symbol] = internSymbol(
+            interface -> iface -> symbols, name.string, name.length);
+    }
+    return interface -> symbols[symbol];
+}
+
+// the names are consecutive again, like the parser leaves them
+static struct Range copyNames(struct Interface* interface, struct Range names) {
+    struct Range res = {
+        .start = interface -> iface -> names.count,
+        .count = names.count
+    };
+    for (uint32_t i = 0; i < names.count; i++) {
+        appendName(interface -> iface, copySymbol(interface,
+            interface -> ast -> names.items[names.start + i]));
+    }
+    return res;
+}
+
+static struct Path copyPath(struct Interface* interface, struct Path path) {
+    path.names = copyNames(interface, path.names);
+    return path;
+}
+
+static struct Type copyType(struct Interface* interface, struct Type type) {
+    uint32_t mark = interface -> types.count;
+    for (uint32_t i = 0; i < type.args.count; i++) {
+        struct Type arg = copyType(interface,
+            interface -> ast -> types.items[type.args.start + i]);
+        pushNode(interface -> types, MEMORY_TYPE, arg);
+    }
+    type.name = copySymbol(interface, type.name);
+    type.args = appendTypes(interface -> iface,
+        &interface -> types.items[mark], type.args.count);
+    interface -> types.count = mark;
+    return type;
+}
+
+static uint32_t copyTypeIndex(struct Interface* interface, uint32_t index) {
+    if (index == NODE_NONE) {
+        return NODE_NONE;
+    }
+    struct Type type = copyType(interface,
+        interface -> ast -> types.items[index]);
+    return appendType(interface -> iface, type);
+}
+
+static struct Range copyFilds(struct Interface* interface, struct Range filds) {
+    uint32_t mark = interface -> filds.count;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct TypeFild fild = interface -> ast -> filds.items[filds.start + i];
+        fild.name = copySymbol(interface, fild.name);
+        fild.type = copyType(interface, fild.type);
+        pushNode(interface -> filds, MEMORY_TYPE, fild);
+    }
+    struct Range res = {
+        .start = interface -> iface -> filds.count,
+        .count = filds.count
+    };
+    for (uint32_t i = 0; i < filds.count; i++) {
+        appendTypeFild(interface -> iface, interface -> filds.items[mark + i]);
+    }
+    interface -> filds.count = mark;
+    return res;
+}
+
+static struct Range copyEnumFilds(
+    struct Interface* interface,
+    struct Range      filds
+) {
+    uint32_t mark = interface -> filds.count;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct EnumFild fild =
+            interface -> ast -> enum_filds.items[filds.start + i];
+        fild.fild.name = copySymbol(interface, fild.fild.name);
+        if (fild.type == ENUM_FILD_TYPED) {
+            fild.fild.type = copyType(interface, fild.fild.type);
+        }
+        pushNode(interface -> filds, MEMORY_TYPE, fild.fild);
+    }
+    struct Range res = {
+        .start = interface -> iface -> enum_filds.count,
+        .count = filds.count
+    };
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct TypeFild fild = interface -> filds.items[mark + i];
+        if (interface -> ast -> enum_filds.items[filds.start + i].type
+                == ENUM_FILD_TYPED) {
+            appendEnumFildTyped(interface -> iface, fild);
+        } else {
+            appendEnumFildUntyped(interface -> iface, fild.name);
+        }
+    }
+    interface -> filds.count = mark;
+    return res;
+}
+
+// whether the tree at index has no more expretion nodes than are left
+static bool fitsNodes(struct AST* ast, uint32_t index, uint32_t* left) {
+    if (index == NODE_NONE) {
+        return true;
+    }
+    if ((*left) == 0) {
+        return false;
+    }
+    (*left)--;
+    struct Expretion expr = ast -> expretions.items[index];
+    switch (expr.type) {
+    case EXPRETION_NONE:
+    case EXPRETION_LITERAL:
+        return true;
+    case EXPRETION_FUNCTION:
+        for (uint32_t i = 0; i < expr.func.args.count; i++) {
+            uint32_t arg = ast -> expretion_lists.items[
+                expr.func.args.start + i
+            ];
+            if (!fitsNodes(ast, arg, left)) {
+                return false;
+            }
+        }
+        return true;
+    case EXPRETION_CAST:
+    case EXPRETION_REF:
+    case EXPRETION_DEREF:
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+    case EXPRETION_LOGICAL_NOT:
+        return fitsNodes(ast, expr.expr, left);
+    default:
+        return fitsNodes(ast, expr.left, left)
+            && fitsNodes(ast, expr.right, left);
+    }
+}
+
+/*
+ * A body can be inlined if it is short and straight: vars, consts,
+ * asignments, calls and returns only, with few expretion nodes in all.
+ * The target a += shares is counted twice, which is fine for a limit.
+ */
+static bool isInlineable(struct AST* ast, struct Range body) {
+    if (body.count > INTERFACE_INLINE_STATEMENTS) {
+        return false;
+    }
+    uint32_t left = INTERFACE_INLINE_NODES;
+    bool res = true;
+    for (uint32_t i = 0; i < body.count && res; i++) {
+        struct Statement statement = ast -> statements.items[
+            ast -> statement_lists.items[body.start + i]
+        ];
+        switch (statement.type) {
+        case STATEMENT_VAR:
+            res = fitsNodes(ast, statement.statement_var.value, &left);
+            break;
+        case STATEMENT_CONST:
+            res = fitsNodes(ast, statement.statement_const.value, &left);
+            break;
+        case STATEMENT_RETURN:
+            res = fitsNodes(ast, statement.statement_return.value, &left);
+            break;
+        case STATEMENT_ASIGN:
+            res = fitsNodes(ast, statement.statement_asign.get_expr, &left)
+               && fitsNodes(ast, statement.statement_asign.value, &left);
+            break;
+        case STATEMENT_CALL:
+            res = fitsNodes(ast, statement.statement_expr, &left);
+            break;
+        default:
+            res = false;
+            break;
+        }
+    }
+    return res;
+}
+
+static struct Literal copyLiteral(
+    struct Interface* interface,
+    struct Literal    literal
+) {
+    switch (literal.type) {
+    case LITERAL_STING:
+        literal.string = copySymbol(interface, literal.string);
+        break;
+    case LITERAL_FLOAT:
+        literal._float = appendFloat(interface -> iface,
+            interface -> ast -> floats.items[literal._float]);
+        break;
+    case LITERAL_INT:
+        break;
+    case LITERAL_NAME:
+        literal.name = copyPath(interface, literal.name);
+        break;
+    }
+    return literal;
+}
+
+// bounded by isInlineable, so the recursion is shallow
+static uint32_t copyExpretion(struct Interface* interface, uint32_t index) {
+    if (index == NODE_NONE) {
+        return NODE_NONE;
+    }
+    if (interface -> exprs[index] != NODE_NONE) {
+        return interface -> exprs[index];
+    }
+    struct AST* ast = interface -> ast;
+    struct Expretion expr = ast -> expretions.items[index];
+    switch (expr.type) {
+    case EXPRETION_NONE:
+        break;
+    case EXPRETION_LITERAL:
+        expr.literal = copyLiteral(interface, expr.literal);
+        break;
+    case EXPRETION_FUNCTION: {
+        uint32_t mark = interface -> ids.count;
+        for (uint32_t i = 0; i < expr.func.args.count; i++) {
+            uint32_t arg = copyExpretion(interface,
+                ast -> expretion_lists.items[expr.func.args.start + i]);
+            pushNode(interface -> ids, MEMORY_OTHER, arg);
+        }
+        expr.func.name = copyPath(interface, expr.func.name);
+        expr.func.args = appendExpretionList(interface -> iface,
+            &interface -> ids.items[mark], expr.func.args.count);
+        interface -> ids.count = mark;
+        break;
+    }
+    case EXPRETION_CAST:
+        expr.cast = copyTypeIndex(interface, expr.cast);
+        expr.expr = copyExpretion(interface, expr.expr);
+        break;
+    case EXPRETION_REF:
+    case EXPRETION_DEREF:
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+    case EXPRETION_LOGICAL_NOT:
+        expr.expr = copyExpretion(interface, expr.expr);
+        break;
+    default:
+        expr.left = copyExpretion(interface, expr.left);
+        expr.right = copyExpretion(interface, expr.right);
+        break;
+    }
+    interface -> exprs[index] = pushNode(interface -> iface -> expretions,
+        MEMORY_EXPRETION, expr);
+    return interface -> exprs[index];
+}
+
+static uint32_t copyStatement(struct Interface* interface, uint32_t index) {
+    struct Statement statement = interface -> ast -> statements.items[index];
+    switch (statement.type) {
+    case STATEMENT_VAR: {
+        struct StatementVar* var = &statement.statement_var;
+        var -> name = copySymbol(interface, var -> name);
+        var -> type = copyTypeIndex(interface, var -> type);
+        var -> value = copyExpretion(interface, var -> value);
+        break;
+    }
+    case STATEMENT_CONST: {
+        struct StatementConst* _const = &statement.statement_const;
+        _const -> name = copySymbol(interface, _const -> name);
+        _const -> value = copyExpretion(interface, _const -> value);
+        break;
+    }
+    case STATEMENT_RETURN:
+        statement.statement_return.value = copyExpretion(interface,
+            statement.statement_return.value);
+        break;
+    case STATEMENT_ASIGN: {
+        struct StatementAsign* asign = &statement.statement_asign;
+        asign -> get_expr = copyExpretion(interface, asign -> get_expr);
+        asign -> var_name = copySymbol(interface, asign -> var_name);
+        asign -> value = copyExpretion(interface, asign -> value);
+        break;
+    }
+    case STATEMENT_CALL:
+        statement.statement_expr = copyExpretion(interface,
+            statement.statement_expr);
+        break;
+    default:
+        // isInlineable lets no other statement through
+        break;
+    }
+    return pushNode(interface -> iface -> statements, MEMORY_STATEMENT,
+        statement);
+}
+
+static struct Range copyBody(struct Interface* interface, struct Range body) {
+    if (!isInlineable(interface -> ast, body)) {
+        return (struct Range) { 0 };
+    }
+    uint32_t mark = interface -> ids.count;
+    for (uint32_t i = 0; i < body.count; i++) {
+        uint32_t statement = copyStatement(interface,
+            interface -> ast -> statement_lists.items[body.start + i]);
+        pushNode(interface -> ids, MEMORY_OTHER, statement);
+    }
+    struct Range res = appendStatementList(interface -> iface,
+        &interface -> ids.items[mark], body.count);
+    interface -> ids.count = mark;
+    return res;
+}
+
+static struct TypeHeader copyHeader(
+    struct Interface* interface,
+    struct TypeHeader header
+) {
+    header.name = copySymbol(interface, header.name);
+    header.params = copyNames(interface, header.params);
+    return header;
+}
+
+static void copyTypeDecl(struct Interface* interface, struct TypeDecl decl) {
+    decl.header = copyHeader(interface, decl.header);
+    switch (decl.type) {
+    case TYPE_TYPE:
+        decl._type = copyType(interface, decl._type);
+        break;
+    case TYPE_STRUCT:
+        decl._struct = copyFilds(interface, decl._struct);
+        break;
+    case TYPE_UNION:
+        decl._union = copyFilds(interface, decl._union);
+        break;
+    case TYPE_ENUM:
+        decl._enum = copyEnumFilds(interface, decl._enum);
+        break;
+    }
+    addTypeDecl(interface -> iface, decl);
+}
+
+static void copyFunc(struct Interface* interface, struct FuncDecl func) {
+    if (func.has_self) {
+        func.self.name = copySymbol(interface, func.self.name);
+        func.self.type = copyHeader(interface, func.self.type);
+    }
+    func.name = copySymbol(interface, func.name);
+    func.args = copyFilds(interface, func.args);
+    func.result = copyTypeIndex(interface, func.result);
+    func.body = copyBody(interface, func.body);
+    addFunc(interface -> iface, func);
+}
+
+void buildInterface(struct AST* iface, struct AST* ast) {
+    timeBegin("interface");
+    uint32_t symbols = ast -> symbols -> count;
+    uint32_t exprs = ast -> expretions.count;
+    struct Interface interface = {
+        .iface   = iface,
+        .ast     = ast,
+        .symbols = memoryAlloc((symbols + 1) * sizeof(uint32_t)),
+        .exprs   = memoryAllocKind(MEMORY_EXPRETION,
+            (exprs + 1) * sizeof(uint32_t))
+    };
+    memset(interface.symbols, 0xff, (symbols + 1) * sizeof(uint32_t));
+    memset(interface.exprs, 0xff, (exprs + 1) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < ast -> decls.count; i++) {
+        struct Decl decl = ast -> decls.items[i];
+        switch (decl.type) {
+        case AST_IMPORT: {
+            struct Import import = ast -> imports.items[decl.index];
+            if (import.is_rename) {
+                import.as = copySymbol(&interface, import.as);
+            }
+            import.path = copyPath(&interface, import.path);
+            addImport(iface, import);
+            break;
+        }
+        case AST_TYPE:
+            if (ast -> type_decls.items[decl.index].is_exported) {
+                copyTypeDecl(&interface, ast -> type_decls.items[decl.index]);
+            }
+            break;
+        case AST_FUNC:
+            if (ast -> funcs.items[decl.index].is_exported) {
+                copyFunc(&interface, ast -> funcs.items[decl.index]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    memoryFree(interface.symbols);
+    memoryFree(interface.exprs);
+    memoryFree(interface.ids.items);
+    memoryFree(interface.types.items);
+    memoryFree(interface.filds.items);
+    timeEnd();
+}
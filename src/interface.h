@@ -0,0 +1,22 @@
+#ifndef INTERFACE_H
+#define INTERFACE_H
+
+#include "ast.h"
+
+// statements and expretion nodes of a body kept for inlining, at most
+#define INTERFACE_INLINE_STATEMENTS 4
+#define INTERFACE_INLINE_NODES      32
+
+/*
+ * What importers see of ast, into iface, which is freshly initialized with
+ * symbols of its own: the imports, the exported types and the signatures
+ * of the exported funcs. A body is kept only if it can be inlined, a few
+ * statements without control flow, other funcs have an empty one. cfuncs,
+ * tests and everything not exported are left out.
+ *
+ * The declarations keep their order, so the interface prints like a file
+ * that only declares them.
+ */
+void buildInterface(struct AST* iface, struct AST* ast);
+
+#endif
@@ -0,0 +1,1677 @@
+#include <ctype.h>
+// for: tolower
+#include <inttypes.h>
+// for: PRId64, PRIu64
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <stdio.h>
+// for: fprintf, fputc, fputs, vsnprintf
+#include <string.h>
+// for: memcmp, memmove, memset
+
+#include "ast.h"
+#include "builtin.h"
+#include "bytecode.h"
+#include "ir.h"
+#include "memory.h"
+#include "timing.h"
+
+#define IR_ERROR "Compile error"
+
+// what an import of path gives, like the natives of bytecode.c
+static const struct {
+    const char* path;
+    bool        is_value;
+    uint32_t    native;             // enum Native, or the stream of a value
+    uint32_t    args;
+} natives[] = {
+    { "Cosole.stdout", true,  VM_STDOUT,     0 },
+    { "Cosole.stderr", true,  VM_STDERR,     0 },
+    { "File.write",    false, NATIVE_WRITE,  2 },
+    { "Test.assert",   false, NATIVE_ASSERT, 1 },
+};
+
+#define NATIVE_COUNT (sizeof(natives) / sizeof(natives[0]))
+
+static const char* const op_names[] = {
+#define IR_OP_NAME(name) #name,
+    IR_OPS(IR_OP_NAME)
+#undef IR_OP_NAME
+};
+
+struct IrKind {
+    uint8_t type;                   // enum IrType
+    uint8_t bits;
+};
+
+struct Local {
+    uint32_t      name;             // SYMBOL_NONE for the counter of repead
+    struct IrKind kind;
+};
+
+/*
+ * An expretion being lowered. state counts the children already lowered,
+ * && and || keep their left value, its truth and the block they join in.
+ */
+struct Work {
+    uint32_t expr;
+    uint32_t state;
+    uint32_t left;
+    uint32_t condition;
+    uint32_t join;
+};
+
+/*
+ * Control flow is structured, so the value every local has at the end of
+ * a block is known once the block ends and blocks that join get a phi
+ * for each local that differs between their predecessors. Loop headers
+ * get a phi for every local up front, the ones that turn out trivial are
+ * removed at the end.
+ */
+struct Build {
+    struct AST*         ast;
+    struct IrModule*    module;
+    struct IrFunction*  function;
+    uint32_t            index;      // of function
+    struct Error*       error;
+    jmp_buf             bail;
+
+    uint32_t*           by_symbol;  // name -> IrModule.functions + 1
+    uint8_t*            queued;     // IrModule.functions
+    NODES(uint32_t)     queue;      // IrModule.functions still to build
+    uint32_t            block;      // being filled
+    NODES(struct Local) locals;
+    NODES(uint32_t)     defs;       // the value of every local
+    NODES(uint32_t)     exits;      // block -> saved, the defs at its end
+    NODES(uint32_t)     saved;
+    NODES(struct Work)  work;       // see lowerExpretion
+    NODES(uint32_t)     values;     // of the expretions lowered
+    NODES(uint32_t)     cases;      // blocks, see lowerSwitch
+};
+
+static _Noreturn __attribute__((format(printf, 2, 3))) void errorBuild(
+    struct Build* build,
+    const char*   format,
+    ...
+) {
+    char message[192];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+
+    if (build -> function -> name == SYMBOL_NONE) {
+        setError(build -> error, IR_ERROR, build -> module -> path, 0,
+            "%s, in a test", message);
+    } else {
+        struct String name = symbolString(build -> ast -> symbols,
+            build -> function -> name);
+        setError(build -> error, IR_ERROR, build -> module -> path, 0,
+            "%s, in func %.*s", message, (int) name.length, name.string);
+    }
+    longjmp(build -> bail, 1);
+}
+
+static inline struct String nameOf(struct Build* build, uint32_t symbol) {
+    return symbolString(build -> ast -> symbols, symbol);
+}
+
+static inline struct IrKind kindOf(struct Build* build, uint32_t value) {
+    struct IrInstr* instr = &build -> function -> instrs.items[value];
+    return (struct IrKind) { .type = instr -> type, .bits = instr -> bits };
+}
+
+static inline bool sameKind(struct IrKind a, struct IrKind b) {
+    return a.type == b.type && a.bits == b.bits;
+}
+
+static inline bool isInteger(struct IrKind kind) {
+    return kind.type == IR_TYPE_INT || kind.type == IR_TYPE_UINT;
+}
+
+// the values the VM can hold, anything else can not be lowered yet
+static struct IrKind kindOfType(struct Build* build, struct Type type) {
+    struct Builtin builtin = builtinType(build -> ast -> symbols, type.name);
+    if (!type.is_ref && type.args.count == 0) {
+        switch (builtin.type) {
+        case BUILTIN_INT:
+            return (struct IrKind) { IR_TYPE_INT, builtin.bits };
+        case BUILTIN_UINT:
+            return (struct IrKind) { IR_TYPE_UINT, builtin.bits };
+        case BUILTIN_FLOAT:
+            // Float128 is computed as wide as Float, like in the VM
+            return (struct IrKind) {
+                IR_TYPE_FLOAT,
+                builtin.bits == 32 ? 32 : 64
+            };
+        case BUILTIN_BOOL:
+            return (struct IrKind) { IR_TYPE_BOOL, 8 };
+        case BUILTIN_STR:
+            return (struct IrKind) { IR_TYPE_STR, 0 };
+        case BUILTIN_NONE:
+            return (struct IrKind) { IR_TYPE_NONE, 0 };
+        default:
+            break;
+        }
+    }
+    struct String name = nameOf(build, type.name);
+    errorBuild(build, "values of type %s%.*s can not be lowered yet",
+        type.is_ref ? "ref " : "", (int) name.length, name.string);
+}
+
+static struct IrKind resultOf(struct Build* build, uint32_t result) {
+    if (result == NODE_NONE) {
+        return (struct IrKind) { IR_TYPE_NONE, 0 };
+    }
+    return kindOfType(build, build -> ast -> types.items[result]);
+}
+
+static uint32_t newBlock(struct Build* build) {
+    struct IrBlock block = { 0 };
+    pushNode(build -> exits, MEMORY_IR, NODE_NONE);
+    return pushNode(build -> function -> blocks, MEMORY_IR, block);
+}
+
+static uint32_t emit(struct Build* build, struct IrInstr instr) {
+    struct IrFunction* function = build -> function;
+    instr.block = build -> block;
+    uint32_t index = pushNode(function -> instrs, MEMORY_IR, instr);
+    pushNode(function -> blocks.items[build -> block].code, MEMORY_IR, index);
+    return index;
+}
+
+static uint32_t emitConst(
+    struct Build* build,
+    struct IrKind kind,
+    uint64_t      value
+) {
+    return emit(build, (struct IrInstr) {
+        .op    = IR_CONST,
+        .type  = kind.type,
+        .bits  = kind.bits,
+        ._uint = value
+    });
+}
+
+static uint32_t emitUnary(
+    struct Build* build,
+    enum IrOp     op,
+    struct IrKind kind,
+    uint32_t      a
+) {
+    return emit(build, (struct IrInstr) {
+        .op   = op,
+        .type = kind.type,
+        .bits = kind.bits,
+        .a    = a
+    });
+}
+
+static uint32_t emitBinary(
+    struct Build* build,
+    enum IrOp     op,
+    struct IrKind kind,
+    uint32_t      a,
+    uint32_t      b
+) {
+    return emit(build, (struct IrInstr) {
+        .op   = op,
+        .type = kind.type,
+        .bits = kind.bits,
+        .a    = a,
+        .b    = b
+    });
+}
+
+// the defs at the end of the block, what its successors start from
+static void terminate(struct Build* build, struct IrInstr instr) {
+    struct IrFunction* function = build -> function;
+    build -> exits.items[build -> block] = build -> saved.count;
+    for (uint32_t i = 0; i < build -> defs.count; i++) {
+        pushNode(build -> saved, MEMORY_IR, build -> defs.items[i]);
+    }
+    uint32_t index = emit(build, instr);
+    uint32_t targets[2];
+    uint32_t count = irSuccessors(&function -> instrs.items[index], targets);
+    for (uint32_t i = 0; i < count; i++) {
+        pushNode(function -> blocks.items[targets[i]].preds, MEMORY_IR,
+            build -> block);
+    }
+}
+
+static void jump(struct Build* build, uint32_t target) {
+    terminate(build, (struct IrInstr) {
+        .op      = IR_JUMP,
+        .targets = { target }
+    });
+}
+
+static void branch(
+    struct Build* build,
+    uint32_t      condition,
+    uint32_t      then,
+    uint32_t      _else
+) {
+    terminate(build, (struct IrInstr) {
+        .op      = IR_BRANCH,
+        .a       = condition,
+        .targets = { then, _else }
+    });
+}
+
+static uint32_t emitPhi(struct Build* build, struct IrKind kind) {
+    return emit(build, (struct IrInstr) {
+        .op   = IR_PHI,
+        .type = kind.type,
+        .bits = kind.bits,
+        .args = { .start = build -> function -> operands.count }
+    });
+}
+
+static inline uint32_t exitDef(
+    struct Build* build,
+    uint32_t      block,
+    uint32_t      i
+) {
+    return build -> saved.items[build -> exits.items[block] + i];
+}
+
+/*
+ * Continues in block once all of its predecessors ended. A block nothing
+ * jumps to keeps the defs as they are, it is removed in the end anyway.
+ */
+static void startBlock(struct Build* build, uint32_t block) {
+    struct IrFunction* function = build -> function;
+    build -> block = block;
+    struct IrBlock* start = &function -> blocks.items[block];
+    if (start -> preds.count == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < build -> defs.count; i++) {
+        uint32_t first = exitDef(build, start -> preds.items[0], i);
+        bool is_same = true;
+        for (uint32_t j = 1; j < start -> preds.count && is_same; j++) {
+            is_same = exitDef(build, start -> preds.items[j], i) == first;
+        }
+        if (is_same) {
+            build -> defs.items[i] = first;
+            continue;
+        }
+        uint32_t phi = emitPhi(build, build -> locals.items[i].kind);
+        start = &function -> blocks.items[block];
+        for (uint32_t j = 0; j < start -> preds.count; j++) {
+            pushNode(function -> operands, MEMORY_IR,
+                exitDef(build, start -> preds.items[j], i));
+        }
+        function -> instrs.items[phi].args.count = start -> preds.count;
+        build -> defs.items[i] = phi;
+    }
+}
+
+// a loop header, entered by one jump so far, the back edge comes later
+static void startLoop(struct Build* build, uint32_t header) {
+    struct IrFunction* function = build -> function;
+    uint32_t entry = function -> blocks.items[header].preds.items[0];
+    build -> block = header;
+    for (uint32_t i = 0; i < build -> defs.count; i++) {
+        uint32_t phi = emitPhi(build, build -> locals.items[i].kind);
+        pushNode(function -> operands, MEMORY_IR, exitDef(build, entry, i));
+        pushNode(function -> operands, MEMORY_IR, NODE_NONE);
+        function -> instrs.items[phi].args.count = 1;
+        build -> defs.items[i] = phi;
+    }
+}
+
+// fills the phis of startLoop with what the locals are at the back edge
+static void closeLoop(struct Build* build, uint32_t header, uint32_t latch) {
+    struct IrFunction* function = build -> function;
+    struct IrBlock* block = &function -> blocks.items[header];
+    for (uint32_t i = 0; i < block -> code.count; i++) {
+        struct IrInstr* phi = &function -> instrs.items[block -> code.items[i]];
+        if (phi -> op != IR_PHI) {
+            break;
+        }
+        function -> operands.items[phi -> args.start + 1] =
+            exitDef(build, latch, i);
+        phi -> args.count = 2;
+    }
+}
+
+static void pushLocal(
+    struct Build* build,
+    uint32_t      name,
+    struct IrKind kind,
+    uint32_t      value
+) {
+    struct Local local = {
+        .name = name,
+        .kind = kind
+    };
+    pushNode(build -> locals, MEMORY_IR, local);
+    pushNode(build -> defs, MEMORY_IR, value);
+}
+
+// the innermost local called name, or NODE_NONE
+static uint32_t findLocal(struct Build* build, uint32_t name) {
+    for (uint32_t i = build -> locals.count; i > 0; i--) {
+        if (build -> locals.items[i - 1].name == name) {
+            return i - 1;
+        }
+    }
+    return NODE_NONE;
+}
+
+static uint32_t findNative(struct Build* build, struct Path path) {
+    path = importedPath(build -> ast, path);
+    for (uint32_t i = 0; i < NATIVE_COUNT; i++) {
+        if (pathIs(build -> ast, path, natives[i].path)) {
+            return i;
+        }
+    }
+    return NATIVE_COUNT;
+}
+
+static _Noreturn void errorUnknownName(struct Build* build, struct Path path) {
+    struct String name = nameOf(build, build -> ast -> names.items[
+        path.names.start + path.names.count - 1
+    ]);
+    errorBuild(build, "unknown name '%.*s'", (int) name.length, name.string);
+}
+
+static const char* kindName(struct IrKind kind) {
+    switch (kind.type) {
+    case IR_TYPE_BOOL:  return "Bool";
+    case IR_TYPE_INT:   return "an integer";
+    case IR_TYPE_UINT:  return "an integer";
+    case IR_TYPE_FLOAT: return "a Float";
+    case IR_TYPE_STR:   return "a Str";
+    case IR_TYPE_FILE:  return "a File";
+    default:            return "None";
+    }
+}
+
+// value as kind, numbers and Bool convert like the CAST of the VM
+static uint32_t convert(
+    struct Build* build,
+    uint32_t      value,
+    struct IrKind kind
+) {
+    struct IrKind from = kindOf(build, value);
+    if (sameKind(from, kind)) {
+        return value;
+    }
+    bool is_number = isInteger(from)
+                  || from.type == IR_TYPE_FLOAT
+                  || from.type == IR_TYPE_BOOL;
+    bool to_number = isInteger(kind)
+                  || kind.type == IR_TYPE_FLOAT
+                  || kind.type == IR_TYPE_BOOL;
+    if (!is_number || !to_number
+     || (from.type == IR_TYPE_BOOL && kind.type == IR_TYPE_FLOAT)) {
+        errorBuild(build, "%s can not be converted to %s", kindName(from),
+            kindName(kind));
+    }
+    return emitUnary(build, IR_CAST, kind, value);
+}
+
+static uint32_t truthOf(struct Build* build, uint32_t value) {
+    struct IrKind kind = kindOf(build, value);
+    if (kind.type == IR_TYPE_FLOAT || isInteger(kind)) {
+        return emitUnary(build, IR_CAST, (struct IrKind) { IR_TYPE_BOOL, 8 },
+            value);
+    }
+    if (kind.type != IR_TYPE_BOOL) {
+        errorBuild(build, "%s is not true or false", kindName(kind));
+    }
+    return value;
+}
+
+static uint32_t lowerLiteral(struct Build* build, struct Literal literal) {
+    switch (literal.type) {
+    case LITERAL_INT:
+        return emitConst(build, (struct IrKind) { IR_TYPE_INT, 64 },
+            literal._int);
+    case LITERAL_FLOAT:
+        return emit(build, (struct IrInstr) {
+            .op     = IR_CONST,
+            .type   = IR_TYPE_FLOAT,
+            .bits   = 64,
+            ._float = (double) build -> ast -> floats.items[literal._float]
+        });
+    case LITERAL_STING:
+        return emit(build, (struct IrInstr) {
+            .op     = IR_CONST,
+            .type   = IR_TYPE_STR,
+            .string = literal.string
+        });
+    case LITERAL_NAME:
+        break;
+    }
+    struct Path path = literal.name;
+    if (!path.is_relative && path.names.count == 1) {
+        uint32_t local = findLocal(
+            build,
+            build -> ast -> names.items[path.names.start]
+        );
+        if (local != NODE_NONE) {
+            return build -> defs.items[local];
+        }
+    }
+    uint32_t native = findNative(build, path);
+    if (native == NATIVE_COUNT || !natives[native].is_value) {
+        errorUnknownName(build, path);
+    }
+    return emitConst(build, (struct IrKind) { IR_TYPE_FILE, 0 },
+        natives[native].native);
+}
+
+static void queueFunction(struct Build* build, uint32_t index) {
+    if (!build -> queued[index]) {
+        build -> queued[index] = true;
+        pushNode(build -> queue, MEMORY_IR, index);
+    }
+}
+
+// the funcs without self and the cfuncs, built later if they were not yet
+static uint32_t callFunction(struct Build* build, struct Path path) {
+    if (path.is_relative || path.names.count != 1) {
+        return NODE_NONE;
+    }
+    uint32_t name = build -> ast -> names.items[path.names.start];
+    if (build -> by_symbol[name] == 0) {
+        return NODE_NONE;
+    }
+    queueFunction(build, build -> by_symbol[name] - 1);
+    return build -> by_symbol[name] - 1;
+}
+
+// the params and the result of IrModule.functions[index]
+static struct Range signatureOf(
+    struct Build*  build,
+    uint32_t       index,
+    struct IrKind* result
+) {
+    struct AST* ast = build -> ast;
+    if (index < ast -> funcs.count) {
+        struct FuncDecl func = ast -> funcs.items[index];
+        (*result) = resultOf(build, func.result);
+        return func.args;
+    }
+    struct CFuncDecl cfunc = ast -> cfuncs.items[index - ast -> funcs.count];
+    (*result) = resultOf(build, cfunc.result);
+    return cfunc.args;
+}
+
+// the arguments are the top count values, converted to what is called
+static uint32_t lowerCall(struct Build* build, struct FunctionCall call) {
+    struct AST* ast = build -> ast;
+    uint32_t* values = &build -> values.items[
+        build -> values.count - call.args.count
+    ];
+    uint32_t function = callFunction(build, call.name);
+    uint32_t args;
+    struct IrInstr instr;
+    if (function != NODE_NONE) {
+        struct IrKind result;
+        struct Range params = signatureOf(build, function, &result);
+        args = params.count;
+        for (uint32_t i = 0; i < args && i < call.args.count; i++) {
+            values[i] = convert(build, values[i], kindOfType(
+                build,
+                ast -> filds.items[params.start + i].type
+            ));
+        }
+        instr = (struct IrInstr) {
+            .op   = IR_CALL,
+            .type = result.type,
+            .bits = result.bits,
+            .a    = function
+        };
+    } else {
+        uint32_t native = findNative(build, call.name);
+        if (native == NATIVE_COUNT || natives[native].is_value) {
+            errorUnknownName(build, call.name);
+        }
+        args = natives[native].args;
+        if (natives[native].native == NATIVE_ASSERT && call.args.count == 1) {
+            values[0] = truthOf(build, values[0]);
+        }
+        instr = (struct IrInstr) {
+            .op   = IR_NATIVE,
+            .type = IR_TYPE_NONE,
+            .a    = natives[native].native
+        };
+    }
+    if (args != call.args.count) {
+        struct String name = nameOf(build, ast -> names.items[
+            call.name.names.start + call.name.names.count - 1
+        ]);
+        errorBuild(build, "'%.*s' takes %u arguments, got %u",
+            (int) name.length, name.string, args, call.args.count);
+    }
+    instr.args = (struct Range) {
+        .start = build -> function -> operands.count,
+        .count = call.args.count
+    };
+    for (uint32_t i = 0; i < call.args.count; i++) {
+        pushNode(build -> function -> operands, MEMORY_IR, values[i]);
+    }
+    build -> values.count -= call.args.count;
+    return emit(build, instr);
+}
+
+static enum IrOp opOf(enum ExpretionTypy type) {
+    switch (type) {
+    case EXPRETION_ADD:                 return IR_ADD;
+    case EXPRETION_SUBTRACT:            return IR_SUBTRACT;
+    case EXPRETION_MULTIPLY:            return IR_MULTIPLY;
+    case EXPRETION_DIVIDE:              return IR_DIVIDE;
+    case EXPRETION_MODULO:              return IR_MODULO;
+    case EXPRETION_BITWIZE_OR:          return IR_BITWIZE_OR;
+    case EXPRETION_BITWIZE_AND:         return IR_BITWIZE_AND;
+    case EXPRETION_LEFT_SHIFT:          return IR_LEFT_SHIFT;
+    case EXPRETION_RIGHT_SHIFT:         return IR_RIGHT_SHIFT;
+    case EXPRETION_EQUAL:               return IR_EQUAL;
+    case EXPRETION_NOT_EQUAL:           return IR_NOT_EQUAL;
+    case EXPRETION_LESS_THEN:           return IR_LESS_THEN;
+    case EXPRETION_GREAT_THEN:          return IR_GREAT_THEN;
+    case EXPRETION_LESS_THEN_OR_EQUAL:  return IR_LESS_THEN_OR_EQUAL;
+    case EXPRETION_GREA_THEN_OR_EQUAL:  return IR_GREA_THEN_OR_EQUAL;
+    case EXPRETION_NEG:                 return IR_NEG;
+    case EXPRETION_BITWIZE_NOT:         return IR_BITWIZE_NOT;
+    case EXPRETION_LOGICAL_NOT:         return IR_LOGICAL_NOT;
+    case EXPRETION_CAST:                return IR_CAST;
+    default:                            return IR_NOP;
+    }
+}
+
+static uint32_t lowerUnary(
+    struct Build*    build,
+    struct Expretion expr,
+    uint32_t         value
+) {
+    struct IrKind kind = kindOf(build, value);
+    switch (expr.type) {
+    case EXPRETION_CAST: {
+        struct IrKind to = kindOfType(
+            build,
+            build -> ast -> types.items[expr.cast]
+        );
+        if (!isInteger(to) && to.type != IR_TYPE_FLOAT
+         && to.type != IR_TYPE_BOOL) {
+            errorBuild(build, "only numbers and Bool can be cast");
+        }
+        return convert(build, value, to);
+    }
+    case EXPRETION_LOGICAL_NOT:
+        return emitUnary(build, IR_LOGICAL_NOT,
+            (struct IrKind) { IR_TYPE_BOOL, 8 }, truthOf(build, value));
+    case EXPRETION_NEG:
+        if (!isInteger(kind) && kind.type != IR_TYPE_FLOAT) {
+            errorBuild(build, "%s can not be negated", kindName(kind));
+        }
+        return emitUnary(build, IR_NEG, kind, value);
+    default:
+        if (!isInteger(kind)) {
+            errorBuild(build, "%s has no bits to flip", kindName(kind));
+        }
+        return emitUnary(build, IR_BITWIZE_NOT, kind, value);
+    }
+}
+
+/*
+ * The type of a binary op is the type of the left value, unless it is a
+ * plain Int or Float, then the right one decides, like in the VM. The
+ * operands of comparisons are widened to 64 bits instead, which is how
+ * the VM compares, and shifts keep the type of their count.
+ */
+static uint32_t lowerBinary(
+    struct Build*      build,
+    enum ExpretionTypy type,
+    uint32_t           left,
+    uint32_t           right
+) {
+    enum IrOp op = opOf(type);
+    struct IrKind a = kindOf(build, left);
+    struct IrKind b = kindOf(build, right);
+    struct IrKind kind = a.bits == 64 && a.type != IR_TYPE_UINT ? b : a;
+    bool is_compare = op >= IR_EQUAL && op <= IR_GREA_THEN_OR_EQUAL;
+    bool are_integers = isInteger(a) && isInteger(b);
+    bool are_floats = a.type == IR_TYPE_FLOAT && b.type == IR_TYPE_FLOAT;
+    struct IrKind boolean = { IR_TYPE_BOOL, 8 };
+
+    if (op == IR_LEFT_SHIFT || op == IR_RIGHT_SHIFT) {
+        if (!are_integers) {
+            errorBuild(build, "only integers can be shifted");
+        }
+        return emitBinary(build, op, a, left, right);
+    }
+    if (is_compare && are_integers) {
+        kind.bits = 64;
+    } else if (is_compare && are_floats) {
+        kind = (struct IrKind) { IR_TYPE_FLOAT, 64 };
+    } else if (is_compare && sameKind(a, b)
+            && (a.type == IR_TYPE_STR
+             || (a.type == IR_TYPE_BOOL
+              && (op == IR_EQUAL || op == IR_NOT_EQUAL)))) {
+        return emitBinary(build, op, boolean, left, right);
+    } else if (!are_integers
+            && (!are_floats || op == IR_MODULO
+             || op == IR_BITWIZE_OR || op == IR_BITWIZE_AND)) {
+        errorBuild(build, "%s and %s do not fit the operator", kindName(a),
+            kindName(b));
+    }
+    left = convert(build, left, kind);
+    right = convert(build, right, kind);
+    return emitBinary(build, op, is_compare ? boolean : kind, left, right);
+}
+
+static inline void pushWork(struct Build* build, struct Work work) {
+    pushNode(build -> work, MEMORY_IR, work);
+}
+
+static inline void pushValue(struct Build* build, uint32_t value) {
+    pushNode(build -> values, MEMORY_IR, value);
+}
+
+static inline uint32_t popValue(struct Build* build) {
+    return build -> values.items[--build -> values.count];
+}
+
+/*
+ * The value of root. Nested expretions can be as deep as the parser
+ * allows, so the ones still open are kept on build -> work and their
+ * values on build -> values.
+ */
+static uint32_t lowerExpretion(struct Build* build, uint32_t root) {
+    struct AST* ast = build -> ast;
+    uint32_t mark = build -> work.count;
+    pushWork(build, (struct Work) { .expr = root });
+    while (build -> work.count > mark) {
+        struct Work work = build -> work.items[--build -> work.count];
+        struct Expretion expr = ast -> expretions.items[work.expr];
+        switch (expr.type) {
+        case EXPRETION_NONE:
+            errorBuild(build, "an expretion is missing");
+        case EXPRETION_LITERAL:
+            pushValue(build, lowerLiteral(build, expr.literal));
+            break;
+        case EXPRETION_FUNCTION:
+            if (work.state == 0) {
+                work.state = 1;
+                pushWork(build, work);
+                for (uint32_t i = expr.func.args.count; i > 0; i--) {
+                    pushWork(build, (struct Work) {
+                        .expr = ast -> expretion_lists.items[
+                            expr.func.args.start + i - 1
+                        ]
+                    });
+                }
+            } else {
+                pushValue(build, lowerCall(build, expr.func));
+            }
+            break;
+        case EXPRETION_REF:
+        case EXPRETION_DEREF:
+        case EXPRETION_GET:
+            errorBuild(build, "references and arrays can not be lowered yet");
+        case EXPRETION_CAST:
+        case EXPRETION_NEG:
+        case EXPRETION_BITWIZE_NOT:
+        case EXPRETION_LOGICAL_NOT:
+            if (work.state == 0) {
+                work.state = 1;
+                pushWork(build, work);
+                pushWork(build, (struct Work) { .expr = expr.expr });
+            } else {
+                pushValue(build, lowerUnary(build, expr, popValue(build)));
+            }
+            break;
+        case EXPRETION_LOGICAL_AND:
+        case EXPRETION_LOGICAL_OR:
+            // the left value is the result if it decides it
+            if (work.state == 0) {
+                work.state = 1;
+                pushWork(build, work);
+                pushWork(build, (struct Work) { .expr = expr.left });
+            } else if (work.state == 1) {
+                work.left = popValue(build);
+                work.condition = truthOf(build, work.left);
+                uint32_t right = newBlock(build);
+                work.join = newBlock(build);
+                if (expr.type == EXPRETION_LOGICAL_AND) {
+                    branch(build, work.condition, right, work.join);
+                } else {
+                    branch(build, work.condition, work.join, right);
+                }
+                startBlock(build, right);
+                work.state = 2;
+                pushWork(build, work);
+                pushWork(build, (struct Work) { .expr = expr.right });
+            } else {
+                uint32_t right = popValue(build);
+                uint32_t left = work.left;
+                if (!sameKind(kindOf(build, left), kindOf(build, right))) {
+                    left = work.condition;
+                    right = truthOf(build, right);
+                }
+                jump(build, work.join);
+                startBlock(build, work.join);
+                uint32_t phi = emitPhi(build, kindOf(build, left));
+                pushNode(build -> function -> operands, MEMORY_IR, left);
+                pushNode(build -> function -> operands, MEMORY_IR, right);
+                build -> function -> instrs.items[phi].args.count = 2;
+                pushValue(build, phi);
+            }
+            break;
+        default:
+            if (work.state == 0) {
+                work.state = 1;
+                pushWork(build, work);
+                pushWork(build, (struct Work) { .expr = expr.right });
+                pushWork(build, (struct Work) { .expr = expr.left });
+            } else {
+                uint32_t right = popValue(build);
+                uint32_t left = popValue(build);
+                pushValue(build, lowerBinary(build, expr.type, left, right));
+            }
+            break;
+        }
+    }
+    return popValue(build);
+}
+
+static void lowerStatement(struct Build* build, uint32_t index);
+
+static void lowerBlock(struct Build* build, struct Range block) {
+    uint32_t locals = build -> locals.count;
+    for (uint32_t i = 0; i < block.count; i++) {
+        lowerStatement(
+            build,
+            build -> ast -> statement_lists.items[block.start + i]
+        );
+    }
+    build -> locals.count = locals;
+    build -> defs.count = locals;
+}
+
+static void lowerVar(
+    struct Build* build,
+    uint32_t      name,
+    uint32_t      type,
+    uint32_t      value
+) {
+    uint32_t res = lowerExpretion(build, value);
+    struct IrKind kind = type == NODE_NONE
+        ? kindOf(build, res)
+        : kindOfType(build, build -> ast -> types.items[type]);
+    if (kind.type == IR_TYPE_NONE) {
+        struct String string = nameOf(build, name);
+        errorBuild(build, "'%.*s' can not hold None", (int) string.length,
+            string.string);
+    }
+    pushLocal(build, name, kind, convert(build, res, kind));
+}
+
+// the cases are tested in order, then default runs, they do not fall through
+static void lowerSwitch(struct Build* build, struct StatementSwitch _switch) {
+    struct AST* ast = build -> ast;
+    uint32_t mark = build -> cases.count;
+    uint32_t value = lowerExpretion(build, _switch.value);
+    uint32_t join = newBlock(build);
+    uint32_t other = join;
+    for (uint32_t i = 0; i < _switch.cases.count; i++) {
+        struct StatementSwitchCase _case = ast -> cases.items[
+            _switch.cases.start + i
+        ];
+        uint32_t block = newBlock(build);
+        pushNode(build -> cases, MEMORY_IR, block);
+        if (_case._default) {
+            other = block;
+            continue;
+        }
+        uint32_t equal = lowerBinary(
+            build,
+            EXPRETION_EQUAL,
+            value,
+            lowerLiteral(build, _case._case)
+        );
+        uint32_t next = newBlock(build);
+        branch(build, equal, block, next);
+        startBlock(build, next);
+    }
+    jump(build, other);
+    for (uint32_t i = 0; i < _switch.cases.count; i++) {
+        struct StatementSwitchCase _case = ast -> cases.items[
+            _switch.cases.start + i
+        ];
+        startBlock(build, build -> cases.items[mark + i]);
+        lowerBlock(build, _case.then);
+        jump(build, join);
+    }
+    build -> cases.count = mark;
+    startBlock(build, join);
+}
+
+// a missing condition loops forever
+static void lowerWhile(
+    struct Build* build,
+    uint32_t      condition,
+    struct Range  then
+) {
+    uint32_t header = newBlock(build);
+    uint32_t exit = newBlock(build);
+    jump(build, header);
+    startLoop(build, header);
+    if (condition != NODE_NONE) {
+        uint32_t body = newBlock(build);
+        branch(build, truthOf(build, lowerExpretion(build, condition)), body,
+            exit);
+        startBlock(build, body);
+    }
+    lowerBlock(build, then);
+    uint32_t latch = build -> block;
+    jump(build, header);
+    closeLoop(build, header, latch);
+    startBlock(build, exit);
+}
+
+// counts down a hidden local, which the loop phis carry like any other
+static void lowerRepead(struct Build* build, struct StatementRepead repead) {
+    struct IrKind int_kind = { IR_TYPE_INT, 64 };
+    uint32_t count = convert(
+        build,
+        lowerExpretion(build, repead.condition),
+        int_kind
+    );
+    pushLocal(build, SYMBOL_NONE, int_kind, count);
+    uint32_t counter = build -> locals.count - 1;
+    uint32_t header = newBlock(build);
+    uint32_t body = newBlock(build);
+    uint32_t exit = newBlock(build);
+    jump(build, header);
+    startLoop(build, header);
+    uint32_t more = emitBinary(build, IR_GREAT_THEN,
+        (struct IrKind) { IR_TYPE_BOOL, 8 }, build -> defs.items[counter],
+        emitConst(build, int_kind, 0));
+    branch(build, more, body, exit);
+    startBlock(build, body);
+    build -> defs.items[counter] = emitBinary(build, IR_SUBTRACT, int_kind,
+        build -> defs.items[counter], emitConst(build, int_kind, 1));
+    lowerBlock(build, repead.then);
+    uint32_t latch = build -> block;
+    jump(build, header);
+    closeLoop(build, header, latch);
+    startBlock(build, exit);
+    build -> locals.count--;
+    build -> defs.count--;
+}
+
+static void lowerStatement(struct Build* build, uint32_t index) {
+    struct Statement statement = build -> ast -> statements.items[index];
+    switch (statement.type) {
+    case STATEMENT_NONE:
+        break;
+    case STATEMENT_VAR:
+        lowerVar(
+            build,
+            statement.statement_var.name,
+            statement.statement_var.type,
+            statement.statement_var.value
+        );
+        break;
+    case STATEMENT_CONST:
+        lowerVar(
+            build,
+            statement.statement_const.name,
+            NODE_NONE,
+            statement.statement_const.value
+        );
+        break;
+    case STATEMENT_IF: {
+        struct StatementIf _if = statement.statement_if;
+        uint32_t condition = truthOf(
+            build,
+            lowerExpretion(build, _if.condition)
+        );
+        uint32_t then = newBlock(build);
+        uint32_t join = newBlock(build);
+        uint32_t _else = _if._else.count == 0 ? join : newBlock(build);
+        branch(build, condition, then, _else);
+        startBlock(build, then);
+        lowerBlock(build, _if.then);
+        jump(build, join);
+        if (_if._else.count != 0) {
+            startBlock(build, _else);
+            lowerBlock(build, _if._else);
+            jump(build, join);
+        }
+        startBlock(build, join);
+        break;
+    }
+    case STATEMENT_SWITCH:
+        lowerSwitch(build, statement.statement_switch);
+        break;
+    case STATEMENT_DO: {
+        uint32_t body = newBlock(build);
+        uint32_t exit = newBlock(build);
+        jump(build, body);
+        startLoop(build, body);
+        lowerBlock(build, statement.statement_do.then);
+        uint32_t condition = truthOf(
+            build,
+            lowerExpretion(build, statement.statement_do.condition)
+        );
+        uint32_t latch = build -> block;
+        branch(build, condition, body, exit);
+        closeLoop(build, body, latch);
+        startBlock(build, exit);
+        break;
+    }
+    case STATEMENT_WHILE:
+        lowerWhile(
+            build,
+            statement.statement_while.condition,
+            statement.statement_while.then
+        );
+        break;
+    case STATEMENT_FOR: {
+        // the var lives as long as the loop
+        uint32_t locals = build -> locals.count;
+        lowerStatement(build, statement.statement_for.var);
+        lowerWhile(
+            build,
+            statement.statement_for.condition,
+            statement.statement_for.then
+        );
+        build -> locals.count = locals;
+        build -> defs.count = locals;
+        break;
+    }
+    case STATEMENT_REPEAD:
+        lowerRepead(build, statement.statement_repead);
+        break;
+    case STATEMENT_RETURN: {
+        uint32_t value = NODE_NONE;
+        if (statement.statement_return.value != NODE_NONE) {
+            value = lowerExpretion(build, statement.statement_return.value);
+            struct IrKind result = {
+                build -> function -> result,
+                build -> function -> bits
+            };
+            value = result.type == IR_TYPE_NONE
+                ? NODE_NONE
+                : convert(build, value, result);
+        }
+        terminate(build, (struct IrInstr) { .op = IR_RETURN, .a = value });
+        // what follows is unreachable, it is removed in the end
+        startBlock(build, newBlock(build));
+        break;
+    }
+    case STATEMENT_ASIGN: {
+        struct StatementAsign asign = statement.statement_asign;
+        if (asign.get_expr != NODE_NONE) {
+            errorBuild(build, "references and arrays can not be lowered yet");
+        }
+        uint32_t local = findLocal(build, asign.var_name);
+        if (local == NODE_NONE) {
+            struct String name = nameOf(build, asign.var_name);
+            errorBuild(build, "unknown variable '%.*s'", (int) name.length,
+                name.string);
+        }
+        uint32_t value = lowerExpretion(build, asign.value);
+        build -> defs.items[local] = convert(
+            build,
+            value,
+            build -> locals.items[local].kind
+        );
+        break;
+    }
+    case STATEMENT_CALL:
+        lowerExpretion(build, statement.statement_expr);
+        break;
+    }
+}
+
+static void buildFunction(struct Build* build, uint32_t index) {
+    struct AST* ast = build -> ast;
+    uint32_t funcs = ast -> funcs.count;
+    uint32_t cfuncs = ast -> cfuncs.count;
+    struct IrFunction* function = &build -> module -> functions.items[index];
+    build -> function = function;
+    build -> index = index;
+
+    bool has_self = false;
+    struct Self self = { 0 };
+    struct Range args = { 0 };
+    struct Range body;
+    uint32_t result = NODE_NONE;
+    if (index < funcs) {
+        struct FuncDecl func = ast -> funcs.items[index];
+        if (func.is_external) {
+            errorBuild(build, "external functions can not be lowered");
+        }
+        has_self = func.has_self;
+        self = func.self;
+        args = func.args;
+        body = func.body;
+        result = func.result;
+    } else if (index < funcs + cfuncs) {
+        struct CFuncDecl cfunc = ast -> cfuncs.items[index - funcs];
+        args = cfunc.args;
+        body = cfunc.body;
+        result = cfunc.result;
+    } else {
+        body = ast -> tests.items[index - funcs - cfuncs].body;
+    }
+
+    struct IrKind kind = resultOf(build, result);
+    function -> result = kind.type;
+    function -> bits = kind.bits;
+    build -> locals.count = 0;
+    build -> defs.count = 0;
+    build -> exits.count = 0;
+    build -> saved.count = 0;
+    startBlock(build, newBlock(build));
+
+    uint32_t param = 0;
+    if (has_self) {
+        kind = kindOfType(build, (struct Type) { .name = self.type.name });
+        pushLocal(build, self.name, kind, emit(build, (struct IrInstr) {
+            .op   = IR_PARAM,
+            .type = kind.type,
+            .bits = kind.bits,
+            .a    = param++
+        }));
+    }
+    for (uint32_t i = 0; i < args.count; i++) {
+        struct TypeFild fild = ast -> filds.items[args.start + i];
+        kind = kindOfType(build, fild.type);
+        pushLocal(build, fild.name, kind, emit(build, (struct IrInstr) {
+            .op   = IR_PARAM,
+            .type = kind.type,
+            .bits = kind.bits,
+            .a    = param++
+        }));
+    }
+    lowerBlock(build, body);
+    terminate(build, (struct IrInstr) { .op = IR_RETURN, .a = NODE_NONE });
+
+    irRemoveUnreachable(function);
+    irRemoveTrivialPhis(function);
+}
+
+static void pushFunction(
+    struct IrModule* module,
+    uint32_t         name,
+    uint32_t         params,
+    bool             is_exported
+) {
+    struct IrFunction function = {
+        .name        = name,
+        .params      = params,
+        .is_exported = is_exported
+    };
+    pushNode(module -> functions, MEMORY_IR, function);
+}
+
+bool buildIR(
+    struct IrModule* module,
+    struct AST*      ast,
+    const char*      path,
+    struct Error*    error
+) {
+    timeBegin("ir");
+    (*module) = (struct IrModule) {
+        .path    = path,
+        .symbols = ast -> symbols,
+        .main    = NODE_NONE
+    };
+    struct Build build = {
+        .ast       = ast,
+        .module    = module,
+        .error     = error,
+        .by_symbol = memoryAllocKind(
+            MEMORY_IR,
+            (ast -> symbols -> count + 1) * sizeof(uint32_t)
+        )
+    };
+    memset(
+        build.by_symbol,
+        0,
+        (ast -> symbols -> count + 1) * sizeof(uint32_t)
+    );
+
+    for (uint32_t i = 0; i < ast -> funcs.count; i++) {
+        struct FuncDecl func = ast -> funcs.items[i];
+        pushFunction(module, func.name, func.args.count + func.has_self,
+            func.is_exported);
+        if (!func.has_self) {
+            build.by_symbol[func.name] = i + 1;
+        }
+    }
+    for (uint32_t i = 0; i < ast -> cfuncs.count; i++) {
+        struct CFuncDecl cfunc = ast -> cfuncs.items[i];
+        pushFunction(module, cfunc.name, cfunc.args.count, true);
+        build.by_symbol[cfunc.name] = module -> functions.count;
+    }
+    for (uint32_t i = 0; i < ast -> tests.count; i++) {
+        pushNode(module -> tests, MEMORY_IR, module -> functions.count);
+        pushFunction(module, SYMBOL_NONE, 0, false);
+    }
+
+    build.queued = memoryAllocKind(MEMORY_IR, module -> functions.count + 1);
+    memset(build.queued, 0, module -> functions.count + 1);
+    for (uint32_t i = 0; i < ast -> funcs.count; i++) {
+        struct String name = symbolString(ast -> symbols,
+            ast -> funcs.items[i].name);
+        if (!ast -> funcs.items[i].has_self && name.length == 4
+         && memcmp(name.string, "main", 4) == 0) {
+            module -> main = i;
+            queueFunction(&build, i);
+        }
+    }
+    for (uint32_t i = ast -> funcs.count; i < module -> functions.count; i++) {
+        queueFunction(&build, i);
+    }
+
+    bool res = true;
+    if (setjmp(build.bail) == 0) {
+        for (uint32_t i = 0; i < build.queue.count; i++) {
+            buildFunction(&build, build.queue.items[i]);
+        }
+    } else {
+        res = false;
+    }
+
+    memoryFree(build.by_symbol);
+    memoryFree(build.queued);
+    memoryFree(build.queue.items);
+    memoryFree(build.locals.items);
+    memoryFree(build.defs.items);
+    memoryFree(build.exits.items);
+    memoryFree(build.saved.items);
+    memoryFree(build.work.items);
+    memoryFree(build.values.items);
+    memoryFree(build.cases.items);
+    timeEnd();
+    return res;
+}
+
+void freeIR(struct IrModule* module) {
+    for (uint32_t i = 0; i < module -> functions.count; i++) {
+        struct IrFunction* function = &module -> functions.items[i];
+        for (uint32_t j = 0; j < function -> blocks.count; j++) {
+            memoryFree(function -> blocks.items[j].code.items);
+            memoryFree(function -> blocks.items[j].preds.items);
+        }
+        memoryFree(function -> instrs.items);
+        memoryFree(function -> blocks.items);
+        memoryFree(function -> operands.items);
+    }
+    memoryFree(module -> functions.items);
+    memoryFree(module -> tests.items);
+    (*module) = (struct IrModule) { 0 };
+}
+
+uint32_t irSuccessors(struct IrInstr* terminator, uint32_t* res) {
+    switch (terminator -> op) {
+    case IR_JUMP:
+        res[0] = terminator -> targets[0];
+        return 1;
+    case IR_BRANCH:
+        res[0] = terminator -> targets[0];
+        res[1] = terminator -> targets[1];
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+void irRemoveEdge(struct IrFunction* function, uint32_t pred, uint32_t block) {
+    struct IrBlock* to = &function -> blocks.items[block];
+    uint32_t edge = 0;
+    while (edge < to -> preds.count && to -> preds.items[edge] != pred) {
+        edge++;
+    }
+    if (edge == to -> preds.count) {
+        return;
+    }
+    to -> preds.count--;
+    memmove(&to -> preds.items[edge], &to -> preds.items[edge + 1],
+        (to -> preds.count - edge) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < to -> code.count; i++) {
+        struct IrInstr* phi = &function -> instrs.items[to -> code.items[i]];
+        if (phi -> op != IR_PHI) {
+            continue;
+        }
+        uint32_t* args = &function -> operands.items[phi -> args.start];
+        phi -> args.count--;
+        memmove(&args[edge], &args[edge + 1],
+            (phi -> args.count - edge) * sizeof(uint32_t));
+    }
+}
+
+static void clearBlock(struct IrFunction* function, uint32_t block) {
+    struct IrBlock* dead = &function -> blocks.items[block];
+    for (uint32_t i = 0; i < dead -> code.count; i++) {
+        function -> instrs.items[dead -> code.items[i]].op = IR_NOP;
+    }
+    dead -> code.count = 0;
+    dead -> preds.count = 0;
+}
+
+bool irRemoveUnreachable(struct IrFunction* function) {
+    uint32_t count = function -> blocks.count;
+    if (count == 0) {
+        return false;
+    }
+    uint8_t* reached = memoryAllocKind(MEMORY_IR, count);
+    uint32_t* stack = memoryAllocKind(MEMORY_IR, count * sizeof(uint32_t));
+    memset(reached, 0, count);
+    uint32_t top = 0;
+    stack[top++] = 0;
+    reached[0] = true;
+    while (top > 0) {
+        struct IrBlock* block = &function -> blocks.items[stack[--top]];
+        uint32_t targets[2];
+        uint32_t successors = irSuccessors(
+            &function -> instrs.items[block -> code.items[
+                block -> code.count - 1
+            ]],
+            targets
+        );
+        for (uint32_t i = 0; i < successors; i++) {
+            if (!reached[targets[i]]) {
+                reached[targets[i]] = true;
+                stack[top++] = targets[i];
+            }
+        }
+    }
+
+    bool changed = false;
+    for (uint32_t i = 0; i < count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        if (reached[i] || block -> code.count == 0) {
+            continue;
+        }
+        uint32_t targets[2];
+        uint32_t successors = irSuccessors(
+            &function -> instrs.items[block -> code.items[
+                block -> code.count - 1
+            ]],
+            targets
+        );
+        for (uint32_t j = 0; j < successors; j++) {
+            irRemoveEdge(function, i, targets[j]);
+        }
+        clearBlock(function, i);
+        changed = true;
+    }
+    memoryFree(reached);
+    memoryFree(stack);
+    return changed;
+}
+
+static inline uint32_t findReplaced(uint32_t* replaced, uint32_t value) {
+    while (value != NODE_NONE && replaced[value] != NODE_NONE) {
+        value = replaced[value];
+    }
+    return value;
+}
+
+void irReplaceUses(struct IrFunction* function, uint32_t* replaced) {
+    for (uint32_t i = 0; i < function -> blocks.count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        for (uint32_t j = 0; j < block -> code.count; j++) {
+            struct IrInstr* instr = &function -> instrs.items[
+                block -> code.items[j]
+            ];
+            uint32_t* operands[2];
+            uint32_t count = irFixedOperands(instr, operands);
+            for (uint32_t k = 0; k < count; k++) {
+                (*operands[k]) = findReplaced(replaced, *operands[k]);
+            }
+            if (instr -> op == IR_PHI || instr -> op == IR_CALL
+             || instr -> op == IR_NATIVE) {
+                uint32_t* args = &function -> operands.items[
+                    instr -> args.start
+                ];
+                for (uint32_t k = 0; k < instr -> args.count; k++) {
+                    args[k] = findReplaced(replaced, args[k]);
+                }
+            }
+        }
+    }
+}
+
+void irCompact(struct IrFunction* function) {
+    for (uint32_t i = 0; i < function -> blocks.count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        uint32_t count = 0;
+        for (uint32_t j = 0; j < block -> code.count; j++) {
+            uint32_t instr = block -> code.items[j];
+            if (function -> instrs.items[instr].op != IR_NOP) {
+                block -> code.items[count++] = instr;
+            }
+        }
+        block -> code.count = count;
+    }
+}
+
+uint32_t* irNewReplaced(struct IrFunction* function) {
+    uint32_t* replaced = memoryAllocKind(
+        MEMORY_IR,
+        (function -> instrs.count + 1) * sizeof(uint32_t)
+    );
+    memset(replaced, 0xff, (function -> instrs.count + 1) * sizeof(uint32_t));
+    return replaced;
+}
+
+bool irRemoveTrivialPhis(struct IrFunction* function) {
+    uint32_t* replaced = irNewReplaced(function);
+    bool changed = false;
+    bool again = true;
+    while (again) {
+        again = false;
+        for (uint32_t i = 0; i < function -> blocks.count; i++) {
+            struct IrBlock* block = &function -> blocks.items[i];
+            for (uint32_t j = 0; j < block -> code.count; j++) {
+                uint32_t index = block -> code.items[j];
+                struct IrInstr* phi = &function -> instrs.items[index];
+                if (phi -> op != IR_PHI) {
+                    continue;
+                }
+                // phi(x, .., x) and phi(x, phi, ..) are x
+                uint32_t same = NODE_NONE;
+                bool is_trivial = true;
+                for (uint32_t k = 0; k < phi -> args.count; k++) {
+                    uint32_t arg = findReplaced(
+                        replaced,
+                        function -> operands.items[phi -> args.start + k]
+                    );
+                    if (arg == index || arg == same) {
+                        continue;
+                    }
+                    if (same != NODE_NONE) {
+                        is_trivial = false;
+                        break;
+                    }
+                    same = arg;
+                }
+                if (is_trivial && same != NODE_NONE) {
+                    replaced[index] = same;
+                    phi -> op = IR_NOP;
+                    again = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+    if (changed) {
+        irReplaceUses(function, replaced);
+        irCompact(function);
+    }
+    memoryFree(replaced);
+    return changed;
+}
+
+uint32_t irReversePostorder(struct IrFunction* function, uint32_t* order) {
+    uint32_t blocks = function -> blocks.count;
+    // depth first with the successor to visit next kept on the stack
+    uint32_t* stack = memoryAllocKind(MEMORY_IR, blocks * sizeof(uint32_t));
+    uint8_t* next = memoryAllocKind(MEMORY_IR, blocks);
+    memset(next, 0xff, blocks);
+    uint32_t top = 0;
+    uint32_t count = 0;
+    stack[top++] = 0;
+    next[0] = 0;
+    while (top > 0) {
+        uint32_t block = stack[top - 1];
+        struct IrBlock* now = &function -> blocks.items[block];
+        uint32_t targets[2];
+        uint32_t successors = irSuccessors(
+            &function -> instrs.items[now -> code.items[now -> code.count - 1]],
+            targets
+        );
+        if (next[block] < successors) {
+            uint32_t target = targets[next[block]++];
+            if (next[target] == 0xff) {
+                next[target] = 0;
+                stack[top++] = target;
+            }
+            continue;
+        }
+        order[count++] = block;
+        top--;
+    }
+    for (uint32_t i = 0; i < count / 2; i++) {
+        uint32_t block = order[i];
+        order[i] = order[count - 1 - i];
+        order[count - 1 - i] = block;
+    }
+    memoryFree(stack);
+    memoryFree(next);
+    return count;
+}
+
+void irSplitCriticalEdges(struct IrFunction* function) {
+    uint32_t blocks = function -> blocks.count;
+    for (uint32_t i = 0; i < blocks; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        if (block -> code.count == 0) {
+            continue;
+        }
+        uint32_t terminator = block -> code.items[block -> code.count - 1];
+        if (function -> instrs.items[terminator].op != IR_BRANCH) {
+            continue;
+        }
+        for (uint32_t j = 0; j < 2; j++) {
+            uint32_t target = function -> instrs.items[terminator].targets[j];
+            struct IrBlock* to = &function -> blocks.items[target];
+            if (to -> preds.count < 2 || function -> instrs.items[
+                to -> code.items[0]
+            ].op != IR_PHI) {
+                continue;
+            }
+            struct IrBlock edge = { 0 };
+            uint32_t split = pushNode(function -> blocks, MEMORY_IR, edge);
+            struct IrInstr jump = {
+                .op      = IR_JUMP,
+                .block   = split,
+                .targets = { target }
+            };
+            uint32_t index = pushNode(function -> instrs, MEMORY_IR, jump);
+            pushNode(function -> blocks.items[split].code, MEMORY_IR, index);
+            pushNode(function -> blocks.items[split].preds, MEMORY_IR, i);
+            to = &function -> blocks.items[target];
+            for (uint32_t k = 0; k < to -> preds.count; k++) {
+                if (to -> preds.items[k] == i) {
+                    to -> preds.items[k] = split;
+                    break;
+                }
+            }
+            function -> instrs.items[terminator].targets[j] = split;
+        }
+    }
+}
+
+size_t irCount(struct IrModule* module) {
+    size_t res = 0;
+    for (uint32_t i = 0; i < module -> functions.count; i++) {
+        struct IrFunction* function = &module -> functions.items[i];
+        for (uint32_t j = 0; j < function -> blocks.count; j++) {
+            res += function -> blocks.items[j].code.count;
+        }
+    }
+    return res;
+}
+
+static void printKind(FILE* stream, uint8_t type, uint8_t bits) {
+    switch (type) {
+    case IR_TYPE_NONE:  fputs("None", stream);  return;
+    case IR_TYPE_BOOL:  fputs("Bool", stream);  return;
+    case IR_TYPE_STR:   fputs("Str", stream);   return;
+    case IR_TYPE_FILE:  fputs("File", stream);  return;
+    case IR_TYPE_INT:   fputs("Int", stream);   break;
+    case IR_TYPE_UINT:  fputs("Uint", stream);  break;
+    case IR_TYPE_FLOAT: fputs("Float", stream); break;
+    }
+    if (bits != 64) {
+        fprintf(stream, "%u", bits);
+    }
+}
+
+static void printOpName(FILE* stream, enum IrOp op) {
+    for (const char* now = op_names[op]; *now != 0; now++) {
+        fputc(tolower((unsigned char) *now), stream);
+    }
+}
+
+static void printConst(
+    FILE*            stream,
+    struct IrModule* module,
+    struct IrInstr   instr
+) {
+    switch (instr.type) {
+    case IR_TYPE_INT:
+        fprintf(stream, "%" PRId64, (int64_t) instr._uint);
+        return;
+    case IR_TYPE_FLOAT:
+        fprintf(stream, "%.17g", instr._float);
+        return;
+    case IR_TYPE_STR: {
+        struct String string = symbolString(module -> symbols, instr.string);
+        fputc('"', stream);
+        for (size_t i = 0; i < string.length; i++) {
+            unsigned char ch = string.string[i];
+            if (ch == '"' || ch == '\\') {
+                fprintf(stream, "\\%c", ch);
+            } else if (ch == '\n') {
+                fputs("\\n", stream);
+            } else if (ch < 0x20 || ch >= 0x7f) {
+                fprintf(stream, "\\x%02x", ch);
+            } else {
+                fputc(ch, stream);
+            }
+        }
+        fputc('"', stream);
+        return;
+    }
+    case IR_TYPE_BOOL:
+        fputs(instr._uint ? "true" : "false", stream);
+        return;
+    case IR_TYPE_FILE:
+        fputs(instr._uint == VM_STDERR ? "stderr" : "stdout", stream);
+        return;
+    default:
+        fprintf(stream, "%" PRIu64, instr._uint);
+        return;
+    }
+}
+
+static void printInstr(
+    FILE*              stream,
+    struct IrModule*   module,
+    struct IrFunction* function,
+    uint32_t           index
+) {
+    struct IrInstr instr = function -> instrs.items[index];
+    fputs("    ", stream);
+    if (instr.type != IR_TYPE_NONE && !irIsTerminator(instr.op)) {
+        fprintf(stream, "v%u ", index);
+        printKind(stream, instr.type, instr.bits);
+        fputs(" = ", stream);
+    }
+    printOpName(stream, instr.op);
+    switch (instr.op) {
+    case IR_CONST:
+        fputs(" ", stream);
+        printConst(stream, module, instr);
+        break;
+    case IR_PARAM:
+        fprintf(stream, " %u", instr.a);
+        break;
+    case IR_JUMP:
+        fprintf(stream, " b%u", instr.targets[0]);
+        break;
+    case IR_BRANCH:
+        fprintf(stream, " v%u, b%u, b%u", instr.a, instr.targets[0],
+            instr.targets[1]);
+        break;
+    case IR_CALL: {
+        uint32_t name = module -> functions.items[instr.a].name;
+        struct String string = symbolString(module -> symbols, name);
+        fprintf(stream, " %.*s", (int) string.length, string.string);
+        break;
+    }
+    case IR_NATIVE:
+        fputs(instr.a == NATIVE_WRITE ? " write" : " assert", stream);
+        break;
+    default: {
+        uint32_t* operands[2];
+        uint32_t count = irFixedOperands(&instr, operands);
+        for (uint32_t i = 0; i < count; i++) {
+            fprintf(stream, "%sv%u", i == 0 ? " " : ", ", *operands[i]);
+        }
+        break;
+    }
+    }
+    if (instr.op == IR_PHI || instr.op == IR_CALL || instr.op == IR_NATIVE) {
+        fputs(instr.op == IR_PHI ? " " : "(", stream);
+        for (uint32_t i = 0; i < instr.args.count; i++) {
+            fprintf(stream, "%sv%u", i == 0 ? "" : ", ",
+                function -> operands.items[instr.args.start + i]);
+        }
+        fputs(instr.op == IR_PHI ? "" : ")", stream);
+    }
+    fputs("\n", stream);
+}
+
+static void printFunction(
+    FILE*              stream,
+    struct IrModule*   module,
+    uint32_t           index
+) {
+    struct IrFunction* function = &module -> functions.items[index];
+    if (function -> blocks.count == 0) {
+        return;
+    }
+    if (function -> name == SYMBOL_NONE) {
+        uint32_t test = 0;
+        while (module -> tests.items[test] != index) {
+            test++;
+        }
+        fprintf(stream, "test %u", test + 1);
+    } else {
+        struct String name = symbolString(module -> symbols, function -> name);
+        fprintf(stream, "func %.*s(%u) ", (int) name.length, name.string,
+            function -> params);
+        printKind(stream, function -> result, function -> bits);
+    }
+    fputs(" {\n", stream);
+    for (uint32_t i = 0; i < function -> blocks.count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        if (block -> code.count == 0) {
+            continue;
+        }
+        fprintf(stream, "b%u:", i);
+        for (uint32_t j = 0; j < block -> preds.count; j++) {
+            fprintf(stream, "%s b%u", j == 0 ? " ; preds" : ",",
+                block -> preds.items[j]);
+        }
+        fputs("\n", stream);
+        for (uint32_t j = 0; j < block -> code.count; j++) {
+            printInstr(stream, module, function, block -> code.items[j]);
+        }
+    }
+    fputs("}\n\n", stream);
+}
+
+void printIR(FILE* stream, struct IrModule* module) {
+    for (uint32_t i = 0; i < module -> functions.count; i++) {
+        printFunction(stream, module, i);
+    }
+}
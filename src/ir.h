@@ -0,0 +1,200 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+#include "symbol.h"
+
+/*
+ * SSA form of the functions of one file. Every instruction defines the
+ * value named by its index in IrFunction.instrs, operands are such
+ * indices. Blocks list their instructions in order, the phis first and
+ * one terminator last. The operands of a phi follow IrBlock.preds.
+ *
+ * Values are typed and the operands of an operator have the type of its
+ * result, the lowering puts in the casts. Comparisons take two values of
+ * 64 bits and give a Bool, the count of a shift keeps its own type.
+ * Integers are kept wrapped to their bits and sign extended like wrapInt.
+ */
+
+#define IR_BINARY_OPS(X)                                                    \
+    X(ADD)                                                                  \
+    X(SUBTRACT)                                                             \
+    X(MULTIPLY)                                                             \
+    X(DIVIDE)                                                               \
+    X(MODULO)                                                               \
+    X(BITWIZE_OR)                                                           \
+    X(BITWIZE_AND)                                                          \
+    X(LEFT_SHIFT)                                                           \
+    X(RIGHT_SHIFT)                                                          \
+    X(EQUAL)                                                                \
+    X(NOT_EQUAL)                                                            \
+    X(LESS_THEN)                                                            \
+    X(GREAT_THEN)                                                           \
+    X(LESS_THEN_OR_EQUAL)                                                   \
+    X(GREA_THEN_OR_EQUAL)
+
+#define IR_OPS(X)                                                           \
+    X(NOP)              /* removed by a pass                        */      \
+    X(CONST)            /* the constant of the instruction          */      \
+    X(PARAM)            /* argument a                               */      \
+    X(PHI)              /* args, one per predecessor                */      \
+    IR_BINARY_OPS(X)    /* a op b                                   */      \
+    X(NEG)              /* -a                                       */      \
+    X(BITWIZE_NOT)      /* ~a                                       */      \
+    X(LOGICAL_NOT)      /* !a                                       */      \
+    X(CAST)             /* a as the type of the instruction         */      \
+    X(CALL)             /* IrModule.functions[a](args)              */      \
+    X(NATIVE)           /* enum Native a of bytecode.h, (args)      */      \
+    X(JUMP)             /* to targets[0]                            */      \
+    X(BRANCH)           /* to targets[0] if a, else targets[1]      */      \
+    X(RETURN)           /* a, NODE_NONE for nothing                 */
+
+enum IrOp {
+#define IR_OP_ENUM(name) IR_##name,
+    IR_OPS(IR_OP_ENUM)
+#undef IR_OP_ENUM
+    IR_OP_COUNT,
+};
+
+enum IrType {
+    IR_TYPE_NONE,
+    IR_TYPE_BOOL,
+    IR_TYPE_INT,
+    IR_TYPE_UINT,
+    IR_TYPE_FLOAT,
+    IR_TYPE_STR,
+    IR_TYPE_FILE,                   // the stream of Cosole.stdout or stderr
+};
+
+struct IrInstr {
+    uint8_t      op;                // enum IrOp
+    uint8_t      type;              // enum IrType of the value
+    uint8_t      bits;
+    uint32_t     block;             // IrFunction.blocks
+    uint32_t     a;
+    uint32_t     b;
+    struct Range args;              // IrFunction.operands
+    union {
+        uint64_t _uint;             // CONST of integers, Bool and File
+        double   _float;
+        uint32_t string;            // symbol of a Str
+        uint32_t targets[2];        // IrFunction.blocks
+    };
+};
+
+struct IrBlock {
+    NODES(uint32_t) code;           // IrFunction.instrs
+    NODES(uint32_t) preds;          // IrFunction.blocks
+};
+
+struct IrFunction {
+    uint32_t                name;   // SYMBOL_NONE for tests
+    uint32_t                params;
+    uint8_t                 result; // enum IrType
+    uint8_t                 bits;
+    bool                    is_exported;
+    NODES(struct IrInstr)   instrs;
+    NODES(struct IrBlock)   blocks; // the first is the entry
+    NODES(uint32_t)         operands;
+};
+
+struct IrModule {
+    const char*              path;
+    struct Symbols*          symbols;
+    NODES(struct IrFunction) functions; // like Program.functions
+    NODES(uint32_t)          tests;     // IrModule.functions, in order
+    uint32_t                 main;      // func main, NODE_NONE without one
+};
+
+static inline bool irIsTerminator(enum IrOp op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+/*
+ * Builds the module from ast: funcs, then cfuncs, then tests, like
+ * lowerAST. Only main, the cfuncs, the tests and what they call get
+ * blocks. Returns false and sets error for what the IR can not express
+ * yet, which is what the VM can not run.
+ */
+bool buildIR(
+    struct IrModule* module,
+    struct AST*      ast,
+    const char*      path,
+    struct Error*    error
+);
+void freeIR(struct IrModule* module);
+void printIR(FILE* stream, struct IrModule* module);
+
+// the blocks a terminator goes to, returns how many
+uint32_t irSuccessors(struct IrInstr* terminator, uint32_t* res);
+
+/*
+ * The operands of instr besides its args, which only PHI, CALL and NATIVE
+ * have. Pointers so passes can rewrite them, returns how many.
+ */
+static inline uint32_t irFixedOperands(
+    struct IrInstr* instr,
+    uint32_t**      res
+) {
+    switch (instr -> op) {
+#define IR_BINARY_CASE(name) case IR_##name:
+    IR_BINARY_OPS(IR_BINARY_CASE)
+#undef IR_BINARY_CASE
+        res[0] = &instr -> a;
+        res[1] = &instr -> b;
+        return 2;
+    case IR_NEG:
+    case IR_BITWIZE_NOT:
+    case IR_LOGICAL_NOT:
+    case IR_CAST:
+    case IR_BRANCH:
+        res[0] = &instr -> a;
+        return 1;
+    case IR_RETURN:
+        res[0] = &instr -> a;
+        return instr -> a != NODE_NONE;
+    default:
+        return 0;
+    }
+}
+
+// drops the edge from pred to block with the phi operands it had
+void irRemoveEdge(struct IrFunction* function, uint32_t pred, uint32_t block);
+
+// empties the blocks the entry can not reach, returns whether there were any
+bool irRemoveUnreachable(struct IrFunction* function);
+
+// replaces the phis that merge one value by it, returns whether there were any
+bool irRemoveTrivialPhis(struct IrFunction* function);
+
+/*
+ * A map of the values a pass replaces, NODE_NONE for the ones it keeps.
+ * irReplaceUses makes every operand use the value it ends up as.
+ */
+uint32_t* irNewReplaced(struct IrFunction* function);
+void irReplaceUses(struct IrFunction* function, uint32_t* replaced);
+
+// drops the NOPs from the blocks
+void irCompact(struct IrFunction* function);
+
+/*
+ * The blocks the entry reaches in reverse postorder, order needs room
+ * for all of them. Returns how many there are.
+ */
+uint32_t irReversePostorder(struct IrFunction* function, uint32_t* order);
+
+/*
+ * Puts a block of its own on every edge from a block with two successors
+ * to one with phis, so the moves of the phis have a place to go.
+ */
+void irSplitCriticalEdges(struct IrFunction* function);
+
+// instructions left in the blocks of the module
+size_t irCount(struct IrModule* module);
+
+#endif
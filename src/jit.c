@@ -0,0 +1,273 @@
+#define _GNU_SOURCE
+// for: pthread_getattr_np
+#include <pthread.h>
+// for: pthread_self, pthread_getattr_np, pthread_attr_getstack
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <string.h>
+// for: memcpy, memset
+#include <sys/mman.h>
+// for: mmap, mprotect, munmap
+#include <unistd.h>
+// for: sysconf
+
+#include "bytecode.h"
+#include "jit.h"
+#include "memory.h"
+#include "timing.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86
+#endif
+
+#define RUNTIME_ERROR "Runtime error"
+
+// what libc may need of the stack after the limit is reached
+#define JIT_STACK_MARGIN (64 * 1024)
+// jmp [rip], then the address
+#define JIT_STUB_SIZE    16
+
+#ifdef JIT_X86
+
+// the code running on this thread, longjmp leaves its frames behind
+struct JitRun {
+    FILE*    out;
+    jmp_buf  fault;
+    uint32_t kind;                  // enum NativeFault
+    uint32_t function;
+};
+
+static _Thread_local struct JitRun* jit_run;
+
+static int jitDprintf(int fd, const char* format, ...) {
+    va_list list;
+    va_start(list, format);
+    int res = vfprintf(fd == VM_STDERR ? stderr : jit_run -> out, format,
+        list);
+    va_end(list);
+    return res;
+}
+
+static long jitWrite(int fd, const void* bytes, size_t length) {
+    fwrite(bytes, 1, length, fd == VM_STDERR ? stderr : jit_run -> out);
+    return (long) length;
+}
+
+static _Noreturn void jitFault(uint32_t kind, uint32_t function) {
+    jit_run -> kind = kind;
+    jit_run -> function = function;
+    longjmp(jit_run -> fault, 1);
+}
+
+// ISO C has no cast from a function to data, the bits are the same here
+static uint64_t addressOf(void (*function)(void)) {
+    uint64_t res;
+    memcpy(&res, &function, sizeof(res));
+    return res;
+}
+
+static uint64_t externAddress(const char* name) {
+    if (strcmp(name, "dprintf") == 0) {
+        return addressOf((void (*)(void)) jitDprintf);
+    }
+    if (strcmp(name, "write") == 0) {
+        return addressOf((void (*)(void)) jitWrite);
+    }
+    if (strcmp(name, NATIVE_FAULT) == 0) {
+        return addressOf((void (*)(void)) jitFault);
+    }
+    return 0;
+}
+
+static inline size_t alignUp(size_t value, size_t align) {
+    return (value + align - 1) / align * align;
+}
+
+bool loadJit(
+    struct Jit*          jit,
+    struct NativeModule* native,
+    struct Error*        error
+) {
+    timeBegin("load");
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t stubs = alignUp(native -> text.count, JIT_STUB_SIZE);
+    size_t externs = 0;
+    for (uint32_t i = 0; i < native -> symbols.count; i++) {
+        externs += native -> symbols.items[i].type == NATIVE_SYMBOL_EXTERN;
+    }
+    size_t code = alignUp(stubs + externs * JIT_STUB_SIZE, page);
+    (*jit) = (struct Jit) {
+        .size   = code + alignUp(native -> data.count + 1, page),
+        .native = native
+    };
+    void* memory = mmap(NULL, jit -> size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        setError(error, RUNTIME_ERROR, native -> path, 0,
+            "no memory for the machine code");
+        timeEnd();
+        return false;
+    }
+    jit -> memory = memory;
+    jit -> text = memory;
+    jit -> data = jit -> memory + code;
+    if (native -> text.count > 0) {
+        memcpy(jit -> text, native -> text.items, native -> text.count);
+    }
+    if (native -> data.count > 0) {
+        memcpy(jit -> data, native -> data.items, native -> data.count);
+    }
+
+    uint64_t* addresses = memoryAllocKind(MEMORY_NATIVE,
+        (native -> symbols.count + 1) * sizeof(uint64_t));
+    uint8_t* stub = jit -> text + stubs;
+    bool res = true;
+    for (uint32_t i = 0; i < native -> symbols.count; i++) {
+        struct NativeSymbol* symbol = &native -> symbols.items[i];
+        switch (symbol -> type) {
+        case NATIVE_SYMBOL_DATA:
+            addresses[i] = (uint64_t) (jit -> data + symbol -> offset);
+            break;
+        case NATIVE_SYMBOL_FUNCTION:
+            addresses[i] = (uint64_t) (jit -> text + symbol -> offset);
+            break;
+        default: {
+            uint64_t target = externAddress(symbol -> name);
+            if (target == 0) {
+                setError(error, RUNTIME_ERROR, native -> path, 0,
+                    "unknown symbol %s", symbol -> name);
+                res = false;
+            }
+            static const uint8_t jump[] = { 0xff, 0x25, 0, 0, 0, 0 };
+            memcpy(stub, jump, sizeof(jump));
+            memcpy(stub + sizeof(jump), &target, sizeof(target));
+            addresses[i] = (uint64_t) stub;
+            stub += JIT_STUB_SIZE;
+            break;
+        }
+        }
+    }
+    for (uint32_t i = 0; i < native -> relocs.count && res; i++) {
+        struct NativeReloc reloc = native -> relocs.items[i];
+        uint8_t* place = jit -> text + reloc.offset;
+        int64_t value = (int64_t) addresses[reloc.symbol] + reloc.addend
+                      - (int64_t) place;
+        if (value < INT32_MIN || value > INT32_MAX) {
+            setError(error, RUNTIME_ERROR, native -> path, 0,
+                "relocation out of range");
+            res = false;
+            break;
+        }
+        int32_t rel = (int32_t) value;
+        memcpy(place, &rel, sizeof(rel));
+    }
+    memoryFree(addresses);
+    if (res && mprotect(jit -> text, code, PROT_READ | PROT_EXEC) != 0) {
+        setError(error, RUNTIME_ERROR, native -> path, 0,
+            "the machine code can not be made executable");
+        res = false;
+    }
+    if (!res) {
+        freeJit(jit);
+    }
+    timeEnd();
+    return res;
+}
+
+// the lowest address the stack of this thread may grow to, and some room
+static uint64_t stackLimit(void) {
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+        return 0;
+    }
+    void* stack = NULL;
+    size_t size = 0;
+    pthread_attr_getstack(&attr, &stack, &size);
+    pthread_attr_destroy(&attr);
+    return stack == NULL ? 0 : (uint64_t) stack + JIT_STACK_MARGIN;
+}
+
+bool runJit(
+    struct Jit*      jit,
+    struct IrModule* module,
+    uint32_t         function,
+    FILE*            out,
+    struct Error*    error
+) {
+    struct NativeModule* native = jit -> native;
+    if (native -> stack_limit != NODE_NONE) {
+        uint64_t limit = stackLimit();
+        memcpy(jit -> data + native -> stack_limit, &limit, sizeof(limit));
+    }
+    struct JitRun run = { .out = out };
+    jit_run = &run;
+    if (setjmp(run.fault) == 0) {
+        uint64_t address = (uint64_t) (jit -> text + native -> symbols.items[
+            native -> functions[function]
+        ].offset);
+        void (*entry)(void);
+        memcpy(&entry, &address, sizeof(entry));
+        entry();
+        jit_run = NULL;
+        return true;
+    }
+    jit_run = NULL;
+    uint32_t name = module -> functions.items[run.function].name;
+    if (name == SYMBOL_NONE) {
+        uint32_t test = 0;
+        while (module -> tests.items[test] != run.function) {
+            test++;
+        }
+        setError(error, RUNTIME_ERROR, module -> path, 0,
+            "%s, in test %u", native_fault_messages[run.kind], test + 1);
+    } else {
+        struct String string = symbolString(module -> symbols, name);
+        setError(error, RUNTIME_ERROR, module -> path, 0,
+            "%s, in func %.*s", native_fault_messages[run.kind],
+            (int) string.length, string.string);
+    }
+    return false;
+}
+
+void freeJit(struct Jit* jit) {
+    if (jit -> memory != NULL) {
+        munmap(jit -> memory, jit -> size);
+    }
+    (*jit) = (struct Jit) { 0 };
+}
+
+#else
+
+bool loadJit(
+    struct Jit*          jit,
+    struct NativeModule* native,
+    struct Error*        error
+) {
+    (*jit) = (struct Jit) { .native = native };
+    setError(error, RUNTIME_ERROR, native -> path, 0,
+        "machine code only runs on x86-64 Linux");
+    return false;
+}
+
+bool runJit(
+    struct Jit*      jit,
+    struct IrModule* module,
+    uint32_t         function,
+    FILE*            out,
+    struct Error*    error
+) {
+    (void) jit;
+    (void) function;
+    (void) out;
+    setError(error, RUNTIME_ERROR, module -> path, 0,
+        "machine code only runs on x86-64 Linux");
+    return false;
+}
+
+void freeJit(struct Jit* jit) {
+    (*jit) = (struct Jit) { 0 };
+}
+
+#endif
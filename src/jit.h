@@ -0,0 +1,46 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "error.h"
+#include "ir.h"
+#include "native.h"
+
+/*
+ * A NativeModule placed in executable memory of this process, only on
+ * x86-64 Linux. The externs of the code are the libc functions it calls,
+ * they get stubs that write like runFunction of the VM does instead.
+ */
+struct Jit {
+    uint8_t*             memory;
+    size_t               size;
+    uint8_t*             text;
+    uint8_t*             data;
+    struct NativeModule* native;
+};
+
+bool loadJit(
+    struct Jit*          jit,
+    struct NativeModule* native,
+    struct Error*        error
+);
+
+/*
+ * Runs IrModule.functions[function] of the module native was compiled
+ * from, it takes no arguments. File.write to Cosole.stdout goes to out,
+ * a fault returns false and sets error like the VM does.
+ */
+bool runJit(
+    struct Jit*      jit,
+    struct IrModule* module,
+    uint32_t         function,
+    FILE*            out,
+    struct Error*    error
+);
+void freeJit(struct Jit* jit);
+
+#endif
@@ -0,0 +1,489 @@
+#include <inttypes.h>
+// for: PRIu64
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <string.h>
+// for: memset
+
+#include "builtin.h"
+#include "layout.h"
+#include "memory.h"
+#include "timing.h"
+
+#define LAYOUT_ERROR "Compile error"
+
+enum LayoutMark {
+    LAYOUT_NONE,
+    LAYOUT_PENDING,
+    LAYOUT_DONE,
+};
+
+struct Layouter {
+    struct Layout*  layout;
+    struct AST*     ast;
+    const char*     path;
+    struct Error*   error;
+    jmp_buf         bail;
+    uint8_t*        marks;          // AST.type_decls, enum LayoutMark
+    NODES(uint32_t) aligns;         // see reorderFilds
+};
+
+// size and alignment of a value of some type
+struct Size {
+    uint64_t size;
+    uint32_t align;
+};
+
+static _Noreturn __attribute__((format(printf, 3, 4))) void errorLayout(
+    struct Layouter* layouter,
+    uint32_t         decl,
+    const char*      format,
+    ...
+) {
+    char message[160];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+    struct String name = symbolString(layouter -> ast -> symbols,
+        layouter -> ast -> type_decls.items[decl].header.name);
+    setError(layouter -> error, LAYOUT_ERROR, layouter -> path, 0,
+        "%s, in type %.*s", message, (int) name.length, name.string);
+    longjmp(layouter -> bail, 1);
+}
+
+static inline uint64_t alignUp(uint64_t value, uint32_t align) {
+    return (value + align - 1) / align * align;
+}
+
+static void layoutDecl(struct Layouter* layouter, uint32_t index);
+
+static inline uint32_t declOf(struct Layout* layout, uint32_t name) {
+    return name < layout -> symbols ? layout -> type_decls[name] : 0;
+}
+
+// of a type laid out already, align is 0 when it has no layout
+static struct Size typeSize(struct Layout* layout, struct Type type) {
+    if (type.is_ref) {
+        return (struct Size) { .size = 8, .align = 8 };
+    }
+    uint32_t index = declOf(layout, type.name);
+    if (index != 0) {
+        struct TypeLayout res = layout -> types[index - 1];
+        return (struct Size) { .size = res.size, .align = res.align };
+    }
+    struct Builtin builtin = builtinType(layout -> ast -> symbols, type.name);
+    switch (builtin.type) {
+    case BUILTIN_INT:
+    case BUILTIN_UINT:
+    case BUILTIN_FLOAT:
+    case BUILTIN_BOOL:
+        // Float128 is long double, 10 bytes kept in 16
+        return (struct Size) {
+            .size  = builtin.bits / 8,
+            .align = builtin.bits / 8
+        };
+    case BUILTIN_STR:
+        return (struct Size) { .size = 16, .align = 8 };
+    case BUILTIN_FUNC:
+        return (struct Size) { .size = 8, .align = 8 };
+    case BUILTIN_NONE:
+        return (struct Size) { .size = 0, .align = 1 };
+    default:
+        return (struct Size) { 0 };
+    }
+}
+
+// null for refs and funcs, 2 to 255 for Bool
+static struct Niche typeNiche(struct Layout* layout, struct Type type) {
+    uint32_t index = declOf(layout, type.name);
+    if (type.is_ref) {
+        return (struct Niche) { .size = 8, .count = 1 };
+    }
+    if (index != 0) {
+        return layout -> types[index - 1].niche;
+    }
+    switch (builtinType(layout -> ast -> symbols, type.name).type) {
+    case BUILTIN_BOOL:
+        return (struct Niche) { .size = 1, .start = 2, .count = 254 };
+    case BUILTIN_FUNC:
+        return (struct Niche) { .size = 8, .count = 1 };
+    default:
+        return (struct Niche) { 0 };
+    }
+}
+
+// decl is the one the type is used in, for errors
+static struct Size sizeOf(
+    struct Layouter* layouter,
+    uint32_t         decl,
+    struct Type      type
+) {
+    struct Layout* layout = layouter -> layout;
+    uint32_t index = declOf(layout, type.name);
+    if (index != 0 && !type.is_ref) {
+        layoutDecl(layouter, index - 1);
+    }
+    struct Size res = typeSize(layout, type);
+    if (res.align == 0) {
+        struct String name = symbolString(layout -> ast -> symbols,
+            type.name);
+        errorLayout(layouter, decl, "%.*s has no layout in memory",
+            (int) name.length, name.string);
+    }
+    return res;
+}
+
+// by descending alignment, filds of the same alignment keep their order
+static void reorderFilds(
+    struct Layouter* layouter,
+    uint32_t         decl,
+    struct Range     filds
+) {
+    uint32_t mark = layouter -> aligns.count;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        uint32_t align = sizeOf(layouter, decl,
+            layouter -> ast -> filds.items[filds.start + i].type).align;
+        pushNode(layouter -> aligns, MEMORY_TYPE, align);
+    }
+    struct TypeFild* items = &layouter -> ast -> filds.items[filds.start];
+    uint32_t* aligns = &layouter -> aligns.items[mark];
+    for (uint32_t i = 1; i < filds.count; i++) {
+        struct TypeFild fild = items[i];
+        uint32_t align = aligns[i];
+        uint32_t j = i;
+        while (j > 0 && aligns[j - 1] < align) {
+            items[j] = items[j - 1];
+            aligns[j] = aligns[j - 1];
+            j--;
+        }
+        items[j] = fild;
+        aligns[j] = align;
+    }
+    layouter -> aligns.count = mark;
+}
+
+// the smallest unsigned integer that counts the tags
+static uint32_t tagSize(uint32_t tags) {
+    return tags <= 0x100 ? 1 : tags <= 0x10000 ? 2 : 4;
+}
+
+/*
+ * Payload after a tag, or no tag when the filds without a value fit the
+ * niche of the only fild with one. The enum has a niche of its own: the
+ * spare values of its tag, or those left in the niche.
+ */
+static uint64_t layoutEnum(
+    struct Layouter*   layouter,
+    uint32_t           index,
+    struct TypeLayout* res
+) {
+    struct AST* ast = layouter -> ast;
+    struct Range filds = ast -> type_decls.items[index]._enum;
+    struct Size payload = { .align = 1 };
+    struct Niche niche = { 0 };
+    uint32_t typed = 0;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[filds.start + i];
+        if (fild.type != ENUM_FILD_TYPED) {
+            continue;
+        }
+        struct Size size = sizeOf(layouter, index, fild.fild.type);
+        payload.size = size.size > payload.size ? size.size : payload.size;
+        payload.align = size.align > payload.align
+            ? size.align
+            : payload.align;
+        niche = typeNiche(layouter -> layout, fild.fild.type);
+        typed++;
+    }
+    uint32_t untyped = filds.count - typed;
+    if (typed == 1 && untyped <= niche.count) {
+        res -> size = payload.size;
+        res -> align = payload.align;
+        res -> niche = niche;
+        res -> niche.start += untyped;
+        res -> niche.count -= untyped;
+        return payload.size;
+    }
+    res -> tag_size = tagSize(filds.count);
+    res -> payload = alignUp(res -> tag_size, payload.align);
+    res -> size = res -> payload + payload.size;
+    res -> align = payload.align > res -> tag_size
+        ? payload.align
+        : res -> tag_size;
+    res -> niche = (struct Niche) {
+        .size  = res -> tag_size,
+        .start = filds.count,
+        .count = (UINT64_C(1) << 8 * res -> tag_size) - filds.count
+    };
+    return res -> tag_size + payload.size;
+}
+
+static void layoutDecl(struct Layouter* layouter, uint32_t index) {
+    struct AST* ast = layouter -> ast;
+    struct TypeDecl decl = ast -> type_decls.items[index];
+    if (layouter -> marks[index] == LAYOUT_DONE) {
+        return;
+    }
+    if (layouter -> marks[index] == LAYOUT_PENDING) {
+        errorLayout(layouter, index, "the type holds itself");
+    }
+    layouter -> marks[index] = LAYOUT_PENDING;
+    struct TypeLayout res = { .align = 1 };
+    uint64_t used = 0;
+    switch (decl.type) {
+    case TYPE_TYPE: {
+        struct Size size = sizeOf(layouter, index, decl._type);
+        res.size = size.size;
+        res.align = size.align;
+        res.niche = typeNiche(layouter -> layout, decl._type);
+        used = size.size;
+        break;
+    }
+    case TYPE_STRUCT:
+        if (!decl.is_exported) {
+            reorderFilds(layouter, index, decl._struct);
+        }
+        for (uint32_t i = 0; i < decl._struct.count; i++) {
+            uint32_t fild = decl._struct.start + i;
+            struct Size size = sizeOf(layouter, index,
+                ast -> filds.items[fild].type);
+            res.size = alignUp(res.size, size.align);
+            layouter -> layout -> offsets[fild] = res.size;
+            res.size += size.size;
+            res.align = size.align > res.align ? size.align : res.align;
+            used += size.size;
+            struct Niche niche = typeNiche(layouter -> layout,
+                ast -> filds.items[fild].type);
+            if (niche.count > res.niche.count) {
+                res.niche = niche;
+                res.niche.offset += layouter -> layout -> offsets[fild];
+            }
+        }
+        break;
+    case TYPE_UNION:
+        for (uint32_t i = 0; i < decl._union.count; i++) {
+            uint32_t fild = decl._union.start + i;
+            struct Size size = sizeOf(layouter, index,
+                ast -> filds.items[fild].type);
+            layouter -> layout -> offsets[fild] = 0;
+            res.size = size.size > res.size ? size.size : res.size;
+            res.align = size.align > res.align ? size.align : res.align;
+        }
+        used = res.size;
+        break;
+    case TYPE_ENUM:
+        used = layoutEnum(layouter, index, &res);
+        break;
+    }
+    // C gives empty structs a byte, see emitTypeDecl of emitc.c
+    res.size = alignUp(res.size == 0 && decl.type != TYPE_TYPE ? 1 : res.size,
+        res.align);
+    res.padding = res.size - (used < res.size ? used : res.size);
+    layouter -> layout -> types[index] = res;
+    layouter -> marks[index] = LAYOUT_DONE;
+}
+
+bool layoutTypes(
+    struct Layout* layout,
+    struct AST*    ast,
+    const char*    path,
+    struct Error*  error
+) {
+    timeBegin("layout");
+    uint32_t decls = ast -> type_decls.count;
+    uint32_t filds = ast -> filds.count;
+    uint32_t symbols = ast -> symbols -> count;
+    (*layout) = (struct Layout) {
+        .ast        = ast,
+        .types      = memoryAllocKind(MEMORY_TYPE,
+            (decls + 1) * sizeof(struct TypeLayout)),
+        .offsets    = memoryAllocKind(MEMORY_TYPE,
+            (filds + 1) * sizeof(uint64_t)),
+        .type_decls = memoryAllocKind(MEMORY_TYPE,
+            (symbols + 1) * sizeof(uint32_t)),
+        .symbols    = symbols
+    };
+    memset(layout -> types, 0, (decls + 1) * sizeof(struct TypeLayout));
+    memset(layout -> offsets, 0, (filds + 1) * sizeof(uint64_t));
+    memset(layout -> type_decls, 0, (symbols + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < decls; i++) {
+        struct TypeHeader header = ast -> type_decls.items[i].header;
+        if (header.params.count == 0) {
+            layout -> type_decls[header.name] = i + 1;
+        }
+    }
+    struct Layouter layouter = {
+        .layout = layout,
+        .ast    = ast,
+        .path   = path,
+        .error  = error,
+        .marks  = memoryAllocKind(MEMORY_TYPE, decls + 1)
+    };
+    memset(layouter.marks, LAYOUT_NONE, decls + 1);
+
+    bool res = setjmp(layouter.bail) == 0;
+    if (res) {
+        for (uint32_t i = 0; i < decls; i++) {
+            if (ast -> type_decls.items[i].header.params.count == 0) {
+                layoutDecl(&layouter, i);
+            }
+        }
+    }
+    memoryFree(layouter.marks);
+    memoryFree(layouter.aligns.items);
+    if (!res) {
+        freeLayout(layout);
+    }
+    timeEnd();
+    return res;
+}
+
+uint64_t nicheValue(struct Layout* layout, uint32_t decl, uint32_t index) {
+    struct AST* ast = layout -> ast;
+    struct Range filds = ast -> type_decls.items[decl]._enum;
+    uint64_t untyped = 0;
+    uint64_t res = 0;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        if (filds.start + i == index) {
+            res = untyped;
+        }
+        untyped += ast -> enum_filds.items[filds.start + i].type
+                == ENUM_FILD_UNTYPED;
+    }
+    return layout -> types[decl].niche.start - untyped + res;
+}
+
+static void printTypeName(FILE* stream, struct AST* ast, struct Type type) {
+    struct String name = symbolString(ast -> symbols, type.name);
+    fprintf(stream, "%s%.*s", type.is_ref ? "ref " : "", (int) name.length,
+        name.string);
+}
+
+static inline const char* bytes(uint64_t count) {
+    return count == 1 ? "byte" : "bytes";
+}
+
+// offset, the cache line it starts in, and whether it runs into the next
+static void printSpan(FILE* stream, uint64_t offset, uint64_t size) {
+    uint64_t line = offset / LAYOUT_CACHE_LINE;
+    fprintf(stream, "    %6" PRIu64 "  line %-3" PRIu64 "%s", offset, line,
+        size != 0 && (offset + size - 1) / LAYOUT_CACHE_LINE != line
+            ? " split "
+            : "       ");
+}
+
+static void printPadding(FILE* stream, uint64_t offset, uint64_t size) {
+    if (size != 0) {
+        printSpan(stream, offset, size);
+        fprintf(stream, "padding, %" PRIu64 " %s\n", size, bytes(size));
+    }
+}
+
+static void printFilds(
+    FILE*          stream,
+    struct Layout* layout,
+    struct Range   filds,
+    uint64_t       size
+) {
+    struct AST* ast = layout -> ast;
+    uint64_t end = 0;
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct TypeFild fild = ast -> filds.items[filds.start + i];
+        uint64_t offset = layout -> offsets[filds.start + i];
+        uint64_t fild_size = typeSize(layout, fild.type).size;
+        if (offset > end) {
+            printPadding(stream, end, offset - end);
+        }
+        printSpan(stream, offset, fild_size);
+        struct String name = symbolString(ast -> symbols, fild.name);
+        fprintf(stream, "%.*s: ", (int) name.length, name.string);
+        printTypeName(stream, ast, fild.type);
+        fprintf(stream, ", %" PRIu64 " %s\n", fild_size, bytes(fild_size));
+        end = offset + fild_size > end ? offset + fild_size : end;
+    }
+    printPadding(stream, end, size - end);
+}
+
+// the tag, or where the filds without a value are kept, then the values
+static void printEnum(FILE* stream, struct Layout* layout, uint32_t decl) {
+    struct AST* ast = layout -> ast;
+    struct Range filds = ast -> type_decls.items[decl]._enum;
+    struct TypeLayout type = layout -> types[decl];
+    uint64_t end = type.tag_size;
+    if (type.tag_size != 0) {
+        printSpan(stream, 0, type.tag_size);
+        fprintf(stream, "tag, %u %s\n", type.tag_size, bytes(type.tag_size));
+    }
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[filds.start + i];
+        struct String name = symbolString(ast -> symbols, fild.fild.name);
+        if (fild.type != ENUM_FILD_TYPED) {
+            if (type.tag_size == 0) {
+                fprintf(stream, "%*s%.*s is %" PRIu64 " in the %u %s at %"
+                    PRIu64 "\n", 27, "", (int) name.length, name.string,
+                    nicheValue(layout, decl, filds.start + i),
+                    type.niche.size, bytes(type.niche.size),
+                    type.niche.offset);
+            }
+            continue;
+        }
+        uint64_t size = typeSize(layout, fild.fild.type).size;
+        if (end < type.payload) {
+            printPadding(stream, end, type.payload - end);
+        }
+        printSpan(stream, type.payload, size);
+        fprintf(stream, "%.*s: ", (int) name.length, name.string);
+        printTypeName(stream, ast, fild.fild.type);
+        fprintf(stream, ", %" PRIu64 " %s\n", size, bytes(size));
+        end = type.payload + size > end ? type.payload + size : end;
+    }
+    printPadding(stream, end, type.size - end);
+}
+
+void printLayout(FILE* stream, struct Layout* layout) {
+    struct AST* ast = layout -> ast;
+    for (uint32_t i = 0; i < ast -> type_decls.count; i++) {
+        struct TypeDecl decl = ast -> type_decls.items[i];
+        struct TypeLayout type = layout -> types[i];
+        struct String name = symbolString(ast -> symbols, decl.header.name);
+        if (decl.header.params.count != 0) {
+            fprintf(stream, "type %.*s is generic, see its instances\n\n",
+                (int) name.length, name.string);
+            continue;
+        }
+        uint64_t lines = (type.size + LAYOUT_CACHE_LINE - 1)
+                       / LAYOUT_CACHE_LINE;
+        fprintf(stream, "type %.*s: %" PRIu64 " %s, align %u, %" PRIu64
+            " %s of padding, %" PRIu64 " cache %s\n", (int) name.length,
+            name.string, type.size, bytes(type.size), type.align,
+            type.padding, bytes(type.padding), lines,
+            lines == 1 ? "line" : "lines");
+        switch (decl.type) {
+        case TYPE_TYPE:
+            printSpan(stream, 0, type.size);
+            printTypeName(stream, ast, decl._type);
+            fputs("\n", stream);
+            break;
+        case TYPE_STRUCT:
+        case TYPE_UNION:
+            printFilds(stream, layout,
+                decl.type == TYPE_STRUCT ? decl._struct : decl._union,
+                type.size);
+            break;
+        case TYPE_ENUM:
+            printEnum(stream, layout, i);
+            break;
+        }
+        fputs("\n", stream);
+    }
+}
+
+void freeLayout(struct Layout* layout) {
+    memoryFree(layout -> types);
+    memoryFree(layout -> offsets);
+    memoryFree(layout -> type_decls);
+    (*layout) = (struct Layout) { 0 };
+}
@@ -0,0 +1,72 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ast.h"
+#include "error.h"
+
+#define LAYOUT_CACHE_LINE 64
+
+/*
+ * Values a type never holds, an enum around it keeps its tag in them:
+ * null for refs, 2 to 255 for Bool and the values past the last tag of
+ * an enum. The count values from start on are spare, in size bytes at
+ * offset of the type.
+ */
+struct Niche {
+    uint64_t offset;
+    uint32_t size;
+    uint64_t start;
+    uint64_t count;                 // 0 when there are none
+};
+
+// how a value of a TypeDecl sits in memory, on x86-64 like C lays it out
+struct TypeLayout {
+    uint64_t     size;
+    uint32_t     align;
+    uint64_t     padding;           // bytes between and after the filds
+    uint64_t     payload;           // offset of the values of an enum
+    uint32_t     tag_size;          // of an enum, 0 if kept in a niche
+    struct Niche niche;
+};
+
+struct Layout {
+    struct AST*        ast;
+    struct TypeLayout* types;       // AST.type_decls, generic ones are 0
+    uint64_t*          offsets;     // AST.filds, of the ones of types
+    uint32_t*          type_decls;  // symbol -> AST.type_decls index + 1
+    uint32_t           symbols;     // the size of type_decls
+};
+
+/*
+ * Finds size and alignment of every TypeDecl of ast that is not generic,
+ * so call monomorphize of mono.h first. The filds of a struct that is not
+ * exported are reordered in the AST by descending alignment first, which
+ * leaves padding only at the end; exported ones keep their order, other
+ * modules see it.
+ *
+ * An enum with one fild that has a value keeps the tag of the others in a
+ * niche of that value when it has enough spare values, so Maybe<ref T> is
+ * as big as a ref. Other enums get the smallest tag that counts their
+ * filds. Returns false and sets error for unknown types and types that
+ * hold themselves.
+ */
+bool layoutTypes(
+    struct Layout* layout,
+    struct AST*    ast,
+    const char*    path,
+    struct Error*  error
+);
+// size, filds and padding of every type, and the cache lines they span
+void printLayout(FILE* stream, struct Layout* layout);
+/*
+ * The value in the niche of an enum that stands for its fild without a
+ * value at index of AST.enum_filds, only for enums with tag_size 0.
+ */
+uint64_t nicheValue(struct Layout* layout, uint32_t decl, uint32_t index);
+void freeLayout(struct Layout* layout);
+
+#endif
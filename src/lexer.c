@@ -1,4 +1,7 @@
 #include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -8,82 +11,118 @@
 
 #include "lexer.h"
 #include "memory.h"
+#include "scan.h"
 
-size_t current_line_number;
-const char* current_file;
+#define LEXER_ERROR "Parsing Error"
 
-static inline void errorIlligalCharacter(char character) {
-    fprintf(
-        stderr,
-        "Parsing Error %s:%ld: illigal character '%c'\n",
-        current_file,
-        current_line_number,
+static inline void errorIlligalCharacter(struct Lexer* lexer, char character) {
+    lexer -> failed = true;
+    setError(
+        lexer -> error,
+        LEXER_ERROR,
+        lexer -> file,
+        lexer -> line,
+        "illigal character '%c'",
         character
     );
-    exit(EXIT_FAILURE);
 }
 
-static inline void errorIlligalEscape(char character) {
-    fprintf(
-        stderr,
-        "Parsing Error %s:%ld: illigal escape character '%c'\n",
-        current_file,
-        current_line_number,
+static inline void errorIlligalEscape(struct Lexer* lexer, char character) {
+    lexer -> failed = true;
+    setError(
+        lexer -> error,
+        LEXER_ERROR,
+        lexer -> file,
+        lexer -> line,
+        "illigal escape character '%c'",
         character
     );
 }
 
-static inline void errorIlligalNewLine(void) {
-    fprintf(
-        stderr,
-        "Parsing Error %s:%ld: illigal new line\n",
-        current_file,
-        current_line_number
+static inline void errorIlligalNewLine(struct Lexer* lexer) {
+    lexer -> failed = true;
+    setError(
+        lexer -> error,
+        LEXER_ERROR,
+        lexer -> file,
+        lexer -> line,
+        "illigal new line"
     );
-    exit(EXIT_FAILURE);
 }
 
-static inline void errorIlligalName(void) {
-    fprintf(
-        stderr,
-        "Parsing Error %s:%ld: illigal name\n",
-        current_file,
-        current_line_number
+static inline void errorIlligalName(struct Lexer* lexer) {
+    lexer -> failed = true;
+    setError(
+        lexer -> error,
+        LEXER_ERROR,
+        lexer -> file,
+        lexer -> line,
+        "illigal name"
     );
-    exit(EXIT_FAILURE);
 }
 
-static inline void skipSpaces(const char** src) {
-    while (isspace(**src)) {
-        if ((**src) == '\n') {
-            current_line_number++;
-        }
-        (*src)++;
+static inline void errorUnexpectedEnd(struct Lexer* lexer) {
+    lexer -> failed = true;
+    setError(
+        lexer -> error,
+        LEXER_ERROR,
+        lexer -> file,
+        lexer -> line,
+        "unexpected end of file"
+    );
+}
+
+static inline void errorOutOfRange(struct Lexer* lexer, const char* what) {
+    lexer -> failed = true;
+    setError(
+        lexer -> error,
+        LEXER_ERROR,
+        lexer -> file,
+        lexer -> line,
+        "%s literal out of range",
+        what
+    );
+}
+
+/*
+ * Most runs between two tokens are a single space or new line, those are
+ * skipped here, a call through scan costs more than the scalar check.
+ */
+static inline void skipSpaces(struct Lexer* lexer, const char** src) {
+    const char* next = (*src) + 1;
+    if (!isspace(*next)) {
+        lexer -> line += (**src) == '\n';
+        (*src) = next;
+        return;
     }
+    size_t lines;
+    (*src) = scan.spaces(*src, &lines);
+    lexer -> line += lines;
 }
 
 static inline void skipOneLineComment(const char** src) {
-    current_line_number++;
-    while ((**src) != '\n') {
-        (*src)++;
-    }
-    (*src)++;
+    (*src) = scan.line_end(*src);
 }
 
-static inline void skipMultiLineComment(const char** src) {
-    while (!((**src) == '/' && (*((*src) - 1)) == '*')) {
-        if ((**src) == '\n') {
-            current_line_number++;
-        }
-        (*src)++;
+// an unclosed comment leaves src on the terminating zero
+static inline void skipMultiLineComment(
+    struct Lexer* lexer,
+    const char**  src
+) {
+    size_t lines;
+    (*src) = scan.comment_end((*src) + 2, &lines);
+    lexer -> line += lines;
+    if ((**src) == 0) {
+        errorUnexpectedEnd(lexer);
+        return;
     }
-    (*src)++;
+    (*src) += 2;
 }
 
-void skipWhiteSpaces(const char** src) {
+void skipWhiteSpaces(struct Lexer* lexer, const char** src) {
     while (true) {
         if (isspace(**src)) {
-            skipSpaces(src);
+            skipSpaces(lexer, src);
             continue;
         }
 
@@ -93,7 +132,7 @@ void skipWhiteSpaces(const char** src) {
         }
 
         if ((**src) == '/' && (*((*src) + 1)) == '*') {
-            skipMultiLineComment(src);
+            skipMultiLineComment(lexer, src);
             continue;
         }
 
@@ -120,8 +159,12 @@ static char parseHex(const char* str) {
     return res;
 }
 
-static struct String escape(const char* str, size_t length) {
-    char* res = memoryAlloc(length + 1);
+static struct String escape(
+    struct Lexer* lexer,
+    const char*   str,
+    size_t        length
+) {
+    char* res = memoryAllocKind(MEMORY_STRING, length + 1);
     size_t res_length = 0;
     for (size_t i = 0; i < length; i++) {
         if (str[i] == '\\') {
@@ -165,55 +208,107 @@ static struct String escape(const char* str, size_t length) {
                 i++;
                 break;
             default:
-                errorIlligalEscape(str[i]);
+                errorIlligalEscape(lexer, str[i]);
                 res[res_length++] = '/';
                 res[res_length++] = str[i];
             }
         } else if (str[i] == '\n') {
-            errorIlligalNewLine(); 
+            errorIlligalNewLine(lexer);
             break;
         } else {
             res[res_length++] = str[i];
         }
     }
     return (struct String) {
-        .string = strndup(res, res_length),
+        .string = res,
         .length = res_length
     };
 }
 
+// on an error the length stops at the offending byte
+static size_t scanString(struct Lexer* lexer, const char* src) {
+    const char* now = src + 1;
+    while (true) {
+        now = scan.quote(now);
+        switch (*now) {
+        case '"':
+            return now - src + 1;
+        case '\\':
+            if (now[1] == 0) {
+                errorUnexpectedEnd(lexer);
+                return now - src + 1;
+            }
+            now += 2;
+            break;
+        case '\n':
+            errorIlligalNewLine(lexer);
+            return now - src;
+        default:
+            errorUnexpectedEnd(lexer);
+            return now - src;
+        }
+    }
+}
+
 // TODO: proper implement 
-bool matchUint(const char* src, const char** end, uint64_t* result) {
+bool matchUint(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    uint64_t*     result
+) {
+    errno = 0;
     (*result) = strtoull(src, (char**)end, 0);
+    if (errno == ERANGE) {
+        errorOutOfRange(lexer, "integer");
+    }
     return src != (*end);
 }
 
-bool matchFloat(const char*  src, const char** end, long double* result) {
+bool matchFloat(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    long double*  result
+) {
     (*result) = strtold(src, (char**)end);
+    // floats are doubles, an underflow to 0 is still usable
+    if (fabsl(*result) > DBL_MAX) {
+        errorOutOfRange(lexer, "float");
+    }
     return src != (*end);
 }
 
-bool matchString(const char* src, const char** end, struct String* result) {
-    skipWhiteSpaces(&src);
+bool matchString(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '"') {
-        size_t length = 1;;
-        while (!(((src[length] == '"')
-               && (src[length - 1] != '\\'))
-              || ((src[length] == '"')
-               && (src[length - 1] == '\\')
-               && (src[length - 2] == '\\')))) {
-            length++;
-        }
-        length++;
+        size_t length = scanString(lexer, src);
         (*end) = src + length;
-        (*result) = escape(src + 1, length - 2);
+        if (lexer -> failed) {
+            return false;
+        }
+        (*result) = escape(lexer, src + 1, length - 2);
+        if (lexer -> failed) {
+            memoryFree(result -> string);
+            return false;
+        }
         return true;
     }
     return false;
 }
 
-bool matchKeyword(const char* src, const char** end, const char*  str) {
-    skipWhiteSpaces(&src);
+bool matchKeyword(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    const char*   str
+) {
+    skipWhiteSpaces(lexer, &src);
     size_t length = strlen(str);
     if (strncmp(src, str, length) == 0 && !isalnum(src[length])) {
         if (end != NULL) {
@@ -224,8 +319,13 @@ bool matchKeyword(const char* src, const char** end, const char*  str) {
     return false;
 } 
 
-bool matchUpperName(const char* src, const char** end, struct String* result) {
-    skipWhiteSpaces(&src);
+bool matchUpperName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+) {
+    skipWhiteSpaces(lexer, &src);
     if (isupper(*src)) {
         size_t length = 1;
         while (isalnum(src[length])) {
@@ -242,8 +342,13 @@ bool matchUpperName(const char* src, const char** end, struct String* result) {
     return false;
 }
 
-bool matchLowerName(const char* src, const char** end, struct String* result) {
-    skipWhiteSpaces(&src);
+bool matchLowerName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+) {
+    skipWhiteSpaces(lexer, &src);
     if (islower(*src)) {
         size_t length = 1;
         while (isalnum(src[length])) {
@@ -260,8 +365,13 @@ bool matchLowerName(const char* src, const char** end, struct String* result) {
     return false;
 }
 
-bool matchDotName(const char* src, const char** end, struct String* result) {
-    skipWhiteSpaces(&src);
+bool matchDotName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '.') {
         size_t length = 1;
         while (isalnum(src[length])) {
@@ -278,8 +388,13 @@ bool matchDotName(const char* src, const char** end, struct String* result) {
     return false;
 }
 
-bool matchAtName(const char* src, const char** end, struct String* result) {
-    skipWhiteSpaces(&src);
+bool matchAtName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '@') {
         size_t length = 1;
         while (isalnum(src[length])) {
@@ -295,3 +410,271 @@ bool matchAtName(const char* src, const char** end, struct String* result) {
     }
     return false;
 }
+
+// slots from keywordSlot, see lexer.h
+static const struct {
+    const char*    name;
+    uint8_t        length;
+    enum TokenType type;
+} keywords[1 << KEYWORD_BITS] = {
+    [ 0] = { "export",  6, TOKEN_EXPORT   },
+    [ 1] = { "cfunc",   5, TOKEN_CFUNC    },
+    [ 2] = { "test",    4, TOKEN_TEST     },
+    [ 3] = { "if",      2, TOKEN_IF       },
+    [ 4] = { "var",     3, TOKEN_VAR      },
+    [ 5] = { "loop",    4, TOKEN_LOOP     },
+    [ 6] = { "const",   5, TOKEN_CONST    },
+    [ 8] = { "func",    4, TOKEN_FUNC     },
+    [11] = { "while",   5, TOKEN_WHILE    },
+    [12] = { "switch",  6, TOKEN_SWITCH   },
+    [14] = { "do",      2, TOKEN_DO       },
+    [15] = { "type",    4, TOKEN_TYPE     },
+    [16] = { "default", 7, TOKEN_DEFAULT  },
+    [17] = { "union",   5, TOKEN_UNION    },
+    [18] = { "repead",  6, TOKEN_REPEAD   },
+    [19] = { "else",    4, TOKEN_ELSE     },
+    [20] = { "import",  6, TOKEN_IMPORT   },
+    [23] = { "ref",     3, TOKEN_REF      },
+    [24] = { "as",      2, TOKEN_AS       },
+    [25] = { "end",     3, TOKEN_CASE_END },
+    [26] = { "for",     3, TOKEN_FOR      },
+    [28] = { "enum",    4, TOKEN_ENUM     },
+    [29] = { "return",  6, TOKEN_RETURN   },
+    [31] = { "case",    4, TOKEN_CASE     },
+};
+
+// src[1] is always readable, a one letter name is followed by something
+static inline enum TokenType findKeyword(const char* src, size_t length) {
+    uint32_t slot = keywordSlot(keywordKey(src, length), KEYWORD_SEED);
+    if (keywords[slot].length == length
+     && memcmp(keywords[slot].name, src, length) == 0) {
+        return keywords[slot].type;
+    }
+    return TOKEN_LOWER_NAME;
+}
+
+static inline size_t scanName(const char* src) {
+    size_t length = 1;
+    while (isalnum(src[length])) {
+        length++;
+    }
+    return length;
+}
+
+static size_t scanNumber(
+    struct Lexer*   lexer,
+    const char*     src,
+    enum TokenType* type
+) {
+    // the whole literal first, only an integer has to fit 64 bits
+    const char* end;
+    strtoull(src, (char**)&end, 0);
+    size_t length = end - src;
+    if (src[length] == '.' || src[length] == 'e' || src[length] == 'E') {
+        long double _float;
+        matchFloat(lexer, src, &end, &_float);
+        if ((size_t)(end - src) > length) {
+            (*type) = TOKEN_FLOAT;
+            return end - src;
+        }
+    }
+    uint64_t _int;
+    matchUint(lexer, src, &end, &_int);
+    (*type) = TOKEN_INT;
+    return length;
+}
+
+/*
+ * Picks the operator token starting at src: `one` alone, `one` followed by
+ * '=' as `asign`, and doubled (`one` twice) as `twice`.
+ */
+static size_t scanOperator(
+    const char*     src,
+    enum TokenType* type,
+    enum TokenType  one,
+    enum TokenType  asign,
+    enum TokenType  twice
+) {
+    if (asign != TOKEN_END && src[1] == '=') {
+        (*type) = asign;
+        return 2;
+    }
+    if (twice != TOKEN_END && src[1] == src[0]) {
+        (*type) = twice;
+        return 2;
+    }
+    (*type) = one;
+    return 1;
+}
+
+static void pushToken(
+    struct Lexer*  lexer,
+    struct Tokens* tokens,
+    enum TokenType type,
+    size_t         offset,
+    size_t         length,
+    uint32_t       symbol
+) {
+    if (tokens -> count == tokens -> capacity) {
+        tokens -> capacity = tokens -> capacity == 0
+            ? 256
+            : tokens -> capacity * 2;
+        tokens -> tokens = memoryReallocKind(
+            MEMORY_TOKEN,
+            tokens -> tokens,
+            tokens -> capacity * sizeof(struct Token)
+        );
+    }
+    tokens -> tokens[tokens -> count++] = (struct Token) {
+        .type   = type,
+        .offset = offset,
+        .length = length,
+        .line   = lexer -> line,
+        .symbol = symbol
+    };
+}
+
+static size_t scanToken(
+    struct Lexer*   lexer,
+    const char*     src,
+    enum TokenType* type
+) {
+    size_t length;
+    if (isupper(*src)) {
+        (*type) = TOKEN_UPPER_NAME;
+        return scanName(src);
+    }
+    if (islower(*src)) {
+        length = scanName(src);
+        (*type) = findKeyword(src, length);
+        return length;
+    }
+    if (isdigit(*src)) {
+        return scanNumber(lexer, src, type);
+    }
+
+    switch (*src) {
+    case '.':
+    case '@':
+        (*type) = (*src) == '.' ? TOKEN_DOT_NAME : TOKEN_AT_NAME;
+        length = scanName(src);
+        if (length == 1) {
+            errorIlligalName(lexer);
+        }
+        return length;
+    case '"':
+        (*type) = TOKEN_STRING;
+        return scanString(lexer, src);
+    case '{': (*type) = TOKEN_LEFT_BRACE;    return 1;
+    case '}': (*type) = TOKEN_RIGHT_BRACE;   return 1;
+    case '(': (*type) = TOKEN_LEFT_PAREN;    return 1;
+    case ')': (*type) = TOKEN_RIGHT_PAREN;   return 1;
+    case '[': (*type) = TOKEN_LEFT_BRACKET;  return 1;
+    case ']': (*type) = TOKEN_RIGHT_BRACKET; return 1;
+    case ',': (*type) = TOKEN_COMMA;         return 1;
+    case ';': (*type) = TOKEN_SEMICOLON;     return 1;
+    case ':': (*type) = TOKEN_COLON;         return 1;
+    case '=':
+        return scanOperator(src, type, TOKEN_ASIGN, TOKEN_EQUAL, TOKEN_END);
+    case '!':
+        return scanOperator(
+            src, type, TOKEN_LOGICAL_NOT, TOKEN_NOT_EQUAL, TOKEN_END
+        );
+    case '<':
+        length = scanOperator(
+            src, type,
+            TOKEN_LESS_THEN, TOKEN_LESS_THEN_OR_EQUAL, TOKEN_LEFT_SHIFT
+        );
+        if ((*type) == TOKEN_LEFT_SHIFT && src[2] == '=') {
+            (*type) = TOKEN_LEFT_SHIFT_ASIGN;
+            length = 3;
+        }
+        return length;
+    case '>':
+        length = scanOperator(
+            src, type,
+            TOKEN_GREAT_THEN, TOKEN_GREAT_THEN_OR_EQUAL, TOKEN_RIGHT_SHIFT
+        );
+        if ((*type) == TOKEN_RIGHT_SHIFT && src[2] == '=') {
+            (*type) = TOKEN_RIGHT_SHIFT_ASIGN;
+            length = 3;
+        }
+        return length;
+    case '|':
+        return scanOperator(
+            src, type,
+            TOKEN_BITWIZE_OR, TOKEN_BITWIZE_OR_ASIGN, TOKEN_LOGICAL_OR
+        );
+    case '&':
+        return scanOperator(
+            src, type,
+            TOKEN_BITWIZE_AND, TOKEN_BITWIZE_AND_ASIGN, TOKEN_LOGICAL_AND
+        );
+    case '~':
+        return scanOperator(
+            src, type, TOKEN_BITWIZE_NOT, TOKEN_BITWIZE_NOT_ASIGN, TOKEN_END
+        );
+    case '+':
+        return scanOperator(src, type, TOKEN_ADD, TOKEN_ADD_ASIGN, TOKEN_END);
+    case '-':
+        return scanOperator(
+            src, type, TOKEN_SUBTRACT, TOKEN_SUBTRACT_ASIGN, TOKEN_END
+        );
+    case '*':
+        return scanOperator(
+            src, type, TOKEN_MULTIPLY, TOKEN_MULTIPLY_ASIGN, TOKEN_END
+        );
+    case '/':
+        return scanOperator(
+            src, type, TOKEN_DIVIDE, TOKEN_DIVIDE_ASIGN, TOKEN_END
+        );
+    case '%':
+        return scanOperator(
+            src, type, TOKEN_MODULO, TOKEN_MODULO_ASIGN, TOKEN_END
+        );
+    default:
+        errorIlligalCharacter(lexer, *src);
+        return 1;
+    }
+}
+
+bool tokenize(struct Lexer* lexer, struct Tokens* tokens, const char* src) {
+    const char* start = src;
+    (*tokens) = (struct Tokens) { 0 };
+
+    while (true) {
+        skipWhiteSpaces(lexer, &src);
+        if (lexer -> failed) {
+            return false;
+        }
+        if ((*src) == 0) {
+            pushToken(lexer, tokens, TOKEN_END, src - start, 0, SYMBOL_NONE);
+            return true;
+        }
+        enum TokenType type;
+        size_t length = scanToken(lexer, src, &type);
+        if (lexer -> failed) {
+            return false;
+        }
+        uint32_t symbol = SYMBOL_NONE;
+        switch (type) {
+        case TOKEN_UPPER_NAME:
+        case TOKEN_LOWER_NAME:
+            symbol = internSymbol(lexer -> symbols, src, length);
+            break;
+        case TOKEN_DOT_NAME:
+        case TOKEN_AT_NAME:
+            symbol = internSymbol(lexer -> symbols, src + 1, length - 1);
+            break;
+        default:
+            break;
+        }
+        pushToken(lexer, tokens, type, src - start, length, symbol);
+        src += length;
+    }
+}
+
+void freeTokens(struct Tokens* tokens) {
+    memoryFree(tokens -> tokens);
+    (*tokens) = (struct Tokens) { 0 };
+}
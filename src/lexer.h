@@ -5,45 +5,321 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "error.h"
 #include "string.h"
+#include "symbol.h"
 
-extern size_t current_line_number;
-extern const char* current_file;
+/*
+ * State of lexing one file. Nothing in the lexer is global, so any number
+ * of files can be lexed at once, each with its own Lexer. On a bad input
+ * the first error goes to error, failed is set and the match* function or
+ * tokenize returns as soon as it can.
+ */
+struct Lexer {
+    const char*     file;
+    size_t          line;
+    struct Symbols* symbols;
+    struct Error*   error;
+    bool            failed;
+};
 
-void skipWhiteSpaces(const char** src);
+enum TokenType {
+    TOKEN_END,
 
-bool matchUint(const char* src, const char** end, uint64_t* result);
-bool matchFloat(const char* src, const char** end, long double* result);
+    TOKEN_UPPER_NAME,               // [A-Z][a-zA-Z0-9]*
+    TOKEN_LOWER_NAME,               // [a-z][a-zA-Z0-9]*
+    TOKEN_DOT_NAME,                 // .[a-zA-Z0-9]+
+    TOKEN_AT_NAME,                  // @[a-zA-Z0-9]+
+    TOKEN_STRING,                   // "[^"]*"
+    TOKEN_INT,
+    TOKEN_FLOAT,
 
-bool matchUpperName(const char* src, const char** end, struct String* result);  // [A-Z][a-zA-Z0-9]*
-bool matchLowerName(const char* src, const char** end, struct String* result);  // [a-z][a-zA-Z0-9]*
-bool matchDotName(const char* src, const char** end, struct String* result);    // .[a-zA-Z0-9]+
-bool matchAtName(const char* src, const char** end, struct String* result);     // @[a-zA-Z0-9]+
-bool matchString(const char* src, const char** end, struct String* result);     // "[^"]*"
+    TOKEN_IMPORT,
+    TOKEN_TYPE,
+    TOKEN_EXPORT,
+    TOKEN_ENUM,
+    TOKEN_UNION,
+    TOKEN_REF,
+    TOKEN_AS,
+    TOKEN_FUNC,
+    TOKEN_CFUNC,
+    TOKEN_TEST,
+    TOKEN_VAR,
+    TOKEN_CONST,
+    TOKEN_IF,
+    TOKEN_ELSE,
+    TOKEN_SWITCH,
+    TOKEN_CASE,
+    TOKEN_CASE_END,                 // end
+    TOKEN_DEFAULT,
+    TOKEN_LOOP,
+    TOKEN_DO,
+    TOKEN_WHILE,
+    TOKEN_FOR,
+    TOKEN_REPEAD,
+    TOKEN_RETURN,
 
-bool matchKeyword(const char* src, const char** end, const char* str);
+    TOKEN_LEFT_BRACE,               // {
+    TOKEN_RIGHT_BRACE,              // }
+    TOKEN_LEFT_PAREN,               // (
+    TOKEN_RIGHT_PAREN,              // )
+    TOKEN_LEFT_BRACKET,             // [
+    TOKEN_RIGHT_BRACKET,            // ]
+    TOKEN_COMMA,                    // ,
+    TOKEN_SEMICOLON,                // ;
+    TOKEN_COLON,                    // :
 
-static inline bool matchChar(const char* src, const char** end, char c);
+    TOKEN_ASIGN,                    // =
+    TOKEN_EQUAL,                    // ==
+    TOKEN_NOT_EQUAL,                // !=
+    TOKEN_LOGICAL_NOT,              // !
+    TOKEN_LESS_THEN,                // <
+    TOKEN_LESS_THEN_OR_EQUAL,       // <=
+    TOKEN_LEFT_SHIFT,               // <<
+    TOKEN_GREAT_THEN,               // >
+    TOKEN_GREAT_THEN_OR_EQUAL,      // >=
+    TOKEN_RIGHT_SHIFT,              // >>
+    TOKEN_BITWIZE_OR,               // |
+    TOKEN_LOGICAL_OR,               // ||
+    TOKEN_BITWIZE_AND,              // &
+    TOKEN_LOGICAL_AND,              // &&
+    TOKEN_BITWIZE_NOT,              // ~
+    TOKEN_ADD,                      // +
+    TOKEN_SUBTRACT,                 // -
+    TOKEN_MULTIPLY,                 // *
+    TOKEN_DIVIDE,                   // /
+    TOKEN_MODULO,                   // %
 
-static inline bool matchAsign(const char* src, const char** end);            // =
-static inline bool matchEqual(const char* src, const char** end);            // ==
-static inline bool matchNotEqual(const char* src, const char** end);         // !=
-static inline bool matchLogicalNot(const char* src, const char** end);       // !
+    TOKEN_ADD_ASIGN,                // +=
+    TOKEN_SUBTRACT_ASIGN,           // -=
+    TOKEN_MULTIPLY_ASIGN,           // *=
+    TOKEN_DIVIDE_ASIGN,             // /=
+    TOKEN_MODULO_ASIGN,             // %=
+    TOKEN_BITWIZE_OR_ASIGN,         // |=
+    TOKEN_BITWIZE_AND_ASIGN,        // &=
+    TOKEN_BITWIZE_NOT_ASIGN,        // ~=
+    TOKEN_LEFT_SHIFT_ASIGN,         // <<=
+    TOKEN_RIGHT_SHIFT_ASIGN,        // >>=
+};
 
-static inline bool matchLessThen(const char* src, const char** end);         // <
-static inline bool matchLessThenOrEqual(const char* src, const char** end);  // >= 
-static inline bool matchLeftShift(const char* src, const char** end);        // <<
-static inline bool matchGreatThen(const char* src, const char** end);        // >
-static inline bool matchGreatThenOrEqual(const char* src, const char** end); // >=
-static inline bool matchRightShift(const char* src, const char** end);       // >>
+struct Token {
+    enum TokenType type;
+    uint32_t       offset;
+    uint32_t       length;
+    uint32_t       line;
+    uint32_t       symbol;      // names only, without the leading '.' or '@'
+};
 
-static inline bool matchBitwizeOr(const char* src, const char** end);        // |
-static inline bool matchLogicalOr(const char* src, const char** end);        // ||
-static inline bool matchBitwizeAnd(const char* src, const char** end);       // &
-static inline bool matchLogicalAnd(const char* src, const char** end);       // &&
+/*
+ * Whole file lexed up front. The last token is always TOKEN_END, so peeking
+ * past the end keeps returning it.
+ */
+struct Tokens {
+    struct Token* tokens;
+    size_t        count;
+    size_t        capacity;
+    size_t        position;
+};
 
-static inline bool matchChar(const char* src, const char** end, char c) {
-    skipWhiteSpaces(&src);
+// false on a lexing error, tokens has to be freed either way
+bool tokenize(struct Lexer* lexer, struct Tokens* tokens, const char* src);
+void freeTokens(struct Tokens* tokens);
+
+static inline struct Token* peekToken(struct Tokens* tokens, size_t n) {
+    size_t index = tokens -> position + n;
+    if (index >= tokens -> count) {
+        index = tokens -> count - 1;
+    }
+    return &tokens -> tokens[index];
+}
+
+static inline struct Token* nextToken(struct Tokens* tokens) {
+    struct Token* res = peekToken(tokens, 0);
+    if (tokens -> position + 1 < tokens -> count) {
+        tokens -> position++;
+    }
+    return res;
+}
+
+/*
+ * Keywords are found with a perfect hash: the slot of a name is the top
+ * KEYWORD_BITS bits of keywordKey times KEYWORD_SEED. findKeywordSeed in
+ * the tests searches for a new seed when a keyword is added.
+ */
+#define KEYWORD_BITS 5
+#define KEYWORD_SEED 0x8a98a25fu
+
+// the first two bytes, the last one and the length of a name
+static inline uint32_t keywordKey(const char* src, size_t length) {
+    return (uint32_t)(unsigned char)src[0]
+         | (uint32_t)(unsigned char)src[1] << 8
+         | (uint32_t)(unsigned char)src[length - 1] << 16
+         | (uint32_t)length << 24;
+}
+
+static inline uint32_t keywordSlot(uint32_t key, uint32_t seed) {
+    return (key * seed) >> (32 - KEYWORD_BITS);
+}
+
+void skipWhiteSpaces(struct Lexer* lexer, const char** src);
+
+bool matchUint(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    uint64_t*     result
+);
+bool matchFloat(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    long double*  result
+);
+
+// [A-Z][a-zA-Z0-9]*
+bool matchUpperName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+);
+// [a-z][a-zA-Z0-9]*
+bool matchLowerName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+);
+// .[a-zA-Z0-9]+
+bool matchDotName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+);
+// @[a-zA-Z0-9]+
+bool matchAtName(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+);
+// "[^"]*"
+bool matchString(
+    struct Lexer*  lexer,
+    const char*    src,
+    const char**   end,
+    struct String* result
+);
+
+bool matchKeyword(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    const char*   str
+);
+
+static inline bool matchChar(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    char          c
+);
+
+// =
+static inline bool matchAsign(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// ==
+static inline bool matchEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// !=
+static inline bool matchNotEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// !
+static inline bool matchLogicalNot(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+
+// <
+static inline bool matchLessThen(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// <=
+static inline bool matchLessThenOrEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// <<
+static inline bool matchLeftShift(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// >
+static inline bool matchGreatThen(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// >=
+static inline bool matchGreatThenOrEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// >>
+static inline bool matchRightShift(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+
+// |
+static inline bool matchBitwizeOr(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// ||
+static inline bool matchLogicalOr(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// &
+static inline bool matchBitwizeAnd(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+// &&
+static inline bool matchLogicalAnd(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+);
+
+static inline bool matchChar(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end,
+    char          c
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == c) {
         if (end != NULL) {
             (*end) = src + 1;
@@ -53,19 +329,27 @@ static inline bool matchChar(const char* src, const char** end, char c) {
     return false;
 }
 
-static inline bool matchAsign(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchAsign(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '=' && (*(src + 1)) != '=') {
         if (end != NULL) {
-            (*end) = src + 2;
+            (*end) = src + 1;
         }
         return true;
     }
     return false;
 }
 
-static inline bool matchEqual(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '=' && (*(src + 1)) == '=') {
         if (end != NULL) {
             (*end) = src + 2;
@@ -75,8 +359,12 @@ static inline bool matchEqual(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchNotEqual(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchNotEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '!' && (*(src + 1)) == '=') {
         if (end != NULL) {
             (*end) = src + 2;
@@ -86,30 +374,42 @@ static inline bool matchNotEqual(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchLogicalNot(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchLogicalNot(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '!' && (*(src + 1)) != '=') {
         if (end != NULL) {
-            (*end) = src + 2;
+            (*end) = src + 1;
         }
         return true;
     }
     return false;
 }
 
-static inline bool matchLessThen(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchLessThen(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '<' && (*(src + 1)) != '=' && (*(src + 1)) != '<') {
         if (end != NULL) {
-            (*end) = src + 2;
+            (*end) = src + 1;
         }
         return true;
     }
     return false;
 }
 
-static inline bool matchLessThenOrEqual(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchLessThenOrEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '<' && (*(src + 1)) == '=') {
         if (end != NULL) {
             (*end) = src + 2;
@@ -119,8 +419,12 @@ static inline bool matchLessThenOrEqual(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchLeftShift(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchLeftShift(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '<' && (*(src + 1)) == '<') {
         if (end != NULL) {
             (*end) = src + 2;
@@ -130,20 +434,28 @@ static inline bool matchLeftShift(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchGreatThen(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
-    if ((*src) == '>' && (*(src + 1)) != '=' && (*(src + 1)) != '<') {
+static inline bool matchGreatThen(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
+    if ((*src) == '>' && (*(src + 1)) != '=' && (*(src + 1)) != '>') {
         if (end != NULL) {
-            (*end) = src + 2;
+            (*end) = src + 1;
         }
         return true;
     }
     return false;
 }
 
-static inline bool matchGreatThenOrEqual(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
-    if ((*src) == '<' && (*(src + 1)) == '=') {
+static inline bool matchGreatThenOrEqual(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
+    if ((*src) == '>' && (*(src + 1)) == '=') {
         if (end != NULL) {
             (*end) = src + 2;
         }
@@ -152,8 +464,12 @@ static inline bool matchGreatThenOrEqual(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchRightShift(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchRightShift(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '>' && (*(src + 1)) == '>') {
         if (end != NULL) {
             (*end) = src + 2;
@@ -163,19 +479,27 @@ static inline bool matchRightShift(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchBitwizeOr(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchBitwizeOr(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '|' && (*(src + 1)) != '|') {
         if (end != NULL) {
-            (*end) = src + 2;
+            (*end) = src + 1;
         }
         return true;
     }
     return false;
 }
 
-static inline bool matchLogicalOr(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchLogicalOr(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '|' && (*(src + 1)) == '|') {
         if (end != NULL) {
             (*end) = src + 2;
@@ -185,19 +509,27 @@ static inline bool matchLogicalOr(const char* src, const char** end) {
     return false;
 }
 
-static inline bool matchBitwizeAnd(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchBitwizeAnd(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '&' && (*(src + 1)) != '&') {
         if (end != NULL) {
-            (*end) = src + 2;
+            (*end) = src + 1;
         }
         return true;
     }
     return false;
 }
 
-static inline bool matchLogicalAnd(const char* src, const char** end) {
-    skipWhiteSpaces(&src);
+static inline bool matchLogicalAnd(
+    struct Lexer* lexer,
+    const char*   src,
+    const char**  end
+) {
+    skipWhiteSpaces(lexer, &src);
     if ((*src) == '&' && (*(src + 1)) == '&') {
         if (end != NULL) {
             (*end) = src + 2;
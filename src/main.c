@@ -1,31 +1,171 @@
+#include <ctype.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 
 #include "args.h"
 #include "compile.h"
+#include "error.h"
+#include "file.h"
+#include "memory.h"
 
 struct Args args;
 
 static char const*         prog_name;
-static const char*         opt_short = "o:";
+static const char*         opt_short = "o:j:c";
 static const struct option opt_long[] = {
     { "output",                 required_argument, NULL,                'o' },
+    { "emit",                   required_argument, NULL,                'E' },
+    { "fold",                   no_argument,       &args.fold,           1  },
+    { "jobs",                   required_argument, NULL,                'j' },
+    { "cache-dir",              required_argument, NULL,                'C' },
+    { "time-report",            optional_argument, NULL,                'T' },
+    { "mem-report",             no_argument,       &args.mem_report,     1  },
+    { "print-ir",               no_argument,       &args.print_ir,       1  },
+    { "print-layout",           no_argument,       &args.print_layout,   1  },
+    { "time-passes",            no_argument,       &args.time_passes,    1  },
+    { "run",                    no_argument,       &args.run,            1  },
+    { "test",                   no_argument,       &args.test,           1  },
+    { "native",                 no_argument,       &args.native,         1  },
     { "verbose",                no_argument,       &args.verbose,        1  },
     { NULL,                     0,                 NULL,                 0  }
 };
 
+struct Paths {
+    const char** paths;
+    size_t       count;
+    size_t       capacity;
+};
+
 static void usage(void) {
     fprintf(
         stderr,
         "usage:\t%s\n"
-        "\t%s [options] <file>\n",
+        "\t%s [options] <file|@response-file>...\n"
+        "options:\n"
+        "\t-o, --output <file>     write to file instead of stdout\n"
+        "\t-c                      write an x86-64 ELF object of every file,"
+        " file.o or -o\n"
+        "\t    --emit=ast|c        print the tree back, or translate it"
+        " to C11\n"
+        "\t    --fold              print the tree with constant expretions"
+        " folded\n"
+        "\t-j, --jobs <n>          files compiled at once, default one per"
+        " cpu\n"
+        "\t    --cache-dir <dir>   keep parsed files in dir and reuse them\n"
+        "\t    --time-report[=table|json]\n"
+        "\t                        time of every phase per file, to stderr\n"
+        "\t    --mem-report        allocations by kind, peak rss and arena use,"
+        " to stderr\n"
+        "\t    --print-ir          print the optimized SSA form instead\n"
+        "\t    --print-layout      print size, padding and cache lines of"
+        " every type\n"
+        "\t    --time-passes       time and instructions of every"
+        " optimization, to stderr\n"
+        "\t    --run               run func main of every file\n"
+        "\t    --test              run the tests of every file\n"
+        "\t    --native            run them as x86-64 machine code, not"
+        " bytecode\n"
+        "\t    --verbose\n",
         prog_name,
         prog_name
     );
     exit(EXIT_FAILURE);
 }
 
+static size_t parseJobs(const char* str) {
+    char* end;
+    long res = strtol(str, &end, 10);
+    if (end == str || *end != 0 || res < 1) {
+        fprintf(stderr, "%s: -j expects a positive number, got '%s'\n",
+            prog_name, str);
+        exit(EXIT_FAILURE);
+    }
+    return (size_t) res;
+}
+
+static enum Emit parseEmit(const char* str) {
+    if (strcmp(str, "ast") == 0) {
+        return EMIT_AST;
+    }
+    if (strcmp(str, "c") == 0) {
+        return EMIT_C;
+    }
+    fprintf(stderr, "%s: --emit is ast or c, got '%s'\n", prog_name, str);
+    exit(EXIT_FAILURE);
+}
+
+static enum TimeReport parseTimeReport(const char* str) {
+    if (str == NULL || strcmp(str, "table") == 0) {
+        return TIME_REPORT_TABLE;
+    }
+    if (strcmp(str, "json") == 0) {
+        return TIME_REPORT_JSON;
+    }
+    fprintf(stderr, "%s: --time-report is table or json, got '%s'\n",
+        prog_name, str);
+    exit(EXIT_FAILURE);
+}
+
+static void appendPath(struct Paths* paths, const char* path) {
+    if (paths -> count == paths -> capacity) {
+        paths -> capacity = paths -> capacity == 0 ? 16 : paths -> capacity * 2;
+        paths -> paths = memoryRealloc(
+            paths -> paths,
+            paths -> capacity * sizeof(const char*)
+        );
+    }
+    paths -> paths[paths -> count++] = path;
+}
+
+static void appendArg(struct Paths* paths, const char* arg, size_t depth);
+
+// whitespace separated arguments, which may be response files themselves
+static void appendResponseFile(
+    struct Paths* paths,
+    const char*   path,
+    size_t        depth
+) {
+    if (depth > 16) {
+        fprintf(stderr, "%s: response files nest too deep at '%s'\n",
+            prog_name, path);
+        exit(EXIT_FAILURE);
+    }
+    struct File file;
+    struct Error error = { 0 };
+    if (!readFile(&file, path, &error)) {
+        printError(stderr, &error);
+        exit(EXIT_FAILURE);
+    }
+    const char* now = file.text;
+    while (true) {
+        while (isspace((unsigned char) *now)) {
+            now++;
+        }
+        if (*now == 0) {
+            break;
+        }
+        const char* start = now;
+        while (*now != 0 && !isspace((unsigned char) *now)) {
+            now++;
+        }
+        // lives as long as the paths, i.e. until the process exits
+        char* arg = memoryStringnLengthDup(start, now - start);
+        appendArg(paths, arg, depth + 1);
+    }
+    closeFile(&file);
+}
+
+static void appendArg(struct Paths* paths, const char* arg, size_t depth) {
+    if (arg[0] == '@') {
+        appendResponseFile(paths, arg + 1, depth);
+    } else {
+        appendPath(paths, arg);
+    }
+}
+
 int main(int argc, char** argv) {
     prog_name = argv[0];
     static char ch;
@@ -34,6 +174,21 @@ int main(int argc, char** argv) {
         case 'o':
             args.output = optarg;
             break;
+        case 'E':
+            args.emit = parseEmit(optarg);
+            break;
+        case 'c':
+            args.object = 1;
+            break;
+        case 'j':
+            args.jobs = parseJobs(optarg);
+            break;
+        case 'C':
+            args.cache_dir = optarg;
+            break;
+        case 'T':
+            args.time_report = parseTimeReport(optarg);
+            break;
         case 0:
             break;
         default:
@@ -44,11 +199,25 @@ int main(int argc, char** argv) {
     argc -= optind;
     argv += optind;
 
-    if (argc != 1) {
+    struct Paths paths = { 0 };
+    for (int i = 0; i < argc; i++) {
+        appendArg(&paths, argv[i], 0);
+    }
+    if (paths.count == 0) {
         usage();
     }
- 
-    compile(argv[0]);
+    if (args.object && args.output != NULL && paths.count > 1) {
+        fprintf(stderr, "%s: -c with -o takes one file\n", prog_name);
+        exit(EXIT_FAILURE);
+    }
 
-    return EXIT_SUCCESS;
+    // has to be set before compile starts any thread
+    memoryTrack(args.mem_report);
+    bool res = compile(paths.paths, paths.count);
+
+    memoryFree(paths.paths);
+    if (args.mem_report) {
+        printMemoryReport(stderr);
+    }
+    return res ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -1,13 +1,119 @@
+#include <malloc.h>
+// for: malloc_usable_size
+#include <stdatomic.h>
+// for: atomic_fetch_add_explicit, atomic_load_explicit
 #include <stdio.h>
-// for: perror
+// for: perror, fprintf
 #include <stdlib.h>
 // for: calloc, free, realloc, exit EXIT_FAILURE
 #include <string.h>
-// for: strdup, strndup
+// for: strdup, strndup, memcpy, memset
+#include <sys/resource.h>
+// for: getrusage
 
 #include "memory.h"
 
-void* memoryAlloc(size_t size) {
+static bool tracking;
+
+static _Atomic size_t stats_allocs[MEMORY_KINDS];
+static _Atomic size_t stats_bytes[MEMORY_KINDS];
+static _Atomic size_t stats_arenas;
+static _Atomic size_t stats_arena_chunks;
+static _Atomic size_t stats_arena_reserved;
+static _Atomic size_t stats_arena_used;
+
+static const char* const kind_names[MEMORY_KINDS] = {
+    [MEMORY_OTHER]     = "other",
+    [MEMORY_FILE]      = "file",
+    [MEMORY_TOKEN]     = "token",
+    [MEMORY_SYMBOL]    = "symbol",
+    [MEMORY_STRING]    = "string",
+    [MEMORY_DECL]      = "decl",
+    [MEMORY_PATH]      = "path",
+    [MEMORY_TYPE]      = "type",
+    [MEMORY_EXPRETION] = "expretion",
+    [MEMORY_STATEMENT] = "statement",
+    [MEMORY_BYTECODE]  = "bytecode",
+    [MEMORY_VM]        = "vm",
+    [MEMORY_IR]        = "ir",
+    [MEMORY_NATIVE]    = "native",
+    [MEMORY_ARENA]     = "arena",
+    [MEMORY_CACHE]     = "cache",
+};
+
+static inline void countAdd(_Atomic size_t* counter, size_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline size_t countGet(_Atomic size_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static inline void countAlloc(enum MemoryKind kind, size_t size) {
+    if (tracking) {
+        countAdd(&stats_allocs[kind], 1);
+        countAdd(&stats_bytes[kind], size);
+    }
+}
+
+void memoryTrack(bool track) {
+    tracking = track;
+}
+
+struct MemoryStats memoryStats(void) {
+    struct MemoryStats res = {
+        .arenas         = countGet(&stats_arenas),
+        .arena_chunks   = countGet(&stats_arena_chunks),
+        .arena_reserved = countGet(&stats_arena_reserved),
+        .arena_used     = countGet(&stats_arena_used)
+    };
+    for (int kind = 0; kind < MEMORY_KINDS; kind++) {
+        res.kinds[kind] = (struct MemoryKindStats) {
+            .allocs = countGet(&stats_allocs[kind]),
+            .bytes  = countGet(&stats_bytes[kind])
+        };
+        res.allocs += res.kinds[kind].allocs;
+        res.bytes  += res.kinds[kind].bytes;
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        res.peak_rss = (size_t) usage.ru_maxrss * 1024;
+    }
+    return res;
+}
+
+void printMemoryReport(FILE* stream) {
+    struct MemoryStats stats = memoryStats();
+    fprintf(stream, "memory report: peak rss %.1f MB\n",
+        stats.peak_rss / (1024.0 * 1024.0));
+    fprintf(stream, "%-16s %12s %14s %12s\n", "kind", "allocs", "bytes",
+        "bytes/alloc");
+    for (int kind = 0; kind < MEMORY_KINDS; kind++) {
+        struct MemoryKindStats kind_stats = stats.kinds[kind];
+        if (kind_stats.allocs == 0) {
+            continue;
+        }
+        fprintf(stream, "  %-14s %12zu %14zu %12.1f\n", kind_names[kind],
+            kind_stats.allocs, kind_stats.bytes,
+            (double) kind_stats.bytes / kind_stats.allocs);
+    }
+    fprintf(stream, "  %-14s %12zu %14zu\n", "total", stats.allocs,
+        stats.bytes);
+    fprintf(
+        stream,
+        "arenas: %zu, %zu chunks, %zu of %zu bytes used (%.1f%%)\n",
+        stats.arenas,
+        stats.arena_chunks,
+        stats.arena_used,
+        stats.arena_reserved,
+        stats.arena_reserved == 0
+            ? 0.0
+            : stats.arena_used * 100.0 / stats.arena_reserved
+    );
+}
+
+void* memoryAllocKind(enum MemoryKind kind, size_t size) {
+    countAlloc(kind, size);
     void* res = calloc(1, size);
     if (res == NULL) {
         perror("Memory Error");
@@ -16,7 +122,11 @@ void* memoryAlloc(size_t size) {
     return res;
 }
 
-void* memoryRealloc(void* mem, size_t size) {
+void* memoryReallocKind(enum MemoryKind kind, void* mem, size_t size) {
+    if (tracking) {
+        size_t old = mem == NULL ? 0 : malloc_usable_size(mem);
+        countAlloc(kind, size > old ? size - old : 0);
+    }
     void* res = realloc(mem, size);
     if (res == NULL) {
         perror("Memory Error");
@@ -31,6 +141,7 @@ void memoryFree(void* mem) {
 
 char* memoryStringnDup(const char *str) {
     void* res = strdup(str);
+    countAlloc(MEMORY_STRING, strlen(str) + 1);
     if (res == NULL) {
         perror("Memory Error");
         exit(EXIT_FAILURE);
@@ -40,9 +151,93 @@ char* memoryStringnDup(const char *str) {
 
 char* memoryStringnLengthDup(const char *str, size_t length) {
     void* res = strndup(str, length);
+    countAlloc(MEMORY_STRING, length + 1);
     if (res == NULL) {
         perror("Memory Error");
         exit(EXIT_FAILURE);
     }
     return res;
 }
+
+void arenaInit(struct Arena* arena, size_t chunk_size) {
+    arena -> first = NULL;
+    arena -> current = NULL;
+    arena -> chunk_size = chunk_size != 0 ? chunk_size : ARENA_CHUNK_SIZE;
+}
+
+static struct ArenaChunk* arenaNewChunk(size_t size) {
+    struct ArenaChunk* res = memoryAllocKind(
+        MEMORY_ARENA,
+        sizeof(struct ArenaChunk) + size
+    );
+    res -> size = size;
+    return res;
+}
+
+void* arenaAllocSlow(struct Arena* arena, size_t size, size_t align) {
+    // chunks kept by arenaReset are reused before asking for new ones
+    while (arena -> current != NULL && arena -> current -> next != NULL) {
+        arena -> current = arena -> current -> next;
+        struct ArenaChunk* chunk = arena -> current;
+        size_t start = (chunk -> used + align - 1) & ~(align - 1);
+        if (start + size <= chunk -> size) {
+            chunk -> used = start + size;
+            return chunk -> data + start;
+        }
+    }
+
+    size_t chunk_size = arena -> chunk_size;
+    if (size + align > chunk_size) {
+        chunk_size = size + align;
+    }
+    struct ArenaChunk* chunk = arenaNewChunk(chunk_size);
+    if (arena -> current == NULL) {
+        arena -> first = chunk;
+    } else {
+        arena -> current -> next = chunk;
+    }
+    arena -> current = chunk;
+
+    size_t start = (chunk -> used + align - 1) & ~(align - 1);
+    chunk -> used = start + size;
+    return chunk -> data + start;
+}
+
+void arenaReset(struct Arena* arena) {
+    for (struct ArenaChunk* chunk = arena -> first;
+         chunk != NULL;
+         chunk = chunk -> next) {
+        memset(chunk -> data, 0, chunk -> used);
+        chunk -> used = 0;
+    }
+    arena -> current = arena -> first;
+}
+
+void arenaFree(struct Arena* arena) {
+    if (tracking) {
+        countAdd(&stats_arenas, 1);
+    }
+    struct ArenaChunk* chunk = arena -> first;
+    while (chunk != NULL) {
+        struct ArenaChunk* next = chunk -> next;
+        if (tracking) {
+            countAdd(&stats_arena_chunks, 1);
+            countAdd(&stats_arena_reserved, chunk -> size);
+            countAdd(&stats_arena_used, chunk -> used);
+        }
+        memoryFree(chunk);
+        chunk = next;
+    }
+    arena -> first = NULL;
+    arena -> current = NULL;
+}
+
+char* arenaStringnLengthDup(
+    struct Arena* arena,
+    const char*   str,
+    size_t        length
+) {
+    char* res = arenaAllocAligned(arena, length + 1, 1);
+    memcpy(res, str, length);
+    return res;
+}
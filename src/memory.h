@@ -1,14 +1,129 @@
 #ifndef MAMOERY_H
 #define MAMOERY_H
 
+#include <stdbool.h>
+// for: bool
 #include <stddef.h>
-// for: size_t
+// for: size_t, max_align_t
+#include <stdio.h>
+// for: FILE
 
-void* memoryAlloc(size_t size);
-void* memoryRealloc(void* mem, size_t size);
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN      (_Alignof(max_align_t))
+
+/*
+ * What an allocation is for, reported by --mem-report. memoryAlloc and
+ * memoryRealloc are MEMORY_OTHER, the AST arrays are counted by the kind
+ * of node they hold.
+ */
+enum MemoryKind {
+    MEMORY_OTHER,
+    MEMORY_FILE,                // source text
+    MEMORY_TOKEN,
+    MEMORY_SYMBOL,              // symbol table, the names are in its arena
+    MEMORY_STRING,              // string literals and copies of strings
+    MEMORY_DECL,
+    MEMORY_PATH,                // AST.names: paths, type params, filds
+    MEMORY_TYPE,
+    MEMORY_EXPRETION,
+    MEMORY_STATEMENT,
+    MEMORY_BYTECODE,
+    MEMORY_VM,                  // registers and call frames
+    MEMORY_IR,
+    MEMORY_NATIVE,              // machine code and what it needs
+    MEMORY_ARENA,               // arena chunks
+    MEMORY_CACHE,
+    MEMORY_KINDS,
+};
+
+void* memoryAllocKind(enum MemoryKind kind, size_t size);
+void* memoryReallocKind(enum MemoryKind kind, void* mem, size_t size);
 void  memoryFree(void* mem);
 
 char* memoryStringnDup(const char *str);
 char* memoryStringnLengthDup(const char *str, size_t length);
 
+static inline void* memoryAlloc(size_t size) {
+    return memoryAllocKind(MEMORY_OTHER, size);
+}
+
+static inline void* memoryRealloc(void* mem, size_t size) {
+    return memoryReallocKind(MEMORY_OTHER, mem, size);
+}
+
+/*
+ * Process wide and only counted after memoryTrack(true), which has to
+ * come before any thread is started. bytes is what the heap grew by, a
+ * realloc counts the difference to the old block. Arenas are counted
+ * when they are freed.
+ */
+struct MemoryKindStats {
+    size_t allocs;
+    size_t bytes;
+};
+
+struct MemoryStats {
+    size_t                 allocs;
+    size_t                 bytes;
+    struct MemoryKindStats kinds[MEMORY_KINDS];
+    size_t                 arenas;
+    size_t                 arena_chunks;
+    size_t                 arena_reserved;  // bytes in chunks
+    size_t                 arena_used;      // bytes handed out of them
+    size_t                 peak_rss;        // bytes, whatever tracking says
+};
+
+void               memoryTrack(bool track);
+struct MemoryStats memoryStats(void);
+void               printMemoryReport(FILE* stream);
+
+/*
+ * Bump pointer allocator. Memory comes from big zeroed chunks and is never
+ * freed one by one, only all at once with arenaReset or arenaFree.
+ */
+
+struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t             size;
+    size_t             used;
+    _Alignas(max_align_t) unsigned char data[];
+};
+
+struct Arena {
+    struct ArenaChunk* first;
+    struct ArenaChunk* current;
+    size_t             chunk_size;
+};
+
+void  arenaInit(struct Arena* arena, size_t chunk_size);
+void* arenaAllocSlow(struct Arena* arena, size_t size, size_t align);
+void  arenaReset(struct Arena* arena);
+void  arenaFree(struct Arena* arena);
+
+char* arenaStringnLengthDup(
+    struct Arena* arena,
+    const char*   str,
+    size_t        length
+);
+
+static inline void* arenaAllocAligned(
+    struct Arena* arena,
+    size_t        size,
+    size_t        align
+) {
+    struct ArenaChunk* chunk = arena -> current;
+    if (chunk != NULL) {
+        size_t start = (chunk -> used + align - 1) & ~(align - 1);
+        if (start + size <= chunk -> size) {
+            chunk -> used = start + size;
+            return chunk -> data + start;
+        }
+    }
+    return arenaAllocSlow(arena, size, align);
+}
+
+static inline void* arenaAlloc(struct Arena* arena, size_t size) {
+    return arenaAllocAligned(arena, size, ARENA_ALIGN);
+}
+
 #endif
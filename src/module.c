@@ -0,0 +1,515 @@
+#include <limits.h>
+// for: PATH_MAX
+#include <stdio.h>
+// for: snprintf
+#include <stdlib.h>
+// for: realpath
+#include <string.h>
+// for: memcpy, strlen, strrchr
+#include <sys/stat.h>
+// for: stat, S_ISREG
+
+#include "args.h"
+#include "cache.h"
+#include "interface.h"
+#include "module.h"
+#include "parser.h"
+#include "pool.h"
+
+#define MODULE_ERROR     "Compile error"
+#define MODULE_EXTENSION ".micro"
+
+// modules with no file, see the natives of bytecode.c and emitc.c
+static const char* const builtin_modules[] = { "Cosole", "File", "Test" };
+
+// the modules one pool run works on
+struct Wave {
+    struct Modules* modules;
+    const uint32_t* items;          // Modules.items
+};
+
+enum Visit {
+    VISIT_NONE,
+    VISIT_OPEN,                     // on the path from the root
+    VISIT_DONE,
+};
+
+// key is the real path of the file, NULL for stdin
+static uint32_t addModule(
+    struct Modules* modules,
+    const char*     path,
+    const char*     key,
+    bool            is_root
+) {
+    struct Module* module = memoryAlloc(sizeof(struct Module));
+    (*module) = (struct Module) {
+        .path    = memoryStringnDup(path),
+        .key     = key == NULL ? NULL : memoryStringnDup(key),
+        .is_root = is_root
+    };
+    if (key != NULL) {
+        uint32_t id = internSymbol(&modules -> keys, key, strlen(key));
+        if (id == modules -> by_key.count) {
+            pushNode(modules -> by_key, MEMORY_OTHER, modules -> items.count);
+        }
+    }
+    return pushNode(modules -> items, MEMORY_OTHER, module);
+}
+
+// the module that has the file at key already, or UINT32_MAX
+static uint32_t findModule(struct Modules* modules, const char* key) {
+    uint32_t id = internSymbol(&modules -> keys, key, strlen(key));
+    return id < modules -> by_key.count
+        ? modules -> by_key.items[id]
+        : UINT32_MAX;
+}
+
+// what importers see of the module, for the next time it is imported
+static void storeInterface(struct Module* module, uint64_t key) {
+    struct Arena arena;
+    arenaInit(&arena, ARENA_CHUNK_SIZE);
+    struct Symbols symbols;
+    initSymbols(&symbols, &arena);
+    struct AST iface;
+    initAST(&iface, &symbols);
+    buildInterface(&iface, &module -> ast);
+    timeBegin("interface store");
+    storeCachedInterface(args.cache_dir, key, &iface);
+    timeEnd();
+    freeAST(&iface);
+    freeSymbols(&symbols);
+    arenaFree(&arena);
+}
+
+/*
+ * Reads and parses a module, through the AST cache if there is one. An
+ * imported module whose bytes had their interface stored before is that
+ * interface, its file is not parsed.
+ */
+static void parseModule(void* data, size_t index) {
+    struct Wave* wave = data;
+    struct Modules* modules = wave -> modules;
+    struct Module* module = modules -> items.items[wave -> items[index]];
+    struct Timings* previous = timingsAttach(module -> timings);
+
+    arenaInit(&module -> arena, ARENA_CHUNK_SIZE);
+    initSymbols(&module -> symbols, &module -> arena);
+    initAST(&module -> ast, &module -> symbols);
+    module -> is_loaded = true;
+    struct AST* ast = &module -> ast;
+
+    timeBegin("read");
+    bool is_read = readFile(&module -> file, module -> path,
+        &module -> error);
+    timeEnd();
+    if (!is_read) {
+        module -> failed = true;
+        timingsAttach(previous);
+        return;
+    }
+    const char* text = module -> file.text;
+
+    // keyed by the bytes read, a file that changes meanwhile is no matter
+    uint64_t interface = 0;
+    bool has_interface = args.cache_dir != NULL && module -> key != NULL;
+    if (has_interface) {
+        interface = interfaceKey(text, module -> file.length);
+    }
+    if (has_interface && !module -> is_root) {
+        timeBegin("interface load");
+        module -> is_interface = loadCachedInterface(args.cache_dir,
+            interface, ast);
+        timeEnd();
+    }
+    if (module -> is_interface) {
+        module -> parsed = true;
+        timingsAttach(previous);
+        return;
+    }
+    bool parsed = false;
+    bool cached = false;
+    if (args.cache_dir != NULL) {
+        timeBegin("cache load");
+        uint64_t key = cacheKey(text, module -> file.length);
+        cached = loadCachedAST(args.cache_dir, key, ast);
+        timeEnd();
+        parsed = cached;
+        if (!parsed) {
+            timeBegin("parse");
+            parsed = parse(ast, text, module -> path, &module -> error);
+            timeEnd();
+            if (parsed) {
+                timeBegin("cache store");
+                storeCachedAST(args.cache_dir, key, ast);
+                timeEnd();
+            }
+        }
+    } else {
+        timeBegin("parse");
+        parsed = parse(ast, text, module -> path, &module -> error);
+        timeEnd();
+    }
+    // a root found in the cache was parsed by an earlier run, which stored
+    // its interface under the same bytes
+    if (parsed && has_interface && !(module -> is_root && cached)) {
+        storeInterface(module, interface);
+    }
+    module -> parsed = parsed;
+    module -> failed = !parsed;
+    timingsAttach(previous);
+}
+
+// A.b or .a.b, cut to fit
+static void formatPath(
+    struct AST* ast,
+    struct Path path,
+    char*       buffer,
+    size_t      size
+) {
+    size_t length = 0;
+    buffer[0] = '\0';
+    for (uint32_t i = 0; i < path.names.count && length < size; i++) {
+        struct String name = symbolString(ast -> symbols,
+            ast -> names.items[path.names.start + i]);
+        length += (size_t) snprintf(buffer + length, size - length, "%s%.*s",
+            i != 0 || path.is_relative ? "." : "", (int) name.length,
+            name.string);
+    }
+}
+
+static bool isBuiltinModule(struct AST* ast, struct Path path) {
+    if (path.is_relative || path.names.count == 0) {
+        return false;
+    }
+    struct String name = symbolString(ast -> symbols,
+        ast -> names.items[path.names.start]);
+    for (size_t i = 0; i < sizeof(builtin_modules) / sizeof(char*); i++) {
+        if (strlen(builtin_modules[i]) == name.length
+         && memcmp(builtin_modules[i], name.string, name.length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * dir/A/B.micro for the first count names of path, with the first letter
+ * of the file lowered if lower is set, like array.micro for Array.
+ */
+static bool candidate(
+    struct AST* ast,
+    struct Path path,
+    uint32_t    count,
+    bool        lower,
+    const char* dir,
+    char*       buffer
+) {
+    size_t length = (size_t) snprintf(buffer, PATH_MAX, "%s", dir);
+    for (uint32_t i = 0; i < count && length < PATH_MAX; i++) {
+        struct String name = symbolString(ast -> symbols,
+            ast -> names.items[path.names.start + i]);
+        length += (size_t) snprintf(buffer + length, PATH_MAX - length,
+            "/%.*s", (int) name.length, name.string);
+        if (lower && i == count - 1 && length < PATH_MAX) {
+            char* first = buffer + length - name.length;
+            (*first) = (char) (*first >= 'A' && *first <= 'Z'
+                ? *first - 'A' + 'a'
+                : *first);
+        }
+    }
+    length += (size_t) snprintf(buffer + length,
+        length < PATH_MAX ? PATH_MAX - length : 0, MODULE_EXTENSION);
+    struct stat info;
+    return length < PATH_MAX && stat(buffer, &info) == 0
+        && S_ISREG(info.st_mode);
+}
+
+// the file of every import of a module, new files become modules
+static void findImports(struct Modules* modules, uint32_t index) {
+    struct Module* module = modules -> items.items[index];
+    struct AST* ast = &module -> ast;
+    char dir[PATH_MAX];
+    const char* slash = module -> key == NULL
+        ? NULL
+        : strrchr(module -> key, '/');
+    if (slash == NULL) {
+        memcpy(dir, ".", 2);
+    } else {
+        size_t length = (size_t) (slash - module -> key);
+        memcpy(dir, module -> key, length);
+        dir[length] = '\0';
+    }
+
+    char buffer[PATH_MAX];
+    char real[PATH_MAX];
+    for (uint32_t i = 0; i < ast -> imports.count; i++) {
+        struct Path path = ast -> imports.items[i].path;
+        if (isBuiltinModule(ast, path)) {
+            continue;
+        }
+        uint32_t names = path.names.count;
+        while (names > 0
+            && !candidate(ast, path, names, false, dir, buffer)
+            && !candidate(ast, path, names, true, dir, buffer)) {
+            names--;
+        }
+        if (names == 0 || realpath(buffer, real) == NULL) {
+            char printed[128];
+            formatPath(ast, path, printed, sizeof(printed));
+            candidate(ast, path, 1, false, dir, buffer);
+            setError(&module -> error, MODULE_ERROR, module -> path, 0,
+                "no file for import %s, looked for %s", printed, buffer);
+            module -> failed = true;
+            continue;
+        }
+        uint32_t found = findModule(modules, real);
+        if (found == UINT32_MAX) {
+            found = addModule(modules, buffer, real, false);
+        }
+        struct ModuleImport import = {
+            .import = i,
+            .module = found,
+            .names  = names
+        };
+        pushNode(module -> imports, MEMORY_OTHER, import);
+    }
+}
+
+// a -> b -> a, into the error of the module the cycle starts from
+static void reportCycle(
+    struct Modules* modules,
+    uint32_t*       path,
+    uint32_t        count
+) {
+    struct Module* first = modules -> items.items[path[0]];
+    char message[200];
+    size_t length = 0;
+    message[0] = '\0';
+    for (uint32_t i = 0; i <= count && length < sizeof(message); i++) {
+        struct Module* module = modules -> items.items[path[i % count]];
+        length += (size_t) snprintf(message + length,
+            sizeof(message) - length, "%s%s", i == 0 ? "" : " -> ",
+            module -> path);
+    }
+    setError(&first -> error, MODULE_ERROR, first -> path, 0,
+        "import cycle %s", message);
+    first -> failed = true;
+}
+
+/*
+ * Depth first with an explicit stack, a module open on it that is
+ * imported again closes a cycle. A module is done after its imports, so
+ * its wave is one more than the last of theirs.
+ */
+static bool findWaves(struct Modules* modules) {
+    uint32_t count = modules -> items.count;
+    uint8_t* visits = memoryAlloc(count + 1);
+    memset(visits, VISIT_NONE, count + 1);
+    NODES(uint32_t) stack = { 0 };
+    NODES(uint32_t) edges = { 0 };          // next import to follow
+    bool res = true;
+    for (uint32_t root = 0; root < count; root++) {
+        if (visits[root] != VISIT_NONE) {
+            continue;
+        }
+        visits[root] = VISIT_OPEN;
+        pushNode(stack, MEMORY_OTHER, root);
+        pushNode(edges, MEMORY_OTHER, 0);
+        while (stack.count != 0) {
+            uint32_t top = stack.count - 1;
+            struct Module* module = modules -> items.items[stack.items[top]];
+            if (edges.items[top] == module -> imports.count) {
+                module -> wave = 0;
+                for (uint32_t i = 0; i < module -> imports.count; i++) {
+                    uint32_t wave = modules -> items.items[
+                        module -> imports.items[i].module
+                    ] -> wave + 1;
+                    module -> wave = wave > module -> wave
+                        ? wave
+                        : module -> wave;
+                }
+                if (module -> wave + 1 > modules -> waves) {
+                    modules -> waves = module -> wave + 1;
+                }
+                visits[stack.items[top]] = VISIT_DONE;
+                stack.count--;
+                edges.count--;
+                continue;
+            }
+            uint32_t next = module -> imports.items[edges.items[top]++].module;
+            if (visits[next] == VISIT_OPEN) {
+                uint32_t from = top;
+                while (stack.items[from] != next) {
+                    from--;
+                }
+                reportCycle(modules, &stack.items[from], top - from + 1);
+                res = false;
+            } else if (visits[next] == VISIT_NONE) {
+                visits[next] = VISIT_OPEN;
+                pushNode(stack, MEMORY_OTHER, next);
+                pushNode(edges, MEMORY_OTHER, 0);
+            }
+        }
+    }
+    memoryFree(visits);
+    memoryFree(stack.items);
+    memoryFree(edges.items);
+    return res;
+}
+
+static bool isNamed(
+    struct Module* module,
+    uint32_t       symbol,
+    struct String  name
+) {
+    struct String string = symbolString(&module -> symbols, symbol);
+    return string.length == name.length
+        && memcmp(string.string, name.string, name.length) == 0;
+}
+
+// whether the module exports a type or func without self called name
+static bool isExported(struct Module* module, struct String name, bool type) {
+    struct AST* ast = &module -> ast;
+    for (uint32_t i = 0; i < ast -> type_decls.count; i++) {
+        struct TypeDecl* decl = &ast -> type_decls.items[i];
+        if (decl -> is_exported && isNamed(module, decl -> header.name, name)) {
+            return true;
+        }
+    }
+    for (uint32_t i = 0; i < ast -> funcs.count && !type; i++) {
+        struct FuncDecl* func = &ast -> funcs.items[i];
+        if (func -> is_exported && !func -> has_self
+         && isNamed(module, func -> name, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * The name after the file has to be exported by it, A.Type.fild only
+ * needs Type. The modules imported are of earlier waves, done and only
+ * read here.
+ */
+static void checkModule(void* data, size_t index) {
+    struct Wave* wave = data;
+    struct Modules* modules = wave -> modules;
+    struct Module* module = modules -> items.items[wave -> items[index]];
+    struct Timings* previous = timingsAttach(module -> timings);
+    timeBegin("imports");
+    struct AST* ast = &module -> ast;
+    for (uint32_t i = 0; i < module -> imports.count; i++) {
+        struct ModuleImport import = module -> imports.items[i];
+        struct Module* other = modules -> items.items[import.module];
+        struct Path path = ast -> imports.items[import.import].path;
+        if (!other -> parsed || import.names == path.names.count) {
+            continue;
+        }
+        struct String name = symbolString(ast -> symbols,
+            ast -> names.items[path.names.start + import.names]);
+        bool is_type = path.names.count - import.names > 1;
+        if (!isExported(other, name, is_type)) {
+            setError(&module -> error, MODULE_ERROR, module -> path, 0,
+                "%.*s is not exported by %s", (int) name.length,
+                name.string, other -> path);
+            module -> failed = true;
+        }
+    }
+    timeEnd();
+    timingsAttach(previous);
+}
+
+bool loadModules(
+    struct Modules*  modules,
+    const char**     paths,
+    struct Timings** timings,
+    size_t           count,
+    size_t           workers
+) {
+    (*modules) = (struct Modules) { 0 };
+    arenaInit(&modules -> arena, ARENA_CHUNK_SIZE);
+    initSymbols(&modules -> keys, &modules -> arena);
+    char real[PATH_MAX];
+    for (size_t i = 0; i < count; i++) {
+        // a root is a module of its own even if given twice, units own it
+        const char* key = paths[i];
+        if (strcmp(paths[i], "-") == 0) {
+            key = NULL;
+        } else if (realpath(paths[i], real) != NULL) {
+            key = real;
+        }
+        uint32_t index = addModule(modules, paths[i], key, true);
+        modules -> items.items[index] -> timings =
+            timings == NULL ? NULL : timings[i];
+    }
+
+    // every wave parses the files the one before found
+    uint32_t* items = NULL;
+    uint32_t start = 0;
+    while (start < modules -> items.count) {
+        uint32_t end = modules -> items.count;
+        items = memoryRealloc(items, (end - start) * sizeof(uint32_t));
+        for (uint32_t i = start; i < end; i++) {
+            items[i - start] = i;
+        }
+        struct Wave wave = { .modules = modules, .items = items };
+        timeBegin("parse wave");
+        poolRun(workers, end - start, parseModule, &wave);
+        timeEnd();
+        for (uint32_t i = start; i < end; i++) {
+            if (modules -> items.items[i] -> parsed) {
+                findImports(modules, i);
+            }
+        }
+        start = end;
+    }
+
+    bool res = findWaves(modules);
+    uint32_t total = modules -> items.count;
+    items = memoryRealloc(items, (total + 1) * sizeof(uint32_t));
+    for (uint32_t wave = 0; wave < modules -> waves && res; wave++) {
+        uint32_t size = 0;
+        for (uint32_t i = 0; i < total; i++) {
+            struct Module* module = modules -> items.items[i];
+            if (module -> wave == wave && module -> parsed) {
+                items[size++] = i;
+            }
+        }
+        struct Wave run = { .modules = modules, .items = items };
+        timeBegin("check wave");
+        poolRun(workers, size, checkModule, &run);
+        timeEnd();
+    }
+    memoryFree(items);
+    for (uint32_t i = 0; i < total; i++) {
+        res = res && !modules -> items.items[i] -> failed;
+    }
+    return res;
+}
+
+void freeModule(struct Module* module) {
+    if (!module -> is_loaded) {
+        return;
+    }
+    freeAST(&module -> ast);
+    freeSymbols(&module -> symbols);
+    arenaFree(&module -> arena);
+    closeFile(&module -> file);
+    module -> is_loaded = false;
+}
+
+void freeModules(struct Modules* modules) {
+    for (uint32_t i = 0; i < modules -> items.count; i++) {
+        struct Module* module = modules -> items.items[i];
+        freeModule(module);
+        memoryFree(module -> imports.items);
+        memoryFree(module -> path);
+        memoryFree(module -> key);
+        memoryFree(module);
+    }
+    memoryFree(modules -> items.items);
+    memoryFree(modules -> by_key.items);
+    freeSymbols(&modules -> keys);
+    arenaFree(&modules -> arena);
+    (*modules) = (struct Modules) { 0 };
+}
@@ -0,0 +1,87 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "error.h"
+#include "file.h"
+#include "memory.h"
+#include "symbol.h"
+#include "timing.h"
+
+// an import of a module that is a file, not one of Cosole, File or Test
+struct ModuleImport {
+    uint32_t import;                // AST.imports
+    uint32_t module;                // Modules.items
+    uint32_t names;                 // of the path that name the file
+};
+
+/*
+ * A file and everything parsed from it. A module is allocated on its own
+ * and never moves, its symbols point into its arena and its AST into its
+ * symbols.
+ */
+struct Module {
+    char*                       path;   // as given, or found for an import
+    char*                       key;    // the real path, NULL for stdin
+    bool                        is_root;
+    bool                        is_loaded;  // file, arena, symbols and AST
+    bool                        is_interface;   // AST, see interface.h
+    bool                        parsed;
+    bool                        failed;
+    struct File                 file;
+    struct Arena                arena;
+    struct Symbols              symbols;
+    struct AST                  ast;
+    struct Error                error;
+    struct Timings*             timings;    // of the unit of a root, or NULL
+    NODES(struct ModuleImport)  imports;
+    uint32_t                    wave;   // 0 imports no module
+};
+
+struct Modules {
+    NODES(struct Module*) items;    // the roots first, in the order given
+    uint32_t              waves;
+    struct Arena          arena;
+    struct Symbols        keys;     // real paths, in arena
+    NODES(uint32_t)       by_key;   // keys symbol -> the first module
+};
+
+/*
+ * Parses the roots at paths and every file they import, directly or not,
+ * each file once. import A.B.c is the file A/B/c.micro, A/B.micro or
+ * A.micro next to the importing file, the longest that exists; .a.b is
+ * the same. Cosole, File and Test are built in and have no file.
+ *
+ * Files are parsed on up to workers threads in waves: the roots, then
+ * every file the last wave imported that is new. Once the graph is
+ * complete and has no cycle the imports are checked in topological waves,
+ * wave n imports only from waves before it, so the files of a wave are
+ * independent and checked at once. Every imported name has to be exported
+ * by its module.
+ *
+ * With args.cache_dir every module parsed stores its interface there, see
+ * interface.h, and an imported file with the same bytes as then is
+ * loaded as its interface instead of being parsed. Roots are always
+ * parsed in full, they are compiled.
+ *
+ * Errors are kept in the module they are found in: parse errors, imports
+ * with no file or not exported and the cycles, which are reported in the
+ * file they start from. False if any module failed. timings[i] records
+ * the reading and parsing of paths[i], it may be NULL.
+ */
+bool loadModules(
+    struct Modules*  modules,
+    const char**     paths,
+    struct Timings** timings,
+    size_t           count,
+    size_t           workers
+);
+// frees what was parsed, the module stays in modules until freeModules
+void freeModule(struct Module* module);
+void freeModules(struct Modules* modules);
+
+#endif
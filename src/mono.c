@@ -0,0 +1,1068 @@
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <stdio.h>
+// for: snprintf, vsnprintf
+#include <stdlib.h>
+// for: qsort
+#include <string.h>
+// for: memcmp, memset
+
+#include "mono.h"
+#include "timing.h"
+
+#define MONO_ERROR "Compile error"
+
+#define CANON_TABLE_SIZE 256
+// instances of instances, deeper is a type that grows without end
+#define MONO_MAX_DEPTH   32
+
+/*
+ * A type once its args are instances: a name, ref or not and the ids of
+ * the args, which have none of their own. Equal types have the same id.
+ */
+struct Canon {
+    uint32_t     name;
+    bool         is_ref;
+    struct Range args;              // Mono.canon_args
+    uint32_t     hash;
+    uint32_t     instance;          // symbol of the TypeDecl, or SYMBOL_NONE
+    uint32_t     depth;             // of the instance
+};
+
+struct Binding {
+    uint32_t    param;
+    struct Type type;               // with no args
+};
+
+// an arg or var of the function made concrete, for asigns to it
+struct Local {
+    uint32_t    name;
+    struct Type type;               // concrete, SYMBOL_NONE if not given
+};
+
+// the code that is made concrete and what its type params stand for
+struct Scope {
+    struct Binding* bindings;
+    uint32_t        count;
+    uint32_t        depth;
+    bool            is_copy;        // copied for an instance, or in place
+    uint32_t        generic;        // Generic.fild is instance.fild
+    uint32_t        instance;
+    struct Type     result;         // of the func, for return
+};
+
+struct Mono {
+    struct AST*          ast;
+    const char*          path;
+    struct Error*        error;
+    jmp_buf              bail;
+    char                 where[96]; // what is made concrete, for errors
+
+    uint32_t             symbols;   // the size of generics and taken
+    uint32_t*            generics;  // symbol -> AST.type_decls index + 1
+    uint8_t*             taken;     // symbols of the TypeDecls of the file
+    uint32_t             funcs;     // AST.funcs before the instances
+    uint32_t*            callees;   // symbol -> AST.funcs index + 1
+    uint32_t*            cfuncs;    // symbol -> AST.cfuncs index + 1
+
+    NODES(struct Canon)  canons;
+    NODES(uint32_t)      canon_args;
+    uint32_t*            table;     // canon id + 1, or 0 when empty
+    uint32_t             table_size;
+    NODES(uint32_t)      instances; // symbol -> canon id + 1, or 0
+    NODES(uint32_t)      work;      // canons still to be instantiated
+
+    NODES(uint32_t)      ids;       // scratch stacks, see their users
+    NODES(uint32_t)      statements;
+    NODES(uint32_t)      exprs;
+    NODES(uint32_t)      copies;
+    NODES(uint32_t)      stack;
+    NODES(struct Local)  locals;    // in scope, innermost last
+};
+
+static _Noreturn __attribute__((format(printf, 2, 3))) void errorMono(
+    struct Mono* mono,
+    const char*  format,
+    ...
+) {
+    char message[160];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+    setError(mono -> error, MONO_ERROR, mono -> path, 0, "%s, in %s",
+        message, mono -> where);
+    longjmp(mono -> bail, 1);
+}
+
+static inline struct String nameOf(struct Mono* mono, uint32_t name) {
+    return symbolString(mono -> ast -> symbols, name);
+}
+
+static void setWhere(struct Mono* mono, const char* what, uint32_t name) {
+    struct String string = nameOf(mono, name);
+    snprintf(mono -> where, sizeof(mono -> where), "%s %.*s", what,
+        (int) string.length, string.string);
+}
+
+static inline bool isGeneric(struct Mono* mono, uint32_t name) {
+    return name < mono -> symbols && mono -> generics[name] != 0;
+}
+
+static inline struct TypeDecl* genericOf(struct Mono* mono, uint32_t name) {
+    return &mono -> ast -> type_decls.items[mono -> generics[name] - 1];
+}
+
+// FNV-1a over the words of the key, like hashName of symbol.c
+static inline uint32_t hashWord(uint32_t hash, uint32_t word) {
+    for (uint32_t i = 0; i < 4; i++) {
+        hash ^= (word >> 8 * i) & 0xff;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void growCanons(struct Mono* mono) {
+    uint32_t size = mono -> table_size * 2;
+    uint32_t* table = memoryAllocKind(MEMORY_TYPE, size * sizeof(uint32_t));
+    memset(table, 0, size * sizeof(uint32_t));
+    for (uint32_t id = 0; id < mono -> canons.count; id++) {
+        uint32_t slot = mono -> canons.items[id].hash & (size - 1);
+        while (table[slot] != 0) {
+            slot = (slot + 1) & (size - 1);
+        }
+        table[slot] = id + 1;
+    }
+    memoryFree(mono -> table);
+    mono -> table = table;
+    mono -> table_size = size;
+}
+
+// the id of name<args>, args are the ids at Mono.ids from mark on
+static uint32_t internCanon(
+    struct Mono* mono,
+    uint32_t     name,
+    bool         is_ref,
+    uint32_t     mark
+) {
+    uint32_t* args = &mono -> ids.items[mark];
+    uint32_t count = mono -> ids.count - mark;
+    uint32_t hash = hashWord(hashWord(2166136261u, name), is_ref);
+    for (uint32_t i = 0; i < count; i++) {
+        hash = hashWord(hash, args[i]);
+    }
+    uint32_t mask = mono -> table_size - 1;
+    uint32_t slot = hash & mask;
+    while (mono -> table[slot] != 0) {
+        struct Canon* canon = &mono -> canons.items[mono -> table[slot] - 1];
+        if (canon -> hash == hash
+         && canon -> name == name
+         && canon -> is_ref == is_ref
+         && canon -> args.count == count
+         && memcmp(&mono -> canon_args.items[canon -> args.start], args,
+                count * sizeof(uint32_t)) == 0) {
+            return mono -> table[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    struct Canon canon = {
+        .name     = name,
+        .is_ref   = is_ref,
+        .args     = { .start = mono -> canon_args.count, .count = count },
+        .hash     = hash,
+        .instance = SYMBOL_NONE
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        pushNode(mono -> canon_args, MEMORY_TYPE, mono -> ids.items[mark + i]);
+    }
+    uint32_t res = pushNode(mono -> canons, MEMORY_TYPE, canon);
+    mono -> table[slot] = res + 1;
+    // keep the load factor under one half
+    if (mono -> canons.count * 2 > mono -> table_size) {
+        growCanons(mono);
+    }
+    return res;
+}
+
+// Generic__Arg__ref_Arg, the args are instances or have no args already
+static uint32_t instanceName(struct Mono* mono, uint32_t id) {
+    struct Canon canon = mono -> canons.items[id];
+    struct String name = nameOf(mono, canon.name);
+    char buffer[512];
+    size_t length = (size_t) snprintf(buffer, sizeof(buffer), "%.*s",
+        (int) name.length, name.string);
+    for (uint32_t i = 0; i < canon.args.count && length < sizeof(buffer); i++) {
+        struct Canon arg = mono -> canons.items[
+            mono -> canon_args.items[canon.args.start + i]
+        ];
+        struct String string = nameOf(mono, arg.name);
+        length += (size_t) snprintf(buffer + length, sizeof(buffer) - length,
+            "__%s%.*s", arg.is_ref ? "ref_" : "", (int) string.length,
+            string.string);
+    }
+    if (length >= sizeof(buffer)) {
+        errorMono(mono, "the name of an instance of %.*s is too long",
+            (int) name.length, name.string);
+    }
+    uint32_t res = internSymbol(mono -> ast -> symbols, buffer, length);
+    if (res < mono -> symbols && mono -> taken[res]) {
+        errorMono(mono, "the instance %s has the name of another type",
+            buffer);
+    }
+    return res;
+}
+
+// the instance of canon id, queued on Mono.work to be declared
+static uint32_t requestInstance(
+    struct Mono* mono,
+    uint32_t     id,
+    uint32_t     depth
+) {
+    if (mono -> canons.items[id].instance != SYMBOL_NONE) {
+        return mono -> canons.items[id].instance;
+    }
+    if (depth > MONO_MAX_DEPTH) {
+        struct String name = nameOf(mono, mono -> canons.items[id].name);
+        errorMono(mono, "instances of %.*s nest without end",
+            (int) name.length, name.string);
+    }
+    uint32_t symbol = instanceName(mono, id);
+    mono -> canons.items[id].instance = symbol;
+    mono -> canons.items[id].depth = depth;
+    while (mono -> instances.count <= symbol) {
+        pushNode(mono -> instances, MEMORY_TYPE, 0);
+    }
+    mono -> instances.items[symbol] = id + 1;
+    pushNode(mono -> work, MEMORY_TYPE, id);
+    return symbol;
+}
+
+/*
+ * type with its params bound and its args made concrete: a type with
+ * args is named after its instance, which is requested on the way.
+ */
+static struct Type concreteType(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Type   type
+) {
+    struct String name = nameOf(mono, type.name);
+    if (type.args.count == 0) {
+        for (uint32_t i = 0; i < scope -> count; i++) {
+            if (scope -> bindings[i].param != type.name) {
+                continue;
+            }
+            struct Type res = scope -> bindings[i].type;
+            if (res.is_ref && type.is_ref) {
+                errorMono(mono, "ref %.*s is a ref of a ref",
+                    (int) name.length, name.string);
+            }
+            res.is_ref = res.is_ref || type.is_ref;
+            return res;
+        }
+        if (isGeneric(mono, type.name)) {
+            errorMono(mono, "generic type %.*s needs type arguments",
+                (int) name.length, name.string);
+        }
+        return type;
+    }
+    if (!isGeneric(mono, type.name)) {
+        errorMono(mono, "%.*s is not generic", (int) name.length,
+            name.string);
+    }
+    uint32_t params = genericOf(mono, type.name) -> header.params.count;
+    if (params != type.args.count) {
+        errorMono(mono, "%.*s takes %u type arguments, not %u",
+            (int) name.length, name.string, params, type.args.count);
+    }
+
+    uint32_t mark = mono -> ids.count;
+    for (uint32_t i = 0; i < type.args.count; i++) {
+        struct Type arg = concreteType(
+            mono,
+            scope,
+            mono -> ast -> types.items[type.args.start + i]
+        );
+        uint32_t arg_mark = mono -> ids.count;
+        uint32_t id = internCanon(mono, arg.name, arg.is_ref, arg_mark);
+        pushNode(mono -> ids, MEMORY_TYPE, id);
+    }
+    uint32_t id = internCanon(mono, type.name, false, mark);
+    mono -> ids.count = mark;
+    return (struct Type) {
+        .is_ref = type.is_ref,
+        .name   = requestInstance(mono, id, scope -> depth + 1)
+    };
+}
+
+// AST.types index of the concrete type, a new one for a copy
+static uint32_t concreteTypeIndex(
+    struct Mono*  mono,
+    struct Scope* scope,
+    uint32_t      index
+) {
+    if (index == NODE_NONE) {
+        return NODE_NONE;
+    }
+    struct Type type = concreteType(mono, scope,
+        mono -> ast -> types.items[index]);
+    if (scope -> is_copy) {
+        return appendType(mono -> ast, type);
+    }
+    mono -> ast -> types.items[index] = type;
+    return index;
+}
+
+// filds of a copy stay consecutive, their types are made concrete first
+static struct Range concreteFilds(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Range  filds
+) {
+    struct AST* ast = mono -> ast;
+    if (!scope -> is_copy) {
+        for (uint32_t i = 0; i < filds.count; i++) {
+            struct Type type = concreteType(mono, scope,
+                ast -> filds.items[filds.start + i].type);
+            ast -> filds.items[filds.start + i].type = type;
+        }
+        return filds;
+    }
+    struct Range res = { .start = ast -> filds.count, .count = filds.count };
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct TypeFild fild = ast -> filds.items[filds.start + i];
+        fild.type = concreteType(mono, scope, fild.type);
+        appendTypeFild(ast, fild);
+    }
+    return res;
+}
+
+static struct Range concreteEnumFilds(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Range  filds
+) {
+    struct AST* ast = mono -> ast;
+    struct Range res = filds;
+    if (scope -> is_copy) {
+        res.start = ast -> enum_filds.count;
+    }
+    for (uint32_t i = 0; i < filds.count; i++) {
+        struct EnumFild fild = ast -> enum_filds.items[filds.start + i];
+        if (fild.type == ENUM_FILD_TYPED) {
+            fild.fild.type = concreteType(mono, scope, fild.fild.type);
+        }
+        if (scope -> is_copy) {
+            pushNode(ast -> enum_filds, MEMORY_TYPE, fild);
+        } else {
+            ast -> enum_filds.items[filds.start + i] = fild;
+        }
+    }
+    return res;
+}
+
+// Generic.fild named by expretion index becomes instance.fild
+static void retarget(
+    struct Mono* mono,
+    uint32_t     index,
+    uint32_t     generic,
+    uint32_t     instance
+) {
+    struct AST* ast = mono -> ast;
+    if (index == NODE_NONE || generic == SYMBOL_NONE) {
+        return;
+    }
+    struct Expretion* expr = &ast -> expretions.items[index];
+    struct Path* path;
+    if (expr -> type == EXPRETION_FUNCTION) {
+        path = &expr -> func.name;
+    } else if (expr -> type == EXPRETION_LITERAL
+            && expr -> literal.type == LITERAL_NAME) {
+        path = &expr -> literal.name;
+    } else {
+        return;
+    }
+    if (path -> is_relative || path -> names.count != 2
+     || ast -> names.items[path -> names.start] != generic) {
+        return;
+    }
+    // the names may be shared with the generic code, they are not changed
+    uint32_t fild = ast -> names.items[path -> names.start + 1];
+    path -> names.start = appendName(ast, instance);
+    appendName(ast, fild);
+}
+
+static struct Type concreteType(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Type   type
+);
+
+static struct Binding* bindParams(
+    struct Mono* mono,
+    struct Canon canon,
+    struct Range params
+);
+
+/*
+ * The value at index, which has the concrete type, is retargeted to it,
+ * and so is the payload of an enum fild of it: Maybe.just(Maybe.nothing)
+ * of type Maybe<Maybe<Int>> has a Maybe<Int> inside.
+ */
+static void retargetTo(struct Mono* mono, uint32_t index, struct Type type) {
+    struct AST* ast = mono -> ast;
+    while (index != NODE_NONE && !type.is_ref
+        && type.name < mono -> instances.count
+        && mono -> instances.items[type.name] != 0) {
+        struct Canon canon = mono -> canons.items[
+            mono -> instances.items[type.name] - 1
+        ];
+        retarget(mono, index, canon.name, type.name);
+        struct Expretion expr = ast -> expretions.items[index];
+        if (expr.type != EXPRETION_FUNCTION || expr.func.args.count != 1
+         || ast -> names.items[expr.func.name.names.start] != type.name) {
+            return;
+        }
+        struct TypeDecl generic = *genericOf(mono, canon.name);
+        uint32_t name = ast -> names.items[expr.func.name.names.start + 1];
+        struct EnumFild* fild = NULL;
+        for (uint32_t i = 0; generic.type == TYPE_ENUM
+                          && i < generic._enum.count; i++) {
+            struct EnumFild* other =
+                &ast -> enum_filds.items[generic._enum.start + i];
+            if (other -> type == ENUM_FILD_TYPED
+             && other -> fild.name == name) {
+                fild = other;
+            }
+        }
+        if (fild == NULL) {
+            return;
+        }
+        struct Scope scope = {
+            .bindings = bindParams(mono, canon, generic.header.params),
+            .count    = canon.args.count,
+            .depth    = canon.depth,
+            .generic  = SYMBOL_NONE
+        };
+        type = concreteType(mono, &scope, fild -> fild.type);
+        memoryFree(scope.bindings);
+        index = ast -> expretion_lists.items[expr.func.args.start];
+    }
+}
+
+// the children of an expretion, args of a call at Mono.stack
+static void pushChildren(struct Mono* mono, struct Expretion expr) {
+    switch (expr.type) {
+    case EXPRETION_NONE:
+    case EXPRETION_LITERAL:
+        return;
+    case EXPRETION_FUNCTION:
+        for (uint32_t i = 0; i < expr.func.args.count; i++) {
+            pushNode(mono -> stack, MEMORY_OTHER, mono -> ast ->
+                expretion_lists.items[expr.func.args.start + i]);
+        }
+        return;
+    case EXPRETION_CAST:
+    case EXPRETION_REF:
+    case EXPRETION_DEREF:
+    case EXPRETION_NEG:
+    case EXPRETION_BITWIZE_NOT:
+    case EXPRETION_LOGICAL_NOT:
+        pushNode(mono -> stack, MEMORY_OTHER, expr.expr);
+        return;
+    default:
+        pushNode(mono -> stack, MEMORY_OTHER, expr.left);
+        pushNode(mono -> stack, MEMORY_OTHER, expr.right);
+        return;
+    }
+}
+
+// the concrete type of the arg at position of a call to the func at path
+static struct Type paramOf(
+    struct Mono* mono,
+    struct Path  path,
+    uint32_t     position
+) {
+    struct AST* ast = mono -> ast;
+    struct Type none = { .name = SYMBOL_NONE };
+    uint32_t name = ast -> names.items[path.names.start];
+    if (path.is_relative || path.names.count != 1 || name >= mono -> symbols) {
+        return none;
+    }
+    struct Range args;
+    if (mono -> callees[name] != 0) {
+        args = ast -> funcs.items[mono -> callees[name] - 1].args;
+    } else if (mono -> cfuncs[name] != 0) {
+        args = ast -> cfuncs.items[mono -> cfuncs[name] - 1].args;
+    } else {
+        return none;
+    }
+    if (position >= args.count) {
+        return none;
+    }
+    struct Scope scope = { .generic = SYMBOL_NONE };
+    return concreteType(mono, &scope,
+        ast -> filds.items[args.start + position].type);
+}
+
+/*
+ * Retargets the concrete expretion at root to type, and every arg of a
+ * call in it to the type of its param. An enum fild of a generic type
+ * that is still left has no type to tell its instance.
+ */
+static void finishExpretion(
+    struct Mono* mono,
+    uint32_t     root,
+    struct Type  type
+) {
+    struct AST* ast = mono -> ast;
+    if (root == NODE_NONE) {
+        return;
+    }
+    retargetTo(mono, root, type);
+    pushNode(mono -> stack, MEMORY_OTHER, root);
+    while (mono -> stack.count != 0) {
+        uint32_t index = mono -> stack.items[--mono -> stack.count];
+        struct Expretion expr = ast -> expretions.items[index];
+        struct Path path;
+        if (expr.type == EXPRETION_FUNCTION) {
+            path = expr.func.name;
+            for (uint32_t i = 0; i < expr.func.args.count; i++) {
+                retargetTo(mono,
+                    ast -> expretion_lists.items[expr.func.args.start + i],
+                    paramOf(mono, path, i));
+            }
+        } else if (expr.type == EXPRETION_LITERAL
+                && expr.literal.type == LITERAL_NAME) {
+            path = expr.literal.name;
+        } else {
+            pushChildren(mono, expr);
+            continue;
+        }
+        uint32_t name = ast -> names.items[path.names.start];
+        if (!path.is_relative && path.names.count == 2
+         && isGeneric(mono, name)
+         && genericOf(mono, name) -> type == TYPE_ENUM) {
+            struct String generic = nameOf(mono, name);
+            struct String fild = nameOf(mono,
+                ast -> names.items[path.names.start + 1]);
+            errorMono(mono, "can not tell which %.*s %.*s.%.*s is, give it"
+                " a type", (int) generic.length, generic.string,
+                (int) generic.length, generic.string, (int) fild.length,
+                fild.string);
+        }
+        pushChildren(mono, expr);
+    }
+}
+
+static int compareIndexes(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+// the copy of old, which is one of the collected ones from mark on
+static uint32_t copyOf(struct Mono* mono, uint32_t mark, uint32_t old) {
+    uint32_t low = mark;
+    uint32_t high = mono -> exprs.count;
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if (mono -> exprs.items[middle] <= old) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return mono -> copies.items[low];
+}
+
+static inline uint32_t remap(struct Mono* mono, uint32_t mark, uint32_t old) {
+    return old == NODE_NONE ? NODE_NONE : copyOf(mono, mark, old);
+}
+
+/*
+ * Makes the expretions at roots concrete, together, since a += shares
+ * its target. Every node of the trees is collected with an explicit
+ * stack and sorted; children come before their parents in AST.expretions,
+ * so a copy is made in that order and its children are copied already.
+ */
+static void concreteExpretions(
+    struct Mono*  mono,
+    struct Scope* scope,
+    uint32_t*     roots,
+    uint32_t      count
+) {
+    struct AST* ast = mono -> ast;
+    uint32_t mark = mono -> exprs.count;
+    for (uint32_t i = 0; i < count; i++) {
+        if (roots[i] != NODE_NONE) {
+            pushNode(mono -> stack, MEMORY_OTHER, roots[i]);
+        }
+    }
+    while (mono -> stack.count != 0) {
+        uint32_t index = mono -> stack.items[--mono -> stack.count];
+        pushNode(mono -> exprs, MEMORY_OTHER, index);
+        pushChildren(mono, ast -> expretions.items[index]);
+    }
+    uint32_t collected = mono -> exprs.count - mark;
+    qsort(&mono -> exprs.items[mark], collected, sizeof(uint32_t),
+        compareIndexes);
+    uint32_t unique = mark;
+    for (uint32_t i = mark; i < mono -> exprs.count; i++) {
+        if (unique == mark || mono -> exprs.items[unique - 1]
+                           != mono -> exprs.items[i]) {
+            mono -> exprs.items[unique++] = mono -> exprs.items[i];
+        }
+    }
+    mono -> exprs.count = unique;
+
+    while (mono -> copies.count < mono -> exprs.count) {
+        pushNode(mono -> copies, MEMORY_OTHER, NODE_NONE);
+    }
+    for (uint32_t i = mark; i < mono -> exprs.count; i++) {
+        uint32_t old = mono -> exprs.items[i];
+        struct Expretion expr = ast -> expretions.items[old];
+        if (expr.type == EXPRETION_CAST) {
+            expr.cast = concreteTypeIndex(mono, scope, expr.cast);
+        }
+        if (!scope -> is_copy) {
+            ast -> expretions.items[old] = expr;
+            mono -> copies.items[i] = old;
+            continue;
+        }
+        switch (expr.type) {
+        case EXPRETION_NONE:
+        case EXPRETION_LITERAL:
+            break;
+        case EXPRETION_FUNCTION: {
+            uint32_t list = mono -> ids.count;
+            for (uint32_t j = 0; j < expr.func.args.count; j++) {
+                uint32_t arg = remap(mono, mark, ast -> expretion_lists.items[
+                    expr.func.args.start + j
+                ]);
+                pushNode(mono -> ids, MEMORY_TYPE, arg);
+            }
+            expr.func.args = appendExpretionList(ast,
+                &mono -> ids.items[list], expr.func.args.count);
+            mono -> ids.count = list;
+            break;
+        }
+        case EXPRETION_CAST:
+        case EXPRETION_REF:
+        case EXPRETION_DEREF:
+        case EXPRETION_NEG:
+        case EXPRETION_BITWIZE_NOT:
+        case EXPRETION_LOGICAL_NOT:
+            expr.expr = remap(mono, mark, expr.expr);
+            break;
+        default:
+            expr.left = remap(mono, mark, expr.left);
+            expr.right = remap(mono, mark, expr.right);
+            break;
+        }
+        uint32_t copy = pushNode(ast -> expretions, MEMORY_EXPRETION, expr);
+        mono -> copies.items[i] = copy;
+        retarget(mono, copy, scope -> generic, scope -> instance);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        roots[i] = remap(mono, mark, roots[i]);
+    }
+    mono -> exprs.count = mark;
+}
+
+static uint32_t concreteExpretion(
+    struct Mono*  mono,
+    struct Scope* scope,
+    uint32_t      root
+) {
+    concreteExpretions(mono, scope, &root, 1);
+    return root;
+}
+
+static uint32_t concreteStatement(
+    struct Mono*  mono,
+    struct Scope* scope,
+    uint32_t      index
+);
+
+// a copy of a block is consecutive again, like parseBlock leaves it
+static struct Range concreteStatements(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Range  block
+) {
+    struct AST* ast = mono -> ast;
+    uint32_t mark = mono -> statements.count;
+    uint32_t locals = mono -> locals.count;
+    for (uint32_t i = 0; i < block.count; i++) {
+        uint32_t statement = concreteStatement(mono, scope,
+            ast -> statement_lists.items[block.start + i]);
+        pushNode(mono -> statements, MEMORY_STATEMENT, statement);
+    }
+    mono -> locals.count = locals;
+    struct Range res = block;
+    if (scope -> is_copy) {
+        res = appendStatementList(ast, &mono -> statements.items[mark],
+            block.count);
+    }
+    mono -> statements.count = mark;
+    return res;
+}
+
+static struct Range concreteCases(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Range  cases
+) {
+    struct AST* ast = mono -> ast;
+    uint32_t mark = mono -> statements.count;
+    for (uint32_t i = 0; i < cases.count; i++) {
+        struct Range then = concreteStatements(mono, scope,
+            ast -> cases.items[cases.start + i].then);
+        pushNode(mono -> statements, MEMORY_STATEMENT, then.start);
+        pushNode(mono -> statements, MEMORY_STATEMENT, then.count);
+    }
+    struct Range res = cases;
+    if (scope -> is_copy) {
+        res.start = ast -> cases.count;
+    }
+    for (uint32_t i = 0; i < cases.count; i++) {
+        struct StatementSwitchCase _case = ast -> cases.items[cases.start + i];
+        _case.then = (struct Range) {
+            .start = mono -> statements.items[mark + 2 * i],
+            .count = mono -> statements.items[mark + 2 * i + 1]
+        };
+        if (scope -> is_copy) {
+            appendSwitchCase(ast, _case);
+        } else {
+            ast -> cases.items[cases.start + i] = _case;
+        }
+    }
+    mono -> statements.count = mark;
+    return res;
+}
+
+// the type of the innermost local called name, SYMBOL_NONE if unknown
+static struct Type localType(struct Mono* mono, uint32_t name) {
+    for (uint32_t i = mono -> locals.count; i > 0; i--) {
+        if (mono -> locals.items[i - 1].name == name) {
+            return mono -> locals.items[i - 1].type;
+        }
+    }
+    return (struct Type) { .name = SYMBOL_NONE };
+}
+
+static uint32_t concreteStatement(
+    struct Mono*  mono,
+    struct Scope* scope,
+    uint32_t      index
+) {
+    struct AST* ast = mono -> ast;
+    struct Statement statement = ast -> statements.items[index];
+    struct Type none = { .name = SYMBOL_NONE };
+    switch (statement.type) {
+    case STATEMENT_NONE:
+        break;
+    case STATEMENT_VAR: {
+        struct StatementVar* var = &statement.statement_var;
+        var -> type = concreteTypeIndex(mono, scope, var -> type);
+        var -> value = concreteExpretion(mono, scope, var -> value);
+        struct Local local = { .name = var -> name, .type = none };
+        if (var -> type != NODE_NONE) {
+            local.type = ast -> types.items[var -> type];
+        }
+        finishExpretion(mono, var -> value, local.type);
+        pushNode(mono -> locals, MEMORY_TYPE, local);
+        break;
+    }
+    case STATEMENT_CONST:
+        statement.statement_const.value = concreteExpretion(mono, scope,
+            statement.statement_const.value);
+        finishExpretion(mono, statement.statement_const.value, none);
+        break;
+    case STATEMENT_IF: {
+        struct StatementIf* _if = &statement.statement_if;
+        _if -> condition = concreteExpretion(mono, scope, _if -> condition);
+        finishExpretion(mono, _if -> condition, none);
+        _if -> then = concreteStatements(mono, scope, _if -> then);
+        _if -> _else = concreteStatements(mono, scope, _if -> _else);
+        break;
+    }
+    case STATEMENT_SWITCH: {
+        struct StatementSwitch* _switch = &statement.statement_switch;
+        _switch -> value = concreteExpretion(mono, scope, _switch -> value);
+        finishExpretion(mono, _switch -> value, none);
+        _switch -> cases = concreteCases(mono, scope, _switch -> cases);
+        break;
+    }
+    case STATEMENT_DO:
+    case STATEMENT_WHILE:
+    case STATEMENT_REPEAD: {
+        // the three have the same layout
+        struct StatementWhile* loop = &statement.statement_while;
+        loop -> condition = concreteExpretion(mono, scope, loop -> condition);
+        finishExpretion(mono, loop -> condition, none);
+        loop -> then = concreteStatements(mono, scope, loop -> then);
+        break;
+    }
+    case STATEMENT_FOR: {
+        // the var is only in scope of the loop
+        uint32_t locals = mono -> locals.count;
+        struct StatementFor* _for = &statement.statement_for;
+        _for -> var = concreteStatement(mono, scope, _for -> var);
+        _for -> condition = concreteExpretion(mono, scope, _for -> condition);
+        finishExpretion(mono, _for -> condition, none);
+        _for -> then = concreteStatements(mono, scope, _for -> then);
+        mono -> locals.count = locals;
+        break;
+    }
+    case STATEMENT_RETURN: {
+        uint32_t value = concreteExpretion(mono, scope,
+            statement.statement_return.value);
+        finishExpretion(mono, value, scope -> result);
+        statement.statement_return.value = value;
+        break;
+    }
+    case STATEMENT_ASIGN: {
+        uint32_t roots[2] = {
+            statement.statement_asign.get_expr,
+            statement.statement_asign.value
+        };
+        concreteExpretions(mono, scope, roots, 2);
+        statement.statement_asign.get_expr = roots[0];
+        statement.statement_asign.value = roots[1];
+        finishExpretion(mono, roots[0], none);
+        finishExpretion(mono, roots[1], roots[0] == NODE_NONE
+            ? localType(mono, statement.statement_asign.var_name)
+            : none);
+        break;
+    }
+    case STATEMENT_CALL:
+        statement.statement_expr = concreteExpretion(mono, scope,
+            statement.statement_expr);
+        finishExpretion(mono, statement.statement_expr, none);
+        break;
+    }
+    if (scope -> is_copy) {
+        return pushNode(ast -> statements, MEMORY_STATEMENT, statement);
+    }
+    ast -> statements.items[index] = statement;
+    return index;
+}
+
+// args, result and body of a func, cfunc or test, copied or in place
+static void concreteFunction(
+    struct Mono*  mono,
+    struct Scope* scope,
+    struct Range* args,
+    uint32_t*     result,
+    struct Range* body
+) {
+    (*args) = concreteFilds(mono, scope, *args);
+    mono -> locals.count = 0;
+    for (uint32_t i = 0; i < args -> count; i++) {
+        struct TypeFild arg = mono -> ast -> filds.items[args -> start + i];
+        struct Local local = { .name = arg.name, .type = arg.type };
+        pushNode(mono -> locals, MEMORY_TYPE, local);
+    }
+    (*result) = concreteTypeIndex(mono, scope, *result);
+    scope -> result = (*result) == NODE_NONE
+        ? (struct Type) { .name = SYMBOL_NONE }
+        : mono -> ast -> types.items[*result];
+    (*body) = concreteStatements(mono, scope, *body);
+}
+
+// bindings of the params at names to the args of canon
+static struct Binding* bindParams(
+    struct Mono* mono,
+    struct Canon canon,
+    struct Range params
+) {
+    struct Binding* res = memoryAllocKind(MEMORY_TYPE,
+        (params.count + 1) * sizeof(struct Binding));
+    for (uint32_t i = 0; i < params.count; i++) {
+        struct Canon arg = mono -> canons.items[
+            mono -> canon_args.items[canon.args.start + i]
+        ];
+        res[i] = (struct Binding) {
+            .param = mono -> ast -> names.items[params.start + i],
+            .type  = { .is_ref = arg.is_ref, .name = arg.name }
+        };
+    }
+    return res;
+}
+
+// the TypeDecl and methods of the instance of canon id
+static void instantiate(struct Mono* mono, uint32_t id) {
+    struct AST* ast = mono -> ast;
+    struct Canon canon = mono -> canons.items[id];
+    struct TypeDecl decl = *genericOf(mono, canon.name);
+    setWhere(mono, "type", canon.instance);
+    struct Scope scope = {
+        .bindings = bindParams(mono, canon, decl.header.params),
+        .count    = canon.args.count,
+        .depth    = canon.depth,
+        .is_copy  = true,
+        .generic  = canon.name,
+        .instance = canon.instance
+    };
+    decl.header = (struct TypeHeader) { .name = canon.instance };
+    switch (decl.type) {
+    case TYPE_TYPE:
+        decl._type = concreteType(mono, &scope, decl._type);
+        break;
+    case TYPE_STRUCT:
+        decl._struct = concreteFilds(mono, &scope, decl._struct);
+        break;
+    case TYPE_UNION:
+        decl._union = concreteFilds(mono, &scope, decl._union);
+        break;
+    case TYPE_ENUM:
+        decl._enum = concreteEnumFilds(mono, &scope, decl._enum);
+        break;
+    }
+    addTypeDecl(ast, decl);
+    memoryFree(scope.bindings);
+
+    for (uint32_t i = 0; i < mono -> funcs; i++) {
+        struct FuncDecl func = ast -> funcs.items[i];
+        if (!func.has_self || func.self.type.name != canon.name) {
+            continue;
+        }
+        setWhere(mono, "func", func.name);
+        if (func.self.type.params.count != canon.args.count) {
+            errorMono(mono, "self takes %u type params, not %u",
+                canon.args.count, func.self.type.params.count);
+        }
+        scope.bindings = bindParams(mono, canon, func.self.type.params);
+        concreteFunction(mono, &scope, &func.args, &func.result, &func.body);
+        memoryFree(scope.bindings);
+        func.self.type = (struct TypeHeader) { .name = canon.instance };
+        addFunc(ast, func);
+    }
+}
+
+// the declarations outside of generic ones, in place
+static void concreteFile(struct Mono* mono) {
+    struct AST* ast = mono -> ast;
+    struct Scope scope = { .generic = SYMBOL_NONE };
+    uint32_t type_decls = ast -> type_decls.count;
+    for (uint32_t i = 0; i < type_decls; i++) {
+        struct TypeDecl decl = ast -> type_decls.items[i];
+        if (decl.header.params.count != 0) {
+            continue;
+        }
+        setWhere(mono, "type", decl.header.name);
+        switch (decl.type) {
+        case TYPE_TYPE:
+            decl._type = concreteType(mono, &scope, decl._type);
+            ast -> type_decls.items[i]._type = decl._type;
+            break;
+        case TYPE_STRUCT:
+        case TYPE_UNION:
+            concreteFilds(mono, &scope, decl._struct);
+            break;
+        case TYPE_ENUM:
+            concreteEnumFilds(mono, &scope, decl._enum);
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < mono -> funcs; i++) {
+        struct FuncDecl* func = &ast -> funcs.items[i];
+        if (func -> has_self && func -> self.type.params.count != 0) {
+            continue;
+        }
+        setWhere(mono, "func", func -> name);
+        struct FuncDecl copy = *func;
+        concreteFunction(mono, &scope, &copy.args, &copy.result, &copy.body);
+    }
+    for (uint32_t i = 0; i < ast -> cfuncs.count; i++) {
+        setWhere(mono, "cfunc", ast -> cfuncs.items[i].name);
+        struct CFuncDecl copy = ast -> cfuncs.items[i];
+        concreteFunction(mono, &scope, &copy.args, &copy.result, &copy.body);
+    }
+    for (uint32_t i = 0; i < ast -> tests.count; i++) {
+        snprintf(mono -> where, sizeof(mono -> where), "test %u", i + 1);
+        struct Range args = { 0 };
+        uint32_t result = NODE_NONE;
+        struct Range body = ast -> tests.items[i].body;
+        concreteFunction(mono, &scope, &args, &result, &body);
+    }
+}
+
+bool monomorphize(struct AST* ast, const char* path, struct Error* error) {
+    bool has_generics = false;
+    for (uint32_t i = 0; i < ast -> type_decls.count; i++) {
+        has_generics = has_generics
+                    || ast -> type_decls.items[i].header.params.count != 0;
+    }
+    if (!has_generics) {
+        return true;
+    }
+    timeBegin("mono");
+    uint32_t symbols = ast -> symbols -> count;
+    struct Mono mono = {
+        .ast        = ast,
+        .path       = path,
+        .error      = error,
+        .symbols    = symbols,
+        .generics   = memoryAllocKind(MEMORY_TYPE, symbols * sizeof(uint32_t)),
+        .taken      = memoryAllocKind(MEMORY_TYPE, symbols),
+        .funcs      = ast -> funcs.count,
+        .callees    = memoryAllocKind(MEMORY_TYPE, symbols * sizeof(uint32_t)),
+        .cfuncs     = memoryAllocKind(MEMORY_TYPE, symbols * sizeof(uint32_t)),
+        .table      = memoryAllocKind(MEMORY_TYPE,
+            CANON_TABLE_SIZE * sizeof(uint32_t)),
+        .table_size = CANON_TABLE_SIZE
+    };
+    memset(mono.generics, 0, symbols * sizeof(uint32_t));
+    memset(mono.taken, 0, symbols);
+    memset(mono.table, 0, CANON_TABLE_SIZE * sizeof(uint32_t));
+    memset(mono.callees, 0, symbols * sizeof(uint32_t));
+    memset(mono.cfuncs, 0, symbols * sizeof(uint32_t));
+    for (uint32_t i = 0; i < ast -> funcs.count; i++) {
+        if (!ast -> funcs.items[i].has_self) {
+            mono.callees[ast -> funcs.items[i].name] = i + 1;
+        }
+    }
+    for (uint32_t i = 0; i < ast -> cfuncs.count; i++) {
+        mono.cfuncs[ast -> cfuncs.items[i].name] = i + 1;
+    }
+    for (uint32_t i = 0; i < ast -> type_decls.count; i++) {
+        struct TypeHeader header = ast -> type_decls.items[i].header;
+        mono.taken[header.name] = true;
+        if (header.params.count != 0) {
+            mono.generics[header.name] = i + 1;
+        }
+    }
+
+    bool res = setjmp(mono.bail) == 0;
+    if (res) {
+        concreteFile(&mono);
+        // instances request more of them, until all are declared
+        for (uint32_t i = 0; i < mono.work.count; i++) {
+            instantiate(&mono, mono.work.items[i]);
+        }
+    }
+
+    memoryFree(mono.generics);
+    memoryFree(mono.taken);
+    memoryFree(mono.callees);
+    memoryFree(mono.cfuncs);
+    memoryFree(mono.canons.items);
+    memoryFree(mono.canon_args.items);
+    memoryFree(mono.table);
+    memoryFree(mono.instances.items);
+    memoryFree(mono.work.items);
+    memoryFree(mono.ids.items);
+    memoryFree(mono.statements.items);
+    memoryFree(mono.exprs.items);
+    memoryFree(mono.copies.items);
+    memoryFree(mono.stack.items);
+    memoryFree(mono.locals.items);
+    timeEnd();
+    return res;
+}
@@ -0,0 +1,26 @@
+#ifndef MONO_H
+#define MONO_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "error.h"
+
+/*
+ * Instantiates the generic types of ast for every list of type arguments
+ * the rest of the file uses, so no type left outside a generic TypeDecl
+ * or method has args. Maybe<Int> becomes a TypeDecl called Maybe__Int,
+ * with a copy of every method of Maybe for it, and Maybe.just in a var,
+ * return, asign, call argument or enum payload of that type becomes
+ * Maybe__Int.just.
+ *
+ * Types are hash-consed to canonical ids once their args are instances
+ * themselves, every id is instantiated once, however often and however
+ * deep it is used. The generic declarations stay as they are. Returns
+ * false and sets error for a wrong number of type arguments, a generic
+ * type used without them, an enum fild of a generic type whose type can
+ * not be told, or instances that nest without end.
+ */
+bool monomorphize(struct AST* ast, const char* path, struct Error* error);
+
+#endif
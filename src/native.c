@@ -0,0 +1,1599 @@
+#include <setjmp.h>
+// for: jmp_buf, setjmp, longjmp
+#include <stdarg.h>
+// for: va_list, va_start, va_end
+#include <stdio.h>
+// for: snprintf, vsnprintf
+#include <string.h>
+// for: memcpy, memset, strlen
+#include <sys/resource.h>
+// for: RLIMIT_STACK
+
+#include "bytecode.h"
+#include "memory.h"
+#include "native.h"
+#include "regalloc.h"
+#include "timing.h"
+
+#define NATIVE_ERROR "Compile error"
+
+// what libc may need of the stack after the limit is reached, as in jit.c
+#define NATIVE_STACK_MARGIN (64 * 1024)
+
+#define REX   0x40
+#define REX_W 0x48
+
+enum Condition {
+    CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+    CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G,
+    CC_ALWAYS,
+};
+
+// where an operand is: a register, [reg + disp] or data offset disp
+enum PlaceType {
+    PLACE_GPR,
+    PLACE_XMM,
+    PLACE_MEMORY,
+    PLACE_DATA,
+};
+
+struct Place {
+    uint8_t type;                   // enum PlaceType
+    uint8_t reg;
+    int32_t disp;
+};
+
+struct Move {
+    struct Place to;
+    struct Place from;
+    bool         is_float;
+};
+
+// a rel32 at offset that goes to a block, or to a fault after the blocks
+struct Fixup {
+    uint32_t offset;
+    uint32_t target;
+};
+
+enum Extern {
+    EXTERN_DPRINTF,
+    EXTERN_WRITE,
+    EXTERN_FAULT,
+    EXTERN_EXIT,
+    EXTERN_GETRLIMIT,
+    EXTERN_COUNT,
+};
+
+static const char* const extern_names[EXTERN_COUNT] = {
+    [EXTERN_DPRINTF]   = "dprintf",
+    [EXTERN_WRITE]     = "write",
+    [EXTERN_FAULT]     = NATIVE_FAULT,
+    [EXTERN_EXIT]      = "exit",
+    [EXTERN_GETRLIMIT] = "getrlimit",
+};
+
+const char* const native_fault_messages[NATIVE_FAULT_COUNT] = {
+    [NATIVE_FAULT_DIVISION] = "division by zero",
+    [NATIVE_FAULT_SHIFT]    = "negative shift count",
+    [NATIVE_FAULT_CAST]     = "value out of the range of the cast",
+    [NATIVE_FAULT_STACK]    = "stack overflow",
+    [NATIVE_FAULT_ASSERT]   = "assertion failed",
+    [NATIVE_FAULT_FILE]     = "write to something that is not a file",
+};
+
+// what File.write needs in data, records like a Str or C strings
+enum Constant {
+    CONSTANT_TRUE,
+    CONSTANT_FALSE,
+    CONSTANT_NONE,
+    CONSTANT_INT,
+    CONSTANT_UINT,
+    CONSTANT_FLOAT,
+    CONSTANT_FILE,
+    CONSTANT_COUNT,
+};
+
+static const struct {
+    const char* text;
+    bool        is_record;
+} constants[CONSTANT_COUNT] = {
+    [CONSTANT_TRUE]  = { "true",        true  },
+    [CONSTANT_FALSE] = { "false",       true  },
+    [CONSTANT_NONE]  = { "None",        true  },
+    [CONSTANT_INT]   = { "%ld",         false },
+    [CONSTANT_UINT]  = { "%lu",         false },
+    [CONSTANT_FLOAT] = { "%g",          false },
+    [CONSTANT_FILE]  = { "<file %lu>",  false },
+};
+
+static const uint8_t int_args[] = {
+    REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9,
+};
+
+#define INT_ARGS   6
+#define FLOAT_ARGS 8
+
+struct Emitter {
+    struct NativeModule* native;
+    struct IrModule*     module;
+    struct IrFunction*   function;
+    uint32_t             index;     // of function
+    enum NativeTarget    target;
+    struct Error*        error;
+    jmp_buf              bail;
+
+    struct Allocation    allocation;
+    uint32_t             saved;     // callee saved registers pushed
+    uint32_t*            starts;    // block -> text offset
+    NODES(struct Fixup)  fixups;
+    NODES(struct Move)   moves;     // see emitMoves
+    uint32_t             faults[NATIVE_FAULT_COUNT];
+
+    uint32_t*            strings;   // symbol -> data offset + 1
+    uint32_t             constants[CONSTANT_COUNT];
+    uint32_t             externs[EXTERN_COUNT];
+};
+
+static _Noreturn __attribute__((format(printf, 2, 3))) void errorNative(
+    struct Emitter* emitter,
+    const char*     format,
+    ...
+) {
+    char message[192];
+    va_list list;
+    va_start(list, format);
+    vsnprintf(message, sizeof(message), format, list);
+    va_end(list);
+
+    if (emitter -> function -> name == SYMBOL_NONE) {
+        setError(emitter -> error, NATIVE_ERROR, emitter -> module -> path, 0,
+            "%s, in a test", message);
+    } else {
+        struct String name = symbolString(emitter -> module -> symbols,
+            emitter -> function -> name);
+        setError(emitter -> error, NATIVE_ERROR, emitter -> module -> path, 0,
+            "%s, in func %.*s", message, (int) name.length, name.string);
+    }
+    longjmp(emitter -> bail, 1);
+}
+
+static inline struct Place gpr(uint8_t reg) {
+    return (struct Place) { .type = PLACE_GPR, .reg = reg };
+}
+
+static inline struct Place xmm(uint8_t reg) {
+    return (struct Place) { .type = PLACE_XMM, .reg = reg };
+}
+
+static inline struct Place at(uint8_t reg, int32_t disp) {
+    return (struct Place) { .type = PLACE_MEMORY, .reg = reg, .disp = disp };
+}
+
+static inline struct Place data(uint32_t offset) {
+    return (struct Place) { .type = PLACE_DATA, .disp = (int32_t) offset };
+}
+
+static inline bool samePlace(struct Place a, struct Place b) {
+    return a.type == b.type && a.reg == b.reg && a.disp == b.disp;
+}
+
+static uint32_t addSymbol(
+    struct NativeModule*  native,
+    char*                 name,
+    enum NativeSymbolType type,
+    bool                  is_global
+) {
+    struct NativeSymbol symbol = {
+        .name      = name,
+        .type      = type,
+        .is_global = is_global
+    };
+    return pushNode(native -> symbols, MEMORY_NATIVE, symbol);
+}
+
+static uint32_t addData(
+    struct NativeModule* native,
+    const void*          bytes,
+    size_t               length,
+    uint32_t             align
+) {
+    while (native -> data.count % align != 0) {
+        pushNode(native -> data, MEMORY_NATIVE, 0);
+    }
+    uint32_t res = native -> data.count;
+    for (size_t i = 0; i < length; i++) {
+        pushNode(native -> data, MEMORY_NATIVE, ((const uint8_t*) bytes)[i]);
+    }
+    return res;
+}
+
+// a Str: its length as 8 bytes, the bytes and a 0 for C
+static uint32_t addRecord(
+    struct NativeModule* native,
+    const char*          string,
+    uint64_t             length
+) {
+    uint32_t res = addData(native, &length, sizeof(length), 8);
+    addData(native, string, length, 1);
+    addData(native, "", 1, 1);
+    return res;
+}
+
+static uint32_t stringOf(struct Emitter* emitter, uint32_t symbol) {
+    if (emitter -> strings[symbol] == 0) {
+        struct String string = symbolString(emitter -> module -> symbols,
+            symbol);
+        emitter -> strings[symbol] = addRecord(emitter -> native,
+            string.string, string.length) + 1;
+    }
+    return emitter -> strings[symbol] - 1;
+}
+
+static uint32_t constantOf(struct Emitter* emitter, enum Constant constant) {
+    if (emitter -> constants[constant] == NODE_NONE) {
+        const char* text = constants[constant].text;
+        emitter -> constants[constant] = constants[constant].is_record
+            ? addRecord(emitter -> native, text, strlen(text))
+            : addData(emitter -> native, text, strlen(text) + 1, 1);
+    }
+    return emitter -> constants[constant];
+}
+
+static uint32_t externOf(struct Emitter* emitter, enum Extern name) {
+    if (emitter -> externs[name] == NODE_NONE) {
+        emitter -> externs[name] = addSymbol(emitter -> native,
+            memoryStringnDup(extern_names[name]), NATIVE_SYMBOL_EXTERN, true);
+    }
+    return emitter -> externs[name];
+}
+
+static inline void emitByte(struct Emitter* emitter, uint8_t byte) {
+    pushNode(emitter -> native -> text, MEMORY_NATIVE, byte);
+}
+
+static void emit32(struct Emitter* emitter, uint32_t value) {
+    for (uint32_t i = 0; i < 4; i++) {
+        emitByte(emitter, (uint8_t) (value >> 8 * i));
+    }
+}
+
+static void emit64(struct Emitter* emitter, uint64_t value) {
+    emit32(emitter, (uint32_t) value);
+    emit32(emitter, (uint32_t) (value >> 32));
+}
+
+static void patch32(struct Emitter* emitter, uint32_t offset, uint32_t value) {
+    for (uint32_t i = 0; i < 4; i++) {
+        emitter -> native -> text.items[offset + i] =
+            (uint8_t) (value >> 8 * i);
+    }
+}
+
+static void addReloc(
+    struct Emitter*      emitter,
+    uint32_t             symbol,
+    int64_t              addend,
+    enum NativeRelocType type
+) {
+    struct NativeReloc reloc = {
+        .offset = emitter -> native -> text.count,
+        .symbol = symbol,
+        .addend = addend,
+        .type   = type
+    };
+    pushNode(emitter -> native -> relocs, MEMORY_NATIVE, reloc);
+    emit32(emitter, 0);
+}
+
+/*
+ * An instruction with a ModRM byte: a legacy prefix or 0, the REX bits
+ * it needs besides R and B or 0, an opcode of up to three bytes, the reg
+ * field and the operand rm. Memory always takes a disp32.
+ */
+static void emitModRM(
+    struct Emitter* emitter,
+    uint8_t         prefix,
+    uint8_t         rex,
+    uint32_t        opcode,
+    uint8_t         reg,
+    struct Place    rm
+) {
+    if (prefix != 0) {
+        emitByte(emitter, prefix);
+    }
+    rex |= (reg & 8) >> 1;
+    if (rm.type != PLACE_DATA) {
+        rex |= (rm.reg & 8) >> 3;
+    }
+    if (rex != 0) {
+        emitByte(emitter, rex | REX);
+    }
+    if (opcode > 0xffff) {
+        emitByte(emitter, (uint8_t) (opcode >> 16));
+    }
+    if (opcode > 0xff) {
+        emitByte(emitter, (uint8_t) (opcode >> 8));
+    }
+    emitByte(emitter, (uint8_t) opcode);
+    switch (rm.type) {
+    case PLACE_GPR:
+    case PLACE_XMM:
+        emitByte(emitter, 0xc0 | (reg & 7) << 3 | (rm.reg & 7));
+        break;
+    case PLACE_MEMORY:
+        emitByte(emitter, 0x80 | (reg & 7) << 3 | (rm.reg & 7));
+        if ((rm.reg & 7) == REG_RSP) {
+            emitByte(emitter, 0x24);
+        }
+        emit32(emitter, (uint32_t) rm.disp);
+        break;
+    case PLACE_DATA:
+        emitByte(emitter, 0x05 | (reg & 7) << 3);
+        addReloc(emitter, 0, rm.disp - 4, NATIVE_RELOC_PC32);
+        break;
+    }
+}
+
+static void emitPush(struct Emitter* emitter, uint8_t reg) {
+    if (reg & 8) {
+        emitByte(emitter, REX | 1);
+    }
+    emitByte(emitter, 0x50 | (reg & 7));
+}
+
+static void emitPop(struct Emitter* emitter, uint8_t reg) {
+    if (reg & 8) {
+        emitByte(emitter, REX | 1);
+    }
+    emitByte(emitter, 0x58 | (reg & 7));
+}
+
+static void emitMovImm(struct Emitter* emitter, uint8_t reg, uint64_t value) {
+    if (value <= UINT32_MAX) {
+        if (reg & 8) {
+            emitByte(emitter, REX | 1);
+        }
+        emitByte(emitter, 0xb8 | (reg & 7));
+        emit32(emitter, (uint32_t) value);
+    } else if ((int64_t) value >= INT32_MIN && (int64_t) value < 0) {
+        emitModRM(emitter, 0, REX_W, 0xc7, 0, gpr(reg));
+        emit32(emitter, (uint32_t) value);
+    } else {
+        emitByte(emitter, REX_W | (reg & 8) >> 3);
+        emitByte(emitter, 0xb8 | (reg & 7));
+        emit64(emitter, value);
+    }
+}
+
+static inline void emitMov(
+    struct Emitter* emitter,
+    uint8_t         reg,
+    struct Place    rm
+) {
+    if (rm.type != PLACE_GPR || rm.reg != reg) {
+        emitModRM(emitter, 0, REX_W, 0x8b, reg, rm);
+    }
+}
+
+static inline void emitStore(
+    struct Emitter* emitter,
+    struct Place    rm,
+    uint8_t         reg
+) {
+    if (rm.type != PLACE_GPR || rm.reg != reg) {
+        emitModRM(emitter, 0, REX_W, 0x89, reg, rm);
+    }
+}
+
+static inline void emitMovsd(
+    struct Emitter* emitter,
+    uint8_t         reg,
+    struct Place    rm
+) {
+    if (rm.type == PLACE_XMM) {
+        if (rm.reg != reg) {
+            emitModRM(emitter, 0x66, 0, 0x0f28, reg, rm);
+        }
+    } else {
+        emitModRM(emitter, 0xf2, 0, 0x0f10, reg, rm);
+    }
+}
+
+static inline void emitStoreSd(
+    struct Emitter* emitter,
+    struct Place    rm,
+    uint8_t         reg
+) {
+    if (rm.type == PLACE_XMM) {
+        if (rm.reg != reg) {
+            emitModRM(emitter, 0x66, 0, 0x0f28, rm.reg, xmm(reg));
+        }
+    } else {
+        emitModRM(emitter, 0xf2, 0, 0x0f11, reg, rm);
+    }
+}
+
+// the bits of value to an XMM register, through RAX
+static void emitFloatImm(struct Emitter* emitter, uint8_t reg, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    emitMovImm(emitter, REG_RAX, bits);
+    emitModRM(emitter, 0x66, REX_W, 0x0f6e, reg, gpr(REG_RAX));
+}
+
+static inline void emitSetcc(struct Emitter* emitter, enum Condition cc) {
+    emitModRM(emitter, 0, 0, 0x0f90 | cc, 0, gpr(REG_RAX));
+}
+
+// RAX = AL, which a setcc left
+static inline void emitBoolean(struct Emitter* emitter) {
+    emitModRM(emitter, 0, 0, 0x0fb6, REG_RAX, gpr(REG_RAX));
+}
+
+// XMM15 rounded to a Float32 and back
+static inline void emitRound(struct Emitter* emitter, uint8_t reg) {
+    emitModRM(emitter, 0xf2, 0, 0x0f5a, reg, xmm(reg));
+    emitModRM(emitter, 0xf3, 0, 0x0f5a, reg, xmm(reg));
+}
+
+// a jump in the instruction, landed by landShort
+static uint32_t jumpShort(struct Emitter* emitter, enum Condition cc) {
+    emitByte(emitter, cc == CC_ALWAYS ? 0xeb : 0x70 | cc);
+    emitByte(emitter, 0);
+    return emitter -> native -> text.count - 1;
+}
+
+static void landShort(struct Emitter* emitter, uint32_t offset) {
+    uint8_t* text = emitter -> native -> text.items;
+    text[offset] = (uint8_t) (emitter -> native -> text.count - offset - 1);
+}
+
+// to a block, or to the fault stub at blocks.count + enum NativeFault
+static void jumpTo(
+    struct Emitter* emitter,
+    enum Condition  cc,
+    uint32_t        target
+) {
+    if (cc == CC_ALWAYS) {
+        emitByte(emitter, 0xe9);
+    } else {
+        emitByte(emitter, 0x0f);
+        emitByte(emitter, 0x80 | cc);
+    }
+    struct Fixup fixup = {
+        .offset = emitter -> native -> text.count,
+        .target = target
+    };
+    pushNode(emitter -> fixups, MEMORY_NATIVE, fixup);
+    emit32(emitter, 0);
+}
+
+static inline void jumpFault(
+    struct Emitter*  emitter,
+    enum Condition   cc,
+    enum NativeFault fault
+) {
+    jumpTo(emitter, cc, emitter -> function -> blocks.count + fault);
+}
+
+static void emitCall(struct Emitter* emitter, uint32_t symbol) {
+    emitByte(emitter, 0xe8);
+    addReloc(emitter, symbol, -4, NATIVE_RELOC_PLT32);
+}
+
+static inline struct IrInstr* instrOf(struct Emitter* emitter, uint32_t value) {
+    return &emitter -> function -> instrs.items[value];
+}
+
+static inline uint32_t operandOf(
+    struct Emitter* emitter,
+    struct IrInstr* instr,
+    uint32_t        index
+) {
+    return emitter -> function -> operands.items[instr -> args.start + index];
+}
+
+static struct Place placeOf(struct Emitter* emitter, uint32_t value) {
+    struct Location location = emitter -> allocation.locations[value];
+    switch (location.type) {
+    case LOCATION_GPR:
+        return gpr(location.reg);
+    case LOCATION_XMM:
+        return xmm(location.reg);
+    default:
+        return at(REG_RBP,
+            -8 * (int32_t) (emitter -> saved + 1 + location.slot));
+    }
+}
+
+static inline void loadValue(
+    struct Emitter* emitter,
+    uint8_t         reg,
+    uint32_t        value
+) {
+    emitMov(emitter, reg, placeOf(emitter, value));
+}
+
+static inline void storeValue(
+    struct Emitter* emitter,
+    uint32_t        value,
+    uint8_t         reg
+) {
+    emitStore(emitter, placeOf(emitter, value), reg);
+}
+
+static inline void loadFloat(
+    struct Emitter* emitter,
+    uint8_t         reg,
+    uint32_t        value
+) {
+    emitMovsd(emitter, reg, placeOf(emitter, value));
+}
+
+static inline void storeFloat(
+    struct Emitter* emitter,
+    uint32_t        value,
+    uint8_t         reg
+) {
+    emitStoreSd(emitter, placeOf(emitter, value), reg);
+}
+
+// sets ZF when value, an integer or Bool, is 0
+static void testValue(struct Emitter* emitter, uint32_t value) {
+    struct Place place = placeOf(emitter, value);
+    if (place.type == PLACE_GPR) {
+        emitModRM(emitter, 0, REX_W, 0x85, place.reg, place);
+    } else {
+        emitModRM(emitter, 0, REX_W, 0x83, 7, place);
+        emitByte(emitter, 0);
+    }
+}
+
+// RAX wrapped like wrapInt
+static void emitWrap(struct Emitter* emitter, uint8_t type, uint8_t bits) {
+    if ((type != IR_TYPE_INT && type != IR_TYPE_UINT)
+     || bits == 0 || bits >= 64) {
+        return;
+    }
+    struct Place rax = gpr(REG_RAX);
+    bool is_signed = type == IR_TYPE_INT;
+    switch (bits) {
+    case 8:
+        emitModRM(emitter, 0, is_signed ? REX_W : 0,
+            is_signed ? 0x0fbe : 0x0fb6, REG_RAX, rax);
+        return;
+    case 16:
+        emitModRM(emitter, 0, is_signed ? REX_W : 0,
+            is_signed ? 0x0fbf : 0x0fb7, REG_RAX, rax);
+        return;
+    case 32:
+        emitModRM(emitter, 0, is_signed ? REX_W : 0,
+            is_signed ? 0x63 : 0x8b, REG_RAX, rax);
+        return;
+    default:
+        emitModRM(emitter, 0, REX_W, 0xc1, 4, rax);
+        emitByte(emitter, 64 - bits);
+        emitModRM(emitter, 0, REX_W, 0xc1, is_signed ? 7 : 5, rax);
+        emitByte(emitter, 64 - bits);
+        return;
+    }
+}
+
+static void emitMove(struct Emitter* emitter, struct Move move) {
+    if (move.from.type == PLACE_MEMORY && move.to.type == PLACE_MEMORY) {
+        emitMov(emitter, REG_RAX, move.from);
+        emitStore(emitter, move.to, REG_RAX);
+    } else if (move.is_float && move.to.type == PLACE_XMM) {
+        emitMovsd(emitter, move.to.reg, move.from);
+    } else if (move.is_float) {
+        emitStoreSd(emitter, move.to, move.from.reg);
+    } else if (move.to.type == PLACE_GPR) {
+        emitMov(emitter, move.to.reg, move.from);
+    } else {
+        emitStore(emitter, move.to, move.from.reg);
+    }
+}
+
+/*
+ * emitter -> moves all at once: a move goes when nothing left still reads
+ * what it writes, a cycle is broken by saving one of its values to R11 or
+ * XMM15 first.
+ */
+static void emitMoves(struct Emitter* emitter) {
+    struct Move* moves = emitter -> moves.items;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < emitter -> moves.count; i++) {
+        if (!samePlace(moves[i].to, moves[i].from)) {
+            moves[count++] = moves[i];
+        }
+    }
+    while (count > 0) {
+        uint32_t ready = NODE_NONE;
+        for (uint32_t i = 0; i < count && ready == NODE_NONE; i++) {
+            ready = i;
+            for (uint32_t j = 0; j < count; j++) {
+                if (j != i && samePlace(moves[j].from, moves[i].to)) {
+                    ready = NODE_NONE;
+                    break;
+                }
+            }
+        }
+        if (ready == NODE_NONE) {
+            struct Place temp = moves[0].is_float ? xmm(15) : gpr(REG_R11);
+            emitMove(emitter, (struct Move) {
+                .to       = temp,
+                .from     = moves[0].from,
+                .is_float = moves[0].is_float
+            });
+            moves[0].from = temp;
+            continue;
+        }
+        emitMove(emitter, moves[ready]);
+        moves[ready] = moves[--count];
+    }
+    emitter -> moves.count = 0;
+}
+
+static inline void pushMove(
+    struct Emitter* emitter,
+    struct Place    to,
+    struct Place    from,
+    bool            is_float
+) {
+    struct Move move = { .to = to, .from = from, .is_float = is_float };
+    pushNode(emitter -> moves, MEMORY_NATIVE, move);
+}
+
+/*
+ * The limit of an object, set by func main since nothing else runs before
+ * it: the stack may grow by its rlimit below where main starts, less some
+ * room. An unlimited stack and functions called without main keep the
+ * limit at 0, which no stack pointer is below.
+ */
+static void emitStackLimit(struct Emitter* emitter) {
+    // getrlimit(RLIMIT_STACK, rsp), the stack stays aligned to 16
+    emitModRM(emitter, 0, REX_W, 0x81, 5, gpr(REG_RSP));
+    emit32(emitter, 16);
+    emitModRM(emitter, 0, REX_W, 0xc7, 0, at(REG_RSP, 0));
+    emit32(emitter, UINT32_MAX);
+    emitMovImm(emitter, REG_RDI, RLIMIT_STACK);
+    emitMov(emitter, REG_RSI, gpr(REG_RSP));
+    emitCall(emitter, externOf(emitter, EXTERN_GETRLIMIT));
+    emitMov(emitter, REG_RCX, at(REG_RSP, 0));
+    emitModRM(emitter, 0, REX_W, 0x81, 0, gpr(REG_RSP));
+    emit32(emitter, 16);
+
+    // rsp - rlim_cur borrows for RLIM_INFINITY, and when getrlimit failed
+    emitMov(emitter, REG_RAX, gpr(REG_RSP));
+    emitModRM(emitter, 0, REX_W, 0x2b, REG_RAX, gpr(REG_RCX));
+    uint32_t skip = jumpShort(emitter, CC_B);
+    emitModRM(emitter, 0, REX_W, 0x81, 0, gpr(REG_RAX));
+    emit32(emitter, NATIVE_STACK_MARGIN);
+    emitStore(emitter, data(emitter -> native -> stack_limit), REG_RAX);
+    landShort(emitter, skip);
+}
+
+static void emitPrologue(struct Emitter* emitter) {
+    struct IrFunction* function = emitter -> function;
+    uint32_t used = emitter -> allocation.used & REGALLOC_CALLEE_SAVED;
+    emitPush(emitter, REG_RBP);
+    emitModRM(emitter, 0, REX_W, 0x89, REG_RSP, gpr(REG_RBP));
+    for (uint8_t reg = 0; reg < 16; reg++) {
+        if (used >> reg & 1) {
+            emitPush(emitter, reg);
+        }
+    }
+    // the calls in the body need the stack aligned to 16
+    uint32_t frame = 8 * emitter -> allocation.slots;
+    if ((emitter -> saved + emitter -> allocation.slots) % 2 != 0) {
+        frame += 8;
+    }
+    if (frame != 0) {
+        emitModRM(emitter, 0, REX_W, 0x81, 5, gpr(REG_RSP));
+        emit32(emitter, frame);
+    }
+    if (emitter -> target == NATIVE_TARGET_OBJECT
+     && emitter -> index == emitter -> module -> main) {
+        emitStackLimit(emitter);
+    }
+    emitModRM(emitter, 0, REX_W, 0x3b, REG_RSP,
+        data(emitter -> native -> stack_limit));
+    jumpFault(emitter, CC_B, NATIVE_FAULT_STACK);
+
+    // the params from where the caller left them
+    uint32_t* params = memoryAllocKind(MEMORY_NATIVE,
+        (function -> params + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < function -> params; i++) {
+        params[i] = NODE_NONE;
+    }
+    for (uint32_t i = 0; i < function -> instrs.count; i++) {
+        if (function -> instrs.items[i].op == IR_PARAM) {
+            params[function -> instrs.items[i].a] = i;
+        }
+    }
+    uint32_t ints = 0;
+    uint32_t floats = 0;
+    uint32_t stack = 0;
+    for (uint32_t i = 0; i < function -> params; i++) {
+        struct IrInstr* param = instrOf(emitter, params[i]);
+        bool is_float = param -> type == IR_TYPE_FLOAT;
+        struct Place from;
+        if (is_float && floats < FLOAT_ARGS) {
+            from = xmm(floats++);
+        } else if (!is_float && ints < INT_ARGS) {
+            from = gpr(int_args[ints++]);
+        } else {
+            from = at(REG_RBP, 16 + 8 * stack++);
+        }
+        if (emitter -> allocation.locations[params[i]].type != LOCATION_NONE) {
+            pushMove(emitter, placeOf(emitter, params[i]), from, is_float);
+        }
+    }
+    emitMoves(emitter);
+
+    // C only sets the bits of a param it has
+    for (uint32_t i = 0; i < function -> params; i++) {
+        struct IrInstr* param = instrOf(emitter, params[i]);
+        if (emitter -> allocation.locations[params[i]].type == LOCATION_NONE) {
+            continue;
+        }
+        if (param -> type == IR_TYPE_FLOAT && param -> bits == 32) {
+            struct Place place = placeOf(emitter, params[i]);
+            uint8_t reg = place.type == PLACE_XMM ? place.reg : 15;
+            if (place.type != PLACE_XMM) {
+                emitModRM(emitter, 0xf3, 0, 0x0f10, reg, place);
+            }
+            emitModRM(emitter, 0xf3, 0, 0x0f5a, reg, xmm(reg));
+            emitStoreSd(emitter, place, reg);
+        } else if (param -> type == IR_TYPE_BOOL
+                || (param -> bits != 0 && param -> bits < 64)) {
+            loadValue(emitter, REG_RAX, params[i]);
+            if (param -> type == IR_TYPE_BOOL) {
+                emitModRM(emitter, 0, 0, 0x0fb6, REG_RAX, gpr(REG_RAX));
+            }
+            emitWrap(emitter, param -> type, param -> bits);
+            storeValue(emitter, params[i], REG_RAX);
+        }
+    }
+    memoryFree(params);
+}
+
+static void emitEpilogue(struct Emitter* emitter) {
+    uint32_t used = emitter -> allocation.used & REGALLOC_CALLEE_SAVED;
+    emitModRM(emitter, 0, REX_W, 0x8d, REG_RSP,
+        at(REG_RBP, -8 * (int32_t) emitter -> saved));
+    for (uint8_t reg = 16; reg > 0; reg--) {
+        if (used >> (reg - 1) & 1) {
+            emitPop(emitter, reg - 1);
+        }
+    }
+    emitPop(emitter, REG_RBP);
+    emitByte(emitter, 0xc3);
+}
+
+static void compileConst(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    struct Place place = placeOf(emitter, index);
+    switch (instr -> type) {
+    case IR_TYPE_FLOAT:
+        emitFloatImm(emitter, place.type == PLACE_XMM ? place.reg : 15,
+            instr -> _float);
+        if (place.type != PLACE_XMM) {
+            storeFloat(emitter, index, 15);
+        }
+        return;
+    case IR_TYPE_STR: {
+        uint8_t reg = place.type == PLACE_GPR ? place.reg : REG_RAX;
+        emitModRM(emitter, 0, REX_W, 0x8d, reg,
+            data(stringOf(emitter, instr -> string)));
+        storeValue(emitter, index, reg);
+        return;
+    }
+    default: {
+        uint8_t reg = place.type == PLACE_GPR ? place.reg : REG_RAX;
+        emitMovImm(emitter, reg, instr -> _uint);
+        storeValue(emitter, index, reg);
+        return;
+    }
+    }
+}
+
+static void compileArithmetic(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    if (instr -> type == IR_TYPE_FLOAT) {
+        static const uint32_t opcodes[] = {
+            [IR_ADD]      = 0x0f58,
+            [IR_SUBTRACT] = 0x0f5c,
+            [IR_MULTIPLY] = 0x0f59,
+            [IR_DIVIDE]   = 0x0f5e,
+        };
+        loadFloat(emitter, 15, instr -> a);
+        emitModRM(emitter, 0xf2, 0, opcodes[instr -> op], 15,
+            placeOf(emitter, instr -> b));
+        if (instr -> bits == 32) {
+            emitRound(emitter, 15);
+        }
+        storeFloat(emitter, index, 15);
+        return;
+    }
+    static const uint32_t opcodes[] = {
+        [IR_ADD]         = 0x03,
+        [IR_SUBTRACT]    = 0x2b,
+        [IR_MULTIPLY]    = 0x0faf,
+        [IR_BITWIZE_OR]  = 0x0b,
+        [IR_BITWIZE_AND] = 0x23,
+    };
+    loadValue(emitter, REG_RAX, instr -> a);
+    emitModRM(emitter, 0, REX_W, opcodes[instr -> op], REG_RAX,
+        placeOf(emitter, instr -> b));
+    emitWrap(emitter, instr -> type, instr -> bits);
+    storeValue(emitter, index, REG_RAX);
+}
+
+// INT64_MIN / -1 wraps to itself like in the VM, instead of trapping
+static void compileDivide(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    if (instr -> type == IR_TYPE_FLOAT) {
+        compileArithmetic(emitter, index);
+        return;
+    }
+    bool is_modulo = instr -> op == IR_MODULO;
+    loadValue(emitter, REG_RCX, instr -> b);
+    emitModRM(emitter, 0, REX_W, 0x85, REG_RCX, gpr(REG_RCX));
+    jumpFault(emitter, CC_E, NATIVE_FAULT_DIVISION);
+    loadValue(emitter, REG_RAX, instr -> a);
+    uint32_t done = NODE_NONE;
+    if (instr -> type == IR_TYPE_INT) {
+        emitModRM(emitter, 0, REX_W, 0x83, 7, gpr(REG_RCX));
+        emitByte(emitter, 0xff);
+        uint32_t divide = jumpShort(emitter, CC_NE);
+        if (is_modulo) {
+            emitModRM(emitter, 0, 0, 0x33, REG_RAX, gpr(REG_RAX));
+        } else {
+            emitModRM(emitter, 0, REX_W, 0xf7, 3, gpr(REG_RAX));
+        }
+        done = jumpShort(emitter, CC_ALWAYS);
+        landShort(emitter, divide);
+        emitByte(emitter, REX_W);
+        emitByte(emitter, 0x99);
+        emitModRM(emitter, 0, REX_W, 0xf7, 7, gpr(REG_RCX));
+    } else {
+        emitModRM(emitter, 0, 0, 0x33, REG_RDX, gpr(REG_RDX));
+        emitModRM(emitter, 0, REX_W, 0xf7, 6, gpr(REG_RCX));
+    }
+    if (is_modulo) {
+        emitMov(emitter, REG_RAX, gpr(REG_RDX));
+    }
+    if (done != NODE_NONE) {
+        landShort(emitter, done);
+    }
+    emitWrap(emitter, instr -> type, instr -> bits);
+    storeValue(emitter, index, REG_RAX);
+}
+
+// counts as wide as the value or wider give 0, or -1 for a negative value
+static void compileShift(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    bool is_signed = instr -> type == IR_TYPE_INT;
+    bool is_left = instr -> op == IR_LEFT_SHIFT;
+    uint8_t bits = instr -> bits == 0 || instr -> bits > 64
+        ? 64
+        : instr -> bits;
+    loadValue(emitter, REG_RCX, instr -> b);
+    if (instrOf(emitter, instr -> b) -> type == IR_TYPE_INT) {
+        emitModRM(emitter, 0, REX_W, 0x85, REG_RCX, gpr(REG_RCX));
+        jumpFault(emitter, CC_S, NATIVE_FAULT_SHIFT);
+    }
+    loadValue(emitter, REG_RAX, instr -> a);
+    emitModRM(emitter, 0, REX_W, 0x83, 7, gpr(REG_RCX));
+    emitByte(emitter, bits);
+    uint32_t wide = jumpShort(emitter, CC_AE);
+    emitModRM(emitter, 0, REX_W, 0xd3, is_left ? 4 : is_signed ? 7 : 5,
+        gpr(REG_RAX));
+    uint32_t done = jumpShort(emitter, CC_ALWAYS);
+    landShort(emitter, wide);
+    if (!is_left && is_signed) {
+        emitModRM(emitter, 0, REX_W, 0xc1, 7, gpr(REG_RAX));
+        emitByte(emitter, 63);
+    } else {
+        emitModRM(emitter, 0, 0, 0x33, REG_RAX, gpr(REG_RAX));
+    }
+    landShort(emitter, done);
+    emitWrap(emitter, instr -> type, instr -> bits);
+    storeValue(emitter, index, REG_RAX);
+}
+
+/*
+ * Floats that are not a number are unordered, ucomisd sets ZF, PF and CF
+ * for them, so < and <= compare the other way around with above.
+ */
+static void compileCompare(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    struct IrInstr* left = instrOf(emitter, instr -> a);
+    if (left -> type == IR_TYPE_FLOAT) {
+        bool is_swapped = instr -> op == IR_LESS_THEN
+                       || instr -> op == IR_LESS_THEN_OR_EQUAL;
+        loadFloat(emitter, 15, is_swapped ? instr -> b : instr -> a);
+        emitModRM(emitter, 0x66, 0, 0x0f2e, 15,
+            placeOf(emitter, is_swapped ? instr -> a : instr -> b));
+        switch (instr -> op) {
+        case IR_EQUAL:
+            emitSetcc(emitter, CC_E);
+            emitModRM(emitter, 0, 0, 0x0f90 | CC_NP, 0, gpr(REG_RCX));
+            emitModRM(emitter, 0, 0, 0x20, REG_RCX, gpr(REG_RAX));
+            break;
+        case IR_NOT_EQUAL:
+            emitSetcc(emitter, CC_NE);
+            emitModRM(emitter, 0, 0, 0x0f90 | CC_P, 0, gpr(REG_RCX));
+            emitModRM(emitter, 0, 0, 0x08, REG_RCX, gpr(REG_RAX));
+            break;
+        case IR_LESS_THEN:
+        case IR_GREAT_THEN:
+            emitSetcc(emitter, CC_A);
+            break;
+        default:
+            emitSetcc(emitter, CC_AE);
+            break;
+        }
+        emitBoolean(emitter);
+        storeValue(emitter, index, REG_RAX);
+        return;
+    }
+    if (left -> type == IR_TYPE_STR
+     && instr -> op != IR_EQUAL && instr -> op != IR_NOT_EQUAL) {
+        errorNative(emitter, "Str can only be compared for equality here");
+    }
+    bool is_signed = left -> type == IR_TYPE_INT;
+    enum Condition cc;
+    switch (instr -> op) {
+    case IR_EQUAL:              cc = CC_E;                      break;
+    case IR_NOT_EQUAL:          cc = CC_NE;                     break;
+    case IR_LESS_THEN:          cc = is_signed ? CC_L : CC_B;   break;
+    case IR_GREAT_THEN:         cc = is_signed ? CC_G : CC_A;   break;
+    case IR_LESS_THEN_OR_EQUAL: cc = is_signed ? CC_LE : CC_BE; break;
+    default:                    cc = is_signed ? CC_GE : CC_AE; break;
+    }
+    loadValue(emitter, REG_RAX, instr -> a);
+    emitModRM(emitter, 0, REX_W, 0x3b, REG_RAX, placeOf(emitter, instr -> b));
+    emitSetcc(emitter, cc);
+    emitBoolean(emitter);
+    storeValue(emitter, index, REG_RAX);
+}
+
+static void compileUnary(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    switch (instr -> op) {
+    case IR_NEG:
+        if (instr -> type == IR_TYPE_FLOAT) {
+            loadFloat(emitter, 15, instr -> a);
+            emitMovImm(emitter, REG_RAX, UINT64_C(1) << 63);
+            emitModRM(emitter, 0x66, REX_W, 0x0f6e, 14, gpr(REG_RAX));
+            emitModRM(emitter, 0x66, 0, 0x0f57, 15, xmm(14));
+            storeFloat(emitter, index, 15);
+            return;
+        }
+        loadValue(emitter, REG_RAX, instr -> a);
+        emitModRM(emitter, 0, REX_W, 0xf7, 3, gpr(REG_RAX));
+        break;
+    case IR_BITWIZE_NOT:
+        loadValue(emitter, REG_RAX, instr -> a);
+        emitModRM(emitter, 0, REX_W, 0xf7, 2, gpr(REG_RAX));
+        break;
+    default:
+        loadValue(emitter, REG_RAX, instr -> a);
+        emitModRM(emitter, 0, 0, 0x83, 6, gpr(REG_RAX));
+        emitByte(emitter, 1);
+        break;
+    }
+    emitWrap(emitter, instr -> type, instr -> bits);
+    storeValue(emitter, index, REG_RAX);
+}
+
+// XMM15 to RAX if it is in the range of the integer, a fault if not
+static void castFloat(struct Emitter* emitter, struct IrInstr* instr) {
+    bool is_signed = instr -> type == IR_TYPE_INT;
+    uint8_t bits = instr -> bits == 0 || instr -> bits > 64
+        ? 64
+        : instr -> bits;
+    double limit = (double) (UINT64_C(1) << (bits - 1));
+    double low = is_signed ? -limit - 1 : -1;
+    double high = is_signed ? limit : limit * 2;
+    emitFloatImm(emitter, 14, low);
+    emitModRM(emitter, 0x66, 0, 0x0f2e, 15, xmm(14));
+    jumpFault(emitter, CC_BE, NATIVE_FAULT_CAST);
+    emitFloatImm(emitter, 14, high);
+    emitModRM(emitter, 0x66, 0, 0x0f2e, 14, xmm(15));
+    jumpFault(emitter, CC_BE, NATIVE_FAULT_CAST);
+    if (is_signed || bits < 64) {
+        emitModRM(emitter, 0xf2, REX_W, 0x0f2c, REG_RAX, xmm(15));
+        return;
+    }
+    // cvttsd2si is signed, the upper half goes through 2^63 less
+    emitFloatImm(emitter, 14, limit);
+    emitModRM(emitter, 0x66, 0, 0x0f2e, 15, xmm(14));
+    uint32_t big = jumpShort(emitter, CC_AE);
+    emitModRM(emitter, 0xf2, REX_W, 0x0f2c, REG_RAX, xmm(15));
+    uint32_t done = jumpShort(emitter, CC_ALWAYS);
+    landShort(emitter, big);
+    emitModRM(emitter, 0xf2, 0, 0x0f5c, 15, xmm(14));
+    emitModRM(emitter, 0xf2, REX_W, 0x0f2c, REG_RAX, xmm(15));
+    emitModRM(emitter, 0, REX_W, 0x0fba, 7, gpr(REG_RAX));
+    emitByte(emitter, 63);
+    landShort(emitter, done);
+}
+
+// RAX to XMM15, a Uint64 with its top bit set is halved and doubled
+static void castInteger(struct Emitter* emitter, struct IrInstr* from) {
+    if (from -> type != IR_TYPE_UINT
+     || (from -> bits != 0 && from -> bits < 64)) {
+        emitModRM(emitter, 0xf2, REX_W, 0x0f2a, 15, gpr(REG_RAX));
+        return;
+    }
+    emitModRM(emitter, 0, REX_W, 0x85, REG_RAX, gpr(REG_RAX));
+    uint32_t big = jumpShort(emitter, CC_S);
+    emitModRM(emitter, 0xf2, REX_W, 0x0f2a, 15, gpr(REG_RAX));
+    uint32_t done = jumpShort(emitter, CC_ALWAYS);
+    landShort(emitter, big);
+    emitMov(emitter, REG_RCX, gpr(REG_RAX));
+    emitModRM(emitter, 0, REX_W, 0xd1, 5, gpr(REG_RCX));
+    emitModRM(emitter, 0, 0, 0x83, 4, gpr(REG_RAX));
+    emitByte(emitter, 1);
+    emitModRM(emitter, 0, REX_W, 0x0b, REG_RCX, gpr(REG_RAX));
+    emitModRM(emitter, 0xf2, REX_W, 0x0f2a, 15, gpr(REG_RCX));
+    emitModRM(emitter, 0xf2, 0, 0x0f58, 15, xmm(15));
+    landShort(emitter, done);
+}
+
+static void compileCast(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    struct IrInstr* from = instrOf(emitter, instr -> a);
+    if (instr -> type == IR_TYPE_FLOAT) {
+        if (from -> type == IR_TYPE_FLOAT) {
+            loadFloat(emitter, 15, instr -> a);
+        } else {
+            loadValue(emitter, REG_RAX, instr -> a);
+            castInteger(emitter, from);
+        }
+        if (instr -> bits == 32) {
+            emitRound(emitter, 15);
+        }
+        storeFloat(emitter, index, 15);
+        return;
+    }
+    if (instr -> type == IR_TYPE_BOOL && from -> type == IR_TYPE_FLOAT) {
+        // not a number is true too
+        loadFloat(emitter, 15, instr -> a);
+        emitModRM(emitter, 0x66, 0, 0x0f57, 14, xmm(14));
+        emitModRM(emitter, 0x66, 0, 0x0f2e, 15, xmm(14));
+        emitSetcc(emitter, CC_NE);
+        emitModRM(emitter, 0, 0, 0x0f90 | CC_P, 0, gpr(REG_RCX));
+        emitModRM(emitter, 0, 0, 0x08, REG_RCX, gpr(REG_RAX));
+        emitBoolean(emitter);
+    } else if (instr -> type == IR_TYPE_BOOL) {
+        loadValue(emitter, REG_RAX, instr -> a);
+        emitModRM(emitter, 0, REX_W, 0x85, REG_RAX, gpr(REG_RAX));
+        emitSetcc(emitter, CC_NE);
+        emitBoolean(emitter);
+    } else if (from -> type == IR_TYPE_FLOAT) {
+        loadFloat(emitter, 15, instr -> a);
+        castFloat(emitter, instr);
+    } else {
+        loadValue(emitter, REG_RAX, instr -> a);
+        emitWrap(emitter, instr -> type, instr -> bits);
+    }
+    storeValue(emitter, index, REG_RAX);
+}
+
+/*
+ * The arguments go where the System V convention puts them: integers,
+ * Bool and Str in RDI, RSI, RDX, RCX, R8 and R9, floats in XMM0 to XMM7,
+ * Float32 as one, and the rest on the stack.
+ */
+static void compileCall(struct Emitter* emitter, uint32_t index) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    uint32_t ints = 0;
+    uint32_t floats = 0;
+    uint32_t stack = 0;
+    for (uint32_t i = 0; i < instr -> args.count; i++) {
+        bool is_float = instrOf(emitter, operandOf(emitter, instr, i)) -> type
+            == IR_TYPE_FLOAT;
+        if (is_float ? floats++ >= FLOAT_ARGS : ints++ >= INT_ARGS) {
+            stack++;
+        }
+    }
+    uint32_t bytes = 8 * (stack + stack % 2);
+    if (stack % 2 != 0) {
+        emitModRM(emitter, 0, REX_W, 0x83, 5, gpr(REG_RSP));
+        emitByte(emitter, 8);
+    }
+    for (uint32_t i = instr -> args.count; i > 0 && stack > 0; i--) {
+        uint32_t arg = operandOf(emitter, instr, i - 1);
+        struct IrInstr* value = instrOf(emitter, arg);
+        bool is_float = value -> type == IR_TYPE_FLOAT;
+        if (is_float ? --floats < FLOAT_ARGS : --ints < INT_ARGS) {
+            continue;
+        }
+        stack--;
+        if (!is_float) {
+            emitModRM(emitter, 0, 0, 0xff, 6, placeOf(emitter, arg));
+            continue;
+        }
+        emitModRM(emitter, 0, REX_W, 0x83, 5, gpr(REG_RSP));
+        emitByte(emitter, 8);
+        loadFloat(emitter, 15, arg);
+        if (value -> bits == 32) {
+            emitModRM(emitter, 0xf2, 0, 0x0f5a, 15, xmm(15));
+            emitModRM(emitter, 0xf3, 0, 0x0f11, 15, at(REG_RSP, 0));
+        } else {
+            emitModRM(emitter, 0xf2, 0, 0x0f11, 15, at(REG_RSP, 0));
+        }
+    }
+
+    ints = 0;
+    floats = 0;
+    for (uint32_t i = 0; i < instr -> args.count; i++) {
+        uint32_t arg = operandOf(emitter, instr, i);
+        bool is_float = instrOf(emitter, arg) -> type == IR_TYPE_FLOAT;
+        if (is_float && floats < FLOAT_ARGS) {
+            pushMove(emitter, xmm(floats++), placeOf(emitter, arg), true);
+        } else if (!is_float && ints < INT_ARGS) {
+            pushMove(emitter, gpr(int_args[ints++]), placeOf(emitter, arg),
+                false);
+        }
+    }
+    emitMoves(emitter);
+    floats = 0;
+    for (uint32_t i = 0; i < instr -> args.count; i++) {
+        struct IrInstr* value = instrOf(emitter, operandOf(emitter, instr, i));
+        if (value -> type == IR_TYPE_FLOAT && floats < FLOAT_ARGS) {
+            if (value -> bits == 32) {
+                emitModRM(emitter, 0xf2, 0, 0x0f5a, floats, xmm(floats));
+            }
+            floats++;
+        }
+    }
+
+    emitCall(emitter, emitter -> native -> functions[instr -> a]);
+    if (bytes != 0) {
+        emitModRM(emitter, 0, REX_W, 0x81, 0, gpr(REG_RSP));
+        emit32(emitter, bytes);
+    }
+    if (instr -> type == IR_TYPE_FLOAT) {
+        if (instr -> bits == 32) {
+            emitModRM(emitter, 0xf3, 0, 0x0f5a, 0, xmm(0));
+        }
+        storeFloat(emitter, index, 0);
+    } else if (instr -> type != IR_TYPE_NONE) {
+        storeValue(emitter, index, REG_RAX);
+    }
+}
+
+// a Str record at RSI as write(RDI, RSI + 8, length)
+static void emitWriteRecord(struct Emitter* emitter) {
+    emitMov(emitter, REG_RDX, at(REG_RSI, 0));
+    emitModRM(emitter, 0, REX_W, 0x83, 0, gpr(REG_RSI));
+    emitByte(emitter, 8);
+    emitCall(emitter, externOf(emitter, EXTERN_WRITE));
+}
+
+// File.write formats values like writeValue of the VM
+static void compileWrite(struct Emitter* emitter, struct IrInstr* instr) {
+    uint32_t file = operandOf(emitter, instr, 0);
+    uint32_t value = operandOf(emitter, instr, 1);
+    if (instrOf(emitter, file) -> type != IR_TYPE_FILE) {
+        jumpFault(emitter, CC_ALWAYS, NATIVE_FAULT_FILE);
+        return;
+    }
+    struct IrInstr* written = instrOf(emitter, value);
+    loadValue(emitter, REG_RAX, file);
+    enum Constant format;
+    switch (written -> type) {
+    case IR_TYPE_INT:
+    case IR_TYPE_UINT:
+    case IR_TYPE_FILE:
+        format = written -> type == IR_TYPE_INT ? CONSTANT_INT
+               : written -> type == IR_TYPE_UINT ? CONSTANT_UINT
+               : CONSTANT_FILE;
+        loadValue(emitter, REG_RDX, value);
+        emitMov(emitter, REG_RDI, gpr(REG_RAX));
+        emitModRM(emitter, 0, REX_W, 0x8d, REG_RSI,
+            data(constantOf(emitter, format)));
+        emitModRM(emitter, 0, 0, 0x33, REG_RAX, gpr(REG_RAX));
+        emitCall(emitter, externOf(emitter, EXTERN_DPRINTF));
+        return;
+    case IR_TYPE_FLOAT:
+        loadFloat(emitter, 0, value);
+        emitMov(emitter, REG_RDI, gpr(REG_RAX));
+        emitModRM(emitter, 0, REX_W, 0x8d, REG_RSI,
+            data(constantOf(emitter, CONSTANT_FLOAT)));
+        emitMovImm(emitter, REG_RAX, 1);
+        emitCall(emitter, externOf(emitter, EXTERN_DPRINTF));
+        return;
+    case IR_TYPE_STR:
+        loadValue(emitter, REG_R11, value);
+        emitMov(emitter, REG_RDI, gpr(REG_RAX));
+        emitMov(emitter, REG_RSI, gpr(REG_R11));
+        break;
+    case IR_TYPE_BOOL:
+        loadValue(emitter, REG_R11, value);
+        emitMov(emitter, REG_RDI, gpr(REG_RAX));
+        emitModRM(emitter, 0, REX_W, 0x8d, REG_RSI,
+            data(constantOf(emitter, CONSTANT_TRUE)));
+        emitModRM(emitter, 0, REX_W, 0x8d, REG_RDX,
+            data(constantOf(emitter, CONSTANT_FALSE)));
+        emitModRM(emitter, 0, REX_W, 0x85, REG_R11, gpr(REG_R11));
+        emitModRM(emitter, 0, REX_W, 0x0f40 | CC_E, REG_RSI, gpr(REG_RDX));
+        break;
+    default:
+        emitMov(emitter, REG_RDI, gpr(REG_RAX));
+        emitModRM(emitter, 0, REX_W, 0x8d, REG_RSI,
+            data(constantOf(emitter, CONSTANT_NONE)));
+        break;
+    }
+    emitWriteRecord(emitter);
+}
+
+// the moves into the phis of target for the edge from block
+static void emitPhiMoves(
+    struct Emitter* emitter,
+    uint32_t        block,
+    uint32_t        target
+) {
+    struct IrBlock* to = &emitter -> function -> blocks.items[target];
+    uint32_t pred = 0;
+    while (to -> preds.items[pred] != block) {
+        pred++;
+    }
+    for (uint32_t i = 0; i < to -> code.count; i++) {
+        uint32_t phi = to -> code.items[i];
+        struct IrInstr* instr = instrOf(emitter, phi);
+        if (instr -> op != IR_PHI) {
+            break;
+        }
+        if (instr -> type == IR_TYPE_NONE
+         || emitter -> allocation.locations[phi].type == LOCATION_NONE) {
+            continue;
+        }
+        pushMove(emitter, placeOf(emitter, phi),
+            placeOf(emitter, operandOf(emitter, instr, pred)),
+            instr -> type == IR_TYPE_FLOAT);
+    }
+    emitMoves(emitter);
+}
+
+// next is the block laid out after this one, NODE_NONE after the last
+static void compileInstr(
+    struct Emitter* emitter,
+    uint32_t        index,
+    uint32_t        next
+) {
+    struct IrInstr* instr = instrOf(emitter, index);
+    switch (instr -> op) {
+    case IR_NOP:
+    case IR_PARAM:
+    case IR_PHI:
+        return;
+    case IR_CONST:
+        compileConst(emitter, index);
+        return;
+    case IR_ADD:
+    case IR_SUBTRACT:
+    case IR_MULTIPLY:
+    case IR_BITWIZE_OR:
+    case IR_BITWIZE_AND:
+        compileArithmetic(emitter, index);
+        return;
+    case IR_DIVIDE:
+    case IR_MODULO:
+        compileDivide(emitter, index);
+        return;
+    case IR_LEFT_SHIFT:
+    case IR_RIGHT_SHIFT:
+        compileShift(emitter, index);
+        return;
+    case IR_EQUAL:
+    case IR_NOT_EQUAL:
+    case IR_LESS_THEN:
+    case IR_GREAT_THEN:
+    case IR_LESS_THEN_OR_EQUAL:
+    case IR_GREA_THEN_OR_EQUAL:
+        compileCompare(emitter, index);
+        return;
+    case IR_NEG:
+    case IR_BITWIZE_NOT:
+    case IR_LOGICAL_NOT:
+        compileUnary(emitter, index);
+        return;
+    case IR_CAST:
+        compileCast(emitter, index);
+        return;
+    case IR_CALL:
+        compileCall(emitter, index);
+        return;
+    case IR_NATIVE:
+        if (instr -> a == NATIVE_WRITE) {
+            compileWrite(emitter, instr);
+        } else {
+            testValue(emitter, operandOf(emitter, instr, 0));
+            jumpFault(emitter, CC_E, NATIVE_FAULT_ASSERT);
+        }
+        return;
+    case IR_JUMP:
+        emitPhiMoves(emitter, instr -> block, instr -> targets[0]);
+        if (instr -> targets[0] != next) {
+            jumpTo(emitter, CC_ALWAYS, instr -> targets[0]);
+        }
+        return;
+    case IR_BRANCH:
+        testValue(emitter, instr -> a);
+        if (instr -> targets[0] == next) {
+            jumpTo(emitter, CC_E, instr -> targets[1]);
+            return;
+        }
+        jumpTo(emitter, CC_NE, instr -> targets[0]);
+        if (instr -> targets[1] != next) {
+            jumpTo(emitter, CC_ALWAYS, instr -> targets[1]);
+        }
+        return;
+    case IR_RETURN: {
+        struct IrFunction* function = emitter -> function;
+        if (instr -> a == NODE_NONE || function -> result == IR_TYPE_NONE) {
+            // func main() is int main() for C
+            emitModRM(emitter, 0, 0, 0x33, REG_RAX, gpr(REG_RAX));
+        } else if (function -> result == IR_TYPE_FLOAT) {
+            loadFloat(emitter, 0, instr -> a);
+            if (function -> bits == 32) {
+                emitModRM(emitter, 0xf2, 0, 0x0f5a, 0, xmm(0));
+            }
+        } else {
+            loadValue(emitter, REG_RAX, instr -> a);
+        }
+        emitEpilogue(emitter);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static char* nameOf(struct Emitter* emitter, uint32_t index) {
+    struct IrFunction* function = &emitter -> module -> functions.items[index];
+    if (function -> name != SYMBOL_NONE) {
+        struct String name = symbolString(emitter -> module -> symbols,
+            function -> name);
+        return memoryStringnLengthDup(name.string, name.length);
+    }
+    uint32_t test = 0;
+    while (emitter -> module -> tests.items[test] != index) {
+        test++;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "test.%u", test + 1);
+    return memoryStringnDup(name);
+}
+
+static void compileFunction(struct Emitter* emitter, uint32_t index) {
+    struct NativeModule* res = emitter -> native;
+    struct IrFunction* function = &emitter -> module -> functions.items[index];
+    emitter -> function = function;
+    emitter -> index = index;
+    irSplitCriticalEdges(function);
+    allocateRegisters(&emitter -> allocation, function);
+    emitter -> saved = __builtin_popcount(
+        emitter -> allocation.used & REGALLOC_CALLEE_SAVED
+    );
+    emitter -> fixups.count = 0;
+    for (uint32_t i = 0; i < NATIVE_FAULT_COUNT; i++) {
+        emitter -> faults[i] = NODE_NONE;
+    }
+    uint32_t blocks = function -> blocks.count;
+    emitter -> starts = memoryAllocKind(MEMORY_NATIVE,
+        blocks * sizeof(uint32_t));
+
+    uint32_t start = res -> text.count;
+    emitPrologue(emitter);
+    struct Allocation* allocation = &emitter -> allocation;
+    for (uint32_t i = 0; i < allocation -> count; i++) {
+        uint32_t block = allocation -> order[i];
+        uint32_t next = i + 1 < allocation -> count
+            ? allocation -> order[i + 1]
+            : NODE_NONE;
+        emitter -> starts[block] = res -> text.count;
+        struct IrBlock* now = &function -> blocks.items[block];
+        for (uint32_t j = 0; j < now -> code.count; j++) {
+            compileInstr(emitter, now -> code.items[j], next);
+        }
+    }
+
+    // the faults of the function after its blocks, they do not return
+    for (uint32_t i = 0; i < emitter -> fixups.count; i++) {
+        uint32_t target = emitter -> fixups.items[i].target;
+        if (target < blocks
+         || emitter -> faults[target - blocks] != NODE_NONE) {
+            continue;
+        }
+        emitter -> faults[target - blocks] = res -> text.count;
+        emitMovImm(emitter, REG_RDI, target - blocks);
+        emitMovImm(emitter, REG_RSI, index);
+        emitCall(emitter, externOf(emitter, EXTERN_FAULT));
+        emitByte(emitter, 0x0f);
+        emitByte(emitter, 0x0b);
+    }
+    for (uint32_t i = 0; i < emitter -> fixups.count; i++) {
+        struct Fixup fixup = emitter -> fixups.items[i];
+        uint32_t to = fixup.target < blocks
+            ? emitter -> starts[fixup.target]
+            : emitter -> faults[fixup.target - blocks];
+        patch32(emitter, fixup.offset, to - (fixup.offset + 4));
+    }
+
+    struct NativeSymbol* symbol = &res -> symbols.items[
+        res -> functions[index]
+    ];
+    symbol -> offset = start;
+    symbol -> size = res -> text.count - start;
+    // the next function starts aligned
+    while (res -> text.count % 16 != 0) {
+        emitByte(emitter, 0xcc);
+    }
+    memoryFree(emitter -> starts);
+    freeAllocation(&emitter -> allocation);
+}
+
+/*
+ * NATIVE_FAULT(kind, function) for an object: writes "Runtime error",
+ * the path, the message of kind and where it happened to stderr in three
+ * records found through tables in data, then exits with 1.
+ */
+static void compileFaultHandler(struct Emitter* emitter) {
+    struct NativeModule* native = emitter -> native;
+    struct IrModule* module = emitter -> module;
+    char prefix[512];
+    snprintf(prefix, sizeof(prefix), "Runtime error %s: ", module -> path);
+    uint32_t prefix_record = addRecord(native, prefix, strlen(prefix));
+
+    uint32_t kinds[NATIVE_FAULT_COUNT];
+    for (uint32_t i = 0; i < NATIVE_FAULT_COUNT; i++) {
+        const char* message = native_fault_messages[i];
+        kinds[i] = addRecord(native, message, strlen(message));
+    }
+    uint32_t* wheres = memoryAllocKind(MEMORY_NATIVE,
+        (module -> functions.count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < module -> functions.count; i++) {
+        struct IrFunction* function = &module -> functions.items[i];
+        char where[320];
+        if (function -> name == SYMBOL_NONE) {
+            uint32_t test = 0;
+            while (module -> tests.items[test] != i) {
+                test++;
+            }
+            snprintf(where, sizeof(where), ", in test %u\n", test + 1);
+        } else {
+            struct String name = symbolString(module -> symbols,
+                function -> name);
+            snprintf(where, sizeof(where), ", in func %.*s\n",
+                (int) name.length, name.string);
+        }
+        wheres[i] = addRecord(native, where, strlen(where));
+    }
+    uint32_t kind_table = addData(native, kinds, sizeof(kinds), 4);
+    uint32_t where_table = addData(native, wheres,
+        module -> functions.count * sizeof(uint32_t), 4);
+    memoryFree(wheres);
+
+    // the call left the stack 8 off, three pushes align it again
+    uint32_t start = native -> text.count;
+    emitPush(emitter, REG_RBX);
+    emitPush(emitter, REG_R12);
+    emitPush(emitter, REG_R13);
+    emitModRM(emitter, 0, 0, 0x8b, REG_RBX, gpr(REG_RDI));
+    emitModRM(emitter, 0, 0, 0x8b, REG_R12, gpr(REG_RSI));
+    emitModRM(emitter, 0, REX_W, 0x8d, REG_R13, data(0));
+
+    emitMovImm(emitter, REG_RDI, VM_STDERR);
+    emitModRM(emitter, 0, REX_W, 0x8d, REG_RSI, data(prefix_record));
+    emitWriteRecord(emitter);
+    uint8_t indexes[] = { REG_RBX, REG_R12 };
+    uint32_t tables[] = { kind_table, where_table };
+    for (uint32_t i = 0; i < 2; i++) {
+        // rsi = data + table[index]
+        emitModRM(emitter, 0, 0, 0x8b, REG_RAX, gpr(indexes[i]));
+        emitModRM(emitter, 0, 0, 0xc1, 4, gpr(REG_RAX));
+        emitByte(emitter, 2);
+        emitModRM(emitter, 0, REX_W, 0x01, REG_R13, gpr(REG_RAX));
+        emitModRM(emitter, 0, 0, 0x8b, REG_RSI, at(REG_RAX, tables[i]));
+        emitModRM(emitter, 0, REX_W, 0x01, REG_R13, gpr(REG_RSI));
+        emitMovImm(emitter, REG_RDI, VM_STDERR);
+        emitWriteRecord(emitter);
+    }
+    emitMovImm(emitter, REG_RDI, 1);
+    emitCall(emitter, externOf(emitter, EXTERN_EXIT));
+    emitByte(emitter, 0x0f);
+    emitByte(emitter, 0x0b);
+    struct NativeSymbol* symbol = &native -> symbols.items[
+        emitter -> externs[EXTERN_FAULT]
+    ];
+    symbol -> type = NATIVE_SYMBOL_FUNCTION;
+    symbol -> is_global = false;
+    symbol -> offset = start;
+    symbol -> size = native -> text.count - start;
+}
+
+bool compileNative(
+    struct NativeModule* native,
+    struct IrModule*     module,
+    enum NativeTarget    target,
+    struct Error*        error
+) {
+    timeBegin("native");
+    (*native) = (struct NativeModule) {
+        .path        = module -> path,
+        .functions   = memoryAllocKind(MEMORY_NATIVE,
+            (module -> functions.count + 1) * sizeof(uint32_t)),
+        .stack_limit = NODE_NONE
+    };
+    addSymbol(native, memoryStringnDup(""), NATIVE_SYMBOL_DATA, false);
+    struct Emitter state = {
+        .native      = native,
+        .module      = module,
+        .target      = target,
+        .error       = error,
+        .strings     = memoryAllocKind(MEMORY_NATIVE,
+            (module -> symbols -> count + 1) * sizeof(uint32_t))
+    };
+    memset(state.strings, 0,
+        (module -> symbols -> count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < CONSTANT_COUNT; i++) {
+        state.constants[i] = NODE_NONE;
+    }
+    for (uint32_t i = 0; i < EXTERN_COUNT; i++) {
+        state.externs[i] = NODE_NONE;
+    }
+    uint64_t limit = 0;
+    native -> stack_limit = addData(native, &limit, sizeof(limit), 8);
+
+    for (uint32_t i = 0; i < module -> functions.count; i++) {
+        struct IrFunction* function = &module -> functions.items[i];
+        native -> functions[i] = NODE_NONE;
+        if (function -> blocks.count != 0) {
+            native -> functions[i] = addSymbol(native, nameOf(&state, i),
+                NATIVE_SYMBOL_FUNCTION, function -> is_exported
+                                     || i == module -> main);
+        }
+    }
+
+    bool res = true;
+    if (setjmp(state.bail) == 0) {
+        for (uint32_t i = 0; i < module -> functions.count; i++) {
+            if (native -> functions[i] != NODE_NONE) {
+                compileFunction(&state, i);
+            }
+        }
+        if (target == NATIVE_TARGET_OBJECT
+         && state.externs[EXTERN_FAULT] != NODE_NONE) {
+            compileFaultHandler(&state);
+        }
+    } else {
+        memoryFree(state.starts);
+        freeAllocation(&state.allocation);
+        res = false;
+    }
+    native -> symbols.items[0].size = native -> data.count;
+
+    memoryFree(state.strings);
+    memoryFree(state.fixups.items);
+    memoryFree(state.moves.items);
+    timeEnd();
+    return res;
+}
+
+void freeNative(struct NativeModule* native) {
+    for (uint32_t i = 0; i < native -> symbols.count; i++) {
+        memoryFree(native -> symbols.items[i].name);
+    }
+    memoryFree(native -> text.items);
+    memoryFree(native -> data.items);
+    memoryFree(native -> symbols.items);
+    memoryFree(native -> relocs.items);
+    memoryFree(native -> functions);
+}
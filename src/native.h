@@ -0,0 +1,96 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "ir.h"
+
+/*
+ * x86-64 machine code of an IrModule, still to be placed in memory: the
+ * code of every function in text, the strings it uses in data and the
+ * places that need an address filled in as relocs, like an object file
+ * has them. Functions follow the System V calling convention, so C can
+ * call the cfuncs and they can call C.
+ *
+ * A Str is the address of its length as 8 bytes, followed by its bytes
+ * and a 0. File.write goes through dprintf and write of libc, a fault
+ * calls NATIVE_FAULT with the enum NativeFault in the first argument and
+ * the index of the function in the second, it does not return.
+ */
+
+#define NATIVE_FAULT "__mic_fault"
+
+enum NativeFault {
+    NATIVE_FAULT_DIVISION,
+    NATIVE_FAULT_SHIFT,
+    NATIVE_FAULT_CAST,
+    NATIVE_FAULT_STACK,
+    NATIVE_FAULT_ASSERT,
+    NATIVE_FAULT_FILE,
+    NATIVE_FAULT_COUNT,
+};
+
+// the text of every fault, like the VM has it
+extern const char* const native_fault_messages[NATIVE_FAULT_COUNT];
+
+enum NativeTarget {
+    NATIVE_TARGET_JIT,              // loaded by loadJit, see jit.h
+    NATIVE_TARGET_OBJECT,           // see writeObject of object.h
+};
+
+enum NativeSymbolType {
+    NATIVE_SYMBOL_DATA,             // the start of data
+    NATIVE_SYMBOL_FUNCTION,         // in text
+    NATIVE_SYMBOL_EXTERN,           // of someone else, like libc
+};
+
+struct NativeSymbol {
+    char*    name;
+    uint8_t  type;                  // enum NativeSymbolType
+    bool     is_global;
+    uint32_t offset;
+    uint32_t size;
+};
+
+enum NativeRelocType {
+    NATIVE_RELOC_PC32,              // symbol + addend - place, 4 bytes
+    NATIVE_RELOC_PLT32,             // the same, for a call
+};
+
+struct NativeReloc {
+    uint32_t offset;                // in text
+    uint32_t symbol;                // NativeModule.symbols
+    int64_t  addend;
+    uint8_t  type;                  // enum NativeRelocType
+};
+
+struct NativeModule {
+    const char*                 path;
+    NODES(uint8_t)              text;
+    NODES(uint8_t)              data;
+    NODES(struct NativeSymbol)  symbols;    // the first is NATIVE_SYMBOL_DATA
+    NODES(struct NativeReloc)   relocs;
+    uint32_t*                   functions;  // IrModule.functions -> symbols
+    uint32_t                    stack_limit;
+};
+
+/*
+ * Compiles every function of module that has blocks, with their critical
+ * edges split on the way. Every function compares the stack pointer
+ * against the 8 bytes at data offset stack_limit first and faults below
+ * it. runJit sets the limit for the JIT, func main sets it for an object.
+ * An object defines NATIVE_FAULT itself: it writes the error to stderr
+ * like mic would and exits with 1. Returns false and sets error for what
+ * has no machine code yet.
+ */
+bool compileNative(
+    struct NativeModule* native,
+    struct IrModule*     module,
+    enum NativeTarget    target,
+    struct Error*        error
+);
+void freeNative(struct NativeModule* native);
+
+#endif
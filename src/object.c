@@ -0,0 +1,244 @@
+#include <elf.h>
+// for: Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, Elf64_Rela and their constants
+#include <string.h>
+// for: strlen
+
+#include "memory.h"
+#include "object.h"
+#include "timing.h"
+
+enum Section {
+    SECTION_NONE,
+    SECTION_TEXT,
+    SECTION_DATA,
+    SECTION_RELA,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_STACK,                  // an empty .note.GNU-stack, no exec stack
+    SECTION_COUNT,
+};
+
+static const char* const section_names[SECTION_COUNT] = {
+    [SECTION_NONE]     = "",
+    [SECTION_TEXT]     = ".text",
+    [SECTION_DATA]     = ".data",
+    [SECTION_RELA]     = ".rela.text",
+    [SECTION_SYMTAB]   = ".symtab",
+    [SECTION_STRTAB]   = ".strtab",
+    [SECTION_SHSTRTAB] = ".shstrtab",
+    [SECTION_STACK]    = ".note.GNU-stack",
+};
+
+struct Tables {
+    NODES(char)       strtab;
+    NODES(char)       shstrtab;
+    NODES(Elf64_Sym)  symtab;
+    NODES(Elf64_Rela) rela;
+    uint32_t*         symbols;      // NativeModule.symbols -> symtab
+};
+
+static uint32_t addString(struct Tables* tables, const char* string) {
+    uint32_t res = tables -> strtab.count;
+    size_t length = strlen(string);
+    for (size_t i = 0; i <= length; i++) {
+        pushNode(tables -> strtab, MEMORY_NATIVE, string[i]);
+    }
+    return res;
+}
+
+static void addSymbols(
+    struct Tables*       tables,
+    struct NativeModule* native,
+    bool                 is_global
+) {
+    for (uint32_t i = 1; i < native -> symbols.count; i++) {
+        struct NativeSymbol* symbol = &native -> symbols.items[i];
+        bool is_extern = symbol -> type == NATIVE_SYMBOL_EXTERN;
+        if (symbol -> is_global != is_global) {
+            continue;
+        }
+        Elf64_Sym sym = {
+            .st_name  = addString(tables, symbol -> name),
+            .st_info  = ELF64_ST_INFO(
+                is_global ? STB_GLOBAL : STB_LOCAL,
+                is_extern ? STT_NOTYPE : STT_FUNC
+            ),
+            .st_shndx = is_extern ? SHN_UNDEF : SECTION_TEXT,
+            .st_value = is_extern ? 0 : symbol -> offset,
+            .st_size  = is_extern ? 0 : symbol -> size
+        };
+        tables -> symbols[i] = pushNode(tables -> symtab, MEMORY_NATIVE, sym);
+    }
+}
+
+/*
+ * The symbols, the file and the sections first, then the functions
+ * without is_global and then the rest, like ELF wants the locals first.
+ * Symbol 0 of native is the start of .data, its section symbol.
+ */
+static uint32_t buildSymbols(
+    struct Tables*       tables,
+    struct NativeModule* native
+) {
+    pushNode(tables -> symtab, MEMORY_NATIVE, (Elf64_Sym) { 0 });
+    addString(tables, "");
+    Elf64_Sym file = {
+        .st_name  = addString(tables, native -> path),
+        .st_info  = ELF64_ST_INFO(STB_LOCAL, STT_FILE),
+        .st_shndx = SHN_ABS
+    };
+    pushNode(tables -> symtab, MEMORY_NATIVE, file);
+    for (uint16_t section = SECTION_TEXT; section <= SECTION_DATA; section++) {
+        Elf64_Sym sym = {
+            .st_info  = ELF64_ST_INFO(STB_LOCAL, STT_SECTION),
+            .st_shndx = section
+        };
+        uint32_t index = pushNode(tables -> symtab, MEMORY_NATIVE, sym);
+        if (section == SECTION_DATA) {
+            tables -> symbols[0] = index;
+        }
+    }
+    addSymbols(tables, native, false);
+    uint32_t res = tables -> symtab.count;
+    addSymbols(tables, native, true);
+
+    for (uint32_t i = 0; i < native -> relocs.count; i++) {
+        struct NativeReloc reloc = native -> relocs.items[i];
+        Elf64_Rela rela = {
+            .r_offset = reloc.offset,
+            .r_info   = ELF64_R_INFO(
+                tables -> symbols[reloc.symbol],
+                reloc.type == NATIVE_RELOC_PLT32
+                    ? R_X86_64_PLT32
+                    : R_X86_64_PC32
+            ),
+            .r_addend = reloc.addend
+        };
+        pushNode(tables -> rela, MEMORY_NATIVE, rela);
+    }
+    return res;
+}
+
+static inline uint64_t alignUp(uint64_t value, uint64_t align) {
+    return (value + align - 1) / align * align;
+}
+
+static void writePadding(FILE* stream, uint64_t* at, uint64_t to) {
+    for (; *at < to; (*at)++) {
+        fputc(0, stream);
+    }
+}
+
+void writeObject(FILE* stream, struct NativeModule* native) {
+    timeBegin("object");
+    struct Tables tables = {
+        .symbols = memoryAllocKind(MEMORY_NATIVE,
+            native -> symbols.count * sizeof(uint32_t))
+    };
+    uint32_t first_global = buildSymbols(&tables, native);
+    uint32_t names[SECTION_COUNT];
+    for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+        names[i] = tables.shstrtab.count;
+        size_t length = strlen(section_names[i]);
+        for (size_t j = 0; j <= length; j++) {
+            pushNode(tables.shstrtab, MEMORY_NATIVE, section_names[i][j]);
+        }
+    }
+
+    Elf64_Shdr sections[SECTION_COUNT] = {
+        [SECTION_TEXT] = {
+            .sh_type      = SHT_PROGBITS,
+            .sh_flags     = SHF_ALLOC | SHF_EXECINSTR,
+            .sh_size      = native -> text.count,
+            .sh_addralign = 16
+        },
+        [SECTION_DATA] = {
+            .sh_type      = SHT_PROGBITS,
+            .sh_flags     = SHF_ALLOC | SHF_WRITE,
+            .sh_size      = native -> data.count,
+            .sh_addralign = 8
+        },
+        [SECTION_RELA] = {
+            .sh_type      = SHT_RELA,
+            .sh_flags     = SHF_INFO_LINK,
+            .sh_size      = tables.rela.count * sizeof(Elf64_Rela),
+            .sh_link      = SECTION_SYMTAB,
+            .sh_info      = SECTION_TEXT,
+            .sh_addralign = 8,
+            .sh_entsize   = sizeof(Elf64_Rela)
+        },
+        [SECTION_SYMTAB] = {
+            .sh_type      = SHT_SYMTAB,
+            .sh_size      = tables.symtab.count * sizeof(Elf64_Sym),
+            .sh_link      = SECTION_STRTAB,
+            .sh_info      = first_global,
+            .sh_addralign = 8,
+            .sh_entsize   = sizeof(Elf64_Sym)
+        },
+        [SECTION_STRTAB] = {
+            .sh_type      = SHT_STRTAB,
+            .sh_size      = tables.strtab.count,
+            .sh_addralign = 1
+        },
+        [SECTION_SHSTRTAB] = {
+            .sh_type      = SHT_STRTAB,
+            .sh_size      = tables.shstrtab.count,
+            .sh_addralign = 1
+        },
+        [SECTION_STACK] = {
+            .sh_type      = SHT_PROGBITS,
+            .sh_addralign = 1
+        },
+    };
+    const void* contents[SECTION_COUNT] = {
+        [SECTION_TEXT]     = native -> text.items,
+        [SECTION_DATA]     = native -> data.items,
+        [SECTION_RELA]     = tables.rela.items,
+        [SECTION_SYMTAB]   = tables.symtab.items,
+        [SECTION_STRTAB]   = tables.strtab.items,
+        [SECTION_SHSTRTAB] = tables.shstrtab.items,
+    };
+    // the contents follow the header in order, the section headers last
+    uint64_t offset = sizeof(Elf64_Ehdr);
+    for (uint32_t i = 1; i < SECTION_COUNT; i++) {
+        sections[i].sh_name = names[i];
+        offset = alignUp(offset, sections[i].sh_addralign);
+        sections[i].sh_offset = offset;
+        offset += sections[i].sh_size;
+    }
+    Elf64_Ehdr header = {
+        .e_ident     = {
+            ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3,
+            ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV
+        },
+        .e_type      = ET_REL,
+        .e_machine   = EM_X86_64,
+        .e_version   = EV_CURRENT,
+        .e_shoff     = alignUp(offset, 8),
+        .e_ehsize    = sizeof(Elf64_Ehdr),
+        .e_shentsize = sizeof(Elf64_Shdr),
+        .e_shnum     = SECTION_COUNT,
+        .e_shstrndx  = SECTION_SHSTRTAB
+    };
+
+    uint64_t at = 0;
+    fwrite(&header, sizeof(header), 1, stream);
+    at += sizeof(header);
+    for (uint32_t i = 1; i < SECTION_COUNT; i++) {
+        writePadding(stream, &at, sections[i].sh_offset);
+        if (sections[i].sh_size != 0) {
+            fwrite(contents[i], 1, sections[i].sh_size, stream);
+        }
+        at += sections[i].sh_size;
+    }
+    writePadding(stream, &at, header.e_shoff);
+    fwrite(sections, sizeof(sections), 1, stream);
+
+    memoryFree(tables.strtab.items);
+    memoryFree(tables.shstrtab.items);
+    memoryFree(tables.symtab.items);
+    memoryFree(tables.rela.items);
+    memoryFree(tables.symbols);
+    timeEnd();
+}
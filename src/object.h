@@ -0,0 +1,16 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdio.h>
+
+#include "native.h"
+
+/*
+ * Writes native as a relocatable ELF64 object for x86-64, the kind `as`
+ * would write: .text, .data, the symbols with the locals first and the
+ * relocations of .text, for the system ld or cc to link. Compile native
+ * with NATIVE_TARGET_OBJECT, so it needs nothing but libc.
+ */
+void writeObject(FILE* stream, struct NativeModule* native);
+
+#endif
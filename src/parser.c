@@ -1,80 +1,297 @@
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stddef.h>
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "ast.h"
 #include "lexer.h"
 #include "parser.h"
 #include "memory.h"
+#include "timing.h"
 
-static inline void errorEndOfToken(void) {
-    fprintf(
-        stderr,
-        "Syntax error: end of tokens\n"
-    );
-    exit(EXIT_FAILURE);
+/*
+ * Binding powers, loosest first. An operator on the frame stack is applied
+ * before a new infix operator that binds as tight or looser, so binary
+ * operators are left associative.
+ */
+enum BindingPower {
+    BP_NONE,
+    BP_LOGICAL_OR,
+    BP_LOGICAL_AND,
+    BP_BITWIZE_OR,
+    BP_BITWIZE_AND,
+    BP_EQUAL,
+    BP_COMPARE,
+    BP_SHIFT,
+    BP_ADD,
+    BP_MULTIPLY,
+    BP_CAST,
+    BP_PREFIX,
+};
+
+struct Operator {
+    enum BindingPower  prefix;
+    enum ExpretionTypy prefix_type;
+    enum BindingPower  infix;
+    enum ExpretionTypy infix_type;
+    enum ExpretionTypy asign_type;      // of the compound asignment
+};
+
+// every operator of the language, tokens not in here are no operators
+static const struct Operator operators[TOKEN_RIGHT_SHIFT_ASIGN + 1] = {
+    [TOKEN_LOGICAL_OR]          = {
+        .infix = BP_LOGICAL_OR,  .infix_type = EXPRETION_LOGICAL_OR
+    },
+    [TOKEN_LOGICAL_AND]         = {
+        .infix = BP_LOGICAL_AND, .infix_type = EXPRETION_LOGICAL_AND
+    },
+    [TOKEN_BITWIZE_OR]          = {
+        .infix = BP_BITWIZE_OR,  .infix_type = EXPRETION_BITWIZE_OR
+    },
+    [TOKEN_BITWIZE_AND]         = {
+        .infix = BP_BITWIZE_AND, .infix_type = EXPRETION_BITWIZE_AND
+    },
+    [TOKEN_EQUAL]               = {
+        .infix = BP_EQUAL,       .infix_type = EXPRETION_EQUAL
+    },
+    [TOKEN_NOT_EQUAL]           = {
+        .infix = BP_EQUAL,       .infix_type = EXPRETION_NOT_EQUAL
+    },
+    [TOKEN_LESS_THEN]           = {
+        .infix = BP_COMPARE,     .infix_type = EXPRETION_LESS_THEN
+    },
+    [TOKEN_LESS_THEN_OR_EQUAL]  = {
+        .infix = BP_COMPARE,     .infix_type = EXPRETION_LESS_THEN_OR_EQUAL
+    },
+    [TOKEN_GREAT_THEN]          = {
+        .infix = BP_COMPARE,     .infix_type = EXPRETION_GREAT_THEN
+    },
+    [TOKEN_GREAT_THEN_OR_EQUAL] = {
+        .infix = BP_COMPARE,     .infix_type = EXPRETION_GREA_THEN_OR_EQUAL
+    },
+    [TOKEN_LEFT_SHIFT]          = {
+        .infix = BP_SHIFT,       .infix_type = EXPRETION_LEFT_SHIFT
+    },
+    [TOKEN_RIGHT_SHIFT]         = {
+        .infix = BP_SHIFT,       .infix_type = EXPRETION_RIGHT_SHIFT
+    },
+    [TOKEN_ADD]                 = {
+        .infix = BP_ADD,         .infix_type = EXPRETION_ADD
+    },
+    [TOKEN_SUBTRACT]            = {
+        .prefix = BP_PREFIX,     .prefix_type = EXPRETION_NEG,
+        .infix = BP_ADD,         .infix_type = EXPRETION_SUBTRACT
+    },
+    [TOKEN_MULTIPLY]            = {
+        .infix = BP_MULTIPLY,    .infix_type = EXPRETION_MULTIPLY
+    },
+    [TOKEN_DIVIDE]              = {
+        .infix = BP_MULTIPLY,    .infix_type = EXPRETION_DIVIDE
+    },
+    [TOKEN_MODULO]              = {
+        .infix = BP_MULTIPLY,    .infix_type = EXPRETION_MODULO
+    },
+    [TOKEN_AS]                  = {
+        .infix = BP_CAST,        .infix_type = EXPRETION_CAST
+    },
+    [TOKEN_LOGICAL_NOT]         = {
+        .prefix = BP_PREFIX,     .prefix_type = EXPRETION_LOGICAL_NOT
+    },
+    [TOKEN_BITWIZE_NOT]         = {
+        .prefix = BP_PREFIX,     .prefix_type = EXPRETION_BITWIZE_NOT
+    },
+    [TOKEN_REF]                 = {
+        .prefix = BP_PREFIX,     .prefix_type = EXPRETION_REF
+    },
+    [TOKEN_ADD_ASIGN]           = { .asign_type = EXPRETION_ADD },
+    [TOKEN_SUBTRACT_ASIGN]      = { .asign_type = EXPRETION_SUBTRACT },
+    [TOKEN_MULTIPLY_ASIGN]      = { .asign_type = EXPRETION_MULTIPLY },
+    [TOKEN_DIVIDE_ASIGN]        = { .asign_type = EXPRETION_DIVIDE },
+    [TOKEN_MODULO_ASIGN]        = { .asign_type = EXPRETION_MODULO },
+    [TOKEN_BITWIZE_OR_ASIGN]    = { .asign_type = EXPRETION_BITWIZE_OR },
+    [TOKEN_BITWIZE_AND_ASIGN]   = { .asign_type = EXPRETION_BITWIZE_AND },
+    [TOKEN_LEFT_SHIFT_ASIGN]    = { .asign_type = EXPRETION_LEFT_SHIFT },
+    [TOKEN_RIGHT_SHIFT_ASIGN]   = { .asign_type = EXPRETION_RIGHT_SHIFT },
+};
+
+enum FrameType {
+    FRAME_PREFIX,                       // operand still to come
+    FRAME_INFIX,                        // left operand on the stack
+    FRAME_PAREN,
+    FRAME_CALL,
+    FRAME_INDEX,                        // indexed operand on the stack
+};
+
+// something parseExpretion opened and has not closed yet
+struct Frame {
+    enum FrameType     type;
+    enum BindingPower  power;
+    enum ExpretionTypy expretion;
+    uint32_t           args;            // calls: first argument on operands
+    struct Path        name;            // calls
+};
+
+/*
+ * State of parsing one file, nothing is shared between files. A syntax
+ * error fills error and jumps back to bail in parseDecls, the nodes added
+ * so far stay in the AST and are freed with it.
+ */
+struct Parser {
+    struct AST*   ast;
+    const char*   src;
+    const char*   file;
+    struct Error* error;
+    jmp_buf       bail;
+    struct Tokens tokens;
+
+    // type arguments of the lists still open, see parseType
+    struct Type*  scratch;
+    uint32_t      scratch_count;
+    uint32_t      scratch_capacity;
+
+    // operands and open operators of parseExpretion
+    NODES(uint32_t)                   operands;
+    NODES(struct Frame)               frames;
+
+    // statements and cases of the blocks still open, see parseBlock
+    NODES(uint32_t)                   statements;
+    NODES(struct StatementSwitchCase) cases;
+
+    // blocks, else ifs and type argument lists open, see enterNesting
+    uint32_t                          depth;
+};
+
+static _Noreturn void errorUnexpextedToken(
+    struct Parser* parser,
+    struct Token*  token
+) {
+    if (token -> type == TOKEN_END) {
+        setError(
+            parser -> error,
+            "Syntax error",
+            parser -> file,
+            token -> line,
+            "unexpected end of file"
+        );
+    } else {
+        setError(
+            parser -> error,
+            "Syntax error",
+            parser -> file,
+            token -> line,
+            "unexpected '%.*s'",
+            (int) token -> length,
+            parser -> src + token -> offset
+        );
+    }
+    longjmp(parser -> bail, 1);
 }
 
-static inline void errorUnexpextedToken(const char* stream) {
-    fprintf(
-        stderr,
-        "Syntax error %s:%ld\n",
-        // TODO: make better error mesage
-        current_file,
-        current_line_number
-    );
-    exit(EXIT_FAILURE);
+static inline struct Token* peek(struct Parser* parser, size_t n) {
+    return peekToken(&parser -> tokens, n);
+}
+
+static inline bool checkToken(struct Parser* parser, enum TokenType type) {
+    return peek(parser, 0) -> type == type;
 }
 
-static inline void assertSyntax(bool test, const char* stream) {
-    if (!test) {
-        errorUnexpextedToken(stream);
+static inline bool acceptToken(struct Parser* parser, enum TokenType type) {
+    if (checkToken(parser, type)) {
+        nextToken(&parser -> tokens);
+        return true;
     }
+    return false;
 }
 
-static struct Path* parsePathTail(const char** stream) {
-    struct Path* res = memoryAlloc(sizeof(struct Path));
-    struct Path* now = res;
-    struct String name;
-    while (matchDotName(*stream, stream, &name)) {
-        appendPath(&now, name);
+static inline struct Token* expectToken(
+    struct Parser* parser,
+    enum TokenType type
+) {
+    struct Token* res = peek(parser, 0);
+    if (res -> type != type) {
+        errorUnexpextedToken(parser, res);
     }
-    return res;
+    return nextToken(&parser -> tokens);
 }
 
-static struct Path* parsePath(const char** stream) {
-    struct Path* res = memoryAlloc(sizeof(struct Path));
-    struct String name;
-    if (matchUpperName(*stream, stream, &name)
-     || matchLowerName(*stream, stream, &name)) {
-        res -> name = name;
-        if (matchDotName(*stream, NULL, NULL)) {
-            res -> next = parsePathTail(stream);
-        }
+// one level deeper, with a syntax error past PARSE_MAX_DEPTH
+static void enterNesting(struct Parser* parser) {
+    if (parser -> depth == PARSE_MAX_DEPTH) {
+        setError(
+            parser -> error,
+            "Syntax error",
+            parser -> file,
+            peek(parser, 0) -> line,
+            "nested deeper than %d levels",
+            PARSE_MAX_DEPTH
+        );
+        longjmp(parser -> bail, 1);
+    }
+    parser -> depth++;
+}
+
+static inline uint32_t expectName(struct Parser* parser, enum TokenType type) {
+    return expectToken(parser, type) -> symbol;
+}
+
+// closes a type argument list, splitting `>>` of nested lists in place
+static void expectCloseAngle(struct Parser* parser) {
+    struct Token* token = peek(parser, 0);
+    if (token -> type == TOKEN_RIGHT_SHIFT) {
+        token -> type = TOKEN_GREAT_THEN;
+        token -> offset++;
+        token -> length--;
+        return;
+    }
+    expectToken(parser, TOKEN_GREAT_THEN);
+}
+
+// appends the .b.c part of a path to names, returns the number appended
+static uint32_t parsePathTail(struct Parser* parser) {
+    uint32_t count = 0;
+    while (checkToken(parser, TOKEN_DOT_NAME)) {
+        appendName(parser -> ast, nextToken(&parser -> tokens) -> symbol);
+        count++;
+    }
+    return count;
+}
+
+static struct Path parsePath(struct Parser* parser) {
+    struct Path res = {
+        .is_relative = false,
+        .names       = { .start = parser -> ast -> names.count }
+    };
+    struct Token* token = peek(parser, 0);
+    if (token -> type == TOKEN_UPPER_NAME
+     || token -> type == TOKEN_LOWER_NAME) {
+        appendName(parser -> ast, nextToken(&parser -> tokens) -> symbol);
+        res.names.count = 1 + parsePathTail(parser);
         return res;
     }
-    errorUnexpextedToken(*stream);
-    return NULL;
+    errorUnexpextedToken(parser, token);
+    return res;
 }
 
-static struct Import parseImport(const char** stream) {
-    struct Path* res_path;
-    if (matchUpperName(*stream, NULL, NULL)
-     || matchLowerName(*stream, NULL, NULL)) {
-        res_path = parsePath(stream);
-    } else if (matchDotName(*stream, NULL, NULL)) {
-        res_path = parsePathTail(stream);
+static struct Import parseImport(struct Parser* parser) {
+    struct Path res_path = { 0 };
+    struct Token* token = peek(parser, 0);
+    if (token -> type == TOKEN_UPPER_NAME
+     || token -> type == TOKEN_LOWER_NAME) {
+        res_path = parsePath(parser);
+    } else if (token -> type == TOKEN_DOT_NAME) {
+        res_path.is_relative = true;
+        res_path.names.start = parser -> ast -> names.count;
+        res_path.names.count = parsePathTail(parser);
     } else {
-        errorUnexpextedToken(*stream);
+        errorUnexpextedToken(parser, token);
     }
     bool res_is_rename = false;
-    struct String res_as;
-    if (matchKeyword(*stream, stream, "as")) {
-        assertSyntax(matchLowerName(*stream, stream, &res_as), *stream);
+    uint32_t res_as = SYMBOL_NONE;
+    if (acceptToken(parser, TOKEN_AS)) {
+        res_as = expectName(parser, TOKEN_LOWER_NAME);
         res_is_rename = true;
     }
-    assertSyntax(matchChar(*stream, stream, ';'), *stream);
+    expectToken(parser, TOKEN_SEMICOLON);
     return (struct Import) {
         .is_rename = res_is_rename,
         .as        = res_as,
@@ -82,19 +299,15 @@ static struct Import parseImport(const char** stream) {
     };
 }
 
-static struct TypeHeader parseTypeHeader(const char** stream) {
-    struct String name;
-    assertSyntax(matchUpperName(*stream, stream, &name), *stream);
-    struct TypeParams* params = NULL;
-    if (matchChar(*stream, stream, '<')) {
-        params = memoryAlloc(sizeof(struct TypeParams));
-        struct TypeParams* now = params;
+static struct TypeHeader parseTypeHeader(struct Parser* parser) {
+    uint32_t name = expectName(parser, TOKEN_UPPER_NAME);
+    struct Range params = { .start = parser -> ast -> names.count };
+    if (acceptToken(parser, TOKEN_LESS_THEN)) {
         do {
-            struct String param;
-            assertSyntax(matchUpperName(*stream, stream, &param), *stream);
-            appendTypeParams(&now, param);
-        } while (matchChar(*stream, stream, ','));
-        assertSyntax(matchChar(*stream, stream, '>'), *stream);
+            appendName(parser -> ast, expectName(parser, TOKEN_UPPER_NAME));
+            params.count++;
+        } while (acceptToken(parser, TOKEN_COMMA));
+        expectCloseAngle(parser);
     }
     return (struct TypeHeader) {
         .name   = name,
@@ -102,19 +315,43 @@ static struct TypeHeader parseTypeHeader(const char** stream) {
     };
 }
 
-static struct Type parseType(const char** stream) {
-    bool is_ref = matchKeyword(*stream, stream, "ref");
-    struct String name;
-    assertSyntax(matchUpperName(*stream, stream, &name), *stream);
-    struct TypeArgs* args = NULL;
-    if (matchChar(*stream, stream, '<')) {
-        args = memoryAlloc(sizeof(struct TypeParams));
-        struct TypeArgs* now = args;
+static void pushScratchType(struct Parser* parser, struct Type type) {
+    if (parser -> scratch_count == parser -> scratch_capacity) {
+        parser -> scratch_capacity = parser -> scratch_capacity == 0
+            ? 16
+            : parser -> scratch_capacity * 2;
+        parser -> scratch = memoryReallocKind(
+            MEMORY_TYPE,
+            parser -> scratch,
+            parser -> scratch_capacity * sizeof(struct Type)
+        );
+    }
+    parser -> scratch[parser -> scratch_count++] = type;
+}
+
+/*
+ * Arguments of one type have to be consecutive in AST.types, but every
+ * argument may have arguments of its own. They are collected on the scratch
+ * stack and copied out once the list is closed, inner lists first.
+ */
+static struct Type parseType(struct Parser* parser) {
+    bool is_ref = acceptToken(parser, TOKEN_REF);
+    uint32_t name = expectName(parser, TOKEN_UPPER_NAME);
+    struct Range args = { .start = parser -> ast -> types.count };
+    if (acceptToken(parser, TOKEN_LESS_THEN)) {
+        enterNesting(parser);
+        uint32_t mark = parser -> scratch_count;
         do {
-            struct Type arg = parseType(stream);
-            appendTypeArgs(&now, arg);
-        } while (matchChar(*stream, stream, ','));
-        assertSyntax(matchChar(*stream, stream, '>'), *stream);
+            pushScratchType(parser, parseType(parser));
+        } while (acceptToken(parser, TOKEN_COMMA));
+        expectCloseAngle(parser);
+        parser -> depth--;
+        args = appendTypes(
+            parser -> ast,
+            parser -> scratch + mark,
+            parser -> scratch_count - mark
+        );
+        parser -> scratch_count = mark;
     }
     return (struct Type) {
         .is_ref = is_ref,
@@ -123,70 +360,67 @@ static struct Type parseType(const char** stream) {
     };
 }
 
-static struct TypeFild parseTypeFild(const char** stream) {
-    struct String name;
-    assertSyntax(matchLowerName(*stream, stream, &name), *stream);
-    assertSyntax(matchChar(*stream, stream, ':'), *stream);
-    struct Type type = parseType(stream);
-    assertSyntax(matchChar(*stream, stream, ';'), *stream);
+static struct TypeFild parseTypeFild(struct Parser* parser) {
+    uint32_t name = expectName(parser, TOKEN_LOWER_NAME);
+    expectToken(parser, TOKEN_COLON);
+    struct Type type = parseType(parser);
+    expectToken(parser, TOKEN_SEMICOLON);
     return (struct TypeFild) {
-        .name = name, 
+        .name = name,
         .type = type
     };
 }
 
-static struct TypeFildList* paresTypeFildList(const char** stream) {
-    assertSyntax(matchChar(*stream, stream, '{'), *stream);
-    struct TypeFildList* res = memoryAlloc(sizeof(struct TypeFildList));
-    struct TypeFildList* now = res;
+static struct Range paresTypeFildList(struct Parser* parser) {
+    expectToken(parser, TOKEN_LEFT_BRACE);
+    struct Range res = { .start = parser -> ast -> filds.count };
     do {
-        struct TypeFild fild = parseTypeFild(stream);
-        appendTypeFildList(&now, fild);
-    } while (!matchChar(*stream, stream, '}'));
+        appendTypeFild(parser -> ast, parseTypeFild(parser));
+        res.count++;
+    } while (!acceptToken(parser, TOKEN_RIGHT_BRACE));
     return res;
 }
 
-static struct EnumFildList* parseEnumFildList(const char** stream) {
-    assertSyntax(matchChar(*stream, stream, '{'), *stream);
-    struct EnumFildList* res = memoryAlloc(sizeof(struct EnumFildList));
-    struct EnumFildList* now = res;
+static struct Range parseEnumFildList(struct Parser* parser) {
+    expectToken(parser, TOKEN_LEFT_BRACE);
+    struct Range res = { .start = parser -> ast -> enum_filds.count };
     do {
-        struct String name;
-        assertSyntax(matchLowerName(*stream, stream, &name), *stream);
-        if (matchChar(*stream, stream, ':')) {
-            struct Type type = parseType(stream);
+        uint32_t name = expectName(parser, TOKEN_LOWER_NAME);
+        if (acceptToken(parser, TOKEN_COLON)) {
+            struct Type type = parseType(parser);
             appendEnumFildTyped(
-                &now, 
+                parser -> ast,
                 (struct TypeFild) {
-                    .name = name, 
+                    .name = name,
                     .type = type
                 }
             );
         } else {
-            appendEnumFildUntyped(&now, name);
+            appendEnumFildUntyped(parser -> ast, name);
         }
-        assertSyntax(matchChar(*stream, stream, ';'), *stream);
-    } while (!matchChar(*stream, stream, '}'));
+        res.count++;
+        expectToken(parser, TOKEN_SEMICOLON);
+    } while (!acceptToken(parser, TOKEN_RIGHT_BRACE));
     return res;
 }
 
-static struct TypeDecl parseTypeDecl(const char** stream, bool exported) {
-    struct TypeHeader header = parseTypeHeader(stream);
+static struct TypeDecl parseTypeDecl(struct Parser* parser, bool exported) {
+    struct TypeHeader header = parseTypeHeader(parser);
 
-    if (matchChar(*stream, stream, '=')) {
-        struct Type res = parseType(stream);
-        assertSyntax(matchChar(*stream, stream, ';'), *stream);
+    if (acceptToken(parser, TOKEN_ASIGN)) {
+        struct Type res = parseType(parser);
+        expectToken(parser, TOKEN_SEMICOLON);
         return (struct TypeDecl) {
             .is_exported = exported,
             .header      = header,
             .type        = TYPE_TYPE,
             ._type       = res
         };
-    } 
+    }
 
-    if (matchKeyword(*stream, stream, "enum")) {
-        struct EnumFildList* res = parseEnumFildList(stream);
-        assertSyntax(matchChar(*stream, stream, ';'), *stream);
+    if (acceptToken(parser, TOKEN_ENUM)) {
+        struct Range res = parseEnumFildList(parser);
+        acceptToken(parser, TOKEN_SEMICOLON);
         return (struct TypeDecl) {
             .is_exported = exported,
             .header      = header,
@@ -195,9 +429,9 @@ static struct TypeDecl parseTypeDecl(const char** stream, bool exported) {
         };
     }
 
-    if (matchKeyword(*stream, stream, "union")) {
-        struct TypeFildList* res = paresTypeFildList(stream);
-        assertSyntax(matchChar(*stream, stream, ';'), *stream);
+    if (acceptToken(parser, TOKEN_UNION)) {
+        struct Range res = paresTypeFildList(parser);
+        acceptToken(parser, TOKEN_SEMICOLON);
         return (struct TypeDecl) {
             .is_exported = exported,
             .header      = header,
@@ -206,9 +440,9 @@ static struct TypeDecl parseTypeDecl(const char** stream, bool exported) {
         };
     }
 
-    if (matchChar(*stream, NULL, '{')) {
-        struct TypeFildList* res = paresTypeFildList(stream);
-        assertSyntax(matchChar(*stream, stream, ';'), *stream);
+    if (checkToken(parser, TOKEN_LEFT_BRACE)) {
+        struct Range res = paresTypeFildList(parser);
+        acceptToken(parser, TOKEN_SEMICOLON);
         return (struct TypeDecl) {
             .is_exported = exported,
             .header      = header,
@@ -217,35 +451,677 @@ static struct TypeDecl parseTypeDecl(const char** stream, bool exported) {
         };
     }
 
-    errorUnexpextedToken(*stream);
+    errorUnexpextedToken(parser, peek(parser, 0));
     return (struct TypeDecl) { 0 };
 }
 
-struct AST* parse(const char* stream, const char* file_name) {
-    current_file = file_name;
-    current_line_number = 1;
-    struct AST* res = memoryAlloc(sizeof(struct AST));
-    struct AST* now = res;
+static void pushOperand(struct Parser* parser, uint32_t expretion) {
+    pushNode(parser -> operands, MEMORY_EXPRETION, expretion);
+}
+
+static uint32_t popOperand(struct Parser* parser) {
+    return parser -> operands.items[--parser -> operands.count];
+}
+
+static void pushFrame(struct Parser* parser, struct Frame frame) {
+    pushNode(parser -> frames, MEMORY_EXPRETION, frame);
+}
+
+static struct Literal parseLiteral(struct Parser* parser) {
+    struct Token* token = nextToken(&parser -> tokens);
+    const char* text = parser -> src + token -> offset;
+    switch (token -> type) {
+    case TOKEN_INT:
+        // range was checked by the lexer
+        return (struct Literal) {
+            .type = LITERAL_INT,
+            ._int = strtoull(text, NULL, 0)
+        };
+    case TOKEN_FLOAT:
+        return (struct Literal) {
+            .type   = LITERAL_FLOAT,
+            ._float = appendFloat(parser -> ast, strtold(text, NULL))
+        };
+    case TOKEN_STRING: {
+        struct Lexer lexer = {
+            .file    = parser -> file,
+            .line    = token -> line,
+            .symbols = parser -> ast -> symbols,
+            .error   = parser -> error
+        };
+        const char* end;
+        struct String string;
+        if (!matchString(&lexer, text, &end, &string)) {
+            longjmp(parser -> bail, 1);
+        }
+        uint32_t symbol = internSymbol(
+            parser -> ast -> symbols,
+            string.string,
+            string.length
+        );
+        memoryFree(string.string);
+        return (struct Literal) {
+            .type   = LITERAL_STING,
+            .string = symbol
+        };
+    }
+    case TOKEN_UPPER_NAME:
+    case TOKEN_LOWER_NAME:
+    case TOKEN_DOT_NAME: {
+        struct Path name = {
+            .is_relative = token -> type == TOKEN_DOT_NAME,
+            .names       = { .start = parser -> ast -> names.count }
+        };
+        appendName(parser -> ast, token -> symbol);
+        name.names.count = 1 + parsePathTail(parser);
+        return (struct Literal) {
+            .type = LITERAL_NAME,
+            .name = name
+        };
+    }
+    default:
+        errorUnexpextedToken(parser, token);
+    }
+}
+
+/*
+ * An operand, false if it opened a call that still needs its arguments.
+ * Only a name can be called.
+ */
+static bool parseOperand(struct Parser* parser) {
+    struct Literal literal = parseLiteral(parser);
+    if (literal.type == LITERAL_NAME
+     && acceptToken(parser, TOKEN_LEFT_PAREN)) {
+        if (acceptToken(parser, TOKEN_RIGHT_PAREN)) {
+            struct Range args = {
+                .start = parser -> ast -> expretion_lists.count
+            };
+            pushOperand(
+                parser,
+                expretionFunction(parser -> ast, literal.name, args)
+            );
+            return true;
+        }
+        pushFrame(parser, (struct Frame) {
+            .type = FRAME_CALL,
+            .args = parser -> operands.count,
+            .name = literal.name
+        });
+        return false;
+    }
+    pushOperand(parser, expretionLiteral(parser -> ast, literal));
+    return true;
+}
+
+// applies the operators above mark that bind at least as tight as power
+static void reduceFrames(
+    struct Parser*    parser,
+    uint32_t          mark,
+    enum BindingPower power
+) {
+    while (parser -> frames.count > mark) {
+        struct Frame frame = parser -> frames.items[parser -> frames.count - 1];
+        if (frame.type == FRAME_PREFIX && frame.power >= power) {
+            uint32_t expr = popOperand(parser);
+            pushOperand(
+                parser,
+                expretionUnary(parser -> ast, frame.expretion, expr)
+            );
+        } else if (frame.type == FRAME_INFIX && frame.power >= power) {
+            uint32_t right = popOperand(parser);
+            uint32_t left = popOperand(parser);
+            pushOperand(
+                parser,
+                expretionBinary(parser -> ast, frame.expretion, left, right)
+            );
+        } else {
+            break;
+        }
+        parser -> frames.count--;
+    }
+}
+
+/*
+ * Closes the innermost paren, call or index with token, after applying the
+ * operators inside of it. False if nothing above mark is open, then token
+ * belongs to whoever asked for the expretion. True with *operand set if
+ * another operand has to follow, i.e. after a comma between arguments.
+ */
+static bool closeFrame(
+    struct Parser* parser,
+    uint32_t       mark,
+    struct Token*  token,
+    bool*          operand
+) {
+    reduceFrames(parser, mark, BP_LOGICAL_OR);
+    if (parser -> frames.count == mark) {
+        return false;
+    }
+    struct Frame frame = parser -> frames.items[parser -> frames.count - 1];
+    nextToken(&parser -> tokens);
+    if (frame.type == FRAME_CALL && token -> type == TOKEN_COMMA) {
+        (*operand) = true;
+        return true;
+    }
+    if (frame.type == FRAME_PAREN && token -> type == TOKEN_RIGHT_PAREN) {
+        parser -> frames.count--;
+        return true;
+    }
+    if (frame.type == FRAME_CALL && token -> type == TOKEN_RIGHT_PAREN) {
+        struct Range args = appendExpretionList(
+            parser -> ast,
+            parser -> operands.items + frame.args,
+            parser -> operands.count - frame.args
+        );
+        parser -> operands.count = frame.args;
+        parser -> frames.count--;
+        pushOperand(
+            parser,
+            expretionFunction(parser -> ast, frame.name, args)
+        );
+        return true;
+    }
+    if (frame.type == FRAME_INDEX && token -> type == TOKEN_RIGHT_BRACKET) {
+        uint32_t index = popOperand(parser);
+        uint32_t expr = popOperand(parser);
+        parser -> frames.count--;
+        pushOperand(parser, expretionGet(parser -> ast, expr, index));
+        return true;
+    }
+    errorUnexpextedToken(parser, token);
+}
+
+/*
+ * Operator precedence parsing in one loop driven by the operators table.
+ * Operands and the operators, parens, calls and indexes still open live on
+ * explicit stacks in the parser instead of the C stack, so nesting depth
+ * costs heap and every token is looked at once. Only the type of a cast
+ * recurses, through parseType.
+ */
+static uint32_t parseExpretion(struct Parser* parser) {
+    uint32_t mark = parser -> frames.count;
+    bool operand = true;
+    while (true) {
+        struct Token* token = peek(parser, 0);
+        struct Operator operator = token -> type <= TOKEN_RIGHT_SHIFT_ASIGN
+            ? operators[token -> type]
+            : (struct Operator) { 0 };
+
+        if (operand) {
+            if (operator.prefix != BP_NONE) {
+                nextToken(&parser -> tokens);
+                pushFrame(parser, (struct Frame) {
+                    .type      = FRAME_PREFIX,
+                    .power     = operator.prefix,
+                    .expretion = operator.prefix_type
+                });
+            } else if (acceptToken(parser, TOKEN_LEFT_PAREN)) {
+                pushFrame(parser, (struct Frame) { .type = FRAME_PAREN });
+            } else {
+                operand = !parseOperand(parser);
+            }
+            continue;
+        }
+
+        switch (token -> type) {
+        case TOKEN_AS: {
+            nextToken(&parser -> tokens);
+            reduceFrames(parser, mark, BP_CAST);
+            uint32_t expr = popOperand(parser);
+            uint32_t cast = appendType(parser -> ast, parseType(parser));
+            pushOperand(parser, expretionCast(parser -> ast, expr, cast));
+            continue;
+        }
+        case TOKEN_LEFT_BRACKET:
+            // postfix, binds tighter than anything on the frame stack
+            nextToken(&parser -> tokens);
+            if (acceptToken(parser, TOKEN_RIGHT_BRACKET)) {
+                uint32_t expr = popOperand(parser);
+                pushOperand(parser, expretionDeref(parser -> ast, expr));
+            } else {
+                pushFrame(parser, (struct Frame) { .type = FRAME_INDEX });
+                operand = true;
+            }
+            continue;
+        case TOKEN_COMMA:
+        case TOKEN_RIGHT_PAREN:
+        case TOKEN_RIGHT_BRACKET:
+            if (closeFrame(parser, mark, token, &operand)) {
+                continue;
+            }
+            break;
+        default:
+            if (operator.infix != BP_NONE) {
+                nextToken(&parser -> tokens);
+                reduceFrames(parser, mark, operator.infix);
+                pushFrame(parser, (struct Frame) {
+                    .type      = FRAME_INFIX,
+                    .power     = operator.infix,
+                    .expretion = operator.infix_type
+                });
+                operand = true;
+                continue;
+            }
+            reduceFrames(parser, mark, BP_LOGICAL_OR);
+            if (parser -> frames.count != mark) {
+                errorUnexpextedToken(parser, token);
+            }
+            break;
+        }
+        return popOperand(parser);
+    }
+}
+
+static struct Range popStatements(struct Parser* parser, uint32_t mark) {
+    struct Range res = appendStatementList(
+        parser -> ast,
+        parser -> statements.items + mark,
+        parser -> statements.count - mark
+    );
+    parser -> statements.count = mark;
+    return res;
+}
+
+static uint32_t parseStatement(struct Parser* parser);
+
+/*
+ * Statements of one block have to be consecutive in AST.statement_lists,
+ * but blocks nest, so like type arguments they are collected on a stack
+ * and copied out when the block is closed.
+ */
+static struct Range parseBlock(struct Parser* parser) {
+    expectToken(parser, TOKEN_LEFT_BRACE);
+    enterNesting(parser);
+    uint32_t mark = parser -> statements.count;
+    while (!acceptToken(parser, TOKEN_RIGHT_BRACE)) {
+        uint32_t statement = parseStatement(parser);
+        pushNode(parser -> statements, MEMORY_STATEMENT, statement);
+    }
+    parser -> depth--;
+    return popStatements(parser, mark);
+}
+
+static uint32_t parseCondition(struct Parser* parser) {
+    expectToken(parser, TOKEN_LEFT_PAREN);
+    uint32_t res = parseExpretion(parser);
+    expectToken(parser, TOKEN_RIGHT_PAREN);
+    return res;
+}
+
+static uint32_t parseVar(struct Parser* parser) {
+    uint32_t name = expectName(parser, TOKEN_LOWER_NAME);
+    uint32_t type = NODE_NONE;
+    if (acceptToken(parser, TOKEN_COLON)) {
+        type = appendType(parser -> ast, parseType(parser));
+    }
+    expectToken(parser, TOKEN_ASIGN);
+    uint32_t value = parseExpretion(parser);
+    expectToken(parser, TOKEN_SEMICOLON);
+    return addStatementVar(parser -> ast, name, type, value);
+}
+
+static uint32_t parseConst(struct Parser* parser) {
+    struct Token* token = nextToken(&parser -> tokens);
+    if (token -> type != TOKEN_UPPER_NAME
+     && token -> type != TOKEN_LOWER_NAME) {
+        errorUnexpextedToken(parser, token);
+    }
+    expectToken(parser, TOKEN_ASIGN);
+    uint32_t value = parseExpretion(parser);
+    expectToken(parser, TOKEN_SEMICOLON);
+    return addStatementConst(parser -> ast, token -> symbol, value);
+}
+
+// else if is an else block with only the next if in it
+static uint32_t parseIf(struct Parser* parser) {
+    uint32_t condition = parseCondition(parser);
+    struct Range then = parseBlock(parser);
+    struct Range _else = { .start = parser -> ast -> statement_lists.count };
+    if (acceptToken(parser, TOKEN_ELSE)) {
+        if (acceptToken(parser, TOKEN_IF)) {
+            enterNesting(parser);
+            uint32_t mark = parser -> statements.count;
+            uint32_t statement = parseIf(parser);
+            pushNode(parser -> statements, MEMORY_STATEMENT, statement);
+            _else = popStatements(parser, mark);
+            parser -> depth--;
+        } else {
+            _else = parseBlock(parser);
+        }
+    }
+    return addStatementIf(parser -> ast, condition, then, _else);
+}
+
+// statements up to the next case, default or the end of the switch
+static struct Range parseCaseBody(struct Parser* parser) {
+    uint32_t mark = parser -> statements.count;
+    while (!checkToken(parser, TOKEN_CASE)
+        && !checkToken(parser, TOKEN_DEFAULT)
+        && !checkToken(parser, TOKEN_RIGHT_BRACE)) {
+        if (acceptToken(parser, TOKEN_CASE_END)) {
+            expectToken(parser, TOKEN_SEMICOLON);
+            break;
+        }
+        uint32_t statement = parseStatement(parser);
+        pushNode(parser -> statements, MEMORY_STATEMENT, statement);
+    }
+    return popStatements(parser, mark);
+}
+
+static uint32_t parseSwitch(struct Parser* parser) {
+    uint32_t value = parseCondition(parser);
+    expectToken(parser, TOKEN_LEFT_BRACE);
+    enterNesting(parser);
+    uint32_t mark = parser -> cases.count;
+    while (!acceptToken(parser, TOKEN_RIGHT_BRACE)) {
+        struct StatementSwitchCase _case = { 0 };
+        if (acceptToken(parser, TOKEN_DEFAULT)) {
+            _case._default = true;
+        } else {
+            expectToken(parser, TOKEN_CASE);
+            _case._case = parseLiteral(parser);
+        }
+        expectToken(parser, TOKEN_COLON);
+        _case.then = parseCaseBody(parser);
+        pushNode(parser -> cases, MEMORY_STATEMENT, _case);
+    }
+    parser -> depth--;
+    struct Range cases = {
+        .start = parser -> ast -> cases.count,
+        .count = parser -> cases.count - mark
+    };
+    for (uint32_t i = mark; i < parser -> cases.count; i++) {
+        appendSwitchCase(parser -> ast, parser -> cases.items[i]);
+    }
+    parser -> cases.count = mark;
+    return addStatementSwitch(parser -> ast, value, cases);
+}
+
+// loop is a while without a condition
+static uint32_t parseLoop(
+    struct Parser* parser,
+    bool           is_label,
+    uint32_t       label
+) {
+    struct Token* token = nextToken(&parser -> tokens);
+    switch (token -> type) {
+    case TOKEN_LOOP: {
+        struct Range then = parseBlock(parser);
+        return addStatementWhile(
+            parser -> ast, is_label, label, NODE_NONE, then
+        );
+    }
+    case TOKEN_WHILE: {
+        uint32_t condition = parseCondition(parser);
+        struct Range then = parseBlock(parser);
+        return addStatementWhile(
+            parser -> ast, is_label, label, condition, then
+        );
+    }
+    case TOKEN_DO: {
+        struct Range then = parseBlock(parser);
+        expectToken(parser, TOKEN_WHILE);
+        uint32_t condition = parseCondition(parser);
+        acceptToken(parser, TOKEN_SEMICOLON);
+        return addStatementDo(
+            parser -> ast, is_label, label, condition, then
+        );
+    }
+    case TOKEN_FOR: {
+        expectToken(parser, TOKEN_LEFT_PAREN);
+        expectToken(parser, TOKEN_VAR);
+        uint32_t var = parseVar(parser);
+        uint32_t condition = parseExpretion(parser);
+        expectToken(parser, TOKEN_RIGHT_PAREN);
+        struct Range then = parseBlock(parser);
+        return addStatementFor(
+            parser -> ast, is_label, label, var, condition, then
+        );
+    }
+    case TOKEN_REPEAD: {
+        uint32_t condition = parseCondition(parser);
+        struct Range then = parseBlock(parser);
+        return addStatementRepead(
+            parser -> ast, is_label, label, condition, then
+        );
+    }
+    default:
+        errorUnexpextedToken(parser, token);
+    }
+}
+
+/*
+ * target = value, target op= value or a call. op= is kept as
+ * target = target op value with the target node shared by both.
+ */
+static uint32_t parseAsignOrCall(struct Parser* parser) {
+    uint32_t target = parseExpretion(parser);
+    struct Expretion expr = parser -> ast -> expretions.items[target];
+    struct Token* token = peek(parser, 0);
+    struct Operator operator = token -> type <= TOKEN_RIGHT_SHIFT_ASIGN
+        ? operators[token -> type]
+        : (struct Operator) { 0 };
+
+    if (token -> type != TOKEN_ASIGN && operator.asign_type == EXPRETION_NONE) {
+        if (expr.type != EXPRETION_FUNCTION) {
+            errorUnexpextedToken(parser, token);
+        }
+        expectToken(parser, TOKEN_SEMICOLON);
+        return addStatementCall(parser -> ast, target);
+    }
+
+    bool is_name = expr.type == EXPRETION_LITERAL
+                && expr.literal.type == LITERAL_NAME;
+    if (!is_name
+     && expr.type != EXPRETION_GET
+     && expr.type != EXPRETION_DEREF) {
+        errorUnexpextedToken(parser, token);
+    }
+    nextToken(&parser -> tokens);
+    uint32_t value = parseExpretion(parser);
+    expectToken(parser, TOKEN_SEMICOLON);
+    if (operator.asign_type != EXPRETION_NONE) {
+        value = expretionBinary(
+            parser -> ast, operator.asign_type, target, value
+        );
+    }
+
+    struct Path path = expr.literal.name;
+    if (is_name && !path.is_relative && path.names.count == 1) {
+        uint32_t name = parser -> ast -> names.items[path.names.start];
+        return addStatementAsign(parser -> ast, NODE_NONE, name, value);
+    }
+    return addStatementAsign(parser -> ast, target, SYMBOL_NONE, value);
+}
 
-    while ((*stream) != 0) {
-        skipWhiteSpaces(&stream);
-        if (matchKeyword(stream, &stream, "import")) {
-            addImport(&now, parseImport(&stream));
+static uint32_t parseStatement(struct Parser* parser) {
+    struct Token* token = peek(parser, 0);
+    switch (token -> type) {
+    case TOKEN_VAR:
+        nextToken(&parser -> tokens);
+        return parseVar(parser);
+    case TOKEN_CONST:
+        nextToken(&parser -> tokens);
+        return parseConst(parser);
+    case TOKEN_IF:
+        nextToken(&parser -> tokens);
+        return parseIf(parser);
+    case TOKEN_SWITCH:
+        nextToken(&parser -> tokens);
+        return parseSwitch(parser);
+    case TOKEN_RETURN: {
+        nextToken(&parser -> tokens);
+        uint32_t value = NODE_NONE;
+        if (!checkToken(parser, TOKEN_SEMICOLON)) {
+            value = parseExpretion(parser);
+        }
+        expectToken(parser, TOKEN_SEMICOLON);
+        return addStatementReturn(parser -> ast, value);
+    }
+    case TOKEN_AT_NAME:
+        nextToken(&parser -> tokens);
+        return parseLoop(parser, true, token -> symbol);
+    case TOKEN_LOOP:
+    case TOKEN_WHILE:
+    case TOKEN_DO:
+    case TOKEN_FOR:
+    case TOKEN_REPEAD:
+        return parseLoop(parser, false, SYMBOL_NONE);
+    default:
+        return parseAsignOrCall(parser);
+    }
+}
+
+// (name: Type, name: Type), the filds are consecutive
+static struct Range parseArgs(struct Parser* parser) {
+    expectToken(parser, TOKEN_LEFT_PAREN);
+    struct Range res = { .start = parser -> ast -> filds.count };
+    if (acceptToken(parser, TOKEN_RIGHT_PAREN)) {
+        return res;
+    }
+    do {
+        uint32_t name = expectName(parser, TOKEN_LOWER_NAME);
+        expectToken(parser, TOKEN_COLON);
+        struct Type type = parseType(parser);
+        appendTypeFild(
+            parser -> ast,
+            (struct TypeFild) {
+                .name = name,
+                .type = type
+            }
+        );
+        res.count++;
+    } while (acceptToken(parser, TOKEN_COMMA));
+    expectToken(parser, TOKEN_RIGHT_PAREN);
+    return res;
+}
+
+// NODE_NONE when the body follows right away
+static uint32_t parseResult(struct Parser* parser) {
+    if (checkToken(parser, TOKEN_LEFT_BRACE)
+     || checkToken(parser, TOKEN_SEMICOLON)) {
+        return NODE_NONE;
+    }
+    return appendType(parser -> ast, parseType(parser));
+}
+
+// a func with ; instead of a body is external
+static struct FuncDecl parseFunc(struct Parser* parser, bool exported) {
+    struct FuncDecl res = {
+        .is_exported = exported
+    };
+    if (acceptToken(parser, TOKEN_LEFT_PAREN)) {
+        uint32_t name = expectName(parser, TOKEN_LOWER_NAME);
+        res.has_self = true;
+        res.self = self(name, parseTypeHeader(parser));
+        expectToken(parser, TOKEN_RIGHT_PAREN);
+    }
+    res.name = expectName(parser, TOKEN_LOWER_NAME);
+    res.args = parseArgs(parser);
+    res.result = parseResult(parser);
+    if (acceptToken(parser, TOKEN_SEMICOLON)) {
+        res.is_external = true;
+        res.body.start = parser -> ast -> statement_lists.count;
+    } else {
+        res.body = parseBlock(parser);
+    }
+    return res;
+}
+
+static struct CFuncDecl parseCFunc(struct Parser* parser) {
+    struct CFuncDecl res = {
+        .name = expectName(parser, TOKEN_LOWER_NAME)
+    };
+    res.args = parseArgs(parser);
+    res.result = parseResult(parser);
+    if (acceptToken(parser, TOKEN_SEMICOLON)) {
+        res.body.start = parser -> ast -> statement_lists.count;
+    } else {
+        res.body = parseBlock(parser);
+    }
+    return res;
+}
+
+static bool parseDecls(struct Parser* parser) {
+    if (setjmp(parser -> bail) != 0) {
+        return false;
+    }
+
+    while (!checkToken(parser, TOKEN_END)) {
+        if (acceptToken(parser, TOKEN_IMPORT)) {
+            addImport(parser -> ast, parseImport(parser));
+            continue;
+        }
+
+        if (acceptToken(parser, TOKEN_TYPE)) {
+            addTypeDecl(parser -> ast, parseTypeDecl(parser, false));
             continue;
         }
 
-        if (matchKeyword(stream, &stream, "type")) {
-            addType(&now, parseTypeDecl(&stream, false));
+        if (acceptToken(parser, TOKEN_FUNC)) {
+            addFunc(parser -> ast, parseFunc(parser, false));
             continue;
         }
 
-        if (matchKeyword(stream, &stream, "export")) { 
-            if (matchKeyword(stream, &stream, "type")) {
-                addType(&now, parseTypeDecl(&stream, true));
+        if (acceptToken(parser, TOKEN_CFUNC)) {
+            addCFunc(parser -> ast, parseCFunc(parser));
+            continue;
+        }
+
+        if (acceptToken(parser, TOKEN_TEST)) {
+            addTest(parser -> ast, (struct Test) {
+                .body = parseBlock(parser)
+            });
+            continue;
+        }
+
+        if (acceptToken(parser, TOKEN_EXPORT)) {
+            if (acceptToken(parser, TOKEN_TYPE)) {
+                addTypeDecl(parser -> ast, parseTypeDecl(parser, true));
+                continue;
+            }
+            if (acceptToken(parser, TOKEN_FUNC)) {
+                addFunc(parser -> ast, parseFunc(parser, true));
                 continue;
             }
         }
+
+        errorUnexpextedToken(parser, peek(parser, 0));
     }
+    return true;
+}
 
+bool parse(
+    struct AST*   ast,
+    const char*   src,
+    const char*   file_name,
+    struct Error* error
+) {
+    struct Lexer lexer = {
+        .file    = file_name,
+        .line    = 1,
+        .symbols = ast -> symbols,
+        .error   = error
+    };
+    struct Parser parser = {
+        .ast   = ast,
+        .src   = src,
+        .file  = file_name,
+        .error = error
+    };
+    timeBegin("lex");
+    bool res = tokenize(&lexer, &parser.tokens, src);
+    timeEnd();
+    if (res) {
+        timeBegin("syntax");
+        res = parseDecls(&parser);
+        timeEnd();
+    }
+    freeTokens(&parser.tokens);
+    memoryFree(parser.scratch);
+    memoryFree(parser.operands.items);
+    memoryFree(parser.frames.items);
+    memoryFree(parser.statements.items);
+    memoryFree(parser.cases.items);
     return res;
 }
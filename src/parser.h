@@ -1,8 +1,29 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdbool.h>
+
+#include "ast.h"
+#include "error.h"
 #include "lexer.h"
 
-struct AST* parse(const char* src, const char* file_name);
+/*
+ * Blocks, else ifs and type arguments are parsed recursively and so is the
+ * tree by every pass after, so they may nest this deep at most. Parens have
+ * no limit.
+ */
+#define PARSE_MAX_DEPTH 256
+
+/*
+ * Appends the declarations of src to ast, names go to ast -> symbols. On a
+ * lexing or syntax error returns false with the error filled in, ast keeps
+ * whatever was parsed before it and still has to be freed.
+ */
+bool parse(
+    struct AST*   ast,
+    const char*   src,
+    const char*   file_name,
+    struct Error* error
+);
 
 #endif
@@ -0,0 +1,942 @@
+#include <stdbool.h>
+// for: bool
+#include <stdint.h>
+// for: uint32_t, uint64_t, INT64_MIN
+#include <stdio.h>
+// for: fprintf
+#include <string.h>
+// for: memcpy, memmove, memset
+
+#include "builtin.h"
+#include "ir.h"
+#include "memory.h"
+#include "passes.h"
+#include "timing.h"
+
+static void* allocFilled(size_t size, int byte) {
+    void* res = memoryAllocKind(MEMORY_IR, size == 0 ? 1 : size);
+    memset(res, byte, size);
+    return res;
+}
+
+static inline struct IrInstr* terminatorOf(
+    struct IrFunction* function,
+    uint32_t           block
+) {
+    struct IrBlock* now = &function -> blocks.items[block];
+    return &function -> instrs.items[now -> code.items[now -> code.count - 1]];
+}
+
+static inline bool isBinary(enum IrOp op) {
+    return op >= IR_ADD && op <= IR_GREA_THEN_OR_EQUAL;
+}
+
+// divisions by zero, negative shift counts and casts of floats out of range
+static bool canFault(struct IrFunction* function, struct IrInstr* instr) {
+    struct IrInstr* b = &function -> instrs.items[instr -> b];
+    switch (instr -> op) {
+    case IR_DIVIDE:
+    case IR_MODULO:
+        return instr -> type != IR_TYPE_FLOAT
+            && (b -> op != IR_CONST || b -> _uint == 0);
+    case IR_LEFT_SHIFT:
+    case IR_RIGHT_SHIFT:
+        return b -> type == IR_TYPE_INT
+            && (b -> op != IR_CONST || (int64_t) b -> _uint < 0);
+    case IR_CAST:
+        return function -> instrs.items[instr -> a].type == IR_TYPE_FLOAT
+            && (instr -> type == IR_TYPE_INT || instr -> type == IR_TYPE_UINT);
+    default:
+        return false;
+    }
+}
+
+// what can be computed anywhere and dropped when unused
+static bool isPure(struct IrFunction* function, struct IrInstr* instr) {
+    switch (instr -> op) {
+    case IR_CONST:
+    case IR_NEG:
+    case IR_BITWIZE_NOT:
+    case IR_LOGICAL_NOT:
+    case IR_CAST:
+        return !canFault(function, instr);
+    default:
+        return isBinary(instr -> op) && !canFault(function, instr);
+    }
+}
+
+/*
+ * The reachable blocks in reverse postorder and their immediate
+ * dominators, found as by Cooper, Harvey and Kennedy.
+ */
+struct Cfg {
+    uint32_t* order;
+    uint32_t  count;
+    uint32_t* rank;                 // block -> order, NODE_NONE if unreached
+    uint32_t* idom;                 // block, the entry is its own
+};
+
+static void initCfg(struct Cfg* cfg, struct IrFunction* function) {
+    uint32_t blocks = function -> blocks.count;
+    size_t size = blocks * sizeof(uint32_t);
+    cfg -> order = allocFilled(size, 0);
+    cfg -> rank = allocFilled(size, 0xff);
+    cfg -> idom = allocFilled(size, 0xff);
+    cfg -> count = irReversePostorder(function, cfg -> order);
+    for (uint32_t i = 0; i < cfg -> count; i++) {
+        cfg -> rank[cfg -> order[i]] = i;
+    }
+
+    cfg -> idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < cfg -> count; i++) {
+            uint32_t block = cfg -> order[i];
+            struct IrBlock* now = &function -> blocks.items[block];
+            uint32_t idom = NODE_NONE;
+            for (uint32_t j = 0; j < now -> preds.count; j++) {
+                uint32_t pred = now -> preds.items[j];
+                if (cfg -> idom[pred] == NODE_NONE) {
+                    continue;
+                }
+                if (idom == NODE_NONE) {
+                    idom = pred;
+                    continue;
+                }
+                while (pred != idom) {
+                    while (cfg -> rank[pred] > cfg -> rank[idom]) {
+                        pred = cfg -> idom[pred];
+                    }
+                    while (cfg -> rank[idom] > cfg -> rank[pred]) {
+                        idom = cfg -> idom[idom];
+                    }
+                }
+            }
+            if (cfg -> idom[block] != idom) {
+                cfg -> idom[block] = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+static void freeCfg(struct Cfg* cfg) {
+    memoryFree(cfg -> order);
+    memoryFree(cfg -> rank);
+    memoryFree(cfg -> idom);
+}
+
+static bool dominates(struct Cfg* cfg, uint32_t a, uint32_t b) {
+    while (b != a && b != 0) {
+        b = cfg -> idom[b];
+    }
+    return b == a;
+}
+
+/*
+ * Sparse conditional constant propagation, as by Wegman and Zadeck. A
+ * value is unknown until something executable defines it, then a
+ * constant, then varying. Only the blocks and edges found executable
+ * count, so a branch on a constant keeps the other side out.
+ */
+
+enum Lattice {
+    LATTICE_UNKNOWN,
+    LATTICE_CONST,
+    LATTICE_VARYING,
+};
+
+struct Sccp {
+    struct IrFunction* function;
+    uint8_t*           lattice;     // IrFunction.instrs
+    uint64_t*          values;      // the constants, as in IrInstr._uint
+    uint8_t*           executable;  // IrFunction.blocks
+    uint32_t*          edges;       // block -> feasible, by pred
+    uint8_t*           feasible;
+    uint32_t*          users;       // value -> uses, by users_start
+    uint32_t*          users_start;
+    NODES(uint32_t)    blocks;      // blocks with a new edge
+    NODES(uint32_t)    changed;     // values that went down
+};
+
+static inline double asFloat(uint64_t value) {
+    double res;
+    memcpy(&res, &value, sizeof(res));
+    return res;
+}
+
+// rounded to Float32 like the floatValue of the VM
+static inline uint64_t fromFloat(double value, uint8_t bits) {
+    if (bits == 32) {
+        value = (float) value;
+    }
+    uint64_t res;
+    memcpy(&res, &value, sizeof(res));
+    return res;
+}
+
+static bool foldDivide(
+    struct IrInstr* instr,
+    uint64_t        a,
+    uint64_t        b,
+    uint64_t*       res
+) {
+    bool is_modulo = instr -> op == IR_MODULO;
+    if (instr -> type == IR_TYPE_FLOAT) {
+        (*res) = fromFloat(asFloat(a) / asFloat(b), instr -> bits);
+        return true;
+    }
+    if (b == 0) {
+        return false;
+    }
+    uint64_t value;
+    if (instr -> type != IR_TYPE_INT) {
+        value = is_modulo ? a % b : a / b;
+    } else if ((int64_t) a == INT64_MIN && (int64_t) b == -1) {
+        value = is_modulo ? 0 : a;
+    } else {
+        value = is_modulo
+            ? (uint64_t) ((int64_t) a % (int64_t) b)
+            : (uint64_t) ((int64_t) a / (int64_t) b);
+    }
+    (*res) = wrapInt(value, instr -> type == IR_TYPE_INT, instr -> bits);
+    return true;
+}
+
+static bool foldShift(
+    struct IrInstr* instr,
+    uint8_t         count_type,
+    uint64_t        a,
+    uint64_t        count,
+    uint64_t*       res
+) {
+    if (count_type == IR_TYPE_INT && (int64_t) count < 0) {
+        return false;
+    }
+    bool is_signed = instr -> type == IR_TYPE_INT;
+    bool is_left = instr -> op == IR_LEFT_SHIFT;
+    uint64_t value;
+    if (count >= instr -> bits) {
+        value = !is_left && is_signed && (int64_t) a < 0 ? UINT64_MAX : 0;
+    } else if (is_left) {
+        value = a << count;
+    } else if (is_signed) {
+        value = (uint64_t) ((int64_t) a >> count);
+    } else {
+        value = a >> count;
+    }
+    (*res) = wrapInt(value, is_signed, instr -> bits);
+    return true;
+}
+
+// -1, 0 or 1, 2 if a float is not a number, like compare of the VM
+static int foldOrder(uint8_t type, uint64_t a, uint64_t b) {
+    if (type == IR_TYPE_INT) {
+        return ((int64_t) a > (int64_t) b) - ((int64_t) a < (int64_t) b);
+    }
+    if (type == IR_TYPE_FLOAT) {
+        double x = asFloat(a);
+        double y = asFloat(b);
+        return x < y ? -1 : x > y ? 1 : x == y ? 0 : 2;
+    }
+    return (a > b) - (a < b);
+}
+
+/*
+ * The binary instr on the constants a and b, false when the VM would
+ * fault, which then is left to happen at run time.
+ */
+static bool foldBinary(
+    struct IrFunction* function,
+    struct IrInstr*    instr,
+    uint64_t           a,
+    uint64_t           b,
+    uint64_t*          res
+) {
+    uint8_t type = function -> instrs.items[instr -> a].type;
+    bool is_float = type == IR_TYPE_FLOAT;
+    bool is_signed = instr -> type == IR_TYPE_INT;
+    int order;
+    switch (instr -> op) {
+    case IR_ADD:
+        (*res) = is_float
+            ? fromFloat(asFloat(a) + asFloat(b), instr -> bits)
+            : wrapInt(a + b, is_signed, instr -> bits);
+        return true;
+    case IR_SUBTRACT:
+        (*res) = is_float
+            ? fromFloat(asFloat(a) - asFloat(b), instr -> bits)
+            : wrapInt(a - b, is_signed, instr -> bits);
+        return true;
+    case IR_MULTIPLY:
+        (*res) = is_float
+            ? fromFloat(asFloat(a) * asFloat(b), instr -> bits)
+            : wrapInt(a * b, is_signed, instr -> bits);
+        return true;
+    case IR_DIVIDE:
+    case IR_MODULO:
+        return foldDivide(instr, a, b, res);
+    case IR_BITWIZE_OR:
+        (*res) = a | b;
+        return true;
+    case IR_BITWIZE_AND:
+        (*res) = a & b;
+        return true;
+    case IR_LEFT_SHIFT:
+    case IR_RIGHT_SHIFT:
+        return foldShift(instr, function -> instrs.items[instr -> b].type, a,
+            b, res);
+    case IR_EQUAL:
+    case IR_NOT_EQUAL:
+        // Str are interned, the same text is the same symbol
+        (*res) = is_float ? asFloat(a) == asFloat(b) : a == b;
+        (*res) ^= instr -> op == IR_NOT_EQUAL;
+        return true;
+    default:
+        if (type == IR_TYPE_STR) {
+            return false;
+        }
+        order = foldOrder(type, a, b);
+        break;
+    }
+    switch (instr -> op) {
+    case IR_LESS_THEN:
+        (*res) = order == -1;
+        break;
+    case IR_GREAT_THEN:
+        (*res) = order == 1;
+        break;
+    case IR_LESS_THEN_OR_EQUAL:
+        (*res) = order == -1 || order == 0;
+        break;
+    default:
+        (*res) = order == 1 || order == 0;
+        break;
+    }
+    return true;
+}
+
+static bool foldCast(
+    struct IrInstr* instr,
+    uint8_t         from,
+    uint64_t        value,
+    uint64_t*       res
+) {
+    bool is_signed = instr -> type == IR_TYPE_INT;
+    switch (instr -> type) {
+    case IR_TYPE_INT:
+    case IR_TYPE_UINT: {
+        if (from != IR_TYPE_FLOAT) {
+            (*res) = wrapInt(value, is_signed, instr -> bits);
+            return true;
+        }
+        double limit = (double) (UINT64_C(1) << (instr -> bits - 1));
+        double low = is_signed ? -limit - 1 : -1;
+        double high = is_signed ? limit : limit * 2;
+        double x = asFloat(value);
+        if (!(x > low && x < high)) {
+            return false;
+        }
+        (*res) = is_signed ? (uint64_t) (int64_t) x : (uint64_t) x;
+        return true;
+    }
+    case IR_TYPE_FLOAT:
+        if (from == IR_TYPE_FLOAT) {
+            (*res) = fromFloat(asFloat(value), instr -> bits);
+        } else {
+            (*res) = fromFloat(
+                from == IR_TYPE_INT ? (double) (int64_t) value : (double) value,
+                instr -> bits
+            );
+        }
+        return true;
+    case IR_TYPE_BOOL:
+        (*res) = from == IR_TYPE_FLOAT ? asFloat(value) != 0 : value != 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool foldUnary(
+    struct IrFunction* function,
+    struct IrInstr*    instr,
+    uint64_t           a,
+    uint64_t*          res
+) {
+    bool is_signed = instr -> type == IR_TYPE_INT;
+    switch (instr -> op) {
+    case IR_NEG:
+        (*res) = instr -> type == IR_TYPE_FLOAT
+            ? fromFloat(-asFloat(a), instr -> bits)
+            : wrapInt(0 - a, is_signed, instr -> bits);
+        return true;
+    case IR_BITWIZE_NOT:
+        (*res) = wrapInt(~a, is_signed, instr -> bits);
+        return true;
+    case IR_LOGICAL_NOT:
+        (*res) = a == 0;
+        return true;
+    default:
+        return foldCast(instr, function -> instrs.items[instr -> a].type, a,
+            res);
+    }
+}
+
+static void lowerTo(
+    struct Sccp* sccp,
+    uint32_t     value,
+    enum Lattice lattice,
+    uint64_t     constant
+) {
+    if (lattice == LATTICE_CONST && sccp -> lattice[value] == LATTICE_CONST
+     && sccp -> values[value] != constant) {
+        lattice = LATTICE_VARYING;
+    }
+    if (lattice > sccp -> lattice[value]) {
+        sccp -> lattice[value] = lattice;
+        sccp -> values[value] = constant;
+        pushNode(sccp -> changed, MEMORY_IR, value);
+    }
+}
+
+static void markEdge(struct Sccp* sccp, uint32_t pred, uint32_t block) {
+    struct IrBlock* now = &sccp -> function -> blocks.items[block];
+    for (uint32_t i = 0; i < now -> preds.count; i++) {
+        uint32_t edge = sccp -> edges[block] + i;
+        if (now -> preds.items[i] == pred && !sccp -> feasible[edge]) {
+            sccp -> feasible[edge] = true;
+            pushNode(sccp -> blocks, MEMORY_IR, block);
+        }
+    }
+}
+
+static void visitInstr(struct Sccp* sccp, uint32_t index) {
+    struct IrFunction* function = sccp -> function;
+    struct IrInstr* instr = &function -> instrs.items[index];
+    uint32_t* operands[2];
+    uint32_t count = irFixedOperands(instr, operands);
+    enum Lattice lattice = LATTICE_CONST;
+    uint64_t values[2] = { 0 };
+    for (uint32_t i = 0; i < count; i++) {
+        if (sccp -> lattice[*operands[i]] < lattice) {
+            lattice = sccp -> lattice[*operands[i]];
+        }
+        values[i] = sccp -> values[*operands[i]];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (sccp -> lattice[*operands[i]] == LATTICE_VARYING) {
+            lattice = LATTICE_VARYING;
+        }
+    }
+
+    switch (instr -> op) {
+    case IR_CONST:
+        lowerTo(sccp, index, LATTICE_CONST, instr -> _uint);
+        return;
+    case IR_PHI: {
+        struct IrBlock* block = &function -> blocks.items[instr -> block];
+        for (uint32_t i = 0; i < block -> preds.count; i++) {
+            if (sccp -> feasible[sccp -> edges[instr -> block] + i]) {
+                uint32_t arg = function -> operands.items[
+                    instr -> args.start + i
+                ];
+                lowerTo(sccp, index, sccp -> lattice[arg], sccp -> values[arg]);
+            }
+        }
+        return;
+    }
+    case IR_JUMP:
+        markEdge(sccp, instr -> block, instr -> targets[0]);
+        return;
+    case IR_BRANCH:
+        if (lattice == LATTICE_CONST) {
+            markEdge(sccp, instr -> block, instr -> targets[values[0] == 0]);
+        } else if (lattice == LATTICE_VARYING) {
+            markEdge(sccp, instr -> block, instr -> targets[0]);
+            markEdge(sccp, instr -> block, instr -> targets[1]);
+        }
+        return;
+    case IR_RETURN:
+    case IR_NOP:
+        return;
+    case IR_PARAM:
+    case IR_CALL:
+    case IR_NATIVE:
+        lowerTo(sccp, index, LATTICE_VARYING, 0);
+        return;
+    default:
+        break;
+    }
+    if (lattice != LATTICE_CONST) {
+        lowerTo(sccp, index, lattice, 0);
+        return;
+    }
+    uint64_t res;
+    bool is_folded = isBinary(instr -> op)
+        ? foldBinary(function, instr, values[0], values[1], &res)
+        : foldUnary(function, instr, values[0], &res);
+    if (is_folded) {
+        lowerTo(sccp, index, LATTICE_CONST, res);
+    } else {
+        lowerTo(sccp, index, LATTICE_VARYING, 0);
+    }
+}
+
+static void visitBlock(struct Sccp* sccp, uint32_t block, bool is_first) {
+    struct IrBlock* now = &sccp -> function -> blocks.items[block];
+    for (uint32_t i = 0; i < now -> code.count; i++) {
+        uint32_t index = now -> code.items[i];
+        if (is_first || sccp -> function -> instrs.items[index].op == IR_PHI) {
+            visitInstr(sccp, index);
+        }
+    }
+}
+
+// for every value the instructions in the blocks that use it
+static void findUsers(struct Sccp* sccp) {
+    struct IrFunction* function = sccp -> function;
+    uint32_t values = function -> instrs.count;
+    sccp -> users_start = allocFilled((values + 1) * sizeof(uint32_t), 0);
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < function -> blocks.count; i++) {
+            struct IrBlock* block = &function -> blocks.items[i];
+            for (uint32_t j = 0; j < block -> code.count; j++) {
+                uint32_t user = block -> code.items[j];
+                struct IrInstr* instr = &function -> instrs.items[user];
+                uint32_t* operands[2];
+                uint32_t count = irFixedOperands(instr, operands);
+                for (uint32_t k = 0; k < count + instr -> args.count; k++) {
+                    uint32_t value = k < count
+                        ? *operands[k]
+                        : function -> operands.items[
+                            instr -> args.start + k - count
+                        ];
+                    if (pass == 0) {
+                        sccp -> users_start[value + 1]++;
+                    } else {
+                        sccp -> users[sccp -> users_start[value]++] = user;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (uint32_t i = 0; i < values; i++) {
+                sccp -> users_start[i + 1] += sccp -> users_start[i];
+            }
+            sccp -> users = allocFilled(
+                sccp -> users_start[values] * sizeof(uint32_t),
+                0
+            );
+        } else {
+            // the second pass moved every start to the next one
+            memmove(&sccp -> users_start[1], &sccp -> users_start[0],
+                values * sizeof(uint32_t));
+            sccp -> users_start[0] = 0;
+        }
+    }
+}
+
+// the constants in place of what computed them, phis first still
+static bool rewriteConstants(struct Sccp* sccp) {
+    struct IrFunction* function = sccp -> function;
+    bool changed = false;
+    for (uint32_t i = 0; i < function -> blocks.count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        if (!sccp -> executable[i]) {
+            continue;
+        }
+        uint32_t phis = 0;
+        for (uint32_t j = 0; j < block -> code.count; j++) {
+            uint32_t index = block -> code.items[j];
+            struct IrInstr* instr = &function -> instrs.items[index];
+            if (instr -> op == IR_BRANCH
+             && sccp -> lattice[instr -> a] == LATTICE_CONST) {
+                uint32_t taken = sccp -> values[instr -> a] == 0;
+                uint32_t target = instr -> targets[taken];
+                if (instr -> targets[!taken] != target) {
+                    irRemoveEdge(function, i, instr -> targets[!taken]);
+                }
+                (*instr) = (struct IrInstr) {
+                    .op      = IR_JUMP,
+                    .block   = i,
+                    .targets = { target }
+                };
+                block = &function -> blocks.items[i];
+                changed = true;
+            } else if (instr -> op != IR_CONST
+                    && instr -> type != IR_TYPE_NONE
+                    && sccp -> lattice[index] == LATTICE_CONST) {
+                (*instr) = (struct IrInstr) {
+                    .op    = IR_CONST,
+                    .type  = instr -> type,
+                    .bits  = instr -> bits,
+                    .block = i,
+                    ._uint = sccp -> values[index]
+                };
+                changed = true;
+            }
+            if (instr -> op == IR_PHI) {
+                memmove(&block -> code.items[phis + 1],
+                    &block -> code.items[phis],
+                    (j - phis) * sizeof(uint32_t));
+                block -> code.items[phis++] = index;
+            }
+        }
+    }
+    return changed;
+}
+
+static bool runSccp(struct IrFunction* function) {
+    uint32_t values = function -> instrs.count;
+    uint32_t blocks = function -> blocks.count;
+    struct Sccp sccp = {
+        .function   = function,
+        .lattice    = allocFilled(values, LATTICE_UNKNOWN),
+        .values     = allocFilled(values * sizeof(uint64_t), 0),
+        .executable = allocFilled(blocks, 0),
+        .edges      = allocFilled(blocks * sizeof(uint32_t), 0)
+    };
+    uint32_t edges = 0;
+    for (uint32_t i = 0; i < blocks; i++) {
+        sccp.edges[i] = edges;
+        edges += function -> blocks.items[i].preds.count;
+    }
+    sccp.feasible = allocFilled(edges, 0);
+    findUsers(&sccp);
+
+    sccp.executable[0] = true;
+    visitBlock(&sccp, 0, true);
+    while (sccp.blocks.count > 0 || sccp.changed.count > 0) {
+        if (sccp.blocks.count > 0) {
+            uint32_t block = sccp.blocks.items[--sccp.blocks.count];
+            bool is_first = !sccp.executable[block];
+            sccp.executable[block] = true;
+            visitBlock(&sccp, block, is_first);
+            continue;
+        }
+        uint32_t value = sccp.changed.items[--sccp.changed.count];
+        for (uint32_t i = sccp.users_start[value];
+             i < sccp.users_start[value + 1]; i++) {
+            uint32_t user = sccp.users[i];
+            if (sccp.executable[function -> instrs.items[user].block]) {
+                visitInstr(&sccp, user);
+            }
+        }
+    }
+
+    bool changed = rewriteConstants(&sccp);
+    changed = irRemoveUnreachable(function) || changed;
+    changed = irRemoveTrivialPhis(function) || changed;
+    memoryFree(sccp.lattice);
+    memoryFree(sccp.values);
+    memoryFree(sccp.executable);
+    memoryFree(sccp.edges);
+    memoryFree(sccp.feasible);
+    memoryFree(sccp.users);
+    memoryFree(sccp.users_start);
+    memoryFree(sccp.blocks.items);
+    memoryFree(sccp.changed.items);
+    return changed;
+}
+
+// marks what the calls, the terminators and what may fault use
+static bool runDce(struct IrFunction* function) {
+    bool changed = irRemoveUnreachable(function);
+    changed = irRemoveTrivialPhis(function) || changed;
+    uint8_t* live = allocFilled(function -> instrs.count, 0);
+    NODES(uint32_t) work = { 0 };
+    for (uint32_t i = 0; i < function -> blocks.count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        for (uint32_t j = 0; j < block -> code.count; j++) {
+            uint32_t index = block -> code.items[j];
+            struct IrInstr* instr = &function -> instrs.items[index];
+            // params stay, they say where the caller puts the others
+            if (irIsTerminator(instr -> op) || instr -> op == IR_CALL
+             || instr -> op == IR_NATIVE || instr -> op == IR_PARAM
+             || canFault(function, instr)) {
+                live[index] = true;
+                pushNode(work, MEMORY_IR, index);
+            }
+        }
+    }
+    while (work.count > 0) {
+        struct IrInstr* instr = &function -> instrs.items[
+            work.items[--work.count]
+        ];
+        uint32_t* operands[2];
+        uint32_t count = irFixedOperands(instr, operands);
+        for (uint32_t k = 0; k < count + instr -> args.count; k++) {
+            uint32_t value = k < count
+                ? *operands[k]
+                : function -> operands.items[instr -> args.start + k - count];
+            if (!live[value]) {
+                live[value] = true;
+                pushNode(work, MEMORY_IR, value);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < function -> blocks.count; i++) {
+        struct IrBlock* block = &function -> blocks.items[i];
+        for (uint32_t j = 0; j < block -> code.count; j++) {
+            uint32_t index = block -> code.items[j];
+            if (!live[index]) {
+                function -> instrs.items[index].op = IR_NOP;
+                changed = true;
+            }
+        }
+    }
+    irCompact(function);
+    memoryFree(live);
+    memoryFree(work.items);
+    return changed;
+}
+
+static inline bool isCommutative(enum IrOp op) {
+    return op == IR_ADD || op == IR_MULTIPLY || op == IR_BITWIZE_OR
+        || op == IR_BITWIZE_AND || op == IR_EQUAL || op == IR_NOT_EQUAL;
+}
+
+static bool sameValue(struct IrInstr* a, struct IrInstr* b) {
+    return a -> op == b -> op && a -> type == b -> type
+        && a -> bits == b -> bits
+        && (a -> op == IR_CONST
+            ? a -> _uint == b -> _uint
+            : a -> a == b -> a && (!isBinary(a -> op) || a -> b == b -> b));
+}
+
+static uint32_t hashValue(struct IrInstr* instr) {
+    uint64_t hash = (uint64_t) instr -> op << 16
+                  | (uint64_t) instr -> type << 8
+                  | instr -> bits;
+    if (instr -> op == IR_CONST) {
+        hash ^= instr -> _uint * 0x9e3779b97f4a7c15;
+    } else {
+        hash ^= (uint64_t) instr -> a * 0x9e3779b97f4a7c15;
+        if (isBinary(instr -> op)) {
+            hash ^= (uint64_t) instr -> b * 0xc2b2ae3d27d4eb4f;
+        }
+    }
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9;
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+/*
+ * Global value numbering over the dominator tree. Blocks go in reverse
+ * postorder, so what dominates an instruction was numbered before it and
+ * an instruction that computes what a dominating one did is replaced.
+ */
+static bool runGvn(struct IrFunction* function) {
+    struct Cfg cfg;
+    initCfg(&cfg, function);
+    uint32_t* replaced = irNewReplaced(function);
+    uint32_t capacity = 16;
+    while (capacity < function -> instrs.count * 2) {
+        capacity *= 2;
+    }
+    uint32_t* table = allocFilled(capacity * sizeof(uint32_t), 0xff);
+    bool changed = false;
+
+    for (uint32_t i = 0; i < cfg.count; i++) {
+        uint32_t block = cfg.order[i];
+        struct IrBlock* now = &function -> blocks.items[block];
+        for (uint32_t j = 0; j < now -> code.count; j++) {
+            uint32_t index = now -> code.items[j];
+            struct IrInstr* instr = &function -> instrs.items[index];
+            uint32_t* operands[2];
+            uint32_t count = irFixedOperands(instr, operands);
+            for (uint32_t k = 0; k < count; k++) {
+                while (replaced[*operands[k]] != NODE_NONE) {
+                    (*operands[k]) = replaced[*operands[k]];
+                }
+            }
+            if (instr -> op != IR_CONST && count == 0) {
+                continue;
+            }
+            if (instr -> op == IR_BRANCH || instr -> op == IR_RETURN) {
+                continue;
+            }
+            if (isCommutative(instr -> op) && instr -> a > instr -> b) {
+                uint32_t a = instr -> a;
+                instr -> a = instr -> b;
+                instr -> b = a;
+            }
+            // equal values that do not dominate this one stay in the table
+            uint32_t slot = hashValue(instr) & (capacity - 1);
+            uint32_t found = NODE_NONE;
+            while (table[slot] != NODE_NONE) {
+                struct IrInstr* other = &function -> instrs.items[table[slot]];
+                if (sameValue(other, instr)
+                 && dominates(&cfg, other -> block, block)) {
+                    found = table[slot];
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+            if (found == NODE_NONE) {
+                table[slot] = index;
+            } else {
+                replaced[index] = found;
+                instr -> op = IR_NOP;
+                changed = true;
+            }
+        }
+    }
+    if (changed) {
+        irReplaceUses(function, replaced);
+        irCompact(function);
+    }
+    freeCfg(&cfg);
+    memoryFree(replaced);
+    memoryFree(table);
+    return changed;
+}
+
+// moves index to the end of block, in front of its terminator
+static void hoist(struct IrFunction* function, uint32_t index, uint32_t block) {
+    struct IrBlock* to = &function -> blocks.items[block];
+    pushNode(to -> code, MEMORY_IR, index);
+    to -> code.items[to -> code.count - 1] =
+        to -> code.items[to -> code.count - 2];
+    to -> code.items[to -> code.count - 2] = index;
+    function -> instrs.items[index].block = block;
+}
+
+/*
+ * Loop invariant code motion. A loop is a header that dominates the
+ * blocks jumping back to it, the blocks that reach them without passing
+ * the header are its body. What the body computes from values defined
+ * outside of it moves to the one block that enters the header, inner
+ * loops first so their invariants can move on out.
+ */
+static bool runLicm(struct IrFunction* function) {
+    struct Cfg cfg;
+    initCfg(&cfg, function);
+    uint32_t blocks = function -> blocks.count;
+    uint8_t* in_loop = allocFilled(blocks, 0);
+    uint32_t* stack = allocFilled(blocks * sizeof(uint32_t), 0);
+    bool changed = false;
+
+    for (uint32_t i = cfg.count; i > 0; i--) {
+        uint32_t header = cfg.order[i - 1];
+        struct IrBlock* now = &function -> blocks.items[header];
+        memset(in_loop, 0, blocks);
+        in_loop[header] = true;
+        uint32_t top = 0;
+        bool is_loop = false;
+        for (uint32_t j = 0; j < now -> preds.count; j++) {
+            uint32_t pred = now -> preds.items[j];
+            if (!dominates(&cfg, header, pred)) {
+                continue;
+            }
+            is_loop = true;
+            if (!in_loop[pred]) {
+                in_loop[pred] = true;
+                stack[top++] = pred;
+            }
+        }
+        if (!is_loop) {
+            continue;
+        }
+        while (top > 0) {
+            struct IrBlock* block = &function -> blocks.items[stack[--top]];
+            for (uint32_t j = 0; j < block -> preds.count; j++) {
+                uint32_t pred = block -> preds.items[j];
+                if (!in_loop[pred] && cfg.rank[pred] != NODE_NONE) {
+                    in_loop[pred] = true;
+                    stack[top++] = pred;
+                }
+            }
+        }
+
+        uint32_t preheader = NODE_NONE;
+        uint32_t outside = 0;
+        for (uint32_t j = 0; j < now -> preds.count; j++) {
+            if (!in_loop[now -> preds.items[j]]) {
+                preheader = now -> preds.items[j];
+                outside++;
+            }
+        }
+        if (outside != 1
+         || terminatorOf(function, preheader) -> op != IR_JUMP) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < cfg.count; j++) {
+            uint32_t block = cfg.order[j];
+            if (!in_loop[block]) {
+                continue;
+            }
+            struct IrBlock* body = &function -> blocks.items[block];
+            uint32_t kept = 0;
+            for (uint32_t k = 0; k < body -> code.count; k++) {
+                uint32_t index = body -> code.items[k];
+                struct IrInstr* instr = &function -> instrs.items[index];
+                uint32_t* operands[2];
+                uint32_t count = irFixedOperands(instr, operands);
+                bool is_invariant = isPure(function, instr);
+                for (uint32_t l = 0; l < count && is_invariant; l++) {
+                    struct IrInstr* from = &function -> instrs.items[
+                        *operands[l]
+                    ];
+                    is_invariant = !in_loop[from -> block];
+                }
+                if (!is_invariant) {
+                    body -> code.items[kept++] = index;
+                    continue;
+                }
+                hoist(function, index, preheader);
+                body = &function -> blocks.items[block];
+                changed = true;
+            }
+            body -> code.count = kept;
+        }
+    }
+    freeCfg(&cfg);
+    memoryFree(in_loop);
+    memoryFree(stack);
+    return changed;
+}
+
+static const struct {
+    const char* name;
+    bool        (*run)(struct IrFunction* function);
+} passes[PASS_COUNT] = {
+    { "sccp", runSccp },
+    { "dce",  runDce  },
+    { "gvn",  runGvn  },
+    { "licm", runLicm },
+    { "dce",  runDce  },
+};
+
+void runPasses(struct IrModule* module, struct PassStat* stats) {
+    for (uint32_t i = 0; i < PASS_COUNT; i++) {
+        timeBegin(passes[i].name);
+        stats[i] = (struct PassStat) {
+            .name   = passes[i].name,
+            .before = irCount(module)
+        };
+        double wall = timeWall();
+        for (uint32_t j = 0; j < module -> functions.count; j++) {
+            struct IrFunction* function = &module -> functions.items[j];
+            if (function -> blocks.count != 0) {
+                passes[i].run(function);
+            }
+        }
+        stats[i].wall = timeWall() - wall;
+        stats[i].after = irCount(module);
+        timeEnd();
+    }
+}
+
+void printPassStats(FILE* stream, const char* path, struct PassStat* stats) {
+    fprintf(stream, "%s: %-6s %10s %21s\n", path, "pass", "ms",
+        "instructions");
+    for (uint32_t i = 0; i < PASS_COUNT; i++) {
+        fprintf(stream, "%s: %-6s %10.3f %10zu -> %7zu\n", path,
+            stats[i].name, stats[i].wall * 1000, stats[i].before,
+            stats[i].after);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "ir.h"
+
+/*
+ * The optimizations run on the IR, in order: sccp folds constants and
+ * the branches they decide, dce drops what nothing uses, gvn reuses the
+ * values a dominating block already computed, licm moves what a loop does
+ * not change in front of it and a last dce cleans up after them.
+ */
+
+#define PASS_COUNT 5
+
+struct PassStat {
+    const char* name;
+    double      wall;               // seconds
+    size_t      before;             // instructions of the module
+    size_t      after;
+};
+
+// stats gets one entry per pass, in the order they ran
+void runPasses(struct IrModule* module, struct PassStat* stats);
+
+// what --time-passes prints for one file
+void printPassStats(FILE* stream, const char* path, struct PassStat* stats);
+
+#endif
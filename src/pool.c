@@ -0,0 +1,141 @@
+#include <pthread.h>
+// for: pthread_create, pthread_join, pthread_mutex_*
+#include <stdbool.h>
+// for: bool
+#include <stdio.h>
+// for: fprintf, stderr
+#include <stdlib.h>
+// for: exit, EXIT_FAILURE
+#include <unistd.h>
+// for: sysconf
+
+#include "memory.h"
+#include "pool.h"
+
+/*
+ * No task spawns new tasks, so a deque only ever shrinks and a worker is
+ * done as soon as every deque is empty. A mutex per deque is plenty for
+ * tasks that each parse a whole file.
+ */
+struct PoolDeque {
+    pthread_mutex_t lock;
+    size_t          front;
+    size_t          back;       // one past the last task
+};
+
+struct Pool {
+    struct PoolDeque* deques;
+    size_t            workers;
+    void              (*run)(void* data, size_t index);
+    void*             data;
+};
+
+struct PoolWorker {
+    struct Pool* pool;
+    size_t       id;
+};
+
+static bool popBack(struct PoolDeque* deque, size_t* index) {
+    bool res = false;
+    pthread_mutex_lock(&deque -> lock);
+    if (deque -> front < deque -> back) {
+        (*index) = --deque -> back;
+        res = true;
+    }
+    pthread_mutex_unlock(&deque -> lock);
+    return res;
+}
+
+static bool popFront(struct PoolDeque* deque, size_t* index) {
+    bool res = false;
+    pthread_mutex_lock(&deque -> lock);
+    if (deque -> front < deque -> back) {
+        (*index) = deque -> front++;
+        res = true;
+    }
+    pthread_mutex_unlock(&deque -> lock);
+    return res;
+}
+
+static bool steal(struct Pool* pool, size_t id, size_t* index) {
+    for (size_t i = 1; i < pool -> workers; i++) {
+        size_t victim = (id + i) % pool -> workers;
+        if (popFront(&pool -> deques[victim], index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* work(void* arg) {
+    struct PoolWorker* worker = arg;
+    struct Pool* pool = worker -> pool;
+    size_t index;
+    while (popBack(&pool -> deques[worker -> id], &index)
+        || steal(pool, worker -> id, &index)) {
+        pool -> run(pool -> data, index);
+    }
+    return NULL;
+}
+
+size_t poolDefaultWorkers(void) {
+    long res = sysconf(_SC_NPROCESSORS_ONLN);
+    return res < 1 ? 1 : (size_t) res;
+}
+
+void poolRun(
+    size_t workers,
+    size_t count,
+    void   (*run)(void* data, size_t index),
+    void*  data
+) {
+    if (workers > count) {
+        workers = count;
+    }
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            run(data, i);
+        }
+        return;
+    }
+
+    struct Pool pool = {
+        .deques  = memoryAlloc(workers * sizeof(struct PoolDeque)),
+        .workers = workers,
+        .run     = run,
+        .data    = data
+    };
+    // contiguous slices, neighbours in the input tend to be alike in size
+    for (size_t i = 0; i < workers; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].front = count * i / workers;
+        pool.deques[i].back  = count * (i + 1) / workers;
+    }
+
+    struct PoolWorker* threads_worker =
+        memoryAlloc(workers * sizeof(struct PoolWorker));
+    pthread_t* threads = memoryAlloc(workers * sizeof(pthread_t));
+    for (size_t i = 0; i < workers; i++) {
+        threads_worker[i] = (struct PoolWorker) {
+            .pool = &pool,
+            .id   = i
+        };
+    }
+    for (size_t i = 1; i < workers; i++) {
+        if (pthread_create(&threads[i], NULL, work, &threads_worker[i]) != 0) {
+            fprintf(stderr, "Thread Error: can not start a worker\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    work(&threads_worker[0]);
+    for (size_t i = 1; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < workers; i++) {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+    memoryFree(threads);
+    memoryFree(threads_worker);
+    memoryFree(pool.deques);
+}
@@ -0,0 +1,22 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/*
+ * Runs run(data, i) for every i in [0, count) on a pool of worker threads.
+ * The indices are split into one deque per worker up front, a worker takes
+ * from the back of its own deque and steals from the front of the others
+ * when it runs dry. Returns once every task is done. The calling thread is
+ * worker 0, so with one worker nothing is spawned at all.
+ */
+
+size_t poolDefaultWorkers(void);    // online cpus, at least 1
+void   poolRun(
+    size_t workers,
+    size_t count,
+    void   (*run)(void* data, size_t index),
+    void*  data
+);
+
+#endif
@@ -0,0 +1,369 @@
+#include <stdlib.h>
+// for: qsort
+#include <string.h>
+// for: memcpy, memset
+
+#include "memory.h"
+#include "regalloc.h"
+
+struct Interval {
+    uint32_t value;
+    uint32_t start;
+    uint32_t end;
+};
+
+struct Lifetimes {
+    struct Interval* intervals;     // IrFunction.instrs
+    NODES(uint32_t)  calls;         // positions of CALL and NATIVE, in order
+};
+
+static void* allocZeroed(size_t size) {
+    void* res = memoryAllocKind(MEMORY_IR, size == 0 ? 1 : size);
+    memset(res, 0, size);
+    return res;
+}
+
+static inline void setBit(uint64_t* set, uint32_t bit) {
+    set[bit / 64] |= UINT64_C(1) << (bit % 64);
+}
+
+static inline void clearBit(uint64_t* set, uint32_t bit) {
+    set[bit / 64] &= ~(UINT64_C(1) << (bit % 64));
+}
+
+static inline bool hasBit(uint64_t* set, uint32_t bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+static inline uint32_t predIndex(struct IrBlock* block, uint32_t pred) {
+    uint32_t res = 0;
+    while (block -> preds.items[res] != pred) {
+        res++;
+    }
+    return res;
+}
+
+// what is live at the end of block: the live in of its successors
+static void liveOut(
+    struct IrFunction* function,
+    uint64_t*          live_in,
+    uint32_t           words,
+    uint32_t           block,
+    uint64_t*          res
+) {
+    struct IrBlock* now = &function -> blocks.items[block];
+    struct IrInstr* terminator = &function -> instrs.items[
+        now -> code.items[now -> code.count - 1]
+    ];
+    memset(res, 0, words * sizeof(uint64_t));
+    uint32_t targets[2];
+    uint32_t count = irSuccessors(terminator, targets);
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t* in = &live_in[(size_t) targets[i] * words];
+        for (uint32_t j = 0; j < words; j++) {
+            res[j] |= in[j];
+        }
+        // and the operands of its phis that come from here
+        struct IrBlock* target = &function -> blocks.items[targets[i]];
+        for (uint32_t j = 0; j < target -> code.count; j++) {
+            struct IrInstr* phi = &function -> instrs.items[
+                target -> code.items[j]
+            ];
+            if (phi -> op != IR_PHI) {
+                break;
+            }
+            setBit(res, function -> operands.items[
+                phi -> args.start + predIndex(target, block)
+            ]);
+        }
+    }
+}
+
+// live_in of every block until nothing changes, phis are defined in it
+static uint64_t* findLiveness(
+    struct IrFunction* function,
+    struct Allocation* allocation,
+    uint32_t           words
+) {
+    uint32_t blocks = function -> blocks.count;
+    uint64_t* live_in = allocZeroed((size_t) blocks * words * 8);
+    uint64_t* live = allocZeroed(words * sizeof(uint64_t));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = allocation -> count; i > 0; i--) {
+            uint32_t block = allocation -> order[i - 1];
+            struct IrBlock* now = &function -> blocks.items[block];
+            liveOut(function, live_in, words, block, live);
+            for (uint32_t j = now -> code.count; j > 0; j--) {
+                uint32_t index = now -> code.items[j - 1];
+                struct IrInstr* instr = &function -> instrs.items[index];
+                clearBit(live, index);
+                if (instr -> op == IR_PHI) {
+                    continue;
+                }
+                uint32_t* operands[2];
+                uint32_t count = irFixedOperands(instr, operands);
+                for (uint32_t k = 0; k < count; k++) {
+                    setBit(live, *operands[k]);
+                }
+                for (uint32_t k = 0; k < instr -> args.count; k++) {
+                    setBit(live, function -> operands.items[
+                        instr -> args.start + k
+                    ]);
+                }
+            }
+            uint64_t* in = &live_in[(size_t) block * words];
+            if (memcmp(in, live, words * sizeof(uint64_t)) != 0) {
+                memcpy(in, live, words * sizeof(uint64_t));
+                changed = true;
+            }
+        }
+    }
+    memoryFree(live);
+    return live_in;
+}
+
+static inline void cover(struct Interval* interval, uint32_t position) {
+    if (position < interval -> start) {
+        interval -> start = position;
+    }
+    if (position > interval -> end) {
+        interval -> end = position;
+    }
+}
+
+/*
+ * Every instruction takes two positions, its operands are read at the
+ * first and its value is written at the second.
+ */
+static void findIntervals(
+    struct IrFunction* function,
+    struct Allocation* allocation,
+    struct Lifetimes*  res
+) {
+    struct Interval* intervals = res -> intervals;
+    uint32_t values = function -> instrs.count;
+    uint32_t blocks = function -> blocks.count;
+    uint32_t words = (values + 63) / 64;
+    uint32_t* from = allocZeroed(blocks * sizeof(uint32_t));
+    uint32_t* to = allocZeroed(blocks * sizeof(uint32_t));
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < allocation -> count; i++) {
+        uint32_t block = allocation -> order[i];
+        from[block] = position;
+        position += 2 * function -> blocks.items[block].code.count;
+        to[block] = position;
+    }
+    for (uint32_t i = 0; i < values; i++) {
+        intervals[i] = (struct Interval) {
+            .value = i,
+            .start = UINT32_MAX,
+            .end   = 0
+        };
+    }
+
+    uint64_t* live_in = findLiveness(function, allocation, words);
+    uint64_t* live = allocZeroed(words * sizeof(uint64_t));
+    for (uint32_t i = 0; i < allocation -> count; i++) {
+        uint32_t block = allocation -> order[i];
+        struct IrBlock* now = &function -> blocks.items[block];
+        liveOut(function, live_in, words, block, live);
+        uint64_t* in = &live_in[(size_t) block * words];
+        for (uint32_t j = 0; j < values; j++) {
+            if (hasBit(live, j)) {
+                cover(&intervals[j], to[block] - 1);
+            }
+            if (hasBit(in, j)) {
+                cover(&intervals[j], from[block]);
+            }
+        }
+        for (uint32_t j = 0; j < now -> code.count; j++) {
+            uint32_t index = now -> code.items[j];
+            struct IrInstr* instr = &function -> instrs.items[index];
+            uint32_t at = from[block] + 2 * j;
+            if (instr -> op == IR_PHI) {
+                cover(&intervals[index], from[block]);
+                for (uint32_t k = 0; k < instr -> args.count; k++) {
+                    uint32_t pred = now -> preds.items[k];
+                    cover(
+                        &intervals[function -> operands.items[
+                            instr -> args.start + k
+                        ]],
+                        to[pred] - 2
+                    );
+                }
+                continue;
+            }
+            if (instr -> op == IR_PARAM) {
+                cover(&intervals[index], 0);
+            } else if (instr -> type != IR_TYPE_NONE) {
+                cover(&intervals[index], at + 1);
+            }
+            if (instr -> op == IR_CALL || instr -> op == IR_NATIVE) {
+                pushNode(res -> calls, MEMORY_IR, at);
+            }
+            uint32_t* operands[2];
+            uint32_t count = irFixedOperands(instr, operands);
+            for (uint32_t k = 0; k < count; k++) {
+                cover(&intervals[*operands[k]], at);
+            }
+            for (uint32_t k = 0; k < instr -> args.count; k++) {
+                cover(
+                    &intervals[function -> operands.items[
+                        instr -> args.start + k
+                    ]],
+                    at
+                );
+            }
+        }
+    }
+    memoryFree(from);
+    memoryFree(to);
+    memoryFree(live_in);
+    memoryFree(live);
+}
+
+static int compareIntervals(const void* a, const void* b) {
+    const struct Interval* x = a;
+    const struct Interval* y = b;
+    if (x -> start != y -> start) {
+        return x -> start < y -> start ? -1 : 1;
+    }
+    return (x -> value > y -> value) - (x -> value < y -> value);
+}
+
+// whether a call happens while the interval holds its value
+static bool spansCall(
+    uint32_t*       calls,
+    uint32_t        count,
+    struct Interval interval
+) {
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (calls[middle] <= interval.start) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < count && calls[low] < interval.end;
+}
+
+void allocateRegisters(struct Allocation* res, struct IrFunction* function) {
+    uint32_t values = function -> instrs.count;
+    (*res) = (struct Allocation) {
+        .locations = allocZeroed(values * sizeof(struct Location)),
+        .order     = allocZeroed(function -> blocks.count * sizeof(uint32_t))
+    };
+    res -> count = irReversePostorder(function, res -> order);
+
+    struct Lifetimes lifetimes = {
+        .intervals = allocZeroed(values * sizeof(struct Interval))
+    };
+    findIntervals(function, res, &lifetimes);
+    struct Interval* intervals = lifetimes.intervals;
+    qsort(intervals, values, sizeof(struct Interval), compareIntervals);
+
+    // the intervals holding a register, by their end
+    struct Interval* active = allocZeroed(values * sizeof(struct Interval));
+    uint32_t actives = 0;
+    uint32_t free_gprs = REGALLOC_CALLER_SAVED | REGALLOC_CALLEE_SAVED;
+    uint32_t free_xmms = REGALLOC_XMM;
+    for (uint32_t i = 0; i < values; i++) {
+        struct Interval interval = intervals[i];
+        struct IrInstr* instr = &function -> instrs.items[interval.value];
+        if (interval.start == UINT32_MAX || instr -> type == IR_TYPE_NONE) {
+            continue;
+        }
+        uint32_t expired = 0;
+        while (expired < actives && active[expired].end < interval.start) {
+            struct Location old = res -> locations[active[expired].value];
+            if (old.type == LOCATION_GPR) {
+                free_gprs |= 1u << old.reg;
+            } else {
+                free_xmms |= 1u << old.reg;
+            }
+            expired++;
+        }
+        actives -= expired;
+        memmove(active, &active[expired], actives * sizeof(struct Interval));
+
+        bool is_float = instr -> type == IR_TYPE_FLOAT;
+        bool is_spanning = spansCall(
+            lifetimes.calls.items,
+            lifetimes.calls.count,
+            interval
+        );
+        uint32_t allowed = is_float
+            ? REGALLOC_XMM
+            : REGALLOC_CALLER_SAVED | REGALLOC_CALLEE_SAVED;
+        if (is_spanning) {
+            allowed = is_float ? 0 : REGALLOC_CALLEE_SAVED;
+        }
+        uint32_t free = allowed & (is_float ? free_xmms : free_gprs);
+        struct Location location = {
+            .type = is_float ? LOCATION_XMM : LOCATION_GPR
+        };
+        if (free != 0) {
+            // the caller saved ones first, they need no saving in the prologue
+            uint32_t cheap = free & (REGALLOC_CALLER_SAVED | REGALLOC_XMM);
+            location.reg = __builtin_ctz(cheap != 0 ? cheap : free);
+            if (is_float) {
+                free_xmms &= ~(1u << location.reg);
+            } else {
+                free_gprs &= ~(1u << location.reg);
+            }
+        } else {
+            // the one that ends last goes to the stack
+            uint32_t victim = NODE_NONE;
+            for (uint32_t j = 0; j < actives; j++) {
+                struct Location other = res -> locations[active[j].value];
+                if (other.type != location.type
+                 || !(allowed >> other.reg & 1)) {
+                    continue;
+                }
+                if (victim == NODE_NONE || active[j].end > active[victim].end) {
+                    victim = j;
+                }
+            }
+            if (victim == NODE_NONE || active[victim].end <= interval.end) {
+                res -> locations[interval.value] = (struct Location) {
+                    .type = LOCATION_STACK,
+                    .slot = res -> slots++
+                };
+                continue;
+            }
+            location.reg = res -> locations[active[victim].value].reg;
+            res -> locations[active[victim].value] = (struct Location) {
+                .type = LOCATION_STACK,
+                .slot = res -> slots++
+            };
+            actives--;
+            memmove(&active[victim], &active[victim + 1],
+                (actives - victim) * sizeof(struct Interval));
+        }
+        res -> locations[interval.value] = location;
+        if (!is_float) {
+            res -> used |= 1u << location.reg;
+        }
+        uint32_t at = actives;
+        while (at > 0 && active[at - 1].end > interval.end) {
+            active[at] = active[at - 1];
+            at--;
+        }
+        active[at] = interval;
+        actives++;
+    }
+    memoryFree(intervals);
+    memoryFree(active);
+    memoryFree(lifetimes.calls.items);
+}
+
+void freeAllocation(struct Allocation* allocation) {
+    memoryFree(allocation -> locations);
+    memoryFree(allocation -> order);
+    (*allocation) = (struct Allocation) { 0 };
+}
@@ -0,0 +1,65 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ir.h"
+
+// x86-64 registers by their encoding, XMM registers number the same way
+enum Register {
+    REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+    REG_R8,  REG_R9,  REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+};
+
+/*
+ * RAX, RCX, RDX and R11 are left to the instruction selector, which
+ * needs them for divisions, shifts, returns and moves, as are XMM14 and
+ * XMM15. Only the callee saved registers keep a value over a call, there
+ * are no such XMM registers.
+ */
+#define REGALLOC_CALLER_SAVED                                               \
+    (1u << REG_RSI | 1u << REG_RDI | 1u << REG_R8 | 1u << REG_R9            \
+   | 1u << REG_R10)
+#define REGALLOC_CALLEE_SAVED                                               \
+    (1u << REG_RBX | 1u << REG_R12 | 1u << REG_R13 | 1u << REG_R14          \
+   | 1u << REG_R15)
+#define REGALLOC_XMM ((1u << 14) - 1)
+
+enum LocationType {
+    LOCATION_NONE,                  // values of type None
+    LOCATION_GPR,
+    LOCATION_XMM,
+    LOCATION_STACK,
+};
+
+struct Location {
+    uint8_t  type;                  // enum LocationType
+    uint8_t  reg;                   // enum Register, or the XMM number
+    uint32_t slot;                  // of 8 bytes in the frame
+};
+
+struct Allocation {
+    struct Location* locations;     // IrFunction.instrs
+    uint32_t*        order;         // the blocks as they are laid out
+    uint32_t         count;
+    uint32_t         slots;
+    uint32_t         used;          // every GPR given out, bit per register
+};
+
+/*
+ * Linear scan as by Poletto and Sarkar: blocks are laid out in reverse
+ * postorder and every value lives from its definition to its last use in
+ * that order, stretched over the blocks it is live through. Values are
+ * handed registers in the order they start, when none is free the one
+ * that ends last goes to the stack for its whole life.
+ *
+ * Floats go to XMM registers, everything else to GPRs. Params live from
+ * the entry, a phi from the start of its block and its operands until
+ * the end of the predecessor they come from. The function needs its
+ * critical edges split.
+ */
+void allocateRegisters(struct Allocation* res, struct IrFunction* function);
+void freeAllocation(struct Allocation* allocation);
+
+#endif
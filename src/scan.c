@@ -0,0 +1,385 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+// for: _mm_*, _mm256_*
+#endif
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+/*
+ * Every kernel is the same loop: find the first byte matching a stop set,
+ * optionally counting the new lines passed on the way. The stop set is a
+ * compile time constant, so each wrapper gets its own specialized loop.
+ */
+enum Stop {
+    STOP_NOT_SPACE,
+    STOP_LINE_END,
+    STOP_COMMENT_END,
+    STOP_QUOTE,
+};
+
+static ALWAYS_INLINE bool stopScalar(const char* src, enum Stop stop) {
+    char c = *src;
+    switch (stop) {
+    case STOP_NOT_SPACE:
+        return !(c == ' ' || (c >= '\t' && c <= '\r'));
+    case STOP_LINE_END:
+        return c == '\n' || c == 0;
+    case STOP_COMMENT_END:
+        return (c == '*' && src[1] == '/') || c == 0;
+    case STOP_QUOTE:
+        return c == '"' || c == '\\' || c == '\n' || c == 0;
+    }
+    return true;
+}
+
+static ALWAYS_INLINE const char* findScalar(
+    const char* src,
+    size_t*     lines,
+    enum Stop   stop
+) {
+    size_t count = 0;
+    while (!stopScalar(src, stop)) {
+        count += (*src) == '\n';
+        src++;
+    }
+    if (lines != NULL) {
+        (*lines) = count;
+    }
+    return src;
+}
+
+static const char* spacesScalar(const char* src, size_t* lines) {
+    return findScalar(src, lines, STOP_NOT_SPACE);
+}
+
+static const char* lineEndScalar(const char* src) {
+    return findScalar(src, NULL, STOP_LINE_END);
+}
+
+static const char* commentEndScalar(const char* src, size_t* lines) {
+    return findScalar(src, lines, STOP_COMMENT_END);
+}
+
+static const char* quoteScalar(const char* src) {
+    return findScalar(src, NULL, STOP_QUOTE);
+}
+
+#ifdef SCAN_X86
+
+// most runs between two tokens are a byte or two, not worth a vector load
+#define SCAN_PRELUDE 8
+
+/*
+ * Mask of the bytes where the search stops. For "*" "/" the '*' is reported,
+ * carry holds a '*' at the end of the previous block whose '/' starts this
+ * one, and gets the last '*' of this block back.
+ */
+static ALWAYS_INLINE uint32_t stopSse2(
+    __m128i   bytes,
+    enum Stop stop,
+    uint32_t* carry
+) {
+    uint32_t zero = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(bytes, _mm_setzero_si128())
+    );
+    uint32_t line = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))
+    );
+    switch (stop) {
+    case STOP_NOT_SPACE: {
+        // '\t' .. '\r' is the only range, x - '\t' <= 4 checks it unsigned
+        __m128i shift = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+        __m128i range = _mm_cmpeq_epi8(
+            _mm_min_epu8(shift, _mm_set1_epi8(4)),
+            shift
+        );
+        __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+        return ~_mm_movemask_epi8(_mm_or_si128(range, space)) & 0xffff;
+    }
+    case STOP_LINE_END:
+        return zero | line;
+    case STOP_COMMENT_END: {
+        uint32_t star = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('*'))
+        );
+        uint32_t slash = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('/'))
+        );
+        uint32_t res = zero | (star & (slash >> 1)) | ((*carry) & slash & 1);
+        (*carry) = (star >> 15) & 1;
+        return res;
+    }
+    case STOP_QUOTE:
+        return zero | line | _mm_movemask_epi8(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))
+            )
+        );
+    }
+    return 0xffff;
+}
+
+static ALWAYS_INLINE const char* findSse2(
+    const char* src,
+    size_t*     lines,
+    enum Stop   stop
+) {
+    size_t count = 0;
+    for (int i = 0; i < SCAN_PRELUDE; i++, src++) {
+        if (stopScalar(src, stop)) {
+            if (lines != NULL) {
+                (*lines) = count;
+            }
+            return src;
+        }
+        count += (*src) == '\n';
+    }
+
+    // aligned loads never cross into the next page
+    const char* block = (const char*)((uintptr_t)src & ~(uintptr_t)15);
+    uint32_t valid = 0xffffu << (src - block);
+    uint32_t carry = 0;
+    while (true) {
+        __m128i bytes = _mm_load_si128((const __m128i*)block);
+        uint32_t last_carry = carry;
+        uint32_t found = stopSse2(bytes, stop, &carry) & valid;
+        uint32_t line = 0;
+        if (lines != NULL) {
+            line = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))
+            ) & valid;
+        }
+        if (found != 0) {
+            unsigned index = __builtin_ctz(found);
+            if (stop == STOP_COMMENT_END && index == 0 && last_carry
+             && block[0] == '/') {
+                if (lines != NULL) {
+                    (*lines) = count;
+                }
+                return block - 1;
+            }
+            if (lines != NULL) {
+                count += __builtin_popcount(line & ((1u << index) - 1));
+                (*lines) = count;
+            }
+            return block + index;
+        }
+        count += __builtin_popcount(line);
+        block += 16;
+        valid = 0xffff;
+    }
+}
+
+static const char* spacesSse2(const char* src, size_t* lines) {
+    return findSse2(src, lines, STOP_NOT_SPACE);
+}
+
+static const char* lineEndSse2(const char* src) {
+    return findSse2(src, NULL, STOP_LINE_END);
+}
+
+static const char* commentEndSse2(const char* src, size_t* lines) {
+    return findSse2(src, lines, STOP_COMMENT_END);
+}
+
+static const char* quoteSse2(const char* src) {
+    return findSse2(src, NULL, STOP_QUOTE);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+static AVX2 ALWAYS_INLINE uint32_t stopAvx2(
+    __m256i   bytes,
+    enum Stop stop,
+    uint32_t* carry
+) {
+    uint32_t zero = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256())
+    );
+    uint32_t line = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'))
+    );
+    switch (stop) {
+    case STOP_NOT_SPACE: {
+        __m256i shift = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+        __m256i range = _mm256_cmpeq_epi8(
+            _mm256_min_epu8(shift, _mm256_set1_epi8(4)),
+            shift
+        );
+        __m256i space = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+        return ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(range, space));
+    }
+    case STOP_LINE_END:
+        return zero | line;
+    case STOP_COMMENT_END: {
+        uint32_t star = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('*'))
+        );
+        uint32_t slash = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/'))
+        );
+        uint32_t res = zero | (star & (slash >> 1)) | ((*carry) & slash & 1);
+        (*carry) = star >> 31;
+        return res;
+    }
+    case STOP_QUOTE:
+        return zero | line | _mm256_movemask_epi8(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+                _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))
+            )
+        );
+    }
+    return 0xffffffffu;
+}
+
+static AVX2 ALWAYS_INLINE const char* findAvx2(
+    const char* src,
+    size_t*     lines,
+    enum Stop   stop
+) {
+    size_t count = 0;
+    for (int i = 0; i < SCAN_PRELUDE; i++, src++) {
+        if (stopScalar(src, stop)) {
+            if (lines != NULL) {
+                (*lines) = count;
+            }
+            return src;
+        }
+        count += (*src) == '\n';
+    }
+
+    const char* block = (const char*)((uintptr_t)src & ~(uintptr_t)31);
+    uint32_t valid = 0xffffffffu << (src - block);
+    uint32_t carry = 0;
+    while (true) {
+        __m256i bytes = _mm256_load_si256((const __m256i*)block);
+        uint32_t last_carry = carry;
+        uint32_t found = stopAvx2(bytes, stop, &carry) & valid;
+        uint32_t line = 0;
+        if (lines != NULL) {
+            line = (uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'))
+            ) & valid;
+        }
+        if (found != 0) {
+            unsigned index = __builtin_ctz(found);
+            if (stop == STOP_COMMENT_END && index == 0 && last_carry
+             && block[0] == '/') {
+                if (lines != NULL) {
+                    (*lines) = count;
+                }
+                return block - 1;
+            }
+            if (lines != NULL) {
+                uint32_t before = index == 0 ? 0 : 0xffffffffu >> (32 - index);
+                count += __builtin_popcount(line & before);
+                (*lines) = count;
+            }
+            return block + index;
+        }
+        count += __builtin_popcount(line);
+        block += 32;
+        valid = 0xffffffffu;
+    }
+}
+
+static AVX2 const char* spacesAvx2(const char* src, size_t* lines) {
+    return findAvx2(src, lines, STOP_NOT_SPACE);
+}
+
+static AVX2 const char* lineEndAvx2(const char* src) {
+    return findAvx2(src, NULL, STOP_LINE_END);
+}
+
+static AVX2 const char* commentEndAvx2(const char* src, size_t* lines) {
+    return findAvx2(src, lines, STOP_COMMENT_END);
+}
+
+static AVX2 const char* quoteAvx2(const char* src) {
+    return findAvx2(src, NULL, STOP_QUOTE);
+}
+
+#endif
+
+static const struct ScanKernels kernels[] = {
+    [SCAN_SCALAR] = {
+        .spaces      = spacesScalar,
+        .line_end    = lineEndScalar,
+        .comment_end = commentEndScalar,
+        .quote       = quoteScalar,
+    },
+#ifdef SCAN_X86
+    [SCAN_SSE2] = {
+        .spaces      = spacesSse2,
+        .line_end    = lineEndSse2,
+        .comment_end = commentEndSse2,
+        .quote       = quoteSse2,
+    },
+    [SCAN_AVX2] = {
+        .spaces      = spacesAvx2,
+        .line_end    = lineEndAvx2,
+        .comment_end = commentEndAvx2,
+        .quote       = quoteAvx2,
+    },
+#endif
+};
+
+struct ScanKernels scan = {
+    .spaces      = spacesScalar,
+    .line_end    = lineEndScalar,
+    .comment_end = commentEndScalar,
+    .quote       = quoteScalar,
+};
+
+const char* scanKernelName(enum ScanKernel kernel) {
+    switch (kernel) {
+    case SCAN_SCALAR:
+        return "scalar";
+    case SCAN_SSE2:
+        return "sse2";
+    case SCAN_AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+bool scanSupported(enum ScanKernel kernel) {
+    switch (kernel) {
+    case SCAN_SCALAR:
+        return true;
+#ifdef SCAN_X86
+    case SCAN_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SCAN_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+bool scanSelect(enum ScanKernel kernel) {
+    if (!scanSupported(kernel)) {
+        return false;
+    }
+    scan = kernels[kernel];
+    return true;
+}
+
+__attribute__((constructor)) static void scanInit(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+#endif
+    if (!scanSelect(SCAN_AVX2)) {
+        scanSelect(SCAN_SSE2);
+    }
+}
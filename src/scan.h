@@ -0,0 +1,37 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Byte scanning kernels used by the lexer. Every kernel expects a zero
+ * terminated source and stops at the terminator at the latest. The vector
+ * versions read whole aligned blocks, so they may look at bytes after the
+ * terminator, but never across a page boundary.
+ */
+
+enum ScanKernel {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+};
+
+struct ScanKernels {
+    // first byte that is not isspace, lines gets the number of '\n' skipped
+    const char* (*spaces)(const char* src, size_t* lines);
+    // first '\n' or end of source
+    const char* (*line_end)(const char* src);
+    // the '*' of the first "*/" or end of source, counts '\n' like spaces
+    const char* (*comment_end)(const char* src, size_t* lines);
+    // first '"', '\\', '\n' or end of source
+    const char* (*quote)(const char* src);
+};
+
+extern struct ScanKernels scan;
+
+const char* scanKernelName(enum ScanKernel kernel);
+bool        scanSupported(enum ScanKernel kernel);
+bool        scanSelect(enum ScanKernel kernel);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "memory.h"
+#include "symbol.h"
+
+#define SYMBOL_TABLE_SIZE 1024
+
+// FNV-1a, names are short so anything fancier does not pay off
+static inline uint32_t hashName(const char* str, size_t length) {
+    uint32_t res = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        res ^= (unsigned char)str[i];
+        res *= 16777619u;
+    }
+    return res;
+}
+
+void initSymbols(struct Symbols* symbols, struct Arena* arena) {
+    (*symbols) = (struct Symbols) {
+        .arena      = arena,
+        .table      = memoryAllocKind(
+            MEMORY_SYMBOL,
+            SYMBOL_TABLE_SIZE * sizeof(uint32_t)
+        ),
+        .table_size = SYMBOL_TABLE_SIZE
+    };
+}
+
+void freeSymbols(struct Symbols* symbols) {
+    memoryFree(symbols -> strings);
+    memoryFree(symbols -> hashes);
+    memoryFree(symbols -> table);
+    (*symbols) = (struct Symbols) { 0 };
+}
+
+static void growTable(struct Symbols* symbols) {
+    uint32_t size = symbols -> table_size * 2;
+    uint32_t* table = memoryAllocKind(
+        MEMORY_SYMBOL,
+        size * sizeof(uint32_t)
+    );
+    for (uint32_t symbol = 0; symbol < symbols -> count; symbol++) {
+        uint32_t slot = symbols -> hashes[symbol] & (size - 1);
+        while (table[slot] != 0) {
+            slot = (slot + 1) & (size - 1);
+        }
+        table[slot] = symbol + 1;
+    }
+    memoryFree(symbols -> table);
+    symbols -> table = table;
+    symbols -> table_size = size;
+}
+
+uint32_t internSymbol(struct Symbols* symbols, const char* str, size_t length) {
+    uint32_t hash = hashName(str, length);
+    uint32_t mask = symbols -> table_size - 1;
+    uint32_t slot = hash & mask;
+    while (symbols -> table[slot] != 0) {
+        uint32_t symbol = symbols -> table[slot] - 1;
+        struct String name = symbols -> strings[symbol];
+        if (symbols -> hashes[symbol] == hash
+         && name.length == length
+         && memcmp(name.string, str, length) == 0) {
+            return symbol;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (symbols -> count == symbols -> capacity) {
+        symbols -> capacity = symbols -> capacity == 0
+            ? 256
+            : symbols -> capacity * 2;
+        symbols -> strings = memoryReallocKind(
+            MEMORY_SYMBOL,
+            symbols -> strings,
+            symbols -> capacity * sizeof(struct String)
+        );
+        symbols -> hashes = memoryReallocKind(
+            MEMORY_SYMBOL,
+            symbols -> hashes,
+            symbols -> capacity * sizeof(uint32_t)
+        );
+    }
+
+    uint32_t res = symbols -> count++;
+    symbols -> strings[res] = newStringL(
+        arenaStringnLengthDup(symbols -> arena, str, length),
+        length
+    );
+    symbols -> hashes[res] = hash;
+    symbols -> table[slot] = res + 1;
+
+    // keep the load factor under one half
+    if (symbols -> count * 2 > symbols -> table_size) {
+        growTable(symbols);
+    }
+    return res;
+}
@@ -0,0 +1,39 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+#include "string.h"
+
+/*
+ * Identifier interning. Every distinct name gets a small integer id, so the
+ * rest of the compiler compares names as integers. The text of each symbol
+ * is copied into the arena and stays valid as long as it does.
+ */
+
+#define SYMBOL_NONE UINT32_MAX
+
+struct Symbols {
+    struct Arena*  arena;
+    struct String* strings;     // id -> text
+    uint32_t*      hashes;      // id -> hash, kept to grow without rehashing
+    uint32_t       count;
+    uint32_t       capacity;
+    uint32_t*      table;       // open addressing, id + 1 or 0 when empty
+    uint32_t       table_size;  // power of two
+};
+
+void     initSymbols(struct Symbols* symbols, struct Arena* arena);
+void     freeSymbols(struct Symbols* symbols);
+uint32_t internSymbol(struct Symbols* symbols, const char* str, size_t length);
+
+static inline struct String symbolString(
+    struct Symbols* symbols,
+    uint32_t        symbol
+) {
+    return symbols -> strings[symbol];
+}
+
+#endif
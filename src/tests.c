@@ -1,24 +1,1593 @@
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#include "token.c"
-#include "memory.c"
+#include "args.h"
+#include "ast.h"
+#include "bytecode.h"
+#include "cache.h"
+#include "compile.h"
+#include "emitc.h"
+#include "file.h"
+#include "fold.h"
+#include "interface.h"
+#include "ir.h"
+#include "jit.h"
+#include "layout.h"
+#include "lexer.h"
+#include "memory.h"
+#include "module.h"
+#include "mono.h"
+#include "native.h"
+#include "object.h"
+#include "parser.h"
+#include "passes.h"
+#include "scan.h"
+#include "symbol.h"
+#include "timing.h"
+#include "vm.h"
+
+struct Args args;
+
+static int failed = 0;
 
 static void test(bool is_working, const char* msg) {
     if (is_working) {
         printf(" [\x1b[92mOK\x1b[0m]: %s\n", msg);
     } else {
         printf(" [\x1b[91mWrong\x1b[0m]: %s\n", msg);
+        failed++;
     }
 }
 
-int main(void) {
+// a file parsed into an arena and symbols of its own, it must not move
+struct Fixture {
+    struct Arena   arena;
+    struct Symbols symbols;
+    struct AST     ast;
+    struct Error   error;
+};
+
+// an empty file, to build one without the parser
+static void initFixture(struct Fixture* fixture) {
+    arenaInit(&fixture -> arena, ARENA_CHUNK_SIZE);
+    initSymbols(&fixture -> symbols, &fixture -> arena);
+    initAST(&fixture -> ast, &fixture -> symbols);
+    fixture -> error = (struct Error) { 0 };
+}
+
+// false on syntax errors, free the fixture either way
+static bool parseSource(const char* src, struct Fixture* fixture) {
+    initFixture(fixture);
+    return parse(&fixture -> ast, src, "<test>", &fixture -> error);
+}
+
+// parses src in place of the last file, the symbols are kept
+static bool reparseSource(const char* src, struct Fixture* fixture) {
+    freeAST(&fixture -> ast);
+    initAST(&fixture -> ast, &fixture -> symbols);
+    fixture -> error = (struct Error) { 0 };
+    return parse(&fixture -> ast, src, "<test>", &fixture -> error);
+}
+
+static void freeFixture(struct Fixture* fixture) {
+    freeAST(&fixture -> ast);
+    freeSymbols(&fixture -> symbols);
+    arenaFree(&fixture -> arena);
+}
+
+static void writeTestFile(const char* dir, const char* name, const char* src) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* stream = fopen(path, "w");
+    if (stream != NULL) {
+        fputs(src, stream);
+        fclose(stream);
+    }
+}
+
+// a directory made by mkdtemp and the files in it, not directories
+static void removeTestDir(const char* dir) {
+    DIR* entries = opendir(dir);
+    for (struct dirent* entry = entries == NULL ? NULL : readdir(entries);
+         entry != NULL; entry = readdir(entries)) {
+        char path[600];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry -> d_name);
+        unlink(path);
+    }
+    if (entries != NULL) {
+        closedir(entries);
+    }
+    rmdir(dir);
+}
+
+static void testMatch(void) {
+    struct Lexer lexer = {
+        .file = "<test>",
+        .line = 1
+    };
     const char* end;
-    struct Token asdf = isTokenString("\"\\x41\" asdf", &end);
-    fprintf(stderr, "%s\n%s\n%d\n", end, 
-            asdf.value_string.string,
-            asdf.value_string.length
-            );
+
+    struct String string;
+    bool res = matchString(&lexer, "\"\\x41\\n\" asdf", &end, &string);
+    test(res && string.length == 2 && memcmp(string.string, "A\n", 2) == 0,
+        "matchString unescapes");
+    test(res && strcmp(end, " asdf") == 0, "matchString ends after the quote");
+    if (res) {
+        memoryFree(string.string);
+    }
+
+    uint64_t _int;
+    test(matchUint(&lexer, "0x1f;", &end, &_int) && _int == 31,
+        "matchUint reads hex");
+    long double _float;
+    test(matchFloat(&lexer, "2.5e2", &end, &_float) && _float == 250,
+        "matchFloat reads exponents");
+
+    struct String name;
+    test(matchUpperName(&lexer, "  Maybe<A>", &end, &name)
+        && name.length == 5 && (*end) == '<', "matchUpperName");
+    test(!matchUpperName(&lexer, "maybe", &end, &name),
+        "matchUpperName rejects lower case");
+    test(matchKeyword(&lexer, "import A;", &end, "import"), "matchKeyword");
+    test(!matchKeyword(&lexer, "imports", &end, "import"),
+        "matchKeyword needs a whole word");
+
+    test(matchGreatThenOrEqual(&lexer, ">= 1", &end) && (*end) == ' ',
+        "matchGreatThenOrEqual");
+    test(matchAsign(&lexer, "= 1", &end) && (*end) == ' ', "matchAsign");
+
+    test(!lexer.failed, "no errors on good input");
+    struct Error error = { 0 };
+    lexer.error = &error;
+    test(!matchString(&lexer, "\"line\nbreak\"", &end, &string)
+        && lexer.failed && error.kind != NULL, "matchString rejects new lines");
+}
+
+/*
+ * Every kernel the cpu has against the scalar one, from every offset of a
+ * page of runs of the bytes they stop at. The page ends in the terminator
+ * and the one after it is not readable, a kernel that reads past a page
+ * faults. A terminator in the middle ends the scans before it early.
+ */
+static void testScan(void) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    char* text = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (text == MAP_FAILED || mprotect(text + page, page, PROT_NONE) != 0) {
+        test(false, "map a page for the scan kernels");
+        return;
+    }
+    const char bytes[] = " \t\n\r*/\"\\a";
+    uint32_t random = 7;
+    for (size_t i = 0; i < page - 1;) {
+        random = random * 1103515245 + 12345;
+        size_t run = 1 + (random >> 16) % 70;
+        char c = bytes[(random >> 8) % (sizeof(bytes) - 1)];
+        for (; run != 0 && i < page - 1; run--) {
+            text[i++] = c;
+        }
+    }
+    text[page / 2 + 3] = 0;
+    text[page - 1] = 0;
+
+    struct ScanKernels saved = scan;
+    scanSelect(SCAN_SCALAR);
+    struct ScanKernels scalar = scan;
+    enum ScanKernel kernels[] = { SCAN_SSE2, SCAN_AVX2 };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!scanSelect(kernels[k])) {
+            continue;
+        }
+        bool same = true;
+        for (size_t i = 0; i < page && same; i++) {
+            size_t lines = 0, expected = 0;
+            same = scan.spaces(text + i, &lines)
+                    == scalar.spaces(text + i, &expected)
+                && lines == expected
+                && scan.comment_end(text + i, &lines)
+                    == scalar.comment_end(text + i, &expected)
+                && lines == expected
+                && scan.line_end(text + i) == scalar.line_end(text + i)
+                && scan.quote(text + i) == scalar.quote(text + i);
+        }
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s scan agrees with scalar up to a page",
+            scanKernelName(kernels[k]));
+        test(same, msg);
+    }
+    scan = saved;
+    munmap(text, 2 * page);
+}
+
+static void testReadFile(void) {
+    char dir[] = "/tmp/mic-tests-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        test(false, "make a directory for files");
+        return;
+    }
+    size_t page = sysconf(_SC_PAGESIZE);
+    char* src = memoryAlloc(page + 1);
+    memset(src, 'a', page);
+    src[page] = 0;
+    writeTestFile(dir, "page.micro", src);
+    writeTestFile(dir, "empty.micro", "");
+
+    char path[256];
+    struct File file;
+    struct Error error = { 0 };
+    snprintf(path, sizeof(path), "%s/page.micro", dir);
+    bool res = readFile(&file, path, &error);
+    test(res && file.mapped > file.length && file.length == page
+        && memcmp(file.text, src, page) == 0 && file.text[page] == 0,
+        "map a file of exactly a page with a terminator after it");
+    closeFile(&file);
+
+    snprintf(path, sizeof(path), "%s/empty.micro", dir);
+    res = readFile(&file, path, &error);
+    test(res && file.length == 0 && file.text[0] == 0, "map an empty file");
+    closeFile(&file);
+
+    snprintf(path, sizeof(path), "%s/missing.micro", dir);
+    test(!readFile(&file, path, &error) && file.text == NULL
+        && strcmp(error.file, path) == 0,
+        "readFile reports missing files with their path");
+
+    memoryFree(src);
+    removeTestDir(dir);
+}
+
+// how often needle is in haystack
+static size_t countOf(const char* haystack, const char* needle) {
+    size_t res = 0;
+    for (const char* at = strstr(haystack, needle); at != NULL;
+         at = strstr(at + 1, needle)) {
+        res++;
+    }
+    return res;
+}
+
+static void testTimeReport(void) {
+    struct Timings files[2] = { 0 };
+    struct Timings driver = { 0 };
+    struct Timings* previous = timingsAttach(&files[0]);
+    for (size_t i = 0; i < 2; i++) {
+        timingsAttach(&files[i]);
+        timeBegin("outer");
+        timeBegin("inner");
+        timeEnd();
+        timeEnd();
+    }
+    timingsAttach(&driver);
+    timeBegin("files");
+    timeEnd();
+    timingsAttach(previous);
+    test(files[0].count == 2 && files[0].items[1].depth == 1
+        && strcmp(files[0].items[1].name, "inner") == 0
+        && files[0].items[0].wall >= files[0].items[1].wall,
+        "time nested phases");
+
+    const char* paths[] = { "a\"b.micro", "c.micro" };
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    printTimeReport(stream, TIME_REPORT_TABLE, &driver, paths, files, 2,
+        1.0, 1.0);
+    fclose(stream);
+    test(strstr(output, "time report: 2 files,")
+        && strstr(output, "\nc.micro\n  outer ")
+        && strstr(output, "\n    inner ")
+        && countOf(output, "  outer ") == 3,
+        "time report table with every file and all files summed");
+    memoryFree(output);
+
+    output = NULL;
+    stream = open_memstream(&output, &length);
+    printTimeReport(stream, TIME_REPORT_JSON, &driver, paths, files, 2,
+        1.0, 1.0);
+    fclose(stream);
+    test(strstr(output, "{\"path\": \"a\\\"b.micro\", \"phases\": "
+            "[{\"name\": \"outer\"")
+        && strstr(output, "\"phases\": [{\"name\": \"inner\"")
+        && strstr(output, "\"total\": [{\"name\": \"outer\"")
+        && countOf(output, "\"outer\"") == 3,
+        "time report as json with nested and escaped names");
+    memoryFree(output);
+
+    freeTimings(&driver);
+    freeTimings(&files[0]);
+    freeTimings(&files[1]);
+}
+
+static void testMemoryReport(void) {
+    memoryTrack(true);
+    struct MemoryStats before = memoryStats();
+    void* ir = memoryAllocKind(MEMORY_IR, 100);
+    struct Arena arena;
+    arenaInit(&arena, 4096);
+    arenaAlloc(&arena, 64);
+    arenaAlloc(&arena, 8192);
+    arenaFree(&arena);
+    struct MemoryStats after = memoryStats();
+    memoryFree(ir);
+
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    printMemoryReport(stream);
+    fclose(stream);
+    memoryTrack(false);
+
+    struct MemoryKindStats kind_before = before.kinds[MEMORY_IR];
+    struct MemoryKindStats kind_after = after.kinds[MEMORY_IR];
+    test(kind_after.allocs == kind_before.allocs + 1
+        && kind_after.bytes == kind_before.bytes + 100
+        && after.allocs > before.allocs && after.bytes >= before.bytes + 100,
+        "memory counts allocations by kind");
+    test(after.arenas == before.arenas + 1
+        && after.arena_chunks == before.arena_chunks + 2
+        && after.arena_used >= before.arena_used + 64 + 8192
+        && after.arena_reserved - before.arena_reserved
+            >= after.arena_used - before.arena_used,
+        "memory counts freed arenas and their chunks");
+    test(strstr(output, "memory report: peak rss ")
+        && strstr(output, "\n  ir ") && strstr(output, "\n  total ")
+        && strstr(output, "\narenas: "),
+        "memory report lists the kinds in use and the arenas");
+    memoryFree(output);
+}
+
+static const struct {
+    const char*    name;
+    enum TokenType type;
+} test_keywords[] = {
+    { "import", TOKEN_IMPORT }, { "type", TOKEN_TYPE },
+    { "export", TOKEN_EXPORT }, { "enum", TOKEN_ENUM },
+    { "union", TOKEN_UNION }, { "ref", TOKEN_REF }, { "as", TOKEN_AS },
+    { "func", TOKEN_FUNC }, { "cfunc", TOKEN_CFUNC }, { "test", TOKEN_TEST },
+    { "var", TOKEN_VAR }, { "const", TOKEN_CONST }, { "if", TOKEN_IF },
+    { "else", TOKEN_ELSE }, { "switch", TOKEN_SWITCH },
+    { "case", TOKEN_CASE }, { "end", TOKEN_CASE_END },
+    { "default", TOKEN_DEFAULT }, { "loop", TOKEN_LOOP }, { "do", TOKEN_DO },
+    { "while", TOKEN_WHILE }, { "for", TOKEN_FOR },
+    { "repead", TOKEN_REPEAD }, { "return", TOKEN_RETURN },
+};
+
+#define TEST_KEYWORDS (sizeof(test_keywords) / sizeof(test_keywords[0]))
+
+/*
+ * The first odd seed from start on that gives every keyword a slot of its
+ * own, 0 if there is none. This is how KEYWORD_SEED was found, the slots of
+ * the table in lexer.c are then keywordSlot of each keyword.
+ */
+static uint32_t findKeywordSeed(uint32_t start) {
+    for (uint64_t seed = start | 1; seed <= UINT32_MAX; seed += 2) {
+        uint32_t used = 0;
+        size_t i = 0;
+        for (; i < TEST_KEYWORDS; i++) {
+            const char* name = test_keywords[i].name;
+            uint32_t key = keywordKey(name, strlen(name));
+            uint32_t slot = keywordSlot(key, (uint32_t) seed);
+            if (used & (uint32_t) 1 << slot) {
+                break;
+            }
+            used |= (uint32_t) 1 << slot;
+        }
+        if (i == TEST_KEYWORDS) {
+            return (uint32_t) seed;
+        }
+    }
     return 0;
 }
+
+static void testKeywords(void) {
+    struct Arena arena;
+    struct Symbols symbols;
+    struct Tokens tokens;
+    arenaInit(&arena, ARENA_CHUNK_SIZE);
+    initSymbols(&symbols, &arena);
+    struct Lexer lexer = {
+        .file    = "<test>",
+        .line    = 1,
+        .symbols = &symbols
+    };
+    bool found = true;
+    for (size_t i = 0; i < TEST_KEYWORDS; i++) {
+        char src[32];
+        snprintf(src, sizeof(src), "%s %sx", test_keywords[i].name,
+            test_keywords[i].name);
+        bool res = tokenize(&lexer, &tokens, src);
+        found = found && res && tokens.tokens[0].type == test_keywords[i].type
+            && tokens.tokens[1].type == TOKEN_LOWER_NAME;
+        freeTokens(&tokens);
+    }
+    test(found, "tokenize finds every keyword");
+    bool is_perfect = findKeywordSeed(KEYWORD_SEED) == KEYWORD_SEED;
+    test(is_perfect, "keyword seed gives every keyword its own slot");
+    if (!is_perfect) {
+        printf("        the first working seed is 0x%08" PRIx32 "\n",
+            findKeywordSeed(1));
+    }
+    freeSymbols(&symbols);
+    arenaFree(&arena);
+}
+
+static void testTokenize(void) {
+    struct Arena arena;
+    struct Symbols symbols;
+    struct Tokens tokens;
+    arenaInit(&arena, ARENA_CHUNK_SIZE);
+    initSymbols(&symbols, &arena);
+    struct Lexer lexer = {
+        .file    = "<test>",
+        .line    = 1,
+        .symbols = &symbols
+    };
+    bool res = tokenize(&lexer, &tokens, "type /* a\n b */ T = A>>B; // c\n");
+    enum TokenType expected[] = {
+        TOKEN_TYPE, TOKEN_UPPER_NAME, TOKEN_ASIGN, TOKEN_UPPER_NAME,
+        TOKEN_RIGHT_SHIFT, TOKEN_UPPER_NAME, TOKEN_SEMICOLON, TOKEN_END
+    };
+    bool same = res && tokens.count == sizeof(expected) / sizeof(expected[0]);
+    for (size_t i = 0; same && i < tokens.count; i++) {
+        same = tokens.tokens[i].type == expected[i];
+    }
+    test(same, "tokenize");
+    test(res && tokens.tokens[1].line == 2, "tokenize counts comment lines");
+    test(res && tokens.tokens[3].symbol != tokens.tokens[5].symbol
+        && tokens.tokens[1].symbol != SYMBOL_NONE,
+        "tokenize interns names");
+    freeTokens(&tokens);
+
+    struct Error error = { 0 };
+    lexer.error = &error;
+    test(!tokenize(&lexer, &tokens, "type $") && error.kind != NULL,
+        "tokenize reports illegal characters");
+    freeTokens(&tokens);
+
+    freeSymbols(&symbols);
+    arenaFree(&arena);
+}
+
+// head, open depth times, close depth times and tail
+static char* nested(
+    const char* head,
+    const char* open,
+    const char* close,
+    const char* tail,
+    size_t      depth
+) {
+    size_t open_length = strlen(open);
+    size_t close_length = strlen(close);
+    char* res = memoryAlloc(strlen(head) + strlen(tail) + 1
+        + depth * (open_length + close_length));
+    char* at = stpcpy(res, head);
+    for (size_t i = 0; i < depth; i++) {
+        at = stpcpy(at, open);
+    }
+    for (size_t i = 0; i < depth; i++) {
+        at = stpcpy(at, close);
+    }
+    stpcpy(at, tail);
+    return res;
+}
+
+static void testParse(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "import A.b as c;\n"
+        "type T <A> = Maybe<Maybe<A>>;\n"
+        "type E enum { a; b: Int; }\n",
+        &file
+    );
+    test(res && file.ast.decls.count == 3, "parse declarations");
+    test(res && file.ast.imports.items[0].path.names.count == 2, "parse paths");
+    struct TypeDecl alias = file.ast.type_decls.items[0];
+    test(res && alias.type == TYPE_TYPE && alias._type.args.count == 1
+        && file.ast.types.items[alias._type.args.start].args.count == 1,
+        "parse nested type arguments");
+    test(res && file.ast.type_decls.items[1]._enum.count == 2, "parse enums");
+
+    test(!reparseSource("type T = ;", &file)
+        && file.error.line == 1 && file.error.kind != NULL,
+        "parse reports syntax errors");
+
+    freeFixture(&file);
+}
+
+static enum ExpretionTypy typeOf(struct AST* ast, uint32_t expr) {
+    return ast -> expretions.items[expr].type;
+}
+
+static void testParseExpretions(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "func f(a: Int) Int {\n"
+        "    x += a[1] * -g(2, (3)) as Int8;\n"
+        "    if (a) { } else if (b) { } else { return; }\n"
+        "    return 1 + 2 * 3 - 4 << 5;\n"
+        "}\n",
+        &file
+    );
+    test(res && file.ast.funcs.count == 1
+        && file.ast.funcs.items[0].body.count == 3,
+        "parse functions");
+
+    struct Statement asign = file.ast.statements.items[
+        file.ast.statement_lists.items[file.ast.funcs.items[0].body.start]
+    ];
+    struct Expretion add =
+        file.ast.expretions.items[asign.statement_asign.value];
+    struct Expretion mul = file.ast.expretions.items[add.right];
+    test(res && asign.type == STATEMENT_ASIGN && add.type == EXPRETION_ADD
+        && mul.type == EXPRETION_MULTIPLY
+        && typeOf(&file.ast, mul.left) == EXPRETION_GET
+        && typeOf(&file.ast, mul.right) == EXPRETION_CAST,
+        "parse compound asignment, index, unary minus and cast");
+
+    struct Statement _if = file.ast.statements.items[
+        file.ast.statement_lists.items[file.ast.funcs.items[0].body.start + 1]
+    ];
+    test(res && _if.statement_if._else.count == 1,
+        "parse else if as a nested if");
+
+    struct Statement ret = file.ast.statements.items[
+        file.ast.statement_lists.items[file.ast.funcs.items[0].body.start + 2]
+    ];
+    struct Expretion shift =
+        file.ast.expretions.items[ret.statement_return.value];
+    struct Expretion sub = file.ast.expretions.items[shift.left];
+    test(res && shift.type == EXPRETION_LEFT_SHIFT
+        && sub.type == EXPRETION_SUBTRACT
+        && typeOf(&file.ast, sub.left) == EXPRETION_ADD,
+        "parse binding powers and left associativity");
+
+    // deeper than the C stack would take if every paren recursed
+    size_t depth = 1000000;
+    char* src = memoryAlloc(2 * depth + 64);
+    size_t length = sprintf(src, "func f() { return ");
+    memset(src + length, '(', depth);
+    length += depth;
+    length += sprintf(src + length, "1");
+    memset(src + length, ')', depth);
+    length += depth;
+    sprintf(src + length, "; }");
+    test(reparseSource(src, &file), "parse deep nesting");
+    memoryFree(src);
+
+    // the function body is one block more than the ifs
+    src = nested("func f() {", " if (x) {", "}", "}", PARSE_MAX_DEPTH - 1);
+    test(reparseSource(src, &file), "parse blocks nested as deep as allowed");
+    memoryFree(src);
+    src = nested("func f() {", " if (x) {", "}", "}", 300000);
+    test(!reparseSource(src, &file)
+        && strcmp(file.error.kind, "Syntax error") == 0
+        && file.error.line == 1
+        && strcmp(file.error.message, "nested deeper than 256 levels") == 0,
+        "parse reports blocks nested too deep");
+    memoryFree(src);
+    src = nested("func f() { if (x) {}", " else if (x) {}", "", "}", 300000);
+    test(!reparseSource(src, &file) && file.error.kind != NULL,
+        "parse reports else ifs nested too deep");
+    memoryFree(src);
+    src = nested("type T { a: A", "<A", ">", "; }", PARSE_MAX_DEPTH);
+    test(reparseSource(src, &file),
+        "parse type arguments nested as deep as allowed");
+    memoryFree(src);
+    src = nested("type T { a: A", "<A", ">", "; }", PARSE_MAX_DEPTH + 1);
+    test(!reparseSource(src, &file) && file.error.kind != NULL,
+        "parse reports type arguments nested too deep");
+    memoryFree(src);
+
+    test(!reparseSource("func f() { x = (1 + 2; }", &file)
+        && file.error.kind != NULL,
+        "parse reports unclosed parens");
+
+    freeFixture(&file);
+}
+
+// the value of the statement at index in the body of the first function
+static struct Expretion valueOf(struct AST* ast, uint32_t index) {
+    struct Statement statement = ast -> statements.items[
+        ast -> statement_lists.items[ast -> funcs.items[0].body.start + index]
+    ];
+    return ast -> expretions.items[statement.statement_var.value];
+}
+
+// the tree as printAST prints it, to compare two trees
+static char* printed(struct AST* ast) {
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    printAST(stream, ast);
+    fclose(stream);
+    return output;
+}
+
+static void testCache(void) {
+    char dir[] = "/tmp/mic-tests-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        test(false, "make a directory for the cache");
+        return;
+    }
+    const char* src =
+        "type Pair { a: Int; b: Float; }\n"
+        "func main() { var x = 1.5 + 2.0; }\n";
+    uint64_t key = cacheKey(src, strlen(src));
+    test(key != cacheKey(src, strlen(src) - 1),
+        "cache keys differ for different sources");
+
+    struct Fixture file;
+    struct Fixture cached;
+    bool res = parseSource(src, &file);
+    initFixture(&cached);
+    test(!loadCachedAST(dir, key, &cached.ast), "cache misses when empty");
+    if (res) {
+        storeCachedAST(dir, key, &file.ast);
+    }
+    res = res && loadCachedAST(dir, key, &cached.ast);
+    char* expected = printed(&file.ast);
+    char* output = printed(&cached.ast);
+    test(res && cached.ast.mapped != NULL
+        && strcmp(expected, output) == 0,
+        "cache hits map the same tree");
+    memoryFree(expected);
+    memoryFree(output);
+    freeFixture(&cached);
+
+    // an entry moved to the name of another key is stale
+    char path[256];
+    char other[256];
+    snprintf(path, sizeof(path), "%s/%016" PRIx64 ".ast", dir, key);
+    snprintf(other, sizeof(other), "%s/%016" PRIx64 ".ast", dir, key + 1);
+    initFixture(&cached);
+    test(rename(path, other) == 0 && !loadCachedAST(dir, key + 1, &cached.ast)
+        && cached.ast.mapped == NULL,
+        "cache rejects entries of another key");
+    freeFixture(&cached);
+
+    // a flipped byte after the header fails the check
+    rename(other, path);
+    FILE* stream = fopen(path, "r+b");
+    if (stream != NULL) {
+        fseek(stream, -1, SEEK_END);
+        int last = fgetc(stream);
+        fseek(stream, -1, SEEK_END);
+        fputc(last ^ 1, stream);
+        fclose(stream);
+    }
+    initFixture(&cached);
+    test(!loadCachedAST(dir, key, &cached.ast), "cache rejects broken entries");
+    freeFixture(&cached);
+
+    // the same source gives the same bytes, whatever the heap held before
+    if (res) {
+        storeCachedAST(dir, key, &file.ast);
+    }
+    freeFixture(&file);
+    char* junk[64];
+    for (size_t i = 0; i < 64; i++) {
+        junk[i] = memoryAlloc(16 * (i + 1) * (i + 1));
+        memset(junk[i], 0xa5, 16 * (i + 1) * (i + 1));
+    }
+    for (size_t i = 0; i < 64; i++) {
+        memoryFree(junk[i]);
+    }
+    res = parseSource(src, &file);
+    if (res) {
+        storeCachedAST(dir, key + 1, &file.ast);
+    }
+    snprintf(other, sizeof(other), "%s/%016" PRIx64 ".ast", dir, key + 1);
+    FILE* first = fopen(path, "rb");
+    FILE* second = fopen(other, "rb");
+    // the header differs in the key and the check that covers the key
+    bool same = first != NULL && second != NULL
+        && fseek(first, 32, SEEK_SET) == 0
+        && fseek(second, 32, SEEK_SET) == 0;
+    for (int c = 0; same && c != EOF;) {
+        c = fgetc(first);
+        same = c == fgetc(second);
+    }
+    if (first != NULL) {
+        fclose(first);
+    }
+    if (second != NULL) {
+        fclose(second);
+    }
+    test(res && same, "cache entries are the same bytes for the same source");
+    freeFixture(&file);
+    removeTestDir(dir);
+}
+
+static void testNumbers(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "func f() { var a = 100000000000000000000000.5; }",
+        &file
+    );
+    test(res && valueOf(&file.ast, 0).literal.type == LITERAL_FLOAT,
+        "lex floats with more digits than an integer holds");
+    res = reparseSource("func f() { var a = 1e309; }", &file);
+    test(!res && strcmp(file.error.message, "float literal out of range") == 0,
+        "lex rejects floats out of the range of a double");
+    res = reparseSource("func f() { var a = 18446744073709551616; }", &file);
+    test(!res
+        && strcmp(file.error.message, "integer literal out of range") == 0,
+        "lex rejects integers out of range");
+    freeFixture(&file);
+}
+
+static void testFold(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "func f(x: Int) {\n"
+        "    var a = 300 as Uint8;\n"
+        "    var b = 1 - 2;\n"
+        "    var c = (x << 0) * 1;\n"
+        "    var d = g() & 0;\n"
+        "    var e = 1 / 0;\n"
+        "}\n",
+        &file
+    );
+    size_t folded = foldAST(&file.ast);
+
+    struct Expretion a = valueOf(&file.ast, 0);
+    test(res && a.type == EXPRETION_CAST
+        && file.ast.expretions.items[a.expr].literal._int == 44,
+        "fold wraps around at the width of the type");
+
+    struct Expretion b = valueOf(&file.ast, 1);
+    test(b.type == EXPRETION_NEG
+        && file.ast.expretions.items[b.expr].literal._int == 1,
+        "fold negative constants");
+
+    struct Expretion c = valueOf(&file.ast, 2);
+    test(c.type == EXPRETION_LITERAL && c.literal.type == LITERAL_NAME,
+        "fold identities");
+
+    test(valueOf(&file.ast, 3).type == EXPRETION_BITWIZE_AND
+        && valueOf(&file.ast, 4).type == EXPRETION_DIVIDE,
+        "fold keeps calls and division by zero");
+    test(folded == 5, "fold counts the removed nodes");
+
+    freeFixture(&file);
+}
+
+static void testRun(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "import Cosole.stdout;\n"
+        "import File.write;\n"
+        "import Test.assert;\n"
+        "func fib(n: Int) Int {\n"
+        "    if (n < 2) { return n; }\n"
+        "    return fib(n - 1) + fib(n - 2);\n"
+        "}\n"
+        "func main() {\n"
+        "    var b: Uint8 = 250;\n"
+        "    b += 10;\n"
+        "    var n = 0;\n"
+        "    repead (3) { n += 1; }\n"
+        "    write(stdout, fib(15));\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, b);\n"
+        "    write(stdout, n);\n"
+        "    var c: Int8 = 8;\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, c / 259);\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, c << 257);\n"
+        "}\n"
+        "test { assert(fib(10) == 55); }\n"
+        "test { var zero = 0; assert(1 / zero == 0); }\n",
+        &file
+    );
+    struct Program program = { 0 };
+    res = res && lowerAST(&program, &file.ast, "<test>", &file.error);
+    test(res && program.main != NODE_NONE && program.tests.count == 2,
+        "lower functions and tests");
+
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    res = res && runFunction(&program, program.main, stream, &file.error);
+    fclose(stream);
+    test(res && strcmp(output, "610 43 2 0") == 0,
+        "run calls, loops and wrapping integers");
+    memoryFree(output);
+
+    test(res
+        && runFunction(&program, program.tests.items[0], NULL, &file.error),
+        "run a passing test");
+    test(res
+        && !runFunction(&program, program.tests.items[1], NULL, &file.error)
+        && strcmp(file.error.kind, "Runtime error") == 0,
+        "run reports division by zero");
+
+    freeProgram(&program);
+    freeFixture(&file);
+}
+
+/*
+ * What func main of src writes on the VM, folded first if is_folded. The
+ * error is set if it faults.
+ */
+static char* runOnVM(const char* src, bool is_folded, struct Error* error) {
+    struct Fixture file;
+    struct Program program = { 0 };
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    bool res = parseSource(src, &file);
+    if (res && is_folded) {
+        foldAST(&file.ast);
+    }
+    if (res && lowerAST(&program, &file.ast, "<test>", &file.error)) {
+        runFunction(&program, program.main, stream, &file.error);
+    }
+    fclose(stream);
+    (*error) = file.error;
+    freeProgram(&program);
+    freeFixture(&file);
+    return output;
+}
+
+// what a shell command writes, is_ok tells whether it exited with 0
+static char* runCommand(const char* command, bool* is_ok) {
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    FILE* pipe = popen(command, "r");
+    char buffer[256];
+    size_t count;
+    while (pipe != NULL && (count = fread(buffer, 1, sizeof(buffer), pipe))) {
+        fwrite(buffer, 1, count, stream);
+    }
+    (*is_ok) = pipe != NULL && pclose(pipe) == 0;
+    fclose(stream);
+    return output;
+}
+
+/*
+ * What func main of the parsed file writes to stdout and stderr as C,
+ * built by gcc the way the README says in dir. is_ok tells whether it
+ * exited with 0.
+ */
+static char* runFileAsC(struct Fixture* file, const char* dir, bool* is_ok) {
+    struct Layout layout = { 0 };
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    bool res = layoutTypes(&layout, &file -> ast, "<test>", &file -> error)
+        && emitC(stream, &file -> ast, &layout, "<test>", &file -> error);
+    fclose(stream);
+    freeLayout(&layout);
+    (*is_ok) = false;
+    if (!res) {
+        return output;
+    }
+    writeTestFile(dir, "main.c", output);
+    memoryFree(output);
+
+    char command[600];
+    snprintf(command, sizeof(command), "gcc -std=c11 -fwrapv -o %s/main"
+        " %s/main.c 2>&1 && %s/main 2>&1", dir, dir, dir);
+    return runCommand(command, is_ok);
+}
+
+static char* runAsC(const char* src, const char* dir, bool* is_ok) {
+    struct Fixture file;
+    char* output = NULL;
+    (*is_ok) = false;
+    if (parseSource(src, &file)) {
+        output = runFileAsC(&file, dir, is_ok);
+    }
+    freeFixture(&file);
+    return output;
+}
+
+static void testFoldTypes(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "func f(x: Int) {\n"
+        "    var a = (1 as Int8) * (300 as Int32);\n"
+        "    var b = (x as Uint8 & 0) - 1;\n"
+        "    var c = (x as Int8) * (1 as Int8);\n"
+        "    var d = (x as Int16) + (0 as Int8);\n"
+        "    var e = 1e300 * 1e300;\n"
+        "}\n",
+        &file
+    );
+    foldAST(&file.ast);
+    test(res && valueOf(&file.ast, 0).type == EXPRETION_MULTIPLY
+        && valueOf(&file.ast, 1).type == EXPRETION_SUBTRACT,
+        "fold keeps identities of another width");
+    test(valueOf(&file.ast, 2).type == EXPRETION_CAST
+        && valueOf(&file.ast, 3).type == EXPRETION_ADD,
+        "fold identities of the same type");
+    test(valueOf(&file.ast, 4).type == EXPRETION_MULTIPLY,
+        "fold leaves floats that overflow a double");
+    freeFixture(&file);
+
+    const char* src =
+        "import Cosole.stdout;\n"
+        "import File.write;\n"
+        "func main() {\n"
+        "    var x: Uint8 = 5;\n"
+        "    var y: Int32 = 300;\n"
+        "    write(stdout, (1 as Int8) * (300 as Int32));\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, (1 as Int8) * y); write(stdout, \" \");\n"
+        "    write(stdout, (1 as Uint64) * (-(96 as Int32)));\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, (x & 0) - 1); write(stdout, \" \");\n"
+        "    write(stdout, x * 1 - 6);\n"
+        "}\n";
+    struct Error error;
+    char* output = runOnVM(src, false, &error);
+    char* folded = runOnVM(src, true, &error);
+    test(strcmp(output, folded) == 0
+        && strcmp(folded, "44 44 18446744073709551520 255 255") == 0,
+        "folded mixed width operands run like unfolded ones");
+    memoryFree(output);
+    memoryFree(folded);
+}
+
+static void testEmitC(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "type Shape enum { empty; circle: Float; }\n"
+        "type Pair { a: Int; b: Uint8; }\n"
+        "func (self Pair) sum() Int { return self.a + self.b as Int; }\n"
+        "cfunc twice(x: Int) Int { return x * 2; }\n"
+        "func main() { var s = Shape.circle(1.5); }\n",
+        &file
+    );
+    struct Layout layout = { 0 };
+    res = res && layoutTypes(&layout, &file.ast, "<test>", &file.error);
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    res = res && emitC(stream, &file.ast, &layout, "<test>", &file.error);
+    fclose(stream);
+    freeLayout(&layout);
+    test(res
+        && strstr(output, "struct m_Shape {\n    uint8_t tag;\n")
+        && strstr(output, "static int64_t m_Pair_sum(m_Pair m_self)")
+        && strstr(output, "int64_t twice(int64_t m_x) {")
+        && strstr(output, "m_Shape m_s = ((m_Shape) { .tag = M_Shape_circle,"
+            " .as.m_circle = 1.5 });"),
+        "emit C for types, methods, cfuncs and enum values");
+    memoryFree(output);
+
+    res = reparseSource("func main() { var x = y; }", &file);
+    res = res && layoutTypes(&layout, &file.ast, "<test>", &file.error);
+    output = NULL;
+    stream = open_memstream(&output, &length);
+    res = res && !emitC(stream, &file.ast, &layout, "<test>", &file.error);
+    fclose(stream);
+    freeLayout(&layout);
+    test(res && length == 0 && strcmp(file.error.kind, "Compile error") == 0,
+        "emit C reports unknown names and writes nothing");
+    memoryFree(output);
+
+    freeFixture(&file);
+
+    char dir[] = "/tmp/mic-emitc-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        test(false, "emit C makes a directory to build in");
+        return;
+    }
+    const char* src =
+        "import Cosole.stdout;\n"
+        "import File.write;\n"
+        "func main() {\n"
+        "    var a: Int8 = 100;\n"
+        "    var m: Int8 = -128;\n"
+        "    var u: Uint8 = 250;\n"
+        "    var n = -9223372036854775808;\n"
+        "    write(stdout, a + a); write(stdout, \" \");\n"
+        "    write(stdout, (a + a) / 3); write(stdout, \" \");\n"
+        "    write(stdout, a * 3 % 7); write(stdout, \" \");\n"
+        "    write(stdout, m / -1); write(stdout, \" \");\n"
+        "    write(stdout, m % -1); write(stdout, \" \");\n"
+        "    write(stdout, -m); write(stdout, \" \");\n"
+        "    write(stdout, a / 259); write(stdout, \" \");\n"
+        "    write(stdout, u + 10); write(stdout, \" \");\n"
+        "    write(stdout, ~u); write(stdout, \" \");\n"
+        "    write(stdout, u / -1); write(stdout, \" \");\n"
+        "    write(stdout, a << 1); write(stdout, \" \");\n"
+        "    write(stdout, a << 64); write(stdout, \" \");\n"
+        "    write(stdout, m >> 100); write(stdout, \" \");\n"
+        "    write(stdout, n); write(stdout, \" \");\n"
+        "    write(stdout, n / -1);\n"
+        "}\n";
+    struct Error error;
+    char* vm_output = runOnVM(src, false, &error);
+    bool is_ok;
+    char* c_output = runAsC(src, dir, &is_ok);
+    test(error.kind == NULL && is_ok && strcmp(vm_output, c_output) == 0
+        && strcmp(vm_output, "-56 -18 2 -128 0 -128 33 4 5 0 -56 0 -1"
+            " -9223372036854775808 -9223372036854775808") == 0,
+        "emitted C wraps and divides like the VM");
+    memoryFree(vm_output);
+    memoryFree(c_output);
+
+    src =
+        "import Cosole.stdout;\n"
+        "import File.write;\n"
+        "func main() {\n"
+        "    var a: Int8 = 1;\n"
+        "    var zero: Int8 = 0;\n"
+        "    write(stdout, a / zero);\n"
+        "}\n";
+    vm_output = runOnVM(src, false, &error);
+    c_output = runAsC(src, dir, &is_ok);
+    test(error.kind != NULL
+        && strstr(error.message, "division by zero") != NULL
+        && !is_ok
+        && strcmp(c_output, "Runtime error: division by zero\n") == 0,
+        "emitted C stops at a division by zero like the VM");
+    memoryFree(vm_output);
+    memoryFree(c_output);
+
+    // the lexer and fold never make them, but a literal can hold them
+    res = parseSource(
+        "import Cosole.stdout;\n"
+        "import File.write;\n"
+        "func main() {\n"
+        "    var a = 1.5;\n"
+        "    var b = 2.5;\n"
+        "    write(stdout, a); write(stdout, \" \");\n"
+        "    write(stdout, -a); write(stdout, \" \");\n"
+        "    write(stdout, b);\n"
+        "}\n",
+        &file
+    );
+    c_output = NULL;
+    is_ok = false;
+    if (res && file.ast.floats.count == 2) {
+        file.ast.floats.items[0] = INFINITY;
+        file.ast.floats.items[1] = NAN;
+        c_output = runFileAsC(&file, dir, &is_ok);
+    }
+    test(is_ok && strcmp(c_output, "inf -inf nan") == 0,
+        "emit C for floats that are not finite");
+    memoryFree(c_output);
+    freeFixture(&file);
+    removeTestDir(dir);
+}
+
+static void testMonomorphize(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "type Maybe <Type> enum { nothing; just: Type; }\n"
+        "type Array <Type> { buf: ref Type; lenght: Int; }\n"
+        "func (self Array <Type>) get(i: Int) ref Type { return self.buf; }\n"
+        "func first(a: Array<Int>) Maybe<Int> { return Maybe.nothing; }\n"
+        "func main() { var m: Maybe<Int> = Maybe.just(1); }\n",
+        &file
+    );
+    uint32_t type_decls = file.ast.type_decls.count;
+    res = res && monomorphize(&file.ast, "<test>", &file.error);
+    test(res && file.ast.type_decls.count == type_decls + 2,
+        "monomorphize instantiates every type once");
+
+    struct Layout layout = { 0 };
+    res = res && layoutTypes(&layout, &file.ast, "<test>", &file.error);
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    res = res && emitC(stream, &file.ast, &layout, "<test>", &file.error);
+    fclose(stream);
+    freeLayout(&layout);
+    test(res
+        && strstr(output, "struct m_Maybe__Int {")
+        && strstr(output, "m_Array__Int_get(m_Array__Int m_self,")
+        && strstr(output, "m_Maybe__Int m_m = ((m_Maybe__Int) { .tag ="
+            " M_Maybe__Int_just,"),
+        "emit C for instances of generic types and their methods");
+    memoryFree(output);
+
+    res = reparseSource(
+        "type Maybe <Type> enum { nothing; just: Type; }\n"
+        "func main(x: Maybe<Int, Int>) {}\n",
+        &file
+    );
+    res = res && !monomorphize(&file.ast, "<test>", &file.error);
+    test(res && strcmp(file.error.kind, "Compile error") == 0,
+        "monomorphize reports the wrong number of type arguments");
+
+    res = reparseSource(
+        "type Maybe <Type> enum { nothing; just: Type; }\n"
+        "func take(m: Maybe<Int>) {}\n"
+        "func main() {\n"
+        "    take(Maybe.nothing);\n"
+        "    var y: Maybe<Int> = Maybe.nothing;\n"
+        "    y = Maybe.just(3);\n"
+        "    var z: Maybe<Maybe<Int>> = Maybe.just(Maybe.nothing);\n"
+        "}\n",
+        &file
+    );
+    res = res && monomorphize(&file.ast, "<test>", &file.error);
+    output = printed(&file.ast);
+    test(res && strstr(output, "take(Maybe__Int.nothing);"),
+        "monomorphize retargets enum filds from the type of the param");
+    test(res && strstr(output, "y = Maybe__Int.just(3);"),
+        "monomorphize retargets enum filds from the type of an asign");
+    test(res && strstr(output,
+            "Maybe__Maybe__Int.just(Maybe__Int.nothing);"),
+        "monomorphize retargets enum filds from the type of a payload");
+    memoryFree(output);
+
+    res = reparseSource(
+        "type Maybe <Type> enum { nothing; just: Type; }\n"
+        "func main() { var y = Maybe.nothing; }\n",
+        &file
+    );
+    res = res && !monomorphize(&file.ast, "<test>", &file.error);
+    test(res && strstr(file.error.message,
+            "can not tell which Maybe Maybe.nothing is"),
+        "monomorphize reports enum filds of an unknown instance");
+
+    freeFixture(&file);
+}
+
+static void testLayout(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "type Loose { a: Int8; b: Int; c: Int8; }\n"
+        "export type Wire { a: Int8; b: Int; c: Int8; }\n"
+        "type Shape enum { empty; circle: Float; }\n",
+        &file
+    );
+    struct Layout layout = { 0 };
+    res = res && layoutTypes(&layout, &file.ast, "<test>", &file.error);
+    test(res
+        && layout.types[0].size == 16 && layout.types[0].padding == 6
+        && file.ast.filds.items[
+            file.ast.type_decls.items[0]._struct.start
+        ].name == internSymbol(&file.symbols, "b", 1)
+        && layout.types[1].size == 24 && layout.types[1].padding == 14
+        && layout.types[2].size == 16 && layout.types[2].payload == 8,
+        "layout reorders structs that are not exported by alignment");
+    freeLayout(&layout);
+
+    res = reparseSource(
+        "type Maybe <Type> enum { nothing; just: Type; }\n"
+        "type Tri enum { a; b; c; }\n"
+        "func main() {\n"
+        "    var p: Maybe<ref Int> = Maybe.nothing;\n"
+        "    var t: Maybe<Tri> = Maybe.just(Tri.c);\n"
+        "    var i: Maybe<Int> = Maybe.nothing;\n"
+        "}\n",
+        &file
+    );
+    res = res && monomorphize(&file.ast, "<test>", &file.error)
+       && layoutTypes(&layout, &file.ast, "<test>", &file.error);
+    test(res
+        && layout.types[2].size == 8 && layout.types[2].tag_size == 0
+        && layout.types[3].size == 1 && layout.types[3].tag_size == 0
+        && nicheValue(&layout, 3,
+            file.ast.type_decls.items[3]._enum.start) == 3
+        && layout.types[4].size == 16 && layout.types[4].tag_size == 1,
+        "layout keeps the tag of enums in a niche of their value");
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    res = res && emitC(stream, &file.ast, &layout, "<test>", &file.error);
+    fclose(stream);
+    freeLayout(&layout);
+    test(res
+        && strstr(output, "m_Maybe__ref_Int m_p = "
+            "m_Maybe__ref_Int_make(M_Maybe__ref_Int_nothing);")
+        && strstr(output, "((m_Maybe__Tri) { .as.m_just = "),
+        "emit C for enums with a niche");
+    memoryFree(output);
+
+    res = reparseSource("type Node { next: Node; }", &file);
+    res = res && !layoutTypes(&layout, &file.ast, "<test>", &file.error);
+    test(res && strcmp(file.error.kind, "Compile error") == 0,
+        "layout reports types that hold themselves");
+    freeLayout(&layout);
+
+    freeFixture(&file);
+}
+
+static void testPasses(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "func f(n: Int) Int {\n"
+        "    var x = 3;\n"
+        "    var s = 0;\n"
+        "    if (x > 2) { x = x * 2; } else { x = 0; }\n"
+        "    while (s < n) { s = s + x + n * 4; }\n"
+        "    return s;\n"
+        "}\n"
+        "func main() { f(10); }\n",
+        &file
+    );
+    struct IrModule module;
+    struct PassStat stats[PASS_COUNT];
+    res = res && buildIR(&module, &file.ast, "<test>", &file.error);
+    if (res) {
+        runPasses(&module, stats);
+    }
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    if (res) {
+        printIR(stream, &module);
+        freeIR(&module);
+    }
+    fclose(stream);
+    test(res
+        && strstr(output, "b3:") == NULL
+        && strstr(output, "    v11 Int = const 6\n"),
+        "sccp folds the constant branch away");
+    test(res
+        && strstr(output, "    v20 Int = multiply v0, v19\n    jump b4\n")
+        && strstr(output, "b4: ; preds b2, b6\n"),
+        "licm moves n * 4 in front of the loop");
+    memoryFree(output);
+
+    freeFixture(&file);
+}
+
+static void testNative(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "import Cosole.stdout;\n"
+        "import File.write;\n"
+        "import Test.assert;\n"
+        "func fib(n: Int) Int {\n"
+        "    if (n < 2) { return n; }\n"
+        "    return fib(n - 1) + fib(n - 2);\n"
+        "}\n"
+        "func mix(a: Int, b: Float, c: Int8, d: Int, e: Int, f: Int,\n"
+        "         g: Int, h: Int) Float {\n"
+        "    var n = d + e + f + g + h;\n"
+        "    return a as Float + b + c as Float + n as Float;\n"
+        "}\n"
+        "func main() {\n"
+        "    var b: Uint8 = 250;\n"
+        "    b += 10;\n"
+        "    write(stdout, fib(15));\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, b);\n"
+        "    write(stdout, \" \");\n"
+        "    write(stdout, mix(1, 0.5, 2, 3, 4, 5, 6, 7));\n"
+        "}\n"
+        "test { assert(fib(10) == 55); }\n"
+        "test { var zero = 0; assert(1 / zero == 0); }\n",
+        &file
+    );
+    struct IrModule module;
+    struct PassStat stats[PASS_COUNT];
+    struct NativeModule native = { 0 };
+    struct Jit jit = { 0 };
+    bool has_ir = res && buildIR(&module, &file.ast, "<test>", &file.error);
+    if (has_ir) {
+        runPasses(&module, stats);
+    }
+    res = has_ir
+       && compileNative(&native, &module, NATIVE_TARGET_JIT, &file.error)
+       && loadJit(&jit, &native, &file.error);
+    test(res && native.relocs.count > 0, "compile and load machine code");
+
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    res = res && runJit(&jit, &module, module.main, stream, &file.error);
+    fclose(stream);
+    test(res && strcmp(output, "610 4 28.5") == 0,
+        "run machine code with calls, wrapping and stack arguments");
+    memoryFree(output);
+
+    test(res && runJit(&jit, &module, module.tests.items[0], NULL, &file.error),
+        "run a passing test as machine code");
+    test(res && !runJit(&jit, &module, module.tests.items[1], NULL, &file.error)
+        && strcmp(file.error.message, "division by zero, in test 2") == 0,
+        "machine code faults like the vm");
+
+    struct NativeModule object = { 0 };
+    output = NULL;
+    stream = open_memstream(&output, &length);
+    res = has_ir
+       && compileNative(&object, &module, NATIVE_TARGET_OBJECT, &file.error);
+    if (res) {
+        writeObject(stream, &object);
+    }
+    fclose(stream);
+    Elf64_Ehdr header = { 0 };
+    if (length >= sizeof(header)) {
+        memcpy(&header, output, sizeof(header));
+    }
+    test(res
+        && memcmp(header.e_ident, ELFMAG, SELFMAG) == 0
+        && header.e_type == ET_REL
+        && header.e_machine == EM_X86_64,
+        "write machine code as an ELF object");
+    memoryFree(output);
+    freeNative(&object);
+
+    freeJit(&jit);
+    freeNative(&native);
+    if (has_ir) {
+        freeIR(&module);
+    }
+    freeFixture(&file);
+}
+
+// an object linked by cc, which has no runJit to set the stack limit
+static void testObjectStack(void) {
+    char dir[] = "/tmp/mic-object-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        test(false, "make a directory to link an object in");
+        return;
+    }
+    struct Fixture file;
+    bool res = parseSource(
+        "func down(n: Int) Int { return down(n + 1) + 1; }\n"
+        "func main() { down(0); }\n",
+        &file
+    );
+    struct IrModule module;
+    struct PassStat stats[PASS_COUNT];
+    struct NativeModule object = { 0 };
+    bool has_ir = res && buildIR(&module, &file.ast, "<test>", &file.error);
+    if (has_ir) {
+        runPasses(&module, stats);
+    }
+    res = has_ir
+       && compileNative(&object, &module, NATIVE_TARGET_OBJECT, &file.error);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/main.o", dir);
+    FILE* stream = res ? fopen(path, "wb") : NULL;
+    char* output = NULL;
+    bool is_ok = true;
+    if (stream != NULL) {
+        writeObject(stream, &object);
+        fclose(stream);
+        char command[600];
+        snprintf(command, sizeof(command), "cc -o %s/main %s/main.o 2>&1"
+            " && %s/main 2>&1", dir, dir, dir);
+        output = runCommand(command, &is_ok);
+    }
+    test(!is_ok && output != NULL && strcmp(output,
+            "Runtime error <test>: stack overflow, in func down\n") == 0,
+        "objects fault on a stack overflow like the JIT");
+    memoryFree(output);
+
+    freeNative(&object);
+    if (has_ir) {
+        freeIR(&module);
+    }
+    freeFixture(&file);
+    removeTestDir(dir);
+}
+
+static void testInterface(void) {
+    struct Fixture file;
+    bool res = parseSource(
+        "import Cosole.stdout;\n"
+        "type Hidden { a: Int; }\n"
+        "export type Pair <T> { a: T; b: Maybe<T>; }\n"
+        "export func twice(x: Int) Int { return x * 2 + 0.5 as Int; }\n"
+        "export func count(n: Int) { while (n > 0) { n -= 1; } }\n"
+        "func hidden() {}\n"
+        "test { }\n",
+        &file
+    );
+
+    struct Fixture iface;
+    initFixture(&iface);
+    if (res) {
+        buildInterface(&iface.ast, &file.ast);
+    }
+    char* output = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&output, &length);
+    printAST(stream, &iface.ast);
+    fclose(stream);
+    test(res && iface.ast.type_decls.count == 1 && iface.ast.funcs.count == 2
+        && iface.ast.tests.count == 0
+        && iface.ast.funcs.items[0].body.count == 1
+        && iface.ast.funcs.items[1].body.count == 0
+        && iface.symbols.count < file.symbols.count
+        && strstr(output, "Hidden") == NULL
+        && strstr(output, "Pair") != NULL,
+        "keep only exported declarations and short bodies in interfaces");
+    memoryFree(output);
+
+    freeFixture(&iface);
+    freeFixture(&file);
+}
+
+static void testModules(void) {
+    char dir[] = "/tmp/mic-tests-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        test(false, "make a directory for modules");
+        return;
+    }
+    writeTestFile(dir, "main.micro",
+        "import Cosole.stdout;\n"
+        "import Shape.Point;\n"
+        "import util.twice;\n"
+        "func main() {}\n");
+    writeTestFile(dir, "shape.micro",
+        "import util.twice;\n"
+        "export type Point { x: Int; y: Int; }\n");
+    writeTestFile(dir, "util.micro",
+        "export func twice(x: Int) Int { return x + x; }\n"
+        "func hidden() {}\n");
+    writeTestFile(dir, "hidden.micro", "import util.hidden;\n");
+    writeTestFile(dir, "a.micro", "import b.f;\nexport func f() {}\n");
+    writeTestFile(dir, "b.micro", "import a.f;\nexport func f() {}\n");
+
+    char main[256], hidden[256], cycle[256];
+    snprintf(main, sizeof(main), "%s/main.micro", dir);
+    snprintf(hidden, sizeof(hidden), "%s/hidden.micro", dir);
+    snprintf(cycle, sizeof(cycle), "%s/a.micro", dir);
+
+    struct Modules modules;
+    const char* paths[] = { main, main };
+    bool res = loadModules(&modules, paths, NULL, 2, 2);
+    test(res && modules.items.count == 4 && modules.waves == 3
+        && modules.items.items[0] -> wave == 2
+        && modules.items.items[3] -> wave == 0,
+        "load imported files once, in topological waves");
+    freeModules(&modules);
+
+    paths[0] = hidden;
+    res = loadModules(&modules, paths, NULL, 1, 2);
+    test(!res && strstr(modules.items.items[0] -> error.message,
+        "hidden is not exported") != NULL,
+        "imported names have to be exported");
+    freeModules(&modules);
+
+    char missing[256];
+    snprintf(missing, sizeof(missing), "%s/missing.micro", dir);
+    paths[0] = main;
+    paths[1] = missing;
+    res = loadModules(&modules, paths, NULL, 2, 2);
+    test(!res && !modules.items.items[0] -> failed
+        && modules.items.items[1] -> failed
+        && strcmp(modules.items.items[1] -> error.kind, "File error") == 0
+        && strcmp(modules.items.items[1] -> error.file, missing) == 0,
+        "a file that cannot be read fails only its own module");
+    freeModules(&modules);
+
+    paths[0] = cycle;
+    res = loadModules(&modules, paths, NULL, 1, 2);
+    test(!res && strstr(modules.items.items[0] -> error.message,
+        "import cycle") != NULL,
+        "find import cycles");
+    freeModules(&modules);
+
+    // the second time util.micro and shape.micro are their interfaces
+    char cache[256];
+    snprintf(cache, sizeof(cache), "%s/cache", dir);
+    mkdir(cache, 0777);
+    args.cache_dir = cache;
+    paths[0] = main;
+    res = loadModules(&modules, paths, NULL, 1, 2);
+    freeModules(&modules);
+    res = res && loadModules(&modules, paths, NULL, 1, 2);
+    test(res && !modules.items.items[0] -> is_interface
+        && modules.items.items[1] -> is_interface
+        && modules.items.items[2] -> is_interface
+        && modules.items.items[2] -> ast.funcs.count == 1,
+        "load imported files as their interfaces");
+    freeModules(&modules);
+
+    // an edit that keeps the size and the time of the file
+    char util[256];
+    snprintf(util, sizeof(util), "%s/util.micro", dir);
+    struct stat info;
+    stat(util, &info);
+    writeTestFile(dir, "util.micro",
+        "export func twice(x: Int) Int { return x * x; }\n"
+        "func hidden() {}\n");
+    struct timespec times[2] = { info.st_atim, info.st_mtim };
+    utimensat(AT_FDCWD, util, times, 0);
+    res = loadModules(&modules, paths, NULL, 1, 2);
+    test(res && !modules.items.items[2] -> is_interface,
+        "interfaces are of the bytes of the file, not of its time");
+    freeModules(&modules);
+    args.cache_dir = NULL;
+    removeTestDir(cache);
+    removeTestDir(dir);
+}
+
+static void testCompileOutput(void) {
+    char dir[] = "/tmp/mic-output-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        test(false, "make a directory for the output");
+        return;
+    }
+    writeTestFile(dir, "good.micro", "func main() { var x = 1; }\n");
+    writeTestFile(dir, "bad.micro", "func main() { var x = y; }\n");
+    writeTestFile(dir, "out.c", "old");
+    char good[256];
+    char bad[256];
+    char output[256];
+    snprintf(good, sizeof(good), "%s/good.micro", dir);
+    snprintf(bad, sizeof(bad), "%s/bad.micro", dir);
+    snprintf(output, sizeof(output), "%s/out.c", dir);
+    const char* paths[] = { good, bad };
+    args.output = output;
+    args.emit = EMIT_C;
+    args.jobs = 1;
+
+    // the errors would end up between the results
+    fflush(stderr);
+    int saved = dup(STDERR_FILENO);
+    FILE* null = fopen("/dev/null", "w");
+    if (null != NULL) {
+        dup2(fileno(null), STDERR_FILENO);
+        fclose(null);
+    }
+    bool res = compile(paths, 2);
+    char text[8] = { 0 };
+    FILE* stream = fopen(output, "r");
+    if (stream != NULL) {
+        fread(text, 1, sizeof(text) - 1, stream);
+        fclose(stream);
+    }
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+    test(!res && strcmp(text, "old") == 0,
+        "a failed compile leaves the output file as it was");
+
+    res = compile(paths, 1);
+    stream = fopen(output, "r");
+    if (stream != NULL) {
+        fread(text, 1, sizeof(text) - 1, stream);
+        fclose(stream);
+    }
+    test(res && strcmp(text, "#includ") == 0,
+        "a compile that works writes the output file");
+
+    args.output = NULL;
+    args.emit = EMIT_AST;
+    args.jobs = 0;
+    removeTestDir(dir);
+}
+
+int main(void) {
+    testMatch();
+    testScan();
+    testReadFile();
+    testTimeReport();
+    testMemoryReport();
+    testKeywords();
+    testTokenize();
+    testParse();
+    testParseExpretions();
+    testCache();
+    testNumbers();
+    testFold();
+    testFoldTypes();
+    testRun();
+    testEmitC();
+    testMonomorphize();
+    testLayout();
+    testPasses();
+    testNative();
+    testObjectStack();
+    testCompileOutput();
+    testInterface();
+    testModules();
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,277 @@
+#include <stdbool.h>
+// for: bool
+#include <stdio.h>
+// for: fprintf, fputc
+#include <string.h>
+// for: memmove, strcmp
+#include <time.h>
+// for: clock_gettime, CLOCK_MONOTONIC, CLOCK_THREAD_CPUTIME_ID
+
+#include "memory.h"
+#include "timing.h"
+
+static _Thread_local struct Timings* attached;
+
+static double timeOf(clockid_t clock) {
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+double timeWall(void) {
+    return timeOf(CLOCK_MONOTONIC);
+}
+
+double timeProcessCpu(void) {
+    return timeOf(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+struct Timings* timingsAttach(struct Timings* timings) {
+    struct Timings* res = attached;
+    attached = timings;
+    return res;
+}
+
+void freeTimings(struct Timings* timings) {
+    memoryFree(timings -> items);
+    (*timings) = (struct Timings) { 0 };
+}
+
+static struct Timing* pushTiming(struct Timings* timings, size_t at) {
+    if (timings -> count == timings -> capacity) {
+        timings -> capacity = timings -> capacity == 0
+            ? 16
+            : timings -> capacity * 2;
+        timings -> items = memoryRealloc(
+            timings -> items,
+            timings -> capacity * sizeof(struct Timing)
+        );
+    }
+    memmove(
+        timings -> items + at + 1,
+        timings -> items + at,
+        (timings -> count - at) * sizeof(struct Timing)
+    );
+    timings -> count++;
+    return &timings -> items[at];
+}
+
+// an open phase holds minus its start times until it ends
+void timeBegin(const char* name) {
+    struct Timings* timings = attached;
+    if (timings == NULL) {
+        return;
+    }
+    if (timings -> depth < TIMING_DEPTH) {
+        timings -> open[timings -> depth] = timings -> count;
+    }
+    (*pushTiming(timings, timings -> count)) = (struct Timing) {
+        .name  = name,
+        .depth = timings -> depth,
+        .wall  = -timeWall(),
+        .cpu   = -timeOf(CLOCK_THREAD_CPUTIME_ID)
+    };
+    timings -> depth++;
+}
+
+void timeEnd(void) {
+    struct Timings* timings = attached;
+    if (timings == NULL || timings -> depth == 0) {
+        return;
+    }
+    timings -> depth--;
+    if (timings -> depth < TIMING_DEPTH) {
+        struct Timing* timing = &timings -> items[
+            timings -> open[timings -> depth]
+        ];
+        timing -> wall += timeWall();
+        timing -> cpu  += timeOf(CLOCK_THREAD_CPUTIME_ID);
+    }
+}
+
+/*
+ * Adds the phases of from to total, a phase is the same if it has the same
+ * name under the same parent. Phases total has not seen yet go after the
+ * last child of their parent, so every phase stays under its parent.
+ */
+static void sumTimings(struct Timings* total, struct Timings* from) {
+    size_t parents[TIMING_DEPTH];
+    for (size_t i = 0; i < from -> count; i++) {
+        struct Timing timing = from -> items[i];
+        if (timing.depth >= TIMING_DEPTH) {
+            continue;
+        }
+        size_t at = timing.depth == 0 ? 0 : parents[timing.depth - 1] + 1;
+        bool found = false;
+        for (; at < total -> count; at++) {
+            struct Timing* item = &total -> items[at];
+            if (item -> depth < timing.depth) {
+                break;
+            }
+            if (item -> depth == timing.depth
+             && strcmp(item -> name, timing.name) == 0) {
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            total -> items[at].wall += timing.wall;
+            total -> items[at].cpu  += timing.cpu;
+        } else {
+            (*pushTiming(total, at)) = timing;
+        }
+        parents[timing.depth] = at;
+    }
+}
+
+static void printTableRows(
+    FILE*           stream,
+    struct Timings* timings,
+    double          wall
+) {
+    for (size_t i = 0; i < timings -> count; i++) {
+        struct Timing timing = timings -> items[i];
+        int indent = 2 + 2 * timing.depth;
+        fprintf(
+            stream,
+            "%*s%-*s %12.3f %12.3f %6.1f%%\n",
+            indent,
+            "",
+            32 - indent,
+            timing.name,
+            timing.wall * 1e3,
+            timing.cpu * 1e3,
+            wall > 0 ? timing.wall / wall * 100 : 0.0
+        );
+    }
+}
+
+static void printTable(
+    FILE*           stream,
+    struct Timings* driver,
+    const char**    paths,
+    struct Timings* files,
+    size_t          count,
+    struct Timings* total,
+    double          wall,
+    double          cpu
+) {
+    fprintf(
+        stream,
+        "time report: %zu files, %.3f ms wall, %.3f ms cpu\n",
+        count,
+        wall * 1e3,
+        cpu * 1e3
+    );
+    fprintf(stream, "%-32s %12s %12s %7s\n",
+        "phase", "wall ms", "cpu ms", "wall");
+    fprintf(stream, "driver\n");
+    printTableRows(stream, driver, wall);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(stream, "%s\n", paths[i]);
+        printTableRows(stream, &files[i], wall);
+    }
+    fprintf(stream, "all files\n");
+    printTableRows(stream, total, wall);
+}
+
+static void printJsonString(FILE* stream, const char* str) {
+    fputc('"', stream);
+    for (; *str != 0; str++) {
+        unsigned char ch = *str;
+        if (ch == '"' || ch == '\\') {
+            fprintf(stream, "\\%c", ch);
+        } else if (ch < 0x20) {
+            fprintf(stream, "\\u%04x", ch);
+        } else {
+            fputc(ch, stream);
+        }
+    }
+    fputc('"', stream);
+}
+
+// the phases from *index on that are at depth, with their children
+static void printJsonPhases(
+    FILE*           stream,
+    struct Timings* timings,
+    size_t*         index,
+    uint32_t        depth
+) {
+    fprintf(stream, "[");
+    bool first = true;
+    while (*index < timings -> count
+        && timings -> items[*index].depth == depth) {
+        struct Timing timing = timings -> items[(*index)++];
+        fprintf(stream, first ? "" : ", ");
+        first = false;
+        fprintf(stream, "{\"name\": ");
+        printJsonString(stream, timing.name);
+        fprintf(stream, ", \"wall\": %.9f, \"cpu\": %.9f", timing.wall,
+            timing.cpu);
+        if (*index < timings -> count
+         && timings -> items[*index].depth > depth) {
+            fprintf(stream, ", \"phases\": ");
+            printJsonPhases(stream, timings, index, depth + 1);
+        }
+        fprintf(stream, "}");
+    }
+    fprintf(stream, "]");
+}
+
+static void printJsonTimings(FILE* stream, struct Timings* timings) {
+    size_t index = 0;
+    printJsonPhases(stream, timings, &index, 0);
+}
+
+static void printJson(
+    FILE*           stream,
+    struct Timings* driver,
+    const char**    paths,
+    struct Timings* files,
+    size_t          count,
+    struct Timings* total,
+    double          wall,
+    double          cpu
+) {
+    fprintf(stream, "{\n  \"wall\": %.9f,\n  \"cpu\": %.9f,\n", wall, cpu);
+    fprintf(stream, "  \"driver\": ");
+    printJsonTimings(stream, driver);
+    fprintf(stream, ",\n  \"files\": [\n");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(stream, "    {\"path\": ");
+        printJsonString(stream, paths[i]);
+        fprintf(stream, ", \"phases\": ");
+        printJsonTimings(stream, &files[i]);
+        fprintf(stream, "}%s\n", i + 1 == count ? "" : ",");
+    }
+    fprintf(stream, "  ],\n  \"total\": ");
+    printJsonTimings(stream, total);
+    fprintf(stream, "\n}\n");
+}
+
+void printTimeReport(
+    FILE*           stream,
+    enum TimeReport format,
+    struct Timings* driver,
+    const char**    paths,
+    struct Timings* files,
+    size_t          count,
+    double          wall,
+    double          cpu
+) {
+    struct Timings total = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        sumTimings(&total, &files[i]);
+    }
+    switch (format) {
+    case TIME_REPORT_NONE:
+        break;
+    case TIME_REPORT_TABLE:
+        printTable(stream, driver, paths, files, count, &total, wall, cpu);
+        break;
+    case TIME_REPORT_JSON:
+        printJson(stream, driver, paths, files, count, &total, wall, cpu);
+        break;
+    }
+    freeTimings(&total);
+}
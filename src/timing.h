@@ -0,0 +1,65 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Phase timings for --time-report. A thread records into the Timings
+ * attached to it, every timeBegin opens a phase nested in the ones still
+ * open and timeEnd closes the innermost one. Without attached Timings
+ * both do nothing, so phases can be marked anywhere without asking
+ * whether a report was requested.
+ */
+
+#define TIMING_DEPTH 16
+
+enum TimeReport {
+    TIME_REPORT_NONE,
+    TIME_REPORT_TABLE,
+    TIME_REPORT_JSON,
+};
+
+struct Timing {
+    const char* name;           // static, phases are compared by name
+    uint32_t    depth;
+    double      wall;           // seconds, monotonic
+    double      cpu;            // seconds of this thread
+};
+
+struct Timings {
+    struct Timing* items;       // in the order the phases began
+    size_t         count;
+    size_t         capacity;
+    uint32_t       depth;
+    size_t         open[TIMING_DEPTH];
+};
+
+// returns what was attached before, attach NULL to stop recording
+struct Timings* timingsAttach(struct Timings* timings);
+void            freeTimings(struct Timings* timings);
+
+void timeBegin(const char* name);
+void timeEnd(void);
+
+/*
+ * driver is the main thread, files[i] the phases of paths[i]. Phases are
+ * also summed up by name over all files. wall and cpu are of the whole
+ * process.
+ */
+void printTimeReport(
+    FILE*           stream,
+    enum TimeReport format,
+    struct Timings* driver,
+    const char**    paths,
+    struct Timings* files,
+    size_t          count,
+    double          wall,
+    double          cpu
+);
+
+double timeWall(void);
+double timeProcessCpu(void);
+
+#endif
@@ -0,0 +1,675 @@
+#include <inttypes.h>
+// for: PRId64, PRIu64
+#include <stdbool.h>
+// for: bool
+#include <stdio.h>
+// for: fprintf, fwrite
+#include <string.h>
+// for: memcmp, memset
+
+#include "builtin.h"
+#include "bytecode.h"
+#include "memory.h"
+#include "vm.h"
+
+#define RUNTIME_ERROR "Runtime error"
+#define VM_MAX_DEPTH  (1 << 18)
+
+enum Fault {
+    FAULT_NONE,
+    FAULT_TYPES,
+    FAULT_DIVISION,
+    FAULT_SHIFT,
+    FAULT_CAST,
+    FAULT_STACK,
+    FAULT_ASSERT,
+    FAULT_FILE,
+};
+
+static const char* const fault_messages[] = {
+    [FAULT_NONE]     = "no fault",
+    [FAULT_TYPES]    = "operand types do not fit the operator",
+    [FAULT_DIVISION] = "division by zero",
+    [FAULT_SHIFT]    = "negative shift count",
+    [FAULT_CAST]     = "value out of the range of the cast",
+    [FAULT_STACK]    = "stack overflow",
+    [FAULT_ASSERT]   = "assertion failed",
+    [FAULT_FILE]     = "write to something that is not a file",
+};
+
+struct CallFrame {
+    uint32_t                  function;
+    uint32_t                  base;
+    const struct Instruction* ip;
+};
+
+struct VM {
+    struct Program*         program;
+    FILE*                   streams[3];     // by VM_STDOUT and VM_STDERR
+    struct Value*           stack;
+    uint32_t                stack_size;
+    NODES(struct CallFrame) frames;         // of the callers
+    uint32_t                function;       // running when it faulted
+};
+
+static inline bool isInt(const struct Value* value) {
+    return value -> type == VALUE_INT || value -> type == VALUE_UINT;
+}
+
+// false, 0, 0.0 and None are false
+static inline bool isTrue(const struct Value* value) {
+    return value -> type == VALUE_FLOAT
+        ? value -> _float != 0
+        : value -> _uint != 0;
+}
+
+static inline struct Value boolValue(bool value) {
+    return (struct Value) {
+        .type  = VALUE_BOOL,
+        .bits  = 8,
+        ._uint = value
+    };
+}
+
+static inline struct Value floatValue(double value, uint8_t bits) {
+    return (struct Value) {
+        .type   = VALUE_FLOAT,
+        .bits   = bits,
+        ._float = bits == 32 ? (float) value : value
+    };
+}
+
+// the type of the result, plain Int and Float take the type of the right
+static inline struct Value resultType(
+    const struct Value* left,
+    const struct Value* right
+) {
+    const struct Value* type = left -> bits == 64
+                            && left -> type != VALUE_UINT
+        ? right
+        : left;
+    return (struct Value) {
+        .type = type -> type,
+        .bits = type -> bits
+    };
+}
+
+static inline uint64_t wrapResult(struct Value type, uint64_t value) {
+    return wrapInt(value, type.type == VALUE_INT, type.bits);
+}
+
+// plain Int and Float are 64 bits wide but have no type of their own yet
+static inline bool isPlain(const struct Value* value) {
+    return value -> bits == 64 && value -> type != VALUE_UINT;
+}
+
+/*
+ * A plain operand next to a typed one is converted to that type first,
+ * like fold does with its literals, so b / 259 with an Int8 b divides by
+ * 3. Only division needs it: the other operators wrap the same either way
+ * and the count of a shift keeps its value, in fold too.
+ */
+static void commonType(struct Value* left, struct Value* right) {
+    if (isPlain(left) == isPlain(right)) {
+        return;
+    }
+    struct Value* plain = isPlain(left) ? left : right;
+    const struct Value* typed = plain == left ? right : left;
+    if (isInt(plain) && isInt(typed)) {
+        plain -> type  = typed -> type;
+        plain -> bits  = typed -> bits;
+        plain -> _uint = wrapResult(*typed, plain -> _uint);
+    } else if (plain -> type == VALUE_FLOAT && typed -> type == VALUE_FLOAT) {
+        (*plain) = floatValue(plain -> _float, typed -> bits);
+    }
+}
+
+static enum Fault divide(
+    struct Value* res,
+    struct Value  left_value,
+    struct Value  right_value,
+    bool          is_modulo
+) {
+    commonType(&left_value, &right_value);
+    const struct Value* left = &left_value;
+    const struct Value* right = &right_value;
+    if (!isInt(left) || !isInt(right)) {
+        if (is_modulo
+         || left -> type != VALUE_FLOAT
+         || right -> type != VALUE_FLOAT) {
+            return FAULT_TYPES;
+        }
+        (*res) = floatValue(
+            left -> _float / right -> _float,
+            resultType(left, right).bits
+        );
+        return FAULT_NONE;
+    }
+    if (right -> _uint == 0) {
+        return FAULT_DIVISION;
+    }
+    struct Value type = resultType(left, right);
+    uint64_t a = left -> _uint;
+    uint64_t b = right -> _uint;
+    uint64_t value;
+    if (type.type != VALUE_INT) {
+        value = is_modulo ? a % b : a / b;
+    } else if ((int64_t) a == INT64_MIN && (int64_t) b == -1) {
+        // wraps like the multiplication it undoes
+        value = is_modulo ? 0 : a;
+    } else {
+        value = is_modulo
+            ? (uint64_t) ((int64_t) a % (int64_t) b)
+            : (uint64_t) ((int64_t) a / (int64_t) b);
+    }
+    (*res) = type;
+    res -> _uint = wrapResult(type, value);
+    return FAULT_NONE;
+}
+
+// shifts by the width or more give 0, or -1 for a negative signed value
+static enum Fault shift(
+    struct Value*       res,
+    const struct Value* left,
+    const struct Value* right,
+    bool                is_left
+) {
+    if (!isInt(left) || !isInt(right)) {
+        return FAULT_TYPES;
+    }
+    if (right -> type == VALUE_INT && right -> _int < 0) {
+        return FAULT_SHIFT;
+    }
+    bool is_signed = left -> type == VALUE_INT;
+    uint64_t count = right -> _uint;
+    uint64_t value;
+    if (count >= left -> bits) {
+        value = !is_left && is_signed && left -> _int < 0 ? UINT64_MAX : 0;
+    } else if (is_left) {
+        value = left -> _uint << count;
+    } else if (is_signed) {
+        value = (uint64_t) (left -> _int >> count);
+    } else {
+        value = left -> _uint >> count;
+    }
+    (*res) = (struct Value) {
+        .type  = left -> type,
+        .bits  = left -> bits,
+        ._uint = wrapInt(value, is_signed, left -> bits)
+    };
+    return FAULT_NONE;
+}
+
+// values of different types are not equal, except integers of any width
+static bool equal(const struct Value* left, const struct Value* right) {
+    if (isInt(left) && isInt(right)) {
+        return left -> _uint == right -> _uint;
+    }
+    if (left -> type != right -> type) {
+        return false;
+    }
+    switch (left -> type) {
+    case VALUE_FLOAT:
+        return left -> _float == right -> _float;
+    case VALUE_STR:
+        return left -> length == right -> length
+            && memcmp(left -> str, right -> str, left -> length) == 0;
+    default:
+        return left -> _uint == right -> _uint;
+    }
+}
+
+// -1, 0 or 1, 2 if a float is not a number
+static enum Fault compare(
+    int*                res,
+    const struct Value* left,
+    const struct Value* right
+) {
+    if (isInt(left) && isInt(right)) {
+        if (resultType(left, right).type == VALUE_INT) {
+            (*res) = (left -> _int > right -> _int)
+                   - (left -> _int < right -> _int);
+        } else {
+            (*res) = (left -> _uint > right -> _uint)
+                   - (left -> _uint < right -> _uint);
+        }
+        return FAULT_NONE;
+    }
+    if (left -> type != right -> type) {
+        return FAULT_TYPES;
+    }
+    if (left -> type == VALUE_FLOAT) {
+        double a = left -> _float;
+        double b = right -> _float;
+        (*res) = a < b ? -1 : a > b ? 1 : a == b ? 0 : 2;
+        return FAULT_NONE;
+    }
+    if (left -> type == VALUE_STR) {
+        uint32_t length = left -> length < right -> length
+            ? left -> length
+            : right -> length;
+        int order = memcmp(left -> str, right -> str, length);
+        (*res) = order != 0
+            ? (order > 0) - (order < 0)
+            : (left -> length > right -> length)
+            - (left -> length < right -> length);
+        return FAULT_NONE;
+    }
+    return FAULT_TYPES;
+}
+
+static enum Fault cast(struct Value* res, struct Value value, uint16_t code) {
+    uint32_t type = code >> 8;
+    uint8_t bits = code & 0xff;
+    bool is_number = isInt(&value) || value.type == VALUE_BOOL;
+    switch (type) {
+    case BUILTIN_INT:
+    case BUILTIN_UINT: {
+        bool is_signed = type == BUILTIN_INT;
+        (*res) = (struct Value) {
+            .type = is_signed ? VALUE_INT : VALUE_UINT,
+            .bits = bits
+        };
+        if (is_number) {
+            res -> _uint = wrapInt(value._uint, is_signed, bits);
+            return FAULT_NONE;
+        }
+        if (value.type != VALUE_FLOAT) {
+            return FAULT_TYPES;
+        }
+        // out of range is undefined in C, a fault here
+        double limit = (double) (UINT64_C(1) << (bits - 1));
+        double low = is_signed ? -limit - 1 : -1;
+        double high = is_signed ? limit : limit * 2;
+        if (!(value._float > low && value._float < high)) {
+            return FAULT_CAST;
+        }
+        res -> _uint = is_signed
+            ? (uint64_t) (int64_t) value._float
+            : (uint64_t) value._float;
+        return FAULT_NONE;
+    }
+    case BUILTIN_FLOAT:
+        if (value.type == VALUE_FLOAT) {
+            (*res) = floatValue(value._float, bits);
+        } else if (is_number) {
+            (*res) = floatValue(
+                value.type == VALUE_INT
+                    ? (double) value._int
+                    : (double) value._uint,
+                bits
+            );
+        } else {
+            return FAULT_TYPES;
+        }
+        return FAULT_NONE;
+    case BUILTIN_BOOL:
+        if (!is_number && value.type != VALUE_FLOAT) {
+            return FAULT_TYPES;
+        }
+        (*res) = boolValue(isTrue(&value));
+        return FAULT_NONE;
+    default:
+        return FAULT_TYPES;
+    }
+}
+
+static void writeValue(FILE* stream, const struct Value* value) {
+    switch (value -> type) {
+    case VALUE_NONE:
+        fprintf(stream, "None");
+        break;
+    case VALUE_BOOL:
+        fprintf(stream, value -> _uint ? "true" : "false");
+        break;
+    case VALUE_INT:
+        fprintf(stream, "%" PRId64, value -> _int);
+        break;
+    case VALUE_UINT:
+        fprintf(stream, "%" PRIu64, value -> _uint);
+        break;
+    case VALUE_FLOAT:
+        fprintf(stream, "%g", value -> _float);
+        break;
+    case VALUE_STR:
+        fwrite(value -> str, 1, value -> length, stream);
+        break;
+    case VALUE_FILE:
+        fprintf(stream, "<file %" PRIu64 ">", value -> _uint);
+        break;
+    }
+}
+
+static void growStack(struct VM* vm, uint32_t size) {
+    uint32_t old = vm -> stack_size;
+    vm -> stack_size = old == 0 ? 1024 : old;
+    while (vm -> stack_size < size) {
+        vm -> stack_size *= 2;
+    }
+    vm -> stack = memoryReallocKind(
+        MEMORY_VM,
+        vm -> stack,
+        vm -> stack_size * sizeof(struct Value)
+    );
+    memset(
+        vm -> stack + old,
+        0,
+        (vm -> stack_size - old) * sizeof(struct Value)
+    );
+}
+
+/*
+ * The dispatch loop. Every handler ends by jumping straight to the handler
+ * of the next instruction through labels, so there is no central switch
+ * and the branch predictor sees one indirect jump per handler. This needs
+ * the labels as values extension of GCC and clang.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#define CASE(name) op_##name:
+#define DISPATCH()                                                          \
+    do {                                                                    \
+        ins = *ip++;                                                        \
+        goto *labels[ins.op];                                               \
+    } while (0)
+#define FAULT(what)                                                         \
+    do {                                                                    \
+        fault = (what);                                                     \
+        goto fault;                                                         \
+    } while (0)
+#define TRY(what)                                                           \
+    do {                                                                    \
+        fault = (what);                                                     \
+        if (fault != FAULT_NONE) {                                          \
+            goto fault;                                                     \
+        }                                                                   \
+    } while (0)
+
+/*
+ * A binary op and its _INT twin, which takes c as an Int16 instead of a
+ * register. The handler reads its operands through left and right.
+ */
+#define BINARY(name, ...)                                                   \
+    CASE(name) {                                                            \
+        const struct Value* left = &r[ins.b];                               \
+        const struct Value* right = &r[ins.c];                              \
+        __VA_ARGS__                                                         \
+        DISPATCH();                                                         \
+    }                                                                       \
+    CASE(name##_INT) {                                                      \
+        const struct Value* left = &r[ins.b];                               \
+        struct Value immediate = {                                          \
+            .type = VALUE_INT,                                              \
+            .bits = 64,                                                     \
+            ._int = (int16_t) ins.c                                         \
+        };                                                                  \
+        const struct Value* right = &immediate;                             \
+        __VA_ARGS__                                                         \
+        DISPATCH();                                                         \
+    }
+
+#define ARITHMETIC(name, op)                                                \
+    BINARY(name,                                                            \
+        struct Value res = resultType(left, right);                         \
+        if (isInt(left) && isInt(right)) {                                  \
+            res._uint = wrapResult(res, left -> _uint op right -> _uint);   \
+        } else if (left -> type == VALUE_FLOAT                              \
+                && right -> type == VALUE_FLOAT) {                          \
+            res = floatValue(left -> _float op right -> _float, res.bits);  \
+        } else {                                                            \
+            FAULT(FAULT_TYPES);                                             \
+        }                                                                   \
+        r[ins.a] = res;                                                     \
+    )
+
+#define BITWIZE(name, op)                                                   \
+    BINARY(name,                                                            \
+        if (!isInt(left) || !isInt(right)) {                                \
+            FAULT(FAULT_TYPES);                                             \
+        }                                                                   \
+        struct Value res = resultType(left, right);                         \
+        res._uint = wrapResult(res, left -> _uint op right -> _uint);       \
+        r[ins.a] = res;                                                     \
+    )
+
+#define COMPARE(name, test)                                                 \
+    BINARY(name,                                                            \
+        int order;                                                          \
+        TRY(compare(&order, left, right));                                  \
+        r[ins.a] = boolValue(test);                                         \
+    )
+
+static enum Fault execute(struct VM* vm, uint32_t entry) {
+    static void* const labels[OPCODE_COUNT] = {
+#define OPCODE_LABEL(name) &&op_##name,
+        OPCODES(OPCODE_LABEL)
+#undef OPCODE_LABEL
+    };
+    const struct Instruction* code = vm -> program -> code.items;
+    const struct Value* constants = vm -> program -> constants.items;
+    const struct Function* functions = vm -> program -> functions.items;
+
+    uint32_t function = entry;
+    uint32_t base = 0;
+    growStack(vm, functions[entry].registers);
+    struct Value* r = vm -> stack;
+    const struct Instruction* ip = code + functions[entry].start;
+    struct Instruction ins;
+    enum Fault fault;
+
+    DISPATCH();
+
+    CASE(MOVE) {
+        r[ins.a] = r[ins.b];
+        DISPATCH();
+    }
+    CASE(LOAD_INT) {
+        r[ins.a] = (struct Value) {
+            .type = VALUE_INT,
+            .bits = 64,
+            ._int = ins.offset
+        };
+        DISPATCH();
+    }
+    CASE(LOAD_CONST) {
+        r[ins.a] = constants[ins.index];
+        DISPATCH();
+    }
+
+    ARITHMETIC(ADD, +)
+    ARITHMETIC(SUBTRACT, -)
+    ARITHMETIC(MULTIPLY, *)
+    BINARY(DIVIDE,
+        TRY(divide(&r[ins.a], *left, *right, false));
+    )
+    BINARY(MODULO,
+        TRY(divide(&r[ins.a], *left, *right, true));
+    )
+    BITWIZE(BITWIZE_OR, |)
+    BITWIZE(BITWIZE_AND, &)
+    BINARY(LEFT_SHIFT,
+        TRY(shift(&r[ins.a], left, right, true));
+    )
+    BINARY(RIGHT_SHIFT,
+        TRY(shift(&r[ins.a], left, right, false));
+    )
+
+    BINARY(EQUAL,
+        r[ins.a] = boolValue(equal(left, right));
+    )
+    BINARY(NOT_EQUAL,
+        r[ins.a] = boolValue(!equal(left, right));
+    )
+    COMPARE(LESS_THEN, order == -1)
+    COMPARE(GREAT_THEN, order == 1)
+    COMPARE(LESS_THEN_OR_EQUAL, order == -1 || order == 0)
+    COMPARE(GREA_THEN_OR_EQUAL, order == 1 || order == 0)
+
+    CASE(NEG) {
+        struct Value value = r[ins.b];
+        if (isInt(&value)) {
+            value._uint = wrapResult(value, 0 - value._uint);
+        } else if (value.type == VALUE_FLOAT) {
+            value._float = -value._float;
+        } else {
+            FAULT(FAULT_TYPES);
+        }
+        r[ins.a] = value;
+        DISPATCH();
+    }
+    CASE(BITWIZE_NOT) {
+        struct Value value = r[ins.b];
+        if (!isInt(&value)) {
+            FAULT(FAULT_TYPES);
+        }
+        value._uint = wrapResult(value, ~value._uint);
+        r[ins.a] = value;
+        DISPATCH();
+    }
+    CASE(LOGICAL_NOT) {
+        r[ins.a] = boolValue(!isTrue(&r[ins.b]));
+        DISPATCH();
+    }
+    CASE(CAST) {
+        TRY(cast(&r[ins.a], r[ins.b], ins.c));
+        DISPATCH();
+    }
+
+    CASE(JUMP) {
+        ip += ins.offset;
+        DISPATCH();
+    }
+    CASE(JUMP_FALSE) {
+        if (!isTrue(&r[ins.a])) {
+            ip += ins.offset;
+        }
+        DISPATCH();
+    }
+    CASE(JUMP_TRUE) {
+        if (isTrue(&r[ins.a])) {
+            ip += ins.offset;
+        }
+        DISPATCH();
+    }
+    CASE(REPEAD) {
+        struct Value* counter = &r[ins.a];
+        if (!isInt(counter)) {
+            FAULT(FAULT_TYPES);
+        }
+        if (counter -> type == VALUE_INT ? counter -> _int <= 0
+                                         : counter -> _uint == 0) {
+            ip += ins.offset;
+        } else {
+            counter -> _uint--;
+        }
+        DISPATCH();
+    }
+
+    CASE(CALL) {
+        const struct Function* callee = &functions[ins.b];
+        if (vm -> frames.count == VM_MAX_DEPTH) {
+            FAULT(FAULT_STACK);
+        }
+        struct CallFrame frame = {
+            .function = function,
+            .base     = base,
+            .ip       = ip
+        };
+        pushNode(vm -> frames, MEMORY_VM, frame);
+        base += ins.a;
+        if (base + callee -> registers > vm -> stack_size) {
+            growStack(vm, base + callee -> registers);
+        }
+        function = ins.b;
+        r = vm -> stack + base;
+        ip = code + callee -> start;
+        DISPATCH();
+    }
+    CASE(NATIVE) {
+        struct Value* args = &r[ins.a];
+        switch (ins.b) {
+        case NATIVE_WRITE:
+            if (args[0].type != VALUE_FILE) {
+                FAULT(FAULT_FILE);
+            }
+            writeValue(vm -> streams[args[0]._uint], &args[1]);
+            break;
+        case NATIVE_ASSERT:
+            if (!isTrue(&args[0])) {
+                FAULT(FAULT_ASSERT);
+            }
+            break;
+        }
+        args[0] = (struct Value) { 0 };
+        DISPATCH();
+    }
+    // the result goes to the first register, where the caller wants it
+    CASE(RETURN) {
+        r[0] = r[ins.a];
+        goto leave;
+    }
+    CASE(RETURN_NONE) {
+        r[0] = (struct Value) { 0 };
+        goto leave;
+    }
+
+leave:
+    if (vm -> frames.count == 0) {
+        return FAULT_NONE;
+    } else {
+        struct CallFrame frame = vm -> frames.items[--vm -> frames.count];
+        function = frame.function;
+        base = frame.base;
+        ip = frame.ip;
+        r = vm -> stack + base;
+        DISPATCH();
+    }
+
+fault:
+    vm -> function = function;
+    return fault;
+}
+
+#undef CASE
+#undef DISPATCH
+#undef FAULT
+#undef TRY
+#undef BINARY
+#undef ARITHMETIC
+#undef BITWIZE
+#undef COMPARE
+
+#pragma GCC diagnostic pop
+
+bool runFunction(
+    struct Program* program,
+    uint32_t        function,
+    FILE*           out,
+    struct Error*   error
+) {
+    struct VM vm = {
+        .program = program,
+        .streams = { NULL, out, stderr }
+    };
+    enum Fault fault = execute(&vm, function);
+    if (fault != FAULT_NONE) {
+        uint32_t name = program -> functions.items[vm.function].name;
+        if (name == SYMBOL_NONE) {
+            uint32_t test = 0;
+            while (program -> tests.items[test] != vm.function) {
+                test++;
+            }
+            setError(error, RUNTIME_ERROR, program -> path, 0,
+                "%s, in test %u", fault_messages[fault], test + 1);
+        } else {
+            struct String string = symbolString(program -> symbols, name);
+            setError(error, RUNTIME_ERROR, program -> path, 0,
+                "%s, in func %.*s", fault_messages[fault],
+                (int) string.length, string.string);
+        }
+    }
+    memoryFree(vm.stack);
+    memoryFree(vm.frames.items);
+    return fault == FAULT_NONE;
+}
@@ -0,0 +1,24 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bytecode.h"
+#include "error.h"
+
+/*
+ * Runs Program.functions[function], which takes no arguments, until it
+ * returns. File.write to Cosole.stdout goes to out, to Cosole.stderr to
+ * stderr. Returns false and sets error when the program faults, like on
+ * a division by zero or a failed Test.assert.
+ */
+bool runFunction(
+    struct Program* program,
+    uint32_t        function,
+    FILE*           out,
+    struct Error*   error
+);
+
+#endif